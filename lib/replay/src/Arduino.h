@@ -0,0 +1,205 @@
+#pragma once
+
+// 主机重放用 Arduino 核心适配层: 只提供固件控制逻辑用到的接口,
+// millis()/micros() 返回重放驱动控制的虚拟时钟 (64 位, 不回绕), delay()/yield() 推进虚拟时钟
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <math.h>
+#include <time.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <string>
+
+#include "IPAddress.h"
+
+// 与 ESP8266 Arduino 核心一致使用 STL 版本
+using std::abs;
+using std::max;
+using std::min;
+
+#define PI 3.1415926535897932384626433832795
+#define constrain(amt, low, high) ((amt) < (low) ? (low) : ((amt) > (high) ? (high) : (amt)))
+
+#define HIGH 0x1
+#define LOW 0x0
+#define INPUT 0x00
+#define OUTPUT 0x01
+#define INPUT_PULLUP 0x02
+
+// NodeMCU 引脚编号
+#define D0 16
+#define D1 5
+#define D2 4
+#define D3 0
+#define D4 2
+#define D5 14
+#define D6 12
+#define D7 13
+#define D8 15
+#define RX 3
+#define TX 1
+#define A0 17
+
+#define IRAM_ATTR
+#define PROGMEM
+#define PGM_P const char *
+#define PSTR(s) (s)
+#define FPSTR(p) (reinterpret_cast<const __FlashStringHelper *>(p))
+#define F(s) FPSTR(PSTR(s))
+
+typedef uint8_t byte;
+
+class __FlashStringHelper;
+
+inline int vsnprintf_P(char *buf, size_t size, PGM_P format, va_list args) { return vsnprintf(buf, size, format, args); }
+inline int snprintf_P(char *buf, size_t size, PGM_P format, ...) __attribute__((format(printf, 3, 4)));
+inline int snprintf_P(char *buf, size_t size, PGM_P format, ...)
+{
+    va_list args;
+    va_start(args, format);
+    int n = vsnprintf(buf, size, format, args);
+    va_end(args);
+    return n;
+}
+inline size_t strlen_P(PGM_P s) { return strlen(s); }
+inline size_t strnlen_P(PGM_P s, size_t n) { return strnlen(s, n); }
+inline int strcmp_P(const char *a, PGM_P b) { return strcmp(a, b); }
+inline int strncmp_P(const char *a, PGM_P b, size_t n) { return strncmp(a, b, n); }
+inline int memcmp_P(const void *a, PGM_P b, size_t n) { return memcmp(a, b, n); }
+inline void *memcpy_P(void *dst, PGM_P src, size_t n) { return memcpy(dst, src, n); }
+
+// GPIO 及 PWM 输出在重放中没有外部效果, 电机输出由 RecorderService 记录
+inline void pinMode(uint8_t, uint8_t) {}
+inline void digitalWrite(uint8_t, uint8_t) {}
+inline int digitalRead(uint8_t) { return LOW; }
+inline void analogWrite(uint8_t, int) {}
+inline void analogWriteRange(uint32_t) {}
+inline void analogWriteFreq(uint32_t) {}
+inline int analogRead(uint8_t) { return 0; }
+
+unsigned long millis();
+unsigned long micros();
+void delay(unsigned long ms);
+void delayMicroseconds(unsigned int us);
+void yield();
+
+long random(long max_value);
+long random(long min_value, long max_value);
+void randomSeed(unsigned long seed);
+
+class String
+{
+public:
+    String(const char *s = "") : m_str(s ? s : "") {}
+    String(const __FlashStringHelper *s) : m_str(s ? reinterpret_cast<const char *>(s) : "") {}
+    String(const std::string &s) : m_str(s) {}
+
+    const char *c_str() const { return m_str.c_str(); }
+    unsigned int length() const { return m_str.length(); }
+    bool isEmpty() const { return m_str.empty(); }
+    long toInt() const { return strtol(m_str.c_str(), nullptr, 10); }
+    float toFloat() const { return strtof(m_str.c_str(), nullptr); }
+
+    char operator[](unsigned int i) const { return i < m_str.size() ? m_str[i] : '\0'; }
+    bool operator==(const String &other) const { return m_str == other.m_str; }
+    bool operator==(const char *other) const { return m_str == other; }
+    bool operator!=(const String &other) const { return m_str != other.m_str; }
+    bool operator!=(const char *other) const { return m_str != other; }
+    String &operator+=(const String &other)
+    {
+        m_str += other.m_str;
+        return *this;
+    }
+    String &operator+=(const char *other)
+    {
+        m_str += other;
+        return *this;
+    }
+    String &operator+=(char c)
+    {
+        m_str += c;
+        return *this;
+    }
+
+protected:
+    std::string m_str;
+};
+
+class Print
+{
+public:
+    virtual ~Print() {}
+
+    virtual size_t write(uint8_t c) = 0;
+    virtual size_t write(const uint8_t *buf, size_t size)
+    {
+        size_t n = 0;
+        while (size--)
+        {
+            n += this->write(*buf++);
+        }
+        return n;
+    }
+
+    size_t print(const char *s) { return this->write((const uint8_t *)s, strlen(s)); }
+    size_t print(const String &s) { return this->write((const uint8_t *)s.c_str(), s.length()); }
+    size_t print(const __FlashStringHelper *s) { return this->print(reinterpret_cast<const char *>(s)); }
+    size_t print(char c) { return this->write((uint8_t)c); }
+    size_t println(const char *s) { return this->print(s) + this->print('\n'); }
+    size_t println() { return this->print('\n'); }
+};
+
+class Printable
+{
+public:
+    virtual ~Printable() {}
+    virtual size_t printTo(Print &p) const = 0;
+};
+
+class Stream : public Print
+{
+public:
+    virtual int available() { return 0; }
+    virtual int read() { return -1; }
+};
+
+/** 串口输出到标准输出, 重放驱动可关闭 */
+class HardwareSerial : public Stream
+{
+public:
+    void begin(unsigned long) {}
+    size_t write(uint8_t c) override;
+    size_t write(const uint8_t *buf, size_t size) override;
+    using Print::write;
+};
+
+#define SERIAL_8N1 0x1c
+#define SERIAL_TX_ONLY 2
+
+extern HardwareSerial Serial;
+
+struct rst_info
+{
+    uint32_t reason;
+};
+
+class EspClass
+{
+public:
+    String getResetReason() { return String("Replay"); }
+    rst_info *getResetInfoPtr();
+    void wdtEnable(uint32_t) {}
+    void wdtFeed() {}
+    void restart() {}
+    uint32_t getCycleCount() { return (uint32_t)(micros() * this->getCpuFreqMHz()); }
+    uint8_t getCpuFreqMHz() { return 160; }
+};
+
+extern EspClass ESP;
@@ -0,0 +1,102 @@
+#include <ArduinoHA.h>
+
+const char HACommandTopic[] PROGMEM = "cmd_t";
+
+HAMqtt *HAMqtt::m_instance = nullptr;
+
+HABaseDeviceType::HABaseDeviceType(const char *, const char *unique_id) : m_unique_id(unique_id)
+{
+    if (HAMqtt::instance() != nullptr)
+    {
+        HAMqtt::instance()->addDeviceType(this);
+    }
+}
+
+bool HABaseDeviceType::isCommandTopic(const char *topic) const
+{
+    if (m_unique_id == nullptr)
+    {
+        return false;
+    }
+
+    // 命令主题为 "<前缀>/<设备标识>/<实体标识>/cmd_t"
+    size_t topic_len = strlen(topic);
+    size_t id_len = strlen(m_unique_id);
+    size_t suffix_len = strlen(HACommandTopic);
+    if (topic_len < id_len + suffix_len + 2)
+    {
+        return false;
+    }
+    const char *suffix = topic + topic_len - suffix_len;
+    const char *id = suffix - 1 - id_len;
+    return strcmp(suffix, HACommandTopic) == 0 && suffix[-1] == '/' && id[-1] == '/' &&
+           strncmp(id, m_unique_id, id_len) == 0;
+}
+
+void HAButton::onMqttMessage(const char *topic, const uint8_t *, uint16_t)
+{
+    if (m_callback != nullptr && this->isCommandTopic(topic))
+    {
+        m_callback(this);
+    }
+}
+
+void HANumber::onMqttMessage(const char *topic, const uint8_t *payload, uint16_t length)
+{
+    if (m_callback == nullptr || !this->isCommandTopic(topic))
+    {
+        return;
+    }
+
+    // "None" 表示清除数值, 其余负载须为完整的数字, 否则忽略
+    std::string text((const char *)payload, length);
+    if (text == "None")
+    {
+        m_callback(HANumeric(), this);
+        return;
+    }
+    char *end = nullptr;
+    double value = strtod(text.c_str(), &end);
+    if (text.empty() || end != text.c_str() + text.size())
+    {
+        return;
+    }
+    m_callback(HANumeric(value), this);
+}
+
+HAMqtt::HAMqtt(Client &, HADevice &, uint8_t max_device_types) : m_message_callback(nullptr),
+                                                                  m_device_types(new HABaseDeviceType *[max_device_types]),
+                                                                  m_max_device_types(max_device_types),
+                                                                  m_device_types_count(0)
+{
+    m_instance = this;
+}
+
+HAMqtt::~HAMqtt()
+{
+    delete[] m_device_types;
+    if (m_instance == this)
+    {
+        m_instance = nullptr;
+    }
+}
+
+void HAMqtt::addDeviceType(HABaseDeviceType *device_type)
+{
+    if (m_device_types_count < m_max_device_types)
+    {
+        m_device_types[m_device_types_count++] = device_type;
+    }
+}
+
+void HAMqtt::processMessage(const char *topic, const uint8_t *payload, uint16_t length)
+{
+    if (m_message_callback != nullptr)
+    {
+        m_message_callback(topic, payload, length);
+    }
+    for (uint8_t i = 0; i < m_device_types_count; i++)
+    {
+        m_device_types[i]->onMqttMessage(topic, payload, length);
+    }
+}
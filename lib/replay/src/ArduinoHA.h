@@ -0,0 +1,165 @@
+#pragma once
+
+// 主机重放用 home-assistant-integration 适配层: 只保留固件用到的实体接口,
+// 不建立 MQTT 连接, 重放驱动通过 HAMqtt::processMessage() 注入记录的消息,
+// 消息按库的分发顺序先交给 onMessage 回调, 再由命令主题匹配的实体处理
+
+#include <Arduino.h>
+#include <ESP8266WiFi.h>
+
+#define AHATOFSTR(x) (reinterpret_cast<const __FlashStringHelper *>(x))
+
+extern const char HACommandTopic[];
+
+class HAMqtt;
+
+class HADevice
+{
+public:
+    bool setUniqueId(const byte *, uint16_t) { return true; }
+    void setName(const char *) {}
+    void setSoftwareVersion(const char *) {}
+    void setManufacturer(const char *) {}
+    void setModel(const char *) {}
+    void enableSharedAvailability() {}
+    void enableLastWill() {}
+};
+
+class HANumeric
+{
+public:
+    HANumeric() : m_set(false), m_value(0) {}
+    HANumeric(double value) : m_set(true), m_value(value) {}
+
+    bool isSet() const { return m_set; }
+    float toFloat() const { return (float)m_value; }
+    int32_t toInt32() const { return (int32_t)lround(m_value); }
+
+protected:
+    bool m_set;
+    double m_value;
+};
+
+class HABaseDeviceType
+{
+public:
+    enum NumberPrecision
+    {
+        PrecisionP0 = 0,
+        PrecisionP1,
+        PrecisionP2,
+        PrecisionP3
+    };
+
+    HABaseDeviceType(const char *component_name, const char *unique_id);
+    virtual ~HABaseDeviceType() {}
+
+    const char *uniqueId() const { return m_unique_id; }
+    void setName(const char *) {}
+    void setAvailability(bool) {}
+
+protected:
+    friend class HAMqtt;
+
+    static bool subscribeTopic(const char *, const __FlashStringHelper *) { return true; }
+
+    virtual void onMqttConnected() {}
+    virtual void onMqttMessage(const char *, const uint8_t *, uint16_t) {}
+    void publishAvailability() {}
+
+    /** 主题是否为本实体的命令主题 ".../<uniqueId>/cmd_t" */
+    bool isCommandTopic(const char *topic) const;
+
+    const char *m_unique_id;
+};
+
+class HAButton : public HABaseDeviceType
+{
+public:
+    HAButton(const char *unique_id) : HABaseDeviceType("button", unique_id), m_callback(nullptr) {}
+
+    void setIcon(const char *) {}
+    void setRetain(bool) {}
+    void onCommand(void (*callback)(HAButton *sender)) { m_callback = callback; }
+
+protected:
+    void onMqttMessage(const char *topic, const uint8_t *payload, uint16_t length) override;
+
+    void (*m_callback)(HAButton *sender);
+};
+
+class HASensor : public HABaseDeviceType
+{
+public:
+    HASensor(const char *unique_id) : HABaseDeviceType("sensor", unique_id) {}
+
+    void setIcon(const char *) {}
+    void setUnitOfMeasurement(const char *) {}
+    bool setValue(const char *, bool = false) { return true; }
+};
+
+class HANumber : public HABaseDeviceType
+{
+public:
+    enum Mode
+    {
+        ModeAuto = 0,
+        ModeBox,
+        ModeSlider
+    };
+
+    HANumber(const char *unique_id, NumberPrecision = PrecisionP0)
+        : HABaseDeviceType("number", unique_id), m_callback(nullptr), m_state()
+    {
+    }
+
+    void setIcon(const char *) {}
+    void setUnitOfMeasurement(const char *) {}
+    void setMin(float) {}
+    void setMax(float) {}
+    void setStep(float) {}
+    void setMode(Mode) {}
+    void onCommand(void (*callback)(HANumeric number, HANumber *sender)) { m_callback = callback; }
+
+    bool setState(const HANumeric &state, bool = false)
+    {
+        m_state = state;
+        return true;
+    }
+    bool setState(float state, bool force = false) { return this->setState(HANumeric(state), force); }
+    const HANumeric &getCurrentState() const { return m_state; }
+
+protected:
+    void onMqttMessage(const char *topic, const uint8_t *payload, uint16_t length) override;
+
+    void (*m_callback)(HANumeric number, HANumber *sender);
+    HANumeric m_state;
+};
+
+class HAMqtt
+{
+public:
+    static HAMqtt *instance() { return m_instance; }
+
+    HAMqtt(Client &client, HADevice &device, uint8_t max_device_types = 6);
+    ~HAMqtt();
+
+    bool begin(const char *, uint16_t, const char * = nullptr, const char * = nullptr) { return true; }
+    void loop() {}
+    bool isConnected() const { return false; }
+    bool disconnect() { return true; }
+    bool subscribe(const char *) { return true; }
+    void onMessage(void (*callback)(const char *topic, const uint8_t *payload, uint16_t length)) { m_message_callback = callback; }
+
+    void addDeviceType(HABaseDeviceType *device_type);
+    /** 按库的顺序分发收到的消息 */
+    void processMessage(const char *topic, const uint8_t *payload, uint16_t length);
+
+protected:
+    static HAMqtt *m_instance;
+
+    void (*m_message_callback)(const char *topic, const uint8_t *payload, uint16_t length);
+    HABaseDeviceType **m_device_types;
+    uint8_t m_max_device_types;
+    uint8_t m_device_types_count;
+};
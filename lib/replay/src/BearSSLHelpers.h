@@ -0,0 +1,21 @@
+#pragma once
+
+// 主机重放适配层: 重放不进行 OTA 更新, 摘要计算只保留接口
+
+#include <Updater.h>
+
+namespace BearSSL
+{
+    class HashSHA256 : public UpdaterHashClass
+    {
+    public:
+        void begin() override {}
+        void add(const void *, uint32_t) override {}
+        void end() override {}
+        int len() override { return 32; }
+        const void *hash() override { return m_hash; }
+
+    protected:
+        uint8_t m_hash[32] = {};
+    };
+}
@@ -0,0 +1,61 @@
+#include <ESP8266WebServer.h>
+
+void ESP8266WebServer::send(int code, const char *content_type, const String &content)
+{
+    m_code = code;
+    m_body.assign(content.c_str(), content.length());
+}
+
+String ESP8266WebServer::arg(const String &name) const
+{
+    for (const Arg &arg : m_args)
+    {
+        if (arg.name == name)
+        {
+            return arg.value;
+        }
+    }
+    return String();
+}
+
+bool ESP8266WebServer::hasArg(const String &name) const
+{
+    for (const Arg &arg : m_args)
+    {
+        if (arg.name == name)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+int ESP8266WebServer::replayRequest(HTTPMethod method, const char *request)
+{
+    // 记录中的参数值已解码, 按 '&' 及第一个 '=' 拆分
+    const char *query = strchr(request, '?');
+    m_uri = String(query ? std::string(request, query - request) : std::string(request));
+    m_method = method;
+    m_args.clear();
+    while (query != nullptr && *query != '\0')
+    {
+        const char *begin = query + 1;
+        const char *end = strchr(begin, '&');
+        std::string pair = end ? std::string(begin, end - begin) : std::string(begin);
+        size_t eq = pair.find('=');
+        m_args.push_back({String(pair.substr(0, eq)), String(eq == std::string::npos ? "" : pair.substr(eq + 1))});
+        query = end;
+    }
+
+    m_code = 404;
+    m_body.clear();
+    for (const Handler &handler : m_handlers)
+    {
+        if (handler.uri == m_uri && (handler.method == HTTP_ANY || handler.method == method))
+        {
+            handler.func();
+            break;
+        }
+    }
+    return m_code;
+}
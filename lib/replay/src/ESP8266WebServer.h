@@ -0,0 +1,84 @@
+#pragma once
+
+#include <Arduino.h>
+#include <ESP8266WiFi.h>
+
+#include <functional>
+#include <vector>
+
+enum HTTPMethod
+{
+    HTTP_ANY,
+    HTTP_GET,
+    HTTP_HEAD,
+    HTTP_POST,
+    HTTP_PUT,
+    HTTP_PATCH,
+    HTTP_DELETE,
+    HTTP_OPTIONS
+};
+
+#define CONTENT_LENGTH_UNKNOWN ((size_t)-1)
+
+/** HTTP 服务 (主机重放适配层)
+ *
+ * 不监听端口, 重放驱动通过 replayRequest() 以记录中的请求调用已注册的处理函数,
+ * 处理函数读取的路径、方法及参数来自该请求, 响应内容只保留状态码及正文。
+ */
+class ESP8266WebServer
+{
+public:
+    using THandlerFunction = std::function<void(void)>;
+
+    ESP8266WebServer(int port = 80) : m_port(port), m_method(HTTP_ANY), m_code(0) {}
+
+    void begin() {}
+    void handleClient() {}
+
+    void on(const String &uri, THandlerFunction handler) { this->on(uri, HTTP_ANY, handler); }
+    void on(const String &uri, HTTPMethod method, THandlerFunction handler) { m_handlers.push_back({uri, method, handler}); }
+
+    void setContentLength(size_t) {}
+    void send(int code, const char *content_type, const String &content);
+    void send(int code, const char *content_type, const char *content) { this->send(code, content_type, String(content)); }
+    void send_P(int code, PGM_P content_type, PGM_P content) { this->send(code, content_type, String(content)); }
+    void sendContent(const char *content, size_t size) { m_body.append(content, size); }
+    void sendContent(const char *content) { m_body.append(content); }
+    void sendContent(const String &content) { m_body.append(content.c_str(), content.length()); }
+    void sendContent_P(PGM_P content) { m_body.append(content); }
+
+    const String &uri() const { return m_uri; }
+    HTTPMethod method() const { return m_method; }
+    int args() const { return (int)m_args.size(); }
+    String arg(int i) const { return i >= 0 && i < this->args() ? m_args[i].value : String(); }
+    String argName(int i) const { return i >= 0 && i < this->args() ? m_args[i].name : String(); }
+    String arg(const String &name) const;
+    bool hasArg(const String &name) const;
+
+    /** 以 "<路径>?<参数名>=<参数值>&..." 形式的请求调用匹配的处理函数, 返回响应状态码, 无匹配时返回 404 */
+    int replayRequest(HTTPMethod method, const char *request);
+    /** 最近一次请求的响应正文 */
+    const std::string &responseBody() const { return m_body; }
+
+protected:
+    struct Handler
+    {
+        String uri;
+        HTTPMethod method;
+        THandlerFunction func;
+    };
+
+    struct Arg
+    {
+        String name;
+        String value;
+    };
+
+    int m_port;
+    std::vector<Handler> m_handlers;
+    String m_uri;
+    HTTPMethod m_method;
+    std::vector<Arg> m_args;
+    int m_code;
+    std::string m_body;
+};
@@ -0,0 +1,43 @@
+#pragma once
+
+// 主机重放适配层: WiFi 始终未连接, MQTT 消息由重放驱动直接送入 HAMqtt
+
+#include <Arduino.h>
+
+#define WL_MAC_ADDR_LENGTH 6
+
+typedef enum
+{
+    WL_IDLE_STATUS = 0,
+    WL_NO_SSID_AVAIL = 1,
+    WL_CONNECTED = 3,
+    WL_CONNECT_FAILED = 4,
+    WL_DISCONNECTED = 6
+} wl_status_t;
+
+class Client : public Stream
+{
+public:
+    size_t write(uint8_t) override { return 0; }
+    using Print::write;
+    virtual uint8_t connected() { return 0; }
+    void setTimeout(unsigned long) {}
+};
+
+class WiFiClient : public Client
+{
+};
+
+class ESP8266WiFiClass
+{
+public:
+    wl_status_t status() { return WL_DISCONNECTED; }
+    uint8_t *macAddress(uint8_t *mac)
+    {
+        static const uint8_t REPLAY_MAC[WL_MAC_ADDR_LENGTH] = {0x02, 0x00, 0x00, 0x00, 0x00, 0x01};
+        memcpy(mac, REPLAY_MAC, WL_MAC_ADDR_LENGTH);
+        return mac;
+    }
+};
+
+extern ESP8266WiFiClass WiFi;
@@ -0,0 +1,18 @@
+#pragma once
+
+#include <stdint.h>
+
+/** IPv4 地址 (主机重放适配层, 只用于保存地址) */
+class IPAddress
+{
+public:
+    IPAddress() : m_addr(0) {}
+    IPAddress(uint32_t addr) : m_addr(addr) {}
+    IPAddress(uint8_t a, uint8_t b, uint8_t c, uint8_t d) : m_addr(a | (b << 8) | (c << 16) | ((uint32_t)d << 24)) {}
+
+    operator uint32_t() const { return m_addr; }
+    bool isSet() const { return m_addr != 0; }
+
+protected:
+    uint32_t m_addr;
+};
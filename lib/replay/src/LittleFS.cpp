@@ -0,0 +1,41 @@
+#include <LittleFS.h>
+#include <replay_host.h>
+
+#include <sys/stat.h>
+
+LittleFSClass LittleFS;
+
+size_t File::size() const
+{
+    struct stat st;
+    return m_fp && fstat(fileno(m_fp.get()), &st) == 0 ? (size_t)st.st_size : 0;
+}
+
+std::string LittleFSClass::path_(const char *path) const
+{
+    return ReplayHost::fs_root() + path;
+}
+
+File LittleFSClass::open(const char *path, const char *mode)
+{
+    // 与设备一致使用二进制模式, "r+" 要求文件已存在
+    std::string fmode = std::string(mode) + "b";
+    FILE *fp = fopen(this->path_(path).c_str(), fmode.c_str());
+    return fp ? File(fp) : File();
+}
+
+bool LittleFSClass::exists(const char *path)
+{
+    struct stat st;
+    return stat(this->path_(path).c_str(), &st) == 0;
+}
+
+bool LittleFSClass::remove(const char *path)
+{
+    return ::remove(this->path_(path).c_str()) == 0;
+}
+
+bool LittleFSClass::rename(const char *from, const char *to)
+{
+    return ::rename(this->path_(from).c_str(), this->path_(to).c_str()) == 0;
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+// 主机重放用 LittleFS 适配层: 设备文件系统映射到重放输出目录 (ReplayHost::set_fs_root)
+
+#include <Arduino.h>
+
+#include <memory>
+
+class File
+{
+public:
+    File() {}
+    File(FILE *fp) : m_fp(fp, &fclose) {}
+
+    explicit operator bool() const { return m_fp != nullptr; }
+
+    size_t read(uint8_t *buf, size_t size) { return m_fp ? fread(buf, 1, size, m_fp.get()) : 0; }
+    size_t write(const uint8_t *buf, size_t size) { return m_fp ? fwrite(buf, 1, size, m_fp.get()) : 0; }
+    bool seek(uint32_t pos) { return m_fp && fseek(m_fp.get(), pos, SEEK_SET) == 0; }
+    size_t position() const { return m_fp ? ftell(m_fp.get()) : 0; }
+    size_t size() const;
+    void close() { m_fp.reset(); }
+
+protected:
+    std::shared_ptr<FILE> m_fp;
+};
+
+class LittleFSClass
+{
+public:
+    bool begin() { return true; }
+    void end() {}
+
+    File open(const char *path, const char *mode);
+    bool exists(const char *path);
+    bool remove(const char *path);
+    bool rename(const char *from, const char *to);
+
+protected:
+    std::string path_(const char *path) const;
+};
+
+extern LittleFSClass LittleFS;
@@ -0,0 +1,183 @@
+#include <PID_v1.h>
+
+PID::PID(double *input, double *output, double *setpoint, double Kp, double Ki, double Kd, int POn, int ControllerDirection)
+{
+    myOutput = output;
+    myInput = input;
+    mySetpoint = setpoint;
+    inAuto = false;
+
+    PID::SetOutputLimits(0, 255);
+    SampleTime = 100;
+
+    PID::SetControllerDirection(ControllerDirection);
+    PID::SetTunings(Kp, Ki, Kd, POn);
+
+    lastTime = millis() - SampleTime;
+}
+
+PID::PID(double *input, double *output, double *setpoint, double Kp, double Ki, double Kd, int ControllerDirection)
+    : PID(input, output, setpoint, Kp, Ki, Kd, P_ON_E, ControllerDirection)
+{
+}
+
+bool PID::Compute()
+{
+    if (!inAuto)
+    {
+        return false;
+    }
+    unsigned long now = millis();
+    unsigned long timeChange = (now - lastTime);
+    if (timeChange < SampleTime)
+    {
+        return false;
+    }
+
+    double input = *myInput;
+    double error = *mySetpoint - input;
+    double dInput = (input - lastInput);
+    outputSum += (ki * error);
+
+    // 测量值比例 (P_ON_M)
+    if (!pOnE)
+    {
+        outputSum -= kp * dInput;
+    }
+
+    if (outputSum > outMax)
+    {
+        outputSum = outMax;
+    }
+    else if (outputSum < outMin)
+    {
+        outputSum = outMin;
+    }
+
+    double output = pOnE ? kp * error : 0;
+    output += outputSum - kd * dInput;
+
+    if (output > outMax)
+    {
+        output = outMax;
+    }
+    else if (output < outMin)
+    {
+        output = outMin;
+    }
+    *myOutput = output;
+
+    lastInput = input;
+    lastTime = now;
+    return true;
+}
+
+void PID::SetTunings(double Kp, double Ki, double Kd, int POn)
+{
+    if (Kp < 0 || Ki < 0 || Kd < 0)
+    {
+        return;
+    }
+
+    pOn = POn;
+    pOnE = POn == P_ON_E;
+
+    dispKp = Kp;
+    dispKi = Ki;
+    dispKd = Kd;
+
+    double SampleTimeInSec = ((double)SampleTime) / 1000;
+    kp = Kp;
+    ki = Ki * SampleTimeInSec;
+    kd = Kd / SampleTimeInSec;
+
+    if (controllerDirection == REVERSE)
+    {
+        kp = (0 - kp);
+        ki = (0 - ki);
+        kd = (0 - kd);
+    }
+}
+
+void PID::SetTunings(double Kp, double Ki, double Kd)
+{
+    SetTunings(Kp, Ki, Kd, pOn);
+}
+
+void PID::SetSampleTime(int NewSampleTime)
+{
+    if (NewSampleTime > 0)
+    {
+        double ratio = (double)NewSampleTime / (double)SampleTime;
+        ki *= ratio;
+        kd /= ratio;
+        SampleTime = (unsigned long)NewSampleTime;
+    }
+}
+
+void PID::SetOutputLimits(double Min, double Max)
+{
+    if (Min >= Max)
+    {
+        return;
+    }
+    outMin = Min;
+    outMax = Max;
+
+    if (inAuto)
+    {
+        if (*myOutput > outMax)
+        {
+            *myOutput = outMax;
+        }
+        else if (*myOutput < outMin)
+        {
+            *myOutput = outMin;
+        }
+
+        if (outputSum > outMax)
+        {
+            outputSum = outMax;
+        }
+        else if (outputSum < outMin)
+        {
+            outputSum = outMin;
+        }
+    }
+}
+
+void PID::SetMode(int Mode)
+{
+    bool newAuto = (Mode == AUTOMATIC);
+    if (newAuto && !inAuto)
+    {
+        // 手动切换到自动时无扰切换
+        PID::Initialize();
+    }
+    inAuto = newAuto;
+}
+
+void PID::Initialize()
+{
+    outputSum = *myOutput;
+    lastInput = *myInput;
+    if (outputSum > outMax)
+    {
+        outputSum = outMax;
+    }
+    else if (outputSum < outMin)
+    {
+        outputSum = outMin;
+    }
+}
+
+void PID::SetControllerDirection(int Direction)
+{
+    if (inAuto && Direction != controllerDirection)
+    {
+        kp = (0 - kp);
+        ki = (0 - ki);
+        kd = (0 - kd);
+    }
+    controllerDirection = Direction;
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+// 主机重放用 PID 控制器: 按 br3ttb/Arduino-PID-Library 1.2.1 的算法重新实现, 保证与设备上的控制输出一致
+
+#include <Arduino.h>
+
+#define AUTOMATIC 1
+#define MANUAL 0
+#define DIRECT 0
+#define REVERSE 1
+#define P_ON_M 0
+#define P_ON_E 1
+
+class PID
+{
+public:
+    PID(double *input, double *output, double *setpoint, double Kp, double Ki, double Kd, int POn, int ControllerDirection);
+    PID(double *input, double *output, double *setpoint, double Kp, double Ki, double Kd, int ControllerDirection);
+
+    void SetMode(int Mode);
+    bool Compute();
+    void SetOutputLimits(double Min, double Max);
+
+    void SetTunings(double Kp, double Ki, double Kd);
+    void SetTunings(double Kp, double Ki, double Kd, int POn);
+    void SetControllerDirection(int Direction);
+    void SetSampleTime(int NewSampleTime);
+
+    double GetKp() { return dispKp; }
+    double GetKi() { return dispKi; }
+    double GetKd() { return dispKd; }
+    int GetMode() { return inAuto ? AUTOMATIC : MANUAL; }
+    int GetDirection() { return controllerDirection; }
+
+private:
+    void Initialize();
+
+    double dispKp;
+    double dispKi;
+    double dispKd;
+
+    double kp;
+    double ki;
+    double kd;
+
+    int controllerDirection;
+    int pOn;
+
+    double *myInput;
+    double *myOutput;
+    double *mySetpoint;
+
+    unsigned long lastTime;
+    double outputSum, lastInput;
+
+    unsigned long SampleTime;
+    double outMin, outMax;
+    bool inAuto, pOnE;
+};
@@ -0,0 +1,15 @@
+#pragma once
+
+#include <Arduino.h>
+
+/** 可作为 Print 输出目标的 String */
+class StreamString : public String, public Stream
+{
+public:
+    size_t write(uint8_t c) override
+    {
+        m_str += (char)c;
+        return 1;
+    }
+    using Print::write;
+};
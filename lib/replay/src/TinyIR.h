@@ -0,0 +1,22 @@
+#pragma once
+
+// 主机重放用 TinyIRReceiver 适配层: 重放驱动直接写入接收数据, 标志位取值与 IRremote 一致
+
+#include <Arduino.h>
+
+#define IRDATA_FLAGS_EMPTY 0x00
+#define IRDATA_FLAGS_IS_REPEAT 0x01
+#define IRDATA_FLAGS_IS_AUTO_REPEAT 0x02
+#define IRDATA_FLAGS_PARITY_FAILED 0x04
+
+struct TinyIRReceiverCallbackDataStruct
+{
+    uint16_t Address;
+    uint8_t Command;
+    uint8_t Flags;
+    bool justWritten;
+};
+
+extern volatile TinyIRReceiverCallbackDataStruct TinyIRReceiverData;
+
+bool initPCIInterruptForTinyReceiver();
@@ -0,0 +1,12 @@
+#pragma once
+
+// 与原库相同, 只能在一个编译单元中包含 (ir.cpp)
+
+#include <TinyIR.h>
+
+volatile TinyIRReceiverCallbackDataStruct TinyIRReceiverData;
+
+bool initPCIInterruptForTinyReceiver()
+{
+    return true;
+}
@@ -0,0 +1,22 @@
+#pragma once
+
+#include <Arduino.h>
+
+class UpdaterHashClass
+{
+public:
+    virtual ~UpdaterHashClass() {}
+    virtual void begin() = 0;
+    virtual void add(const void *data, uint32_t len) = 0;
+    virtual void end() = 0;
+    virtual int len() = 0;
+    virtual const void *hash() = 0;
+};
+
+class UpdaterVerifyClass
+{
+public:
+    virtual ~UpdaterVerifyClass() {}
+    virtual uint32_t length() = 0;
+    virtual bool verify(UpdaterHashClass *hash, const void *signature, uint32_t signature_len) = 0;
+};
@@ -0,0 +1,77 @@
+#include <Arduino.h>
+#include <ESP8266WiFi.h>
+#include <replay_host.h>
+
+HardwareSerial Serial;
+EspClass ESP;
+ESP8266WiFiClass WiFi;
+
+unsigned long millis()
+{
+    return (unsigned long)(ReplayHost::now_us() / 1000);
+}
+
+unsigned long micros()
+{
+    return (unsigned long)ReplayHost::now_us();
+}
+
+void delay(unsigned long ms)
+{
+    ReplayHost::idle_us((uint64_t)ms * 1000);
+}
+
+void delayMicroseconds(unsigned int us)
+{
+    ReplayHost::idle_us(us);
+}
+
+void yield()
+{
+    ReplayHost::idle_us(ReplayHost::IDLE_STEP_US);
+}
+
+// 固定种子的线性同余随机数, 保证每次重放结果相同
+static uint32_t s_random_state = 1;
+
+void randomSeed(unsigned long seed)
+{
+    if (seed != 0)
+    {
+        s_random_state = (uint32_t)seed;
+    }
+}
+
+long random(long max_value)
+{
+    if (max_value <= 0)
+    {
+        return 0;
+    }
+    s_random_state = s_random_state * 1103515245u + 12345u;
+    return (long)((s_random_state >> 1) % (uint32_t)max_value);
+}
+
+long random(long min_value, long max_value)
+{
+    return min_value >= max_value ? min_value : min_value + random(max_value - min_value);
+}
+
+size_t HardwareSerial::write(uint8_t c)
+{
+    return this->write(&c, 1);
+}
+
+size_t HardwareSerial::write(const uint8_t *buf, size_t size)
+{
+    if (ReplayHost::serial_output())
+    {
+        fwrite(buf, 1, size, stdout);
+    }
+    return size;
+}
+
+rst_info *EspClass::getResetInfoPtr()
+{
+    return ReplayHost::reset_info();
+}
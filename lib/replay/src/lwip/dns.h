@@ -0,0 +1,10 @@
+#pragma once
+
+#include <stdint.h>
+
+typedef struct ip_addr
+{
+    uint32_t addr;
+} ip_addr_t;
+
+typedef signed char err_t;
@@ -0,0 +1,5 @@
+#pragma once
+
+#include <lwip/dns.h>
+
+struct tcp_pcb;
@@ -0,0 +1,9 @@
+#pragma once
+
+#include <lwip/dns.h>
+
+// 主机重放时 NTP 时间由记录给出, 只保留类型声明, 不收发数据
+typedef uint16_t u16_t;
+
+struct pbuf;
+struct udp_pcb;
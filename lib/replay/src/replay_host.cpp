@@ -0,0 +1,28 @@
+#include <replay_host.h>
+
+void ReplayHost::set_now_us(uint64_t us)
+{
+    if (us > m_now_us)
+    {
+        m_now_us = us;
+    }
+}
+
+void ReplayHost::idle_us(uint64_t us)
+{
+    m_now_us = min(m_now_us + us, max(m_limit_us, m_now_us));
+}
+
+void ReplayHost::set_epoch(int64_t epoch_ms)
+{
+    m_epoch_pending = true;
+    m_epoch_ms = epoch_ms;
+    m_epoch_at_us = m_now_us;
+}
+
+int64_t ReplayHost::take_epoch(uint64_t *at_us)
+{
+    m_epoch_pending = false;
+    *at_us = m_epoch_at_us;
+    return m_epoch_ms;
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <Arduino.h>
+
+/** 重放宿主环境
+ *
+ * 管理虚拟时钟及设备环境: micros() 返回 64 位虚拟时刻, 固件任务运行期间时钟静止,
+ * 调度器空闲时 delay()/yield() 推进时钟但不超过驱动设置的上限, 使重放远快于实际时间且结果确定。
+ */
+class ReplayHost
+{
+public:
+    static constexpr uint64_t IDLE_STEP_US = 20; // yield() 推进的虚拟时间(us)
+
+    /** 当前虚拟时刻(us) */
+    static uint64_t now_us() { return m_now_us; }
+    /** 设置虚拟时刻, 只能向前 */
+    static void set_now_us(uint64_t us);
+    /** 设置空闲时时钟推进的上限 */
+    static void set_limit_us(uint64_t us) { m_limit_us = us; }
+    /** 空闲时推进虚拟时钟 */
+    static void idle_us(uint64_t us);
+
+    /** 设置 ESP.getResetInfoPtr() 返回的复位原因 */
+    static void set_reset_reason(uint32_t reason) { m_reset_info.reason = reason; }
+    static rst_info *reset_info() { return &m_reset_info; }
+
+    /** 串口输出是否写到标准输出 */
+    static void set_serial_output(bool enabled) { m_serial_output = enabled; }
+    static bool serial_output() { return m_serial_output; }
+
+    /** 设备文件系统映射到的目录 */
+    static void set_fs_root(const std::string &root) { m_fs_root = root; }
+    static const std::string &fs_root() { return m_fs_root; }
+
+    /** 设置 NTP 同步得到的 UTC 时间(ms), 下次 NTPService::update() 时生效 */
+    static void set_epoch(int64_t epoch_ms);
+    /** 是否有待生效的 UTC 时间 */
+    static bool epoch_pending() { return m_epoch_pending; }
+    /** 取出待生效的 UTC 时间及对应的虚拟时刻 */
+    static int64_t take_epoch(uint64_t *at_us);
+
+private:
+    static inline uint64_t m_now_us = 0;
+    static inline uint64_t m_limit_us = 0;
+    static inline rst_info m_reset_info = {0};
+    static inline bool m_serial_output = true;
+    static inline std::string m_fs_root = ".";
+    static inline bool m_epoch_pending = false;
+    static inline int64_t m_epoch_ms = 0;
+    static inline uint64_t m_epoch_at_us = 0;
+};
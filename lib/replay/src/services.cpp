@@ -0,0 +1,214 @@
+// 主机重放中替换的固件服务: 配置只保存在内存, 不连接 WiFi, NTP 时间及编码器读数由重放驱动给出
+
+#include "service/config.h"
+#include "service/wireless.h"
+#include "service/ntp.h"
+#include "service/recorder.h"
+#include "utility/tcp_probe.h"
+#include "utility/quadrature_encoder.h"
+
+#include <replay_host.h>
+
+ConfigService::ConfigService() : m_mounted(false),
+                                 m_record()
+{
+    this->set_defaults_();
+}
+
+ConfigService::~ConfigService()
+{
+}
+
+void ConfigService::begin()
+{
+    m_mounted = true;
+}
+
+void ConfigService::end()
+{
+    m_mounted = false;
+}
+
+bool ConfigService::remount()
+{
+    m_mounted = true;
+    return true;
+}
+
+bool ConfigService::save()
+{
+    return m_mounted;
+}
+
+void ConfigService::set_defaults_()
+{
+    memset(&m_record, 0, sizeof(m_record));
+    strncpy(m_record.data.mqtt.server, DEF_MQTT_SERVER, sizeof(m_record.data.mqtt.server) - 1);
+    strncpy(m_record.data.mqtt.port, DEF_MQTT_PORT, sizeof(m_record.data.mqtt.port) - 1);
+    strncpy(m_record.data.mqtt_group, DEF_MQTT_GROUP, sizeof(m_record.data.mqtt_group) - 1);
+}
+
+WirelessService::WirelessService() : m_should_save_config(false),
+                                     m_wifi_cache(),
+                                     m_lease_pending(false),
+                                     m_state(WIFI_CONNECTING),
+                                     m_state_ms(0),
+                                     m_connect_start_ms(0),
+                                     m_ota_started(false),
+                                     m_ota_hash(),
+                                     m_ota_verifier(),
+                                     m_ota_start_ms(0),
+                                     m_ota_progress_step(0),
+                                     m_ota_size(0),
+                                     m_wm(nullptr),
+                                     m_param_server(nullptr),
+                                     m_param_port(nullptr),
+                                     m_param_user(nullptr),
+                                     m_param_pass(nullptr),
+                                     m_param_group(nullptr)
+{
+}
+
+WirelessService::~WirelessService()
+{
+}
+
+void WirelessService::begin()
+{
+}
+
+void WirelessService::update()
+{
+}
+
+void WirelessService::clear_settings_and_restart()
+{
+}
+
+NTPService::NTPService() : m_pcb(nullptr),
+                           m_started(false),
+                           m_state(NTP_IDLE),
+                           m_server_addr(),
+                           m_state_ms(0),
+                           m_last_sync_ms(0),
+                           m_next_sync_ms(0),
+                           m_req_local_us(0),
+                           m_req_cookie(),
+                           m_reply(),
+                           m_reply_local_us(0),
+                           m_reply_ready(false),
+                           m_sync_interval_s(NTP_MIN_INTERVAL),
+                           m_drift_ppm(0.0f),
+                           m_sync_count(0),
+                           m_reject_count(0)
+{
+}
+
+NTPService::~NTPService()
+{
+}
+
+void NTPService::begin()
+{
+}
+
+void NTPService::update(bool)
+{
+    if (!ReplayHost::epoch_pending())
+    {
+        return;
+    }
+
+    // 主机版本中 m_req_local_us 保存 UTC 时间与虚拟时钟的差值(us)
+    uint64_t at_us;
+    int64_t epoch = ReplayHost::take_epoch(&at_us);
+    m_req_local_us = epoch * 1000 - (int64_t)at_us;
+    m_last_sync_ms = millis();
+    m_sync_count++;
+    RECORD_CLOCK(this->epoch_ms());
+}
+
+int64_t NTPService::epoch_ms() const
+{
+    return now_us_() / 1000;
+}
+
+int64_t NTPService::now_us_()
+{
+    return NTPService::get_instance()->m_req_local_us + (int64_t)ReplayHost::now_us();
+}
+
+TcpProbe::TcpProbe() : m_state(PROBE_IDLE),
+                       m_pcb(nullptr),
+                       m_addr(),
+                       m_port(0),
+                       m_start_ms(0)
+{
+}
+
+TcpProbe::~TcpProbe()
+{
+}
+
+bool TcpProbe::start(const char *, uint16_t)
+{
+    return false;
+}
+
+TcpProbe::State TcpProbe::poll(unsigned long)
+{
+    m_state = PROBE_FAILED;
+    return m_state;
+}
+
+void TcpProbe::abort()
+{
+    m_state = PROBE_IDLE;
+}
+
+QuadratureEncoder::QuadratureEncoder(uint8_t pin_a, uint8_t pin_b) : m_pin_a(pin_a),
+                                                                     m_pin_b(pin_b),
+                                                                     m_attached(false),
+                                                                     m_state(0),
+                                                                     m_last_dir(0),
+                                                                     m_position(0),
+                                                                     m_edges(0),
+                                                                     m_errors(0),
+                                                                     m_isr_max_cycles(0),
+                                                                     m_last_edge_cycles(0),
+                                                                     m_min_edge_gap_cycles(UINT32_MAX)
+{
+}
+
+QuadratureEncoder::~QuadratureEncoder()
+{
+}
+
+void QuadratureEncoder::begin()
+{
+    m_attached = true;
+}
+
+int64_t QuadratureEncoder::read64() const
+{
+    return m_position;
+}
+
+void QuadratureEncoder::write(int64_t pos)
+{
+    m_position = pos;
+}
+
+QuadratureEncoder::Stats QuadratureEncoder::get_stats() const
+{
+    return Stats{m_edges, m_errors, m_isr_max_cycles, m_min_edge_gap_cycles};
+}
+
+void QuadratureEncoder::reset_stats()
+{
+}
+
+QuadratureEncoder::BenchResult QuadratureEncoder::bench() const
+{
+    return BenchResult{0, 0, 0};
+}
@@ -3,25 +3,105 @@
 #include "service/ir.h"
 #include "service/logger.h"
 #include "service/ntp.h"
+#include "service/scheduler.h"
+#include "service/profiler.h"
+#include "service/config.h"
+#include "service/history.h"
+#include "service/trace.h"
+#include "service/recorder.h"
 #include "application.h"
 
-#include <LittleFS.h>
 #include <ESP8266WiFi.h>
-#include <ArduinoJson.h>
 
-Application *Application::m_instance = nullptr;
+// 各通道 HA 实体显示名称: 打开、关闭、停止按钮, 电机状态传感器及开度标定数值
+static const char *const COVER_LABELS[][5] = {
+    {"打开", "关闭", "停止", "电机状态", "标定当前开度"},
+    {"打开 2", "关闭 2", "停止 2", "电机状态 2", "标定当前开度 2"}};
 
-Application::Application() : m_cover_full_close_pos(0),
-                             m_cover_full_open_pos(0),
-                             m_cover_current_pos(0),
-                             m_motor_reversed(false),
-                             m_wifi_client(),
+static_assert(sizeof(ConfigService::CalibrationConf::percent) == PositionMap::MAX_POINTS &&
+                  sizeof(ConfigService::CalibrationConf::pos) / sizeof(int32_t) == PositionMap::MAX_POINTS,
+              "CalibrationConf must hold PositionMap::MAX_POINTS points");
+
+// 控制参数 HA 实体, 顺序同 MotorService::TUNING_PARAMS
+struct TuningEntity
+{
+    const char *id;
+    const char *name;
+    const char *unit;
+    HABaseDeviceType::NumberPrecision precision;
+};
+
+static const TuningEntity TUNING_ENTITIES[] = {
+    {"tune_kp", "PID 比例系数", nullptr, HABaseDeviceType::PrecisionP3},
+    {"tune_ki", "PID 积分系数", nullptr, HABaseDeviceType::PrecisionP3},
+    {"tune_kd", "PID 微分系数", nullptr, HABaseDeviceType::PrecisionP3},
+    {"tune_pid_sample", "PID 采样周期", "ms", HABaseDeviceType::PrecisionP0},
+    {"tune_stable_sample", "稳态采样周期", "ms", HABaseDeviceType::PrecisionP0},
+    {"tune_stable_n", "稳态样本数", nullptr, HABaseDeviceType::PrecisionP0},
+    {"tune_speed_cutoff", "速度滤波截止频率", "Hz", HABaseDeviceType::PrecisionP1},
+    {"tune_rel_tol", "到位相对误差", nullptr, HABaseDeviceType::PrecisionP3},
+    {"tune_abs_tol", "到位绝对误差", nullptr, HABaseDeviceType::PrecisionP0}};
+
+static_assert(sizeof(TUNING_ENTITIES) / sizeof(TUNING_ENTITIES[0]) == MotorService::TUNING_PARAM_COUNT,
+              "TUNING_ENTITIES must match MotorService::TUNING_PARAMS");
+
+Application::Cover::Cover(uint8_t channel) : channel(channel),
+                                             full_close_pos(0),
+                                             full_open_pos(0),
+                                             position_map(),
+                                             current_pos(0),
+                                             reversed(false),
+                                             backlash(0),
+                                             slack(0),
+                                             group_target(0),
+                                             motor_state(nullptr),
+                                             conf_pending(false),
+                                             history_pending(false),
+                                             tuning_pending(false),
+                                             move_stats(),
+                                             btn_open(channel == 0 ? BTN_OPEN_NAME : BTN_OPEN2_NAME),
+                                             btn_close(channel == 0 ? BTN_CLOSE_NAME : BTN_CLOSE2_NAME),
+                                             btn_stop(channel == 0 ? BTN_STOP_NAME : BTN_STOP2_NAME),
+                                             sensor_motor(channel == 0 ? SENSOR_MOTOR_NAME : SENSOR_MOTOR2_NAME),
+                                             num_calibrate(channel == 0 ? NUM_CALIBRATE_NAME : NUM_CALIBRATE2_NAME)
+{
+}
+
+Application::TuningNumber::TuningNumber(uint8_t index) : index(index),
+                                                          number(TUNING_ENTITIES[index].id, TUNING_ENTITIES[index].precision)
+{
+}
+
+Application::Application() : m_wifi_client(),
                              m_device(),
-                             m_mqtt(m_wifi_client, m_device),
-                             m_btn_open(Application::BTN_OPEN_NAME),
-                             m_btn_close(Application::BTN_CLOSE_NAME),
-                             m_btn_stop(Application::BTN_STOP_NAME),
-                             m_sensor_motor(Application::SENSOR_MOTOR_NAME),
+                             m_mqtt(m_wifi_client, m_device, MQTT_MAX_DEVICE_TYPES),
+#if MOTOR_CHANNELS > 1
+                             m_covers{{0}, {1}},
+#else
+                             m_covers{{0}},
+#endif
+                             m_sensor_group_skew(Application::SENSOR_GROUP_SKEW_NAME),
+                             m_tuning_numbers{{0}, {1}, {2}, {3}, {4}, {5}, {6}, {7}, {8}},
+                             m_tuning_publish_pending(false),
+#if defined(ENABLE_LOOP_PROFILER) && defined(ENABLE_PROFILER_MQTT)
+                             m_sensor_loop_max(Application::SENSOR_LOOP_MAX_NAME),
+                             m_profiler_last_report_ms(0),
+#endif
+                             m_mqtt_state(MQTT_LINK_BACKOFF),
+                             m_mqtt_probe(),
+                             m_mqtt_backoff_ms(0),
+                             m_mqtt_retry_ms(0),
+                             m_mqtt_state_ms(0),
+                             m_mqtt_connects(0),
+                             m_mqtt_loop_us(0),
+                             m_ha_offline_seen(false),
+                             m_group_topic(),
+                             m_group_move_task(-1),
+                             m_group_move_start_ms(0),
+                             m_group_skew_ms(0),
+                             m_group_skew_pending(false),
+                             m_persist_task(-1),
+                             m_ir_channel(0),
                              m_last_ir_key(KEY_UNKNOWN),
                              m_last_ir_key_pos(0)
 {
@@ -33,18 +113,25 @@ Application::~Application()
 
 void Application::begin()
 {
-    // 加载之前保存的电机标定位置及当前初始位置
-    this->load_motor_conf_();
-
     // 设置红外遥控器事件处理函数
     IRService *ir_service = IRService::get_instance();
     ir_service->on_anykey(&Application::on_ir_key_);
 
-    MotorService *ms = MotorService::get_instance();
-    // 设置电机当前位置
-    ms->set_motor_pos(this->m_cover_current_pos);
-    ms->set_reverse(this->m_motor_reversed);
-    ms->set_stop_callback(&Application::on_motor_stop_);
+    for (Cover &cover : m_covers)
+    {
+        // 加载之前保存的电机标定位置及当前初始位置
+        this->load_motor_conf_(cover);
+
+        MotorService *ms = MotorService::get_instance(cover.channel);
+        // 设置电机齿隙及当前位置
+        ms->set_reverse(cover.reversed);
+        ms->set_backlash(cover.backlash, cover.slack);
+        ms->set_cover_pos(cover.current_pos);
+        ms->set_stop_callback(&Application::on_motor_stop_);
+
+        // 恢复保存的控制参数
+        this->load_tuning_(cover.channel);
+    }
 
     // 获取 WiFi MAC 地址
     byte mac[WL_MAC_ADDR_LENGTH];
@@ -61,283 +148,1166 @@ void Application::begin()
     m_device.enableSharedAvailability();
     m_device.enableLastWill();
 
-    // 配置窗帘控制按钮
-    m_btn_open.setName("打开");
-    m_btn_open.setIcon("mdi:arrow-up");
-    m_btn_open.setRetain(false);
-    m_btn_open.onCommand(&Application::on_cover_command_);
+    // 配置各通道窗帘控制按钮
+    for (Cover &cover : m_covers)
+    {
+        const char *const *labels = COVER_LABELS[cover.channel];
+
+        cover.btn_open.setName(labels[0]);
+        cover.btn_open.setIcon("mdi:arrow-up");
+        cover.btn_open.setRetain(false);
+        cover.btn_open.onCommand(&Application::on_cover_command_);
+
+        cover.btn_close.setName(labels[1]);
+        cover.btn_close.setIcon("mdi:arrow-down");
+        cover.btn_close.setRetain(false);
+        cover.btn_close.onCommand(&Application::on_cover_command_);
+
+        cover.btn_stop.setName(labels[2]);
+        cover.btn_stop.setIcon("mdi:stop");
+        cover.btn_stop.setRetain(false);
+        cover.btn_stop.onCommand(&Application::on_cover_command_);
+
+        cover.sensor_motor.setName(labels[3]);
+        cover.sensor_motor.setIcon("mdi:engine");
+        cover.sensor_motor.setValue("Stopped");
+
+        cover.num_calibrate.setName(labels[4]);
+        cover.num_calibrate.setIcon("mdi:ruler");
+        cover.num_calibrate.setUnitOfMeasurement("%");
+        cover.num_calibrate.setMin(1);
+        cover.num_calibrate.setMax(99);
+        cover.num_calibrate.setStep(1);
+        cover.num_calibrate.setMode(HANumber::ModeBox);
+        cover.num_calibrate.onCommand(&Application::on_calibrate_command_);
+    }
+
+    m_sensor_group_skew.setName("同步启动偏差");
+    m_sensor_group_skew.setIcon("mdi:timer-sync-outline");
+    m_sensor_group_skew.setUnitOfMeasurement("ms");
 
-    m_btn_close.setName("关闭");
-    m_btn_close.setIcon("mdi:arrow-down");
-    m_btn_open.setRetain(false);
-    m_btn_close.onCommand(&Application::on_cover_command_);
+    // 配置通道 0 的控制参数实体, 其余通道通过 HTTP 接口调整
+    for (TuningNumber &entity : m_tuning_numbers)
+    {
+        const MotorService::TuningParam &param = MotorService::TUNING_PARAMS[entity.index];
+        const TuningEntity &info = TUNING_ENTITIES[entity.index];
 
-    m_btn_stop.setName("停止");
-    m_btn_stop.setIcon("mdi:stop");
-    m_btn_open.setRetain(false);
-    m_btn_stop.onCommand(&Application::on_cover_command_);
+        entity.number.setName(info.name);
+        entity.number.setIcon("mdi:tune-variant");
+        if (info.unit)
+        {
+            entity.number.setUnitOfMeasurement(info.unit);
+        }
+        entity.number.setMin(param.min);
+        entity.number.setMax(param.max);
+        entity.number.setStep(param.step);
+        entity.number.setMode(HANumber::ModeBox);
+        entity.number.onCommand(&Application::on_tuning_command_);
+    }
 
-    m_sensor_motor.setName("电机状态");
-    m_sensor_motor.setIcon("mdi:engine");
-    m_sensor_motor.setValue("Stopped");
+#if defined(ENABLE_LOOP_PROFILER) && defined(ENABLE_PROFILER_MQTT)
+    m_sensor_loop_max.setName("主循环最大耗时");
+    m_sensor_loop_max.setIcon("mdi:timer-alert-outline");
+    m_sensor_loop_max.setUnitOfMeasurement("ms");
+#endif
 
-    // 连接 HA 的 MQTT 服务器
+    // 配置 HA 的 MQTT 服务器, 连接由 update_mqtt_link_() 在后台建立
     WirelessService *ws = WirelessService::get_instance();
+    m_wifi_client.setTimeout(MQTT_IO_TIMEOUT_MS);
+    m_mqtt.onMessage(&Application::on_mqtt_message_);
     m_mqtt.begin(ws->mqtt_server(), ws->mqtt_port(), ws->mqtt_user(), ws->mqtt_pass());
+    const char *group = ws->mqtt_group()[0] ? ws->mqtt_group() : ConfigService::DEF_MQTT_GROUP;
+    snprintf(m_group_topic, sizeof(m_group_topic), GROUP_TOPIC_FMT, group);
+
+    // 注册本地 HTTP 控制接口, 不依赖 MQTT 服务器
+    ESP8266WebServer *server = LoggerService::get_instance()->web_server();
+    server->on(API_STATE_PATH, HTTP_GET, &Application::handle_api_state_);
+    server->on(API_GOTO_PATH, HTTP_POST, &Application::handle_api_goto_);
+    server->on(API_JOG_PATH, HTTP_POST, &Application::handle_api_jog_);
+    server->on(API_STOP_PATH, HTTP_POST, &Application::handle_api_stop_);
+    server->on(API_TUNING_PATH, &Application::handle_api_tuning_);
+    server->on(API_CALIBRATE_PATH, &Application::handle_api_calibrate_);
 
     // 启用软件看门狗
     ESP.wdtEnable(Application::WATCHDOG_INTERVAL_MS);
+
+    // 注册 MQTT 通信及喂狗任务
+    SchedulerService::get_instance()->add_periodic(
+        "app",
+        []()
+        {
+            Application::get_instance()->update();
+        },
+        UPDATE_INTERVAL_MS * 1000UL, SchedulerService::PRIO_NETWORK);
 }
 
 void Application::update()
 {
     // MQTT 通信
-    m_mqtt.loop();
+    this->update_mqtt_link_();
+
+    // 上报控制路径上产生的状态变化
+    this->publish_states_();
 
     // 喂狗
     ESP.wdtFeed();
+    PROFILE_WDT_FEED();
+
+#if defined(ENABLE_LOOP_PROFILER) && defined(ENABLE_PROFILER_MQTT)
+    // 定时上报主循环任务最大耗时
+    unsigned long cur_ms = millis();
+    if (cur_ms - m_profiler_last_report_ms > PROFILER_REPORT_INTERVAL_MS)
+    {
+        m_profiler_last_report_ms = cur_ms;
+
+        char buf[16];
+        snprintf_P(buf, sizeof(buf), PSTR("%.1f"), ProfilerService::get_instance()->get_max_task_us() / 1000.0);
+        m_sensor_loop_max.setValue(buf);
+    }
+#endif
 }
 
-void Application::load_motor_conf_()
+void Application::publish_states_()
 {
-    if (LittleFS.begin())
+    // 控制任务只记录待上报的状态, 发布 MQTT 消息时网络协议栈需要分配缓冲区, 统一在通信任务中完成
+    for (Cover &cover : m_covers)
     {
-        if (LittleFS.exists(MOTOR_CONF_FILE))
+        if (cover.motor_state)
         {
-            File conf_file = LittleFS.open(MOTOR_CONF_FILE, "r");
-            if (conf_file)
+            cover.sensor_motor.setValue(cover.motor_state);
+            cover.motor_state = nullptr;
+        }
+    }
+
+    if (m_group_skew_pending)
+    {
+        m_group_skew_pending = false;
+
+        char buf[16];
+        snprintf_P(buf, sizeof(buf), PSTR("%ld"), m_group_skew_ms);
+        m_sensor_group_skew.setValue(buf);
+    }
+
+    if (m_tuning_publish_pending)
+    {
+        m_tuning_publish_pending = false;
+
+        const MotorService::Tuning &tuning = MotorService::get_instance(0)->get_tuning();
+        for (TuningNumber &entity : m_tuning_numbers)
+        {
+            entity.number.setState(tuning.*MotorService::TUNING_PARAMS[entity.index].field, true);
+        }
+    }
+}
+
+void Application::update_mqtt_link_()
+{
+    unsigned long cur_ms = millis();
+
+    if (WiFi.status() != WL_CONNECTED)
+    {
+        // WiFi 断开时不调用 m_mqtt.loop(), 避免其在循环内阻塞重连
+        if (m_mqtt_state != MQTT_LINK_BACKOFF)
+        {
+            m_mqtt_probe.abort();
+            this->schedule_mqtt_retry_();
+        }
+        return;
+    }
+
+    switch (m_mqtt_state)
+    {
+    case MQTT_LINK_BACKOFF:
+        if ((long)(cur_ms - m_mqtt_retry_ms) >= 0)
+        {
+            WirelessService *ws = WirelessService::get_instance();
+            if (m_mqtt_probe.start(ws->mqtt_server(), ws->mqtt_port()))
+            {
+                m_mqtt_state = MQTT_LINK_PROBING;
+                m_mqtt_state_ms = cur_ms;
+            }
+            else
             {
-                JsonDocument doc;
-                auto err = deserializeJson(doc, conf_file);
-                if (!err)
-                {
-                    this->m_cover_full_close_pos = doc["full_close_pos"];
-                    this->m_cover_full_open_pos = doc["full_open_pos"];
-                    this->m_cover_current_pos = doc["current_pos"];
-                    // 未设置 reversed 键时默认电机转向为正向
-                    this->m_motor_reversed = doc["reversed"] | false;
-                }
-                else
-                {
-                    LoggerService::printf("Failed to parse motor config file: %s\n", err.c_str());
-                }
-                conf_file.close();
+                this->schedule_mqtt_retry_();
             }
         }
-        else
+        break;
+    case MQTT_LINK_PROBING:
+        switch (m_mqtt_probe.poll(MQTT_PROBE_TIMEOUT_MS))
+        {
+        case TcpProbe::PROBE_SUCCEEDED:
+            // 服务器端口可达, 交给 HAMqtt 建立连接
+            m_mqtt_state = MQTT_LINK_CONNECTING;
+            m_mqtt_state_ms = cur_ms;
+            break;
+        case TcpProbe::PROBE_FAILED:
+            LoggerService::println(F("MQTT broker unreachable"));
+            this->schedule_mqtt_retry_();
+            break;
+        default:
+            break;
+        }
+        break;
+    case MQTT_LINK_CONNECTING:
+        // HAMqtt 建立连接时阻塞等待 CONNACK (最长 MQTT_SOCKET_TIMEOUT), 期间调度器无法运行电机控制任务,
+        // 因此只在电机全部停止时调用, 调用返回前不会处理新的命令; 等待连接的时间从电机停止后起算
+        if (this->is_motion_active_())
+        {
+            m_mqtt_state_ms = cur_ms;
+            break;
+        }
+        m_mqtt_loop_us = micros();
+        m_mqtt.loop();
+        if (m_mqtt.isConnected())
+        {
+            LoggerService::printf_P(PSTR("MQTT connected (%s discovery)\n"), HADiscovery::should_skip() ? "cached" : "full");
+            m_mqtt_state = MQTT_LINK_CONNECTED;
+            m_mqtt_state_ms = cur_ms;
+            m_mqtt_backoff_ms = 0;
+            m_mqtt_connects++;
+
+            // 自动发现配置已发送, 之后的重连跳过发送, 直到 HA 重启
+            HADiscovery::set_skip(true);
+            m_ha_offline_seen = false;
+            m_mqtt.subscribe(HA_STATUS_TOPIC);
+            m_mqtt.subscribe(m_group_topic);
+
+            // 控制参数实体的状态不是保留消息, 每次连接后重新上报
+            m_tuning_publish_pending = true;
+        }
+        else if (cur_ms - m_mqtt_state_ms > MQTT_CONNECT_WINDOW_MS)
+        {
+            LoggerService::println(F("MQTT connect failed"));
+            this->schedule_mqtt_retry_();
+        }
+        break;
+    case MQTT_LINK_CONNECTED:
+        // 连接已断开时直接进入退避, 不让 m_mqtt.loop() 在本轮内阻塞重连
+        if (!m_wifi_client.connected())
+        {
+            LoggerService::println(F("MQTT connection lost"));
+            this->schedule_mqtt_retry_();
+            break;
+        }
+        m_mqtt_loop_us = micros();
+        m_mqtt.loop();
+        if (!m_mqtt.isConnected())
+        {
+            LoggerService::println(F("MQTT connection lost"));
+            this->schedule_mqtt_retry_();
+        }
+        break;
+    }
+}
+
+bool Application::is_motion_active_() const
+{
+    if (m_group_move_task >= 0)
+    {
+        return true;
+    }
+    for (int ch = 0; ch < MOTOR_CHANNELS; ch++)
+    {
+        if (MotorService::get_instance(ch)->is_moving())
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+void Application::schedule_mqtt_retry_()
+{
+    // 指数退避: 首次断线后以最小退避时间重试, 之后每次翻倍直至上限
+    m_mqtt_backoff_ms = (m_mqtt_backoff_ms == 0) ? MQTT_BACKOFF_MIN_MS : min(m_mqtt_backoff_ms * 2, (unsigned long)MQTT_BACKOFF_MAX_MS);
+
+    // 加入随机抖动, 避免 HA 主机重启后所有设备同时重连
+    long jitter = (long)(m_mqtt_backoff_ms * MQTT_BACKOFF_JITTER_PCT / 100);
+    m_mqtt_retry_ms = millis() + m_mqtt_backoff_ms + random(-jitter, jitter + 1);
+
+    m_mqtt_state = MQTT_LINK_BACKOFF;
+    m_mqtt_state_ms = millis();
+}
+
+void Application::on_mqtt_message_(const char *topic, const uint8_t *payload, uint16_t length)
+{
+    RECORD_MQTT(topic, payload, length);
+    Application *app = Application::get_instance();
+    if (strcmp(topic, app->m_group_topic) == 0)
+    {
+        TraceService::get_instance()->discard_receipt();
+        app->plan_group_move_((const char *)payload, length);
+        return;
+    }
+
+    // HA 重启时先发送下线消息再发送上线消息, 此时需要重新发送自动发现配置;
+    // 上线消息可能是保留消息, 订阅后立即收到的上线消息前没有下线消息, 不触发重新发送
+    if (strcmp(topic, HA_STATUS_TOPIC) == 0)
+    {
+        if (length == 7 && memcmp_P(payload, PSTR("offline"), 7) == 0)
+        {
+            app->m_ha_offline_seen = true;
+        }
+        else if (length == 6 && memcmp_P(payload, PSTR("online"), 6) == 0 && app->m_ha_offline_seen &&
+                 HADiscovery::should_skip())
         {
-            LoggerService::println("Motor config file " + String(MOTOR_CONF_FILE) + " not found, using default values.");
+            app->m_ha_offline_seen = false;
+            LoggerService::println(F("Home Assistant restarted, republishing discovery"));
+            HADiscovery::set_skip(false);
+
+            // 断开后由连接状态机以最小退避时间重连并发送完整的自动发现配置
+            app->m_mqtt.disconnect();
+            app->m_mqtt_backoff_ms = 0;
         }
+        return;
+    }
+
+    // 其余消息为 HA 按钮命令, 随后分发给按钮实体, 以本轮 MQTT 循环开始时刻作为接收时刻
+    TraceService::get_instance()->receive(TraceService::SOURCE_MQTT, app->m_mqtt_loop_us);
+}
+
+long Application::percent_to_pos(int channel, int percent) const
+{
+    const Cover &cover = m_covers[channel];
+    return cover.position_map.percent_to_pos(percent, cover.full_close_pos, cover.full_open_pos);
+}
+
+int Application::pos_to_percent(int channel, long pos) const
+{
+    const Cover &cover = m_covers[channel];
+    return cover.position_map.pos_to_percent(pos, cover.full_close_pos, cover.full_open_pos);
+}
+
+void Application::cover_goto(int channel, long pos, const char *source)
+{
+    Cover &cover = m_covers[channel];
+    MotorService *ms = MotorService::get_instance(channel);
+    LoggerService::printf_P(PSTR("%s: Blinds %d goto %ld (%d%%)\n"), source, channel, pos, this->pos_to_percent(channel, pos));
+    bool opening = (pos - ms->get_cover_pos()) * (cover.full_open_pos - cover.full_close_pos) >= 0;
+    ms->goto_pos(pos);
+
+    // 设置电机传感器状态
+    cover.motor_state = opening ? "Opening" : "Closing";
+}
+
+void Application::cover_jog(int channel, int dir, const char *source)
+{
+    Cover &cover = m_covers[channel];
+    MotorService *ms = MotorService::get_instance(channel);
+    if (dir > 0)
+    {
+        LoggerService::printf_P(PSTR("%s: Blinds %d manual close\n"), source, channel);
+        ms->forward(MotorService::PWM_MIN_SPEED);
+        cover.motor_state = "Closing";
     }
     else
     {
-        LoggerService::println("Failed to open filesystem!");
+        LoggerService::printf_P(PSTR("%s: Blinds %d manual open\n"), source, channel);
+        ms->backward(MotorService::PWM_MIN_SPEED);
+        cover.motor_state = "Opening";
+    }
+}
+
+void Application::cover_stop(int channel, const char *source)
+{
+    LoggerService::printf_P(PSTR("%s: Blinds %d stop\n"), source, channel);
+    MotorService::get_instance(channel)->stop();
+    m_covers[channel].motor_state = "Stopped";
+}
+
+int Application::api_channel_()
+{
+    ESP8266WebServer *server = LoggerService::get_instance()->web_server();
+    if (!server->hasArg("ch"))
+    {
+        return 0;
+    }
+    long channel = strtol(server->arg("ch").c_str(), nullptr, 10);
+    return (channel >= 0 && channel < MOTOR_CHANNELS) ? (int)channel : -1;
+}
+
+void Application::send_api_state_(int channel)
+{
+    Application *app = Application::get_instance();
+    const Cover &cover = app->m_covers[channel];
+    MotorService *ms = MotorService::get_instance(channel);
+    long pos = ms->get_cover_pos();
+
+    // 在栈上生成响应, 避免 String 动态分配
+    char buf[256];
+    snprintf_P(buf, sizeof(buf),
+               PSTR("{\"channel\":%d,\"pos\":%ld,\"percent\":%d,\"target\":%ld,\"moving\":%s,\"speed\":%d,"
+                    "\"open_pos\":%ld,\"close_pos\":%ld,\"calibration_points\":%d,\"start_latency_us\":%lu}\n"),
+               channel, pos, app->pos_to_percent(channel, pos), ms->get_target_pos(), ms->is_moving() ? "true" : "false",
+               (int)ms->get_speed_pulse(), cover.full_open_pos, cover.full_close_pos,
+               cover.position_map.point_count(), ms->get_start_latency_us());
+    LoggerService::get_instance()->web_server()->send(200, "application/json", buf);
+}
+
+void Application::send_api_error_(const char *msg)
+{
+    char buf[96];
+    snprintf_P(buf, sizeof(buf), PSTR("{\"error\":\"%s\"}\n"), msg);
+    LoggerService::get_instance()->web_server()->send(400, "application/json", buf);
+}
+
+void Application::handle_api_state_()
+{
+    int channel = Application::api_channel_();
+    if (channel < 0)
+    {
+        Application::send_api_error_("invalid channel");
+        return;
+    }
+    Application::send_api_state_(channel);
+}
+
+void Application::handle_api_goto_()
+{
+    RECORD_HTTP();
+    TraceService::get_instance()->receive(TraceService::SOURCE_HTTP, micros());
+    Application *app = Application::get_instance();
+    ESP8266WebServer *server = LoggerService::get_instance()->web_server();
+    int channel = Application::api_channel_();
+    if (channel < 0)
+    {
+        Application::send_api_error_("invalid channel");
+        return;
+    }
+
+    // 目标可以是电机位置 pos 或开度百分比 percent (0 关闭, 100 打开)
+    if (server->hasArg("pos"))
+    {
+        app->cover_goto(channel, strtol(server->arg("pos").c_str(), nullptr, 10), "HTTP");
+    }
+    else if (server->hasArg("percent"))
+    {
+        long percent = strtol(server->arg("percent").c_str(), nullptr, 10);
+        if (percent < 0 || percent > 100)
+        {
+            Application::send_api_error_("percent out of range");
+            return;
+        }
+        app->cover_goto(channel, app->percent_to_pos(channel, percent), "HTTP");
+    }
+    else
+    {
+        Application::send_api_error_("missing pos or percent");
+        return;
+    }
+    Application::send_api_state_(channel);
+}
+
+void Application::handle_api_jog_()
+{
+    RECORD_HTTP();
+    TraceService::get_instance()->receive(TraceService::SOURCE_HTTP, micros());
+    Application *app = Application::get_instance();
+    ESP8266WebServer *server = LoggerService::get_instance()->web_server();
+    int channel = Application::api_channel_();
+    if (channel < 0)
+    {
+        Application::send_api_error_("invalid channel");
+        return;
+    }
+
+    // delta 为相对当前位置移动的脉冲数, dir=open/close 为持续手动运行直至 stop
+    if (server->hasArg("delta"))
+    {
+        long delta = strtol(server->arg("delta").c_str(), nullptr, 10);
+        app->cover_goto(channel, MotorService::get_instance(channel)->get_cover_pos() + delta, "HTTP");
+    }
+    else if (server->arg("dir") == "open")
+    {
+        app->cover_jog(channel, -1, "HTTP");
+    }
+    else if (server->arg("dir") == "close")
+    {
+        app->cover_jog(channel, 1, "HTTP");
+    }
+    else
+    {
+        Application::send_api_error_("missing delta or dir");
+        return;
+    }
+    Application::send_api_state_(channel);
+}
+
+void Application::handle_api_stop_()
+{
+    RECORD_HTTP();
+    int channel = Application::api_channel_();
+    if (channel < 0)
+    {
+        Application::send_api_error_("invalid channel");
+        return;
+    }
+    Application::get_instance()->cover_stop(channel, "HTTP");
+    Application::send_api_state_(channel);
+}
+
+void Application::send_api_tuning_(int channel)
+{
+    const MotorService::Tuning &tuning = MotorService::get_instance(channel)->get_tuning();
+
+    char buf[384];
+    int len = snprintf_P(buf, sizeof(buf), PSTR("{\"channel\":%d"), channel);
+    for (const MotorService::TuningParam &param : MotorService::TUNING_PARAMS)
+    {
+        len += snprintf_P(buf + len, sizeof(buf) - len, PSTR(",\"%s\":%g"), param.key, tuning.*param.field);
     }
+    snprintf_P(buf + len, sizeof(buf) - len, PSTR("}\n"));
+    LoggerService::get_instance()->web_server()->send(200, "application/json", buf);
 }
 
-void Application::save_motor_conf_()
+void Application::handle_api_tuning_()
 {
-    if (LittleFS.begin())
+    Application *app = Application::get_instance();
+    ESP8266WebServer *server = LoggerService::get_instance()->web_server();
+    int channel = Application::api_channel_();
+    if (channel < 0)
+    {
+        Application::send_api_error_("invalid channel");
+        return;
+    }
+    if (server->method() != HTTP_POST)
     {
-        JsonDocument doc;
-        doc["full_close_pos"] = this->m_cover_full_close_pos;
-        doc["full_open_pos"] = this->m_cover_full_open_pos;
-        doc["current_pos"] = this->m_cover_current_pos;
-        doc["reversed"] = this->m_motor_reversed;
+        Application::send_api_tuning_(channel);
+        return;
+    }
+    RECORD_HTTP();
 
-        File conf_file = LittleFS.open(MOTOR_CONF_FILE, "w");
-        if (!conf_file)
+    // 在当前参数 (或 reset 时的默认值) 基础上修改请求中给出的参数, 全部校验通过后整体生效
+    MotorService *ms = MotorService::get_instance(channel);
+    MotorService::Tuning tuning = server->hasArg("reset") ? MotorService::default_tuning() : ms->get_tuning();
+    for (const MotorService::TuningParam &param : MotorService::TUNING_PARAMS)
+    {
+        if (!server->hasArg(param.key))
+        {
+            continue;
+        }
+        const String &arg = server->arg(param.key);
+        char *end = nullptr;
+        float value = strtof(arg.c_str(), &end);
+        if (end == arg.c_str() || *end != '\0' || !(value >= param.min && value <= param.max))
         {
-            LoggerService::println("Failed to open motor config file for writing: " + String(MOTOR_CONF_FILE));
+            char msg[48];
+            snprintf_P(msg, sizeof(msg), PSTR("%s out of range"), param.key);
+            Application::send_api_error_(msg);
             return;
         }
+        tuning.*param.field = value;
+    }
+
+    if (!app->update_tuning_(channel, tuning))
+    {
+        Application::send_api_error_("invalid tuning");
+        return;
+    }
+    LoggerService::printf_P(PSTR("HTTP: Motor %d tuning updated\n"), channel);
+    Application::send_api_tuning_(channel);
+}
 
-        serializeJson(doc, conf_file);
-        serializeJson(doc, Serial);
-        conf_file.close();
+void Application::send_api_calibration_(int channel)
+{
+    const Cover &cover = Application::get_instance()->m_covers[channel];
+    PositionMap::Point knots[PositionMap::MAX_KNOTS];
+    int n = cover.position_map.knots(cover.full_close_pos, cover.full_open_pos, knots);
+
+    // 输出实际参与插值的节点 (含两端), 以及保存的中间标定点数
+    char buf[384];
+    int len = snprintf_P(buf, sizeof(buf), PSTR("{\"channel\":%d,\"points\":%d,\"knots\":["),
+                         channel, cover.position_map.point_count());
+    for (int i = 0; i < n; i++)
+    {
+        len += snprintf_P(buf + len, sizeof(buf) - len, PSTR("%s{\"percent\":%u,\"pos\":%ld}"),
+                          i ? "," : "", knots[i].percent, (long)knots[i].pos);
+    }
+    snprintf_P(buf + len, sizeof(buf) - len, PSTR("]}\n"));
+    LoggerService::get_instance()->web_server()->send(200, "application/json", buf);
+}
+
+void Application::handle_api_calibrate_()
+{
+    Application *app = Application::get_instance();
+    ESP8266WebServer *server = LoggerService::get_instance()->web_server();
+    int channel = Application::api_channel_();
+    if (channel < 0)
+    {
+        Application::send_api_error_("invalid channel");
+        return;
+    }
+    if (server->method() != HTTP_POST)
+    {
+        Application::send_api_calibration_(channel);
+        return;
+    }
+    RECORD_HTTP();
 
-        LoggerService::println("Motor state saved to " + String(MOTOR_CONF_FILE));
+    Cover &cover = app->m_covers[channel];
+    if (server->hasArg("clear"))
+    {
+        app->clear_calibration_points_(cover, "HTTP");
+    }
+    else if (server->hasArg("percent"))
+    {
+        long percent = strtol(server->arg("percent").c_str(), nullptr, 10);
+        if (percent < 1 || percent > 99)
+        {
+            Application::send_api_error_("percent out of range");
+            return;
+        }
+        if (!app->calibrate_percent_(cover, percent, "HTTP"))
+        {
+            Application::send_api_error_("position not between neighbouring points");
+            return;
+        }
     }
     else
     {
-        LoggerService::println("Failed to open filesystem!");
+        Application::send_api_error_("missing percent or clear");
+        return;
     }
+    Application::send_api_calibration_(channel);
 }
 
-void Application::on_motor_stop_(long cur_pos)
+void Application::plan_group_move_(const char *payload, uint16_t length)
+{
+    // 负载格式: "<开度百分比> <UTC 起始时间 ms>"
+    char buf[48];
+    size_t n = min((size_t)length, sizeof(buf) - 1);
+    memcpy(buf, payload, n);
+    buf[n] = '\0';
+
+    char *end = nullptr;
+    long percent = strtol(buf, &end, 10);
+    long long start_ms = strtoll(end, &end, 10);
+    if (end == buf || percent < 0 || percent > 100 || start_ms <= 0)
+    {
+        LoggerService::printf_P(PSTR("Group move: invalid payload '%s'\n"), buf);
+        return;
+    }
+
+    NTPService *ntp = NTPService::get_instance();
+    if (!ntp->is_synced())
+    {
+        LoggerService::println(F("Group move: time not synchronized, ignored"));
+        return;
+    }
+
+    int64_t lead_ms = start_ms - ntp->epoch_ms();
+    if (lead_ms < -GROUP_MAX_LATE_MS || lead_ms > GROUP_MAX_LEAD_MS)
+    {
+        LoggerService::printf_P(PSTR("Group move: start time out of range (%ld ms ahead), ignored\n"), (long)lead_ms);
+        return;
+    }
+
+    // 预先换算各通道目标位置, 并以单次高优先级任务在约定时刻启动
+    SchedulerService *scheduler = SchedulerService::get_instance();
+    scheduler->cancel(m_group_move_task);
+    for (Cover &cover : m_covers)
+    {
+        cover.group_target = this->percent_to_pos(cover.channel, percent);
+    }
+    m_group_move_start_ms = start_ms;
+    m_group_move_task = scheduler->add_oneshot("group", &Application::start_group_move_,
+                                               lead_ms > 0 ? (unsigned long)lead_ms * 1000UL : 0,
+                                               SchedulerService::PRIO_CONTROL);
+
+    LoggerService::printf_P(PSTR("Group move: %ld%% (pos %ld) planned in %ld ms\n"), percent, m_covers[0].group_target, (long)lead_ms);
+}
+
+void Application::start_group_move_()
 {
     Application *app = Application::get_instance();
+    app->m_group_move_task = -1;
+
+    for (Cover &cover : app->m_covers)
+    {
+        MotorService::get_instance(cover.channel)->goto_pos(cover.group_target);
+    }
+    int64_t skew_ms = NTPService::get_instance()->epoch_ms() - app->m_group_move_start_ms;
 
-    LoggerService::println("Callback: Motor stopped at position: " + String(cur_pos));
+    // 设置电机传感器状态及启动偏差, 由 MQTT 通信任务上报
+    for (Cover &cover : app->m_covers)
+    {
+        cover.motor_state = "Moving";
+    }
+    app->m_group_skew_ms = (long)skew_ms;
+    app->m_group_skew_pending = true;
+    LoggerService::printf_P(PSTR("Group move started, skew %ld ms\n"), (long)skew_ms);
+}
 
-    // 保存电机当前位置
-    app->m_cover_current_pos = cur_pos;
-    app->save_motor_conf_();
+void Application::load_motor_conf_(Cover &cover)
+{
+    const ConfigService::MotorConf &conf = ConfigService::get_instance()->motor(cover.channel);
+    cover.full_close_pos = conf.full_close_pos;
+    cover.full_open_pos = conf.full_open_pos;
+    cover.current_pos = conf.current_pos;
+    cover.reversed = conf.reversed != 0;
+    cover.backlash = conf.backlash;
+    cover.slack = conf.slack;
 
-    // 设置电机传感器状态
-    app->m_sensor_motor.setValue("Stopped");
+    // 中间标定点按当前两端重新校验, 不再单调的点丢弃
+    const ConfigService::CalibrationConf &calib = ConfigService::get_instance()->calibration(cover.channel);
+    cover.position_map.clear_points();
+    for (int i = 0; i < min((int)calib.count, PositionMap::MAX_POINTS); i++)
+    {
+        cover.position_map.set_point(calib.percent[i], calib.pos[i], cover.full_close_pos, cover.full_open_pos);
+    }
 }
 
-void Application::on_cover_command_(HAButton *sender)
+void Application::save_motor_conf_(const Cover &cover)
+{
+    ConfigService *config = ConfigService::get_instance();
+    ConfigService::MotorConf &conf = config->motor(cover.channel);
+    conf.full_close_pos = cover.full_close_pos;
+    conf.full_open_pos = cover.full_open_pos;
+    conf.current_pos = cover.current_pos;
+    conf.reversed = cover.reversed ? 1 : 0;
+    conf.backlash = cover.backlash;
+    conf.slack = cover.slack;
+
+    ConfigService::CalibrationConf &calib = config->calibration(cover.channel);
+    calib.count = cover.position_map.point_count();
+    for (int i = 0; i < calib.count; i++)
+    {
+        calib.percent[i] = cover.position_map.point(i).percent;
+        calib.pos[i] = cover.position_map.point(i).pos;
+    }
+
+    if (config->save())
+    {
+        LoggerService::printf_P(PSTR("Motor %u state saved: open=%ld, close=%ld, current=%ld, reversed=%d\n"),
+                                cover.channel, cover.full_open_pos, cover.full_close_pos, cover.current_pos, cover.reversed);
+    }
+}
+
+void Application::load_tuning_(int channel)
+{
+    const ConfigService::TuningConf &conf = ConfigService::get_instance()->tuning(channel);
+    if (!conf.valid)
+    {
+        return;
+    }
+
+    MotorService::Tuning tuning;
+    tuning.kp = conf.kp;
+    tuning.ki = conf.ki;
+    tuning.kd = conf.kd;
+    tuning.pid_sample_ms = conf.pid_sample_ms;
+    tuning.stable_sample_ms = conf.stable_sample_ms;
+    tuning.stable_n_sample = conf.stable_n_sample;
+    tuning.speed_cutoff_hz = conf.speed_cutoff_hz;
+    tuning.rel_err_tol = conf.rel_err_tol;
+    tuning.abs_err_tol = conf.abs_err_tol;
+    if (!MotorService::get_instance(channel)->set_tuning(tuning))
+    {
+        LoggerService::printf_P(PSTR("Motor %d saved tuning out of range, using defaults\n"), channel);
+    }
+}
+
+void Application::save_tuning_(int channel)
+{
+    ConfigService *config = ConfigService::get_instance();
+    ConfigService::TuningConf &conf = config->tuning(channel);
+    const MotorService::Tuning &tuning = MotorService::get_instance(channel)->get_tuning();
+    conf.kp = tuning.kp;
+    conf.ki = tuning.ki;
+    conf.kd = tuning.kd;
+    conf.pid_sample_ms = tuning.pid_sample_ms;
+    conf.stable_sample_ms = tuning.stable_sample_ms;
+    conf.stable_n_sample = tuning.stable_n_sample;
+    conf.speed_cutoff_hz = tuning.speed_cutoff_hz;
+    conf.rel_err_tol = tuning.rel_err_tol;
+    conf.abs_err_tol = tuning.abs_err_tol;
+
+    // 与默认值相同时不标记为有效, 之后固件调整默认值时随之生效
+    MotorService::Tuning defaults = MotorService::default_tuning();
+    conf.valid = memcmp(&tuning, &defaults, sizeof(defaults)) != 0 ? 1 : 0;
+
+    if (config->save())
+    {
+        LoggerService::printf_P(PSTR("Motor %d tuning saved (%s)\n"), channel, conf.valid ? "custom" : "default");
+    }
+}
+
+bool Application::update_tuning_(int channel, const MotorService::Tuning &tuning)
+{
+    if (!MotorService::get_instance(channel)->set_tuning(tuning))
+    {
+        return false;
+    }
+
+    // 参数在下一个控制周期生效, 写入 Flash 及上报 HA 由后台任务和通信任务完成
+    m_covers[channel].tuning_pending = true;
+    this->request_persist_();
+    if (channel == 0)
+    {
+        m_tuning_publish_pending = true;
+    }
+    return true;
+}
+
+void Application::on_tuning_command_(HANumeric number, HANumber *sender)
 {
     Application *app = Application::get_instance();
-    MotorService *ms = MotorService::get_instance();
+    for (TuningNumber &entity : app->m_tuning_numbers)
+    {
+        if (sender != &entity.number || !number.isSet())
+        {
+            continue;
+        }
 
-    if (sender == &(app->m_btn_open))
+        const MotorService::TuningParam &param = MotorService::TUNING_PARAMS[entity.index];
+        MotorService::Tuning tuning = MotorService::get_instance(0)->get_tuning();
+        tuning.*param.field = number.toFloat();
+        if (app->update_tuning_(0, tuning))
+        {
+            LoggerService::printf_P(PSTR("Command: Motor 0 tuning %s = %g\n"), param.key, tuning.*param.field);
+        }
+        else
+        {
+            // 拒绝超出范围的值, 重新上报当前值让 HA 界面恢复
+            LoggerService::printf_P(PSTR("Command: Motor 0 tuning %s out of range, rejected\n"), param.key);
+            app->m_tuning_publish_pending = true;
+        }
+    }
+}
+
+bool Application::calibrate_percent_(Cover &cover, int percent, const char *source)
+{
+    // 运动中的位置不稳定, 只在电机停止时标定
+    MotorService *ms = MotorService::get_instance(cover.channel);
+    long pos = ms->get_cover_pos();
+    if (ms->is_moving() || !cover.position_map.set_point(percent, pos, cover.full_close_pos, cover.full_open_pos))
     {
-        LoggerService::println("Command: Blinds auto open");
-        ms->goto_pos(app->m_cover_full_open_pos);
+        LoggerService::printf_P(PSTR("%s: Blinds %u mark %d%% position at %ld rejected\n"), source, cover.channel, percent, pos);
+        return false;
+    }
+    LoggerService::printf_P(PSTR("%s: Blinds %u mark %d%% position at %ld\n"), source, cover.channel, percent, pos);
 
-        // 设置电机传感器状态
-        app->m_sensor_motor.setValue("Opening");
+    // 保存开度标定点
+    cover.conf_pending = true;
+    this->request_persist_();
+    return true;
+}
+
+void Application::clear_calibration_points_(Cover &cover, const char *source)
+{
+    LoggerService::printf_P(PSTR("%s: Blinds %u clear intermediate calibration points\n"), source, cover.channel);
+    cover.position_map.clear_points();
+
+    // 保存开度标定点
+    cover.conf_pending = true;
+    this->request_persist_();
+}
+
+void Application::on_calibrate_command_(HANumeric number, HANumber *sender)
+{
+    Application *app = Application::get_instance();
+    for (Cover &cover : app->m_covers)
+    {
+        if (sender != &cover.num_calibrate || !number.isSet())
+        {
+            continue;
+        }
+
+        // 标定成功后上报该开度, 作为最近一次标定的记录
+        if (app->calibrate_percent_(cover, number.toInt32(), "Command"))
+        {
+            sender->setState(number);
+        }
     }
-    else if (sender == &(app->m_btn_close))
+}
+
+void Application::on_motor_stop_(uint8_t channel, long cur_pos)
+{
+    Application *app = Application::get_instance();
+    Cover &cover = app->m_covers[channel];
+    MotorService *ms = MotorService::get_instance(channel);
+
+    LoggerService::printf_P(PSTR("Callback: Motor %u stopped at position: %ld\n"), channel, cur_pos);
+
+    // 保存电机当前位置及齿隙状态, 并记录运动历史统计; 齿隙标定的结果 (含失败或放弃时保留的原值) 同样在此同步
+    cover.current_pos = cur_pos;
+    cover.backlash = ms->get_backlash();
+    cover.slack = ms->get_backlash_slack();
+    cover.move_stats = ms->get_move_stats();
+    cover.conf_pending = true;
+    cover.history_pending = true;
+    app->request_persist_();
+
+    // 设置电机传感器状态
+    cover.motor_state = "Stopped";
+}
+
+void Application::request_persist_()
+{
+    // 写入 Flash 需要打开文件 (堆分配) 并等待擦写, 不在控制任务中进行, 交给后台任务完成
+    if (m_persist_task < 0)
     {
-        LoggerService::println("Command: Blinds auto close");
-        ms->goto_pos(app->m_cover_full_close_pos);
+        m_persist_task = SchedulerService::get_instance()->add_oneshot("persist", &Application::persist_covers_, 0,
+                                                                       SchedulerService::PRIO_BACKGROUND);
+    }
+}
 
-        // 设置电机传感器状态
-        app->m_sensor_motor.setValue("Closing");
+void Application::persist_covers_()
+{
+    Application *app = Application::get_instance();
+    app->m_persist_task = -1;
+
+    for (Cover &cover : app->m_covers)
+    {
+        if (cover.conf_pending)
+        {
+            cover.conf_pending = false;
+            app->save_motor_conf_(cover);
+        }
+        if (cover.tuning_pending)
+        {
+            cover.tuning_pending = false;
+            app->save_tuning_(cover.channel);
+        }
+        if (cover.history_pending)
+        {
+            cover.history_pending = false;
+            HistoryService::get_instance()->append(cover.move_stats);
+        }
     }
-    else if (sender == &(app->m_btn_stop))
+}
+
+void Application::on_cover_command_(HAButton *sender)
+{
+    Application *app = Application::get_instance();
+
+    for (Cover &cover : app->m_covers)
     {
-        LoggerService::println("Command: Blinds stop");
-        ms->stop();
+        MotorService *ms = MotorService::get_instance(cover.channel);
 
-        // 设置电机传感器状态
-        app->m_sensor_motor.setValue("Stopped");
+        if (sender == &cover.btn_open)
+        {
+            LoggerService::printf_P(PSTR("Command: Blinds %u auto open\n"), cover.channel);
+            ms->goto_pos(cover.full_open_pos);
+
+            // 设置电机传感器状态
+            cover.motor_state = "Opening";
+        }
+        else if (sender == &cover.btn_close)
+        {
+            LoggerService::printf_P(PSTR("Command: Blinds %u auto close\n"), cover.channel);
+            ms->goto_pos(cover.full_close_pos);
+
+            // 设置电机传感器状态
+            cover.motor_state = "Closing";
+        }
+        else if (sender == &cover.btn_stop)
+        {
+            LoggerService::printf_P(PSTR("Command: Blinds %u stop\n"), cover.channel);
+            ms->stop();
+
+            // 设置电机传感器状态
+            cover.motor_state = "Stopped";
+        }
     }
 }
 
 void Application::on_ir_key_(IRKey key)
 {
     Application *app = Application::get_instance();
-    MotorService *ms = MotorService::get_instance();
-    long cur_pos = ms->get_pos_pulse();
+    Cover &cover = app->m_covers[app->m_ir_channel];
+    MotorService *ms = MotorService::get_instance(cover.channel);
+    long cur_pos = ms->get_cover_pos();
 
     switch (key)
     {
     case KEY_LEFT: // 窗帘手动升起 (CCW)
-        LoggerService::println("IR remote: Blinds manual open");
+        LoggerService::println(F("IR remote: Blinds manual open"));
         ms->backward(MotorService::PWM_MIN_SPEED);
 
         // 设置电机传感器状态
-        app->m_sensor_motor.setValue("Opening");
+        cover.motor_state = "Opening";
         break;
     case KEY_RIGHT: // 窗帘手动放下 (CW)
-        LoggerService::println("IR remote: Blinds manual close");
+        LoggerService::println(F("IR remote: Blinds manual close"));
         ms->forward(MotorService::PWM_MIN_SPEED);
 
         // 设置电机传感器状态
-        app->m_sensor_motor.setValue("Closing");
+        cover.motor_state = "Closing";
         break;
     case KEY_OK: // 电机停止
-        LoggerService::println("IR remote: Blinds stop");
+        if (ms->is_backlash_cal())
+        {
+            // 齿隙标定过程中窗帘开始移动时按下 OK 键结束标定
+            long backlash = ms->finish_backlash_cal();
+            // 齿隙由电机停止回调同步并保存
+            if (backlash >= 0)
+            {
+                LoggerService::printf_P(PSTR("IR remote: Backlash calibrated to %ld pulses\n"), backlash);
+            }
+            else
+            {
+                LoggerService::println(F("IR remote: Backlash calibration failed"));
+            }
+            cover.motor_state = "Stopped";
+            cur_pos = ms->get_cover_pos();
+            break;
+        }
+        LoggerService::println(F("IR remote: Blinds stop"));
         ms->stop();
 
         // 设置电机传感器状态
-        app->m_sensor_motor.setValue("Stopped");
+        cover.motor_state = "Stopped";
         break;
     case KEY_UP: // 电机运行至完全打开
-        LoggerService::println("IR remote: Blinds auto open");
-        ms->goto_pos(app->m_cover_full_open_pos);
+        LoggerService::println(F("IR remote: Blinds auto open"));
+        ms->goto_pos(cover.full_open_pos);
 
         // 设置电机传感器状态
-        app->m_sensor_motor.setValue("Opening");
+        cover.motor_state = "Opening";
         break;
     case KEY_DOWN: // 电机运行至完全关闭
-        LoggerService::println("IR remote: Blinds auto close");
-        ms->goto_pos(app->m_cover_full_close_pos);
+        LoggerService::println(F("IR remote: Blinds auto close"));
+        ms->goto_pos(cover.full_close_pos);
 
         // 设置电机传感器状态
-        app->m_sensor_motor.setValue("Closing");
+        cover.motor_state = "Closing";
         break;
     case KEY_POUND: // 切换电机转向
         if (app->m_last_ir_key == KEY_0 && app->m_last_ir_key_pos == cur_pos)
         {
             // 顺序按下 0、# 键，切换电机转向
-            LoggerService::println("IR remote: Toggle motor direction");
-            app->m_motor_reversed = !ms->get_reverse();
-            LoggerService::println("Motor direction set to: " + String(app->m_motor_reversed ? "reversed" : "normal"));
+            LoggerService::println(F("IR remote: Toggle motor direction"));
+            cover.reversed = !ms->get_reverse();
+            LoggerService::printf_P(PSTR("Motor direction set to: %s\n"), cover.reversed ? "reversed" : "normal");
 
             // 设置电机转向
-            ms->set_reverse(app->m_motor_reversed);
+            ms->set_reverse(cover.reversed);
 
             // 保存电机配置
-            app->save_motor_conf_();
+            cover.conf_pending = true;
+            app->request_persist_();
         }
         else
         {
-            LoggerService::println("IR remote: Toggle motor direction failed, wrong key sequence");
+            LoggerService::println(F("IR remote: Toggle motor direction failed, wrong key sequence"));
         }
         break;
     case KEY_2: // 清除电机标定位置
         if (app->m_last_ir_key == KEY_0 && app->m_last_ir_key_pos == cur_pos)
         {
             // 顺序按下 0、2 键，清除电机标定位置
-            LoggerService::println("IR remote: Blinds clear motor calibration");
-            app->m_cover_full_close_pos = 0;
-            app->m_cover_full_open_pos = 0;
-            app->m_cover_current_pos = 0;
+            LoggerService::println(F("IR remote: Blinds clear motor calibration"));
+            cover.full_close_pos = 0;
+            cover.full_open_pos = 0;
+            cover.position_map.clear_points();
+            cover.current_pos = 0;
 
             // 重置电机编码器位置
-            ms->set_motor_pos(0);
+            ms->set_cover_pos(0);
 
             // 保存电机标定位置
-            app->save_motor_conf_();
+            cover.conf_pending = true;
+            app->request_persist_();
         }
         else
         {
-            LoggerService::println("IR remote: Blinds clear motor calibration failed, wrong key sequence");
+            LoggerService::println(F("IR remote: Blinds clear motor calibration failed, wrong key sequence"));
         }
         break;
     case KEY_1: // 标记电机当前位置为打开点
         if (app->m_last_ir_key == KEY_0 && app->m_last_ir_key_pos == cur_pos)
         {
             // 顺序按下 0、1 键，标记电机当前位置为打开点
-            LoggerService::println("IR remote: Blinds mark full open position");
-            app->m_cover_full_open_pos = cur_pos;
+            LoggerService::println(F("IR remote: Blinds mark full open position"));
+            cover.full_open_pos = cur_pos;
 
             // 保存电机标定位置
-            app->save_motor_conf_();
+            cover.conf_pending = true;
+            app->request_persist_();
         }
         else
         {
-            LoggerService::println("IR remote: Blinds mark full open position failed, wrong key sequence");
+            LoggerService::println(F("IR remote: Blinds mark full open position failed, wrong key sequence"));
         }
         break;
     case KEY_3: // 标记电机当前位置为关闭点
         if (app->m_last_ir_key == KEY_0 && app->m_last_ir_key_pos == cur_pos)
         {
             // 顺序按下 0、3 键，标记电机当前位置为关闭点
-            LoggerService::println("IR remote: Blinds mark full close position");
-            app->m_cover_full_close_pos = cur_pos;
+            LoggerService::println(F("IR remote: Blinds mark full close position"));
+            cover.full_close_pos = cur_pos;
 
             // 保存电机标定位置
-            app->save_motor_conf_();
+            cover.conf_pending = true;
+            app->request_persist_();
         }
         else
         {
-            LoggerService::println("IR remote: Blinds mark full close position failed, wrong key sequence");
+            LoggerService::println(F("IR remote: Blinds mark full close position failed, wrong key sequence"));
         }
         break;
     case KEY_4: // 手动触发同步 NTP 时间
         if (app->m_last_ir_key == KEY_0 && app->m_last_ir_key_pos == cur_pos)
         {
             // 顺序按下 0、4 键，手动触发同步 NTP 时间
-            LoggerService::println("IR remote: Manually sync NTP time");
+            LoggerService::println(F("IR remote: Manually sync NTP time"));
             NTPService::get_instance()->update(true);
         }
         else
         {
-            LoggerService::println("IR remote: Manually sync NTP time failed, wrong key sequence");
+            LoggerService::println(F("IR remote: Manually sync NTP time failed, wrong key sequence"));
         }
         break;
+    case KEY_5: // 标定电机齿隙
+        if (app->m_last_ir_key == KEY_0 && app->m_last_ir_key_pos == cur_pos)
+        {
+            // 顺序按下 0、5 键，电机低速反向运行，窗帘开始移动时按 OK 键完成齿隙标定
+            LoggerService::println(F("IR remote: Blinds backlash calibration start, press OK when blinds start moving"));
+            ms->start_backlash_cal();
+
+            // 设置电机传感器状态
+            cover.motor_state = "Calibrating";
+        }
+        else
+        {
+            LoggerService::println(F("IR remote: Blinds backlash calibration failed, wrong key sequence"));
+        }
+        break;
+    case KEY_7: // 标记电机当前位置为 25% 开度
+    case KEY_8: // 标记电机当前位置为 50% 开度
+    case KEY_9: // 标记电机当前位置为 75% 开度
+        if (app->m_last_ir_key == KEY_0 && app->m_last_ir_key_pos == cur_pos)
+        {
+            // 顺序按下 0、7/8/9 键，标记电机当前位置为 25%/50%/75% 开度
+            app->calibrate_percent_(cover, key == KEY_7 ? 25 : key == KEY_8 ? 50 : 75, "IR remote");
+        }
+        else
+        {
+            LoggerService::println(F("IR remote: Blinds mark partial position failed, wrong key sequence"));
+        }
+        break;
+    case KEY_6: // 清除开度中间标定点
+        if (app->m_last_ir_key == KEY_0 && app->m_last_ir_key_pos == cur_pos)
+        {
+            // 顺序按下 0、6 键，清除开度中间标定点, 恢复两端之间线性换算
+            app->clear_calibration_points_(cover, "IR remote");
+        }
+        else
+        {
+            LoggerService::println(F("IR remote: Blinds clear partial positions failed, wrong key sequence"));
+        }
+        break;
+    case KEY_STAR: // 切换红外遥控器控制的电机通道
+        app->m_ir_channel = (app->m_ir_channel + 1) % MOTOR_CHANNELS;
+        LoggerService::printf_P(PSTR("IR remote: Controlling blinds %u\n"), app->m_ir_channel);
+        cur_pos = MotorService::get_instance(app->m_ir_channel)->get_cover_pos();
+        break;
     case KEY_0: // 功能键序列开始
-        LoggerService::println("IR remote: Blinds function key sequence start");
+        LoggerService::println(F("IR remote: Blinds function key sequence start"));
         break;
     default:
-        LoggerService::println("IR remote: unknown key pressed");
+        LoggerService::println(F("IR remote: unknown key pressed"));
         break;
     }
 
@@ -1,6 +1,11 @@
 #pragma once
 
+#include "config/pins.h"
 #include "service/ir.h"
+#include "service/motor.h"
+#include "utility/tcp_probe.h"
+#include "utility/position_map.h"
+#include "utility/ha_discovery.h"
 
 #include <ESP8266WiFi.h>
 #include <ArduinoHA.h>
@@ -13,17 +18,49 @@ public:
     static constexpr const char *BTN_STOP_NAME = "blinds_stop";
     static constexpr const char *SENSOR_BAT_NAME = "sensor_battery";
     static constexpr const char *SENSOR_MOTOR_NAME = "sensor_motor";
-    static constexpr const char *MOTOR_CONF_FILE = "/motor_conf.json";
+    static constexpr const char *BTN_OPEN2_NAME = "blinds2_open"; // 第二通道实体
+    static constexpr const char *BTN_CLOSE2_NAME = "blinds2_close";
+    static constexpr const char *BTN_STOP2_NAME = "blinds2_stop";
+    static constexpr const char *SENSOR_MOTOR2_NAME = "sensor_motor2";
+    static constexpr const char *NUM_CALIBRATE_NAME = "calibrate_percent";
+    static constexpr const char *NUM_CALIBRATE2_NAME = "calibrate2_percent";
     static constexpr int BATTERY_UPDATE_INTERVAL_MS = 2000;
     static constexpr int WATCHDOG_INTERVAL_MS = 60000;
+    static constexpr int UPDATE_INTERVAL_MS = 10; // MQTT 通信及喂狗间隔(ms)
+    static constexpr const char *SENSOR_LOOP_MAX_NAME = "sensor_loop_max";
+    static constexpr int PROFILER_REPORT_INTERVAL_MS = 30000; // 主循环性能诊断数据上报间隔(ms)
+    static constexpr int MQTT_BACKOFF_MIN_MS = 2000;          // MQTT 重连最小退避时间(ms)
+    static constexpr int MQTT_BACKOFF_MAX_MS = 120000;        // MQTT 重连最大退避时间(ms)
+    static constexpr int MQTT_BACKOFF_JITTER_PCT = 25;        // MQTT 重连退避时间随机抖动比例(%)
+    static constexpr int MQTT_PROBE_TIMEOUT_MS = 3000;        // MQTT 服务器连通性探测超时时间(ms)
+    static constexpr int MQTT_CONNECT_WINDOW_MS = 12000;      // 探测成功后等待 MQTT 连接建立的时间(ms), 需大于 HAMqtt 重连间隔
+    static constexpr int MQTT_IO_TIMEOUT_MS = 250;            // MQTT 套接字连接及写入超时时间(ms), 等待 CONNACK 及读取报文的超时由编译选项 MQTT_SOCKET_TIMEOUT 限制为 1s, 只在电机停止时建立连接
+    static constexpr const char *HA_STATUS_TOPIC = "homeassistant/status";
+    static constexpr int MQTT_MAX_DEVICE_TYPES = 24;          // HA 实体数量上限
+    static constexpr const char *SENSOR_GROUP_SKEW_NAME = "sensor_group_skew";
+    static constexpr const char *GROUP_TOPIC_FMT = "chaosblinds/group/%s/move"; // 同步移动命令主题, 负载为 "<开度百分比> <UTC 起始时间 ms>"
+    static constexpr int GROUP_MAX_LEAD_MS = 60000; // 同步移动起始时间最多提前量(ms)
+    static constexpr int GROUP_MAX_LATE_MS = 2000;  // 同步移动起始时间已过去超过该值时放弃移动(ms)
+    static constexpr const char *API_STATE_PATH = "/api/state"; // 本地 HTTP 控制接口, 与日志共用 HTTP 服务
+    static constexpr const char *API_GOTO_PATH = "/api/goto";
+    static constexpr const char *API_JOG_PATH = "/api/jog";
+    static constexpr const char *API_STOP_PATH = "/api/stop"; // 以上接口均可用 ch=<通道号> 选择电机通道, 默认 0
+    static constexpr const char *API_TUNING_PATH = "/api/tuning"; // GET 查询控制参数, POST 修改 (参数名同 MotorService::TUNING_PARAMS, reset 恢复默认值)
+    static constexpr const char *API_CALIBRATE_PATH = "/api/calibrate"; // GET 查询开度标定节点, POST percent=<1-99> 标定当前位置, clear 清除中间标定点
+
+    // MQTT 连接状态
+    enum MqttLinkState
+    {
+        MQTT_LINK_BACKOFF,    // 等待下次重连
+        MQTT_LINK_PROBING,    // 非阻塞探测服务器端口
+        MQTT_LINK_CONNECTING, // 服务器可达, 等待电机停止后建立 MQTT 连接
+        MQTT_LINK_CONNECTED   // 已连接
+    };
 
     static Application *get_instance()
     {
-        if (m_instance == nullptr)
-        {
-            m_instance = new Application();
-        }
-        return m_instance;
+        static Application instance;
+        return &instance;
     }
 
     ~Application();
@@ -31,31 +68,129 @@ public:
     void begin();
     void update();
 
+    /** 将开度百分比 (0 关闭, 100 打开) 按标定表换算为指定通道的电机位置 */
+    long percent_to_pos(int channel, int percent) const;
+    /** 将指定通道的电机位置按标定表换算为开度百分比 */
+    int pos_to_percent(int channel, long pos) const;
+
+    /** 窗帘运行至指定位置, source 为命令来源 */
+    void cover_goto(int channel, long pos, const char *source);
+    /** 窗帘手动运行, dir > 0 为放下(关闭方向), dir < 0 为升起(打开方向) */
+    void cover_jog(int channel, int dir, const char *source);
+    /** 窗帘停止 */
+    void cover_stop(int channel, const char *source);
+
+    /** MQTT 是否已连接 */
+    bool is_mqtt_connected() const { return m_mqtt_state == MQTT_LINK_CONNECTED; }
+    /** 获取 MQTT 重连成功次数, 不含启动后的首次连接 */
+    uint32_t get_mqtt_reconnects() const { return m_mqtt_connects > 0 ? m_mqtt_connects - 1 : 0; }
+
 protected:
     Application();
 
+    /** 单个电机通道的窗帘标定数据及 HA 实体 */
+    struct Cover
+    {
+        Cover(uint8_t channel);
+
+        uint8_t channel;
+        long full_close_pos;                // 窗帘完全关闭时的电机标定位置
+        long full_open_pos;                 // 窗帘完全打开时的电机标定位置
+        PositionMap position_map;           // 开度中间标定点
+        long current_pos;                   // 当前电机停止位置
+        bool reversed;                      // 电机是否反向
+        long backlash;                      // 电机齿隙大小(编码脉冲数)
+        long slack;                         // 电机停止时在齿隙中的位置
+        long group_target;                  // 同步移动目标位置
+        const char *motor_state;            // 待上报的电机状态, nullptr 表示无需上报
+        bool conf_pending;                  // 电机配置是否待写入 Flash
+        bool history_pending;               // 运动记录是否待写入 Flash
+        bool tuning_pending;                // 控制参数是否待写入 Flash
+        MotorService::MoveStats move_stats; // 待写入的运动记录
+
+        HACachedButton btn_open;
+        HACachedButton btn_close;
+        HACachedButton btn_stop;
+        HACachedSensor sensor_motor;
+        HACachedNumber num_calibrate;       // 将当前位置标定为指定开度
+    };
+
+    /** 控制参数 HA 数值实体, index 为参数在 MotorService::TUNING_PARAMS 中的序号 */
+    struct TuningNumber
+    {
+        TuningNumber(uint8_t index);
+
+        uint8_t index;
+        HACachedNumber number;
+    };
+
     static void on_cover_command_(HAButton *sender);
     static void on_ir_key_(IRKey key);
-    static void on_motor_stop_(long cur_pos);
+    static void on_motor_stop_(uint8_t channel, long cur_pos);
+    static void on_mqtt_message_(const char *topic, const uint8_t *payload, uint16_t length);
+    static void on_tuning_command_(HANumeric number, HANumber *sender);
+    static void on_calibrate_command_(HANumeric number, HANumber *sender);
 
-    void load_motor_conf_();
-    void save_motor_conf_();
+    static void start_group_move_();
+    static void persist_covers_();
 
-    static Application *m_instance;
+    static void handle_api_state_();
+    static void handle_api_goto_();
+    static void handle_api_jog_();
+    static void handle_api_stop_();
+    static void handle_api_tuning_();
+    static void handle_api_calibrate_();
+    static int api_channel_();
+    static void send_api_state_(int channel);
+    static void send_api_tuning_(int channel);
+    static void send_api_calibration_(int channel);
+    static void send_api_error_(const char *msg);
 
-    long m_cover_full_close_pos; // 窗帘完全关闭时的电机标定位置
-    long m_cover_full_open_pos;  // 窗帘完全打开时的电机标定位置
-    long m_cover_current_pos;    // 当前电机停止位置
-    bool m_motor_reversed;       // 电机是否反向
+    void update_mqtt_link_();
+    /** 是否有电机正在运行或有待执行的同步移动 */
+    bool is_motion_active_() const;
+    void plan_group_move_(const char *payload, uint16_t length);
+    void schedule_mqtt_retry_();
+    void publish_states_();
+
+    void load_motor_conf_(Cover &cover);
+    void save_motor_conf_(const Cover &cover);
+    void load_tuning_(int channel);
+    void save_tuning_(int channel);
+    bool update_tuning_(int channel, const MotorService::Tuning &tuning);
+    bool calibrate_percent_(Cover &cover, int percent, const char *source);
+    void clear_calibration_points_(Cover &cover, const char *source);
+    void request_persist_();
 
     WiFiClient m_wifi_client;
     HADevice m_device;
     HAMqtt m_mqtt;
-    HAButton m_btn_open;
-    HAButton m_btn_close;
-    HAButton m_btn_stop;
-    HASensor m_sensor_motor;
+    Cover m_covers[MOTOR_CHANNELS]; // 各通道窗帘, 实体须在 m_mqtt 之后构造
+    HACachedSensor m_sensor_group_skew;
+    TuningNumber m_tuning_numbers[MotorService::TUNING_PARAM_COUNT]; // 通道 0 的控制参数
+    bool m_tuning_publish_pending; // 控制参数是否待上报
+#if defined(ENABLE_LOOP_PROFILER) && defined(ENABLE_PROFILER_MQTT)
+    HASensor m_sensor_loop_max;               // 主循环任务最大耗时诊断传感器
+    unsigned long m_profiler_last_report_ms;  // 最近一次上报诊断数据的时间戳
+#endif
+
+    MqttLinkState m_mqtt_state;        // MQTT 连接状态
+    TcpProbe m_mqtt_probe;             // MQTT 服务器连通性探测
+    unsigned long m_mqtt_backoff_ms;   // 当前重连退避时间
+    unsigned long m_mqtt_retry_ms;     // 下次重连时间戳
+    unsigned long m_mqtt_state_ms;     // 进入当前连接状态的时间戳
+    uint32_t m_mqtt_connects;          // MQTT 连接成功次数
+    unsigned long m_mqtt_loop_us;      // 本轮 m_mqtt.loop() 开始时刻, 作为 MQTT 命令接收时刻
+    bool m_ha_offline_seen;            // 本次连接中是否收到过 HA 下线消息
+
+    char m_group_topic[64];          // 同步移动命令主题
+    int m_group_move_task;           // 待执行的同步移动任务编号
+    int64_t m_group_move_start_ms;   // 同步移动约定的 UTC 起始时间(ms)
+    long m_group_skew_ms;            // 同步移动启动偏差(ms)
+    bool m_group_skew_pending;       // 启动偏差是否待上报
+    int m_persist_task;              // 待执行的 Flash 写入任务编号
 
+    uint8_t m_ir_channel;   // 红外遥控器当前控制的电机通道
     IRKey m_last_ir_key;    // 最后一次红外遥控器按键
     long m_last_ir_key_pos; // 最后一次红外遥控器按键时的电机位置
 };
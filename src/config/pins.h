@@ -3,12 +3,27 @@
 #define BATTERY_PIN A0 // 电池电压检测引脚
 
 #define IR_RECEIVE_PIN D5 // 红外接收头数据引脚
-#define IR_RECEIVE_PWR D1 // 红外接收头电源引脚
 
-#define DRV_EEP_PIN D2 // 电机驱动模块使能引脚，高电平启用驱动模块, 低电平驱动模块休眠
+#define DRV_EEP_PIN D2 // 电机驱动模块使能引脚，高电平启用驱动模块, 低电平驱动模块休眠 (两路 H 桥共用)
 #define DRV_IN1_PIN D3 // 电机驱动模块输入1引脚
 #define DRV_IN2_PIN D4 // 电机驱动模块输入2引脚
 
 #define ENCODER_A_PIN D6 // 电机霍尔编码器A相引脚
 #define ENCODER_B_PIN D7 // 电机霍尔编码器B相引脚
-#define ENCODER_PWR D8   // 电机霍尔编码器电源引脚
+#define ENCODER_PWR D8   // 电机霍尔编码器电源引脚 (两路编码器共用)
+
+#ifdef DUAL_CHANNEL
+// 双通道: 第二路 H 桥及编码器占用 D0、D1、RX、SD3,
+// 红外接收头改由 3V3 供电, 串口只保留 TX 输出, SD3 要求 Flash 工作在 DIO 模式
+#define MOTOR_CHANNELS 2
+
+#define DRV_IN3_PIN D0 // 电机驱动模块输入3引脚 (GPIO16, 无中断, 只用作输出)
+#define DRV_IN4_PIN D1 // 电机驱动模块输入4引脚
+
+#define ENCODER2_A_PIN 3  // 第二路电机霍尔编码器A相引脚 (RX)
+#define ENCODER2_B_PIN 10 // 第二路电机霍尔编码器B相引脚 (SD3)
+#else
+#define MOTOR_CHANNELS 1
+
+#define IR_RECEIVE_PWR D1 // 红外接收头电源引脚
+#endif
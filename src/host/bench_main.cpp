@@ -0,0 +1,235 @@
+// 主机基准测试: 以 lib/replay 中的适配层在 Linux 上编译原始 MotorService/Application 及红外服务,
+// 测量控制热点路径的单次耗时: 误差判定 is_close_enough()、PID 单步计算、格式化日志、红外按键经 IRService::update()
+// 到 Application 任意按键处理函数的完整路径, 以及电机控制周期 MotorService::update()。
+// 电机输出由适配层替换, 虚拟时钟只在测试代码中推进, 结果可在不同提交之间对比趋势, 绝对值不代表设备耗时。
+//
+// 用法: program [--rounds <N>] [--only <名称>]
+
+#include "service/config.h"
+#include "service/logger.h"
+#include "service/wireless.h"
+#include "service/motor.h"
+#include "service/ir.h"
+#include "service/capture.h"
+#include "service/history.h"
+#include "service/trace.h"
+#include "utility/misc.h"
+#include "application.h"
+
+#include <PID_v1.h>
+#include <TinyIR.h>
+#include <replay_host.h>
+
+#include <chrono>
+
+#include <stdlib.h>
+
+static constexpr int DEF_ROUNDS = 7;                 // 默认测试轮数
+static constexpr int MAX_ROUNDS = 15;                // 最大测试轮数
+static constexpr int32_t BENCH_CLOSE_POS = 10000;    // 测试用窗帘完全关闭位置
+static constexpr uint64_t IR_FRAME_GAP_US = 150000;  // 红外帧间隔, 大于按键去抖时间
+static constexpr uint64_t CONTROL_TICK_US = 1000;    // 电机控制任务周期, 与 MotorService 一致
+static constexpr long MOVE_PULSES_PER_TICK = 5;      // 电机控制测试中每个周期的编码器增量
+
+using bench_clock = std::chrono::steady_clock;
+
+/** 基准测试函数, 执行 iterations 次被测操作, 返回被测部分消耗的时间(ns) */
+using bench_fn_t = uint64_t (*)(uint32_t iterations);
+
+/** 基准测试项 */
+struct Bench
+{
+    const char *name;
+    uint32_t iterations; // 每轮执行次数
+    bench_fn_t fn;
+};
+
+// 保存测试结果, 避免编译器优化掉被测计算
+static volatile uint32_t bench_sink = 0;
+
+static uint64_t elapsed_ns(bench_clock::time_point start)
+{
+    return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(bench_clock::now() - start).count();
+}
+
+static uint64_t bench_is_close(uint32_t iterations)
+{
+    volatile float val = 1234.0f;
+    uint32_t hits = 0;
+    bench_clock::time_point start = bench_clock::now();
+    for (uint32_t i = 0; i < iterations; i++)
+    {
+        hits += is_close_enough(val, (float)(i * 8));
+    }
+    uint64_t ns = elapsed_ns(start);
+    bench_sink = hits;
+    return ns;
+}
+
+static uint64_t bench_pid_compute(uint32_t iterations)
+{
+    // PID 控制器只在距上次计算超过采样时间时才计算, 每次新建控制器保证 Compute() 执行完整的一步
+    double input = 0, output = 0, setpoint = 1000;
+    uint64_t ns = 0;
+    for (uint32_t i = 0; i < iterations; i++)
+    {
+        PID pid(&input, &output, &setpoint, MotorService::PID_DEF_KP, MotorService::PID_DEF_KI,
+                MotorService::PID_DEF_KD, DIRECT);
+        pid.SetOutputLimits(-MotorService::PWM_RANGE, MotorService::PWM_RANGE);
+        pid.SetMode(AUTOMATIC);
+        input = (double)(i % 100);
+
+        bench_clock::time_point start = bench_clock::now();
+        pid.Compute();
+        ns += elapsed_ns(start);
+    }
+    bench_sink = (uint32_t)output;
+    return ns;
+}
+
+static uint64_t bench_logger_printf(uint32_t iterations)
+{
+    // 与控制周期中 Teleplot 输出相同的格式, 串口输出已关闭, 只包括格式化及日志缓冲的耗时
+    bench_clock::time_point start = bench_clock::now();
+    for (uint32_t i = 0; i < iterations; i++)
+    {
+        LoggerService::printf_P(PSTR(">bench: %lu %.3f\n"), (unsigned long)i, i * 0.5f);
+    }
+    return elapsed_ns(start);
+}
+
+static uint64_t bench_ir_anykey(uint32_t iterations)
+{
+    // 交替送入关闭及停止按键, 经 _poll() 的去抖、延迟跟踪及按键分发由 Application 处理,
+    // 包括电机开始运行及停止的控制调用; 每帧之前推进虚拟时钟越过去抖时间, 推进时钟不计入耗时
+    IRService *ir_service = IRService::get_instance();
+    uint64_t ns = 0;
+    for (uint32_t i = 0; i < iterations; i++)
+    {
+        ReplayHost::set_now_us(ReplayHost::now_us() + IR_FRAME_GAP_US);
+        TinyIRReceiverData.Address = 0;
+        TinyIRReceiverData.Command = (i % 2 == 0) ? KEY_DOWN : KEY_OK;
+        TinyIRReceiverData.Flags = IRDATA_FLAGS_EMPTY;
+        TinyIRReceiverData.justWritten = true;
+
+        bench_clock::time_point start = bench_clock::now();
+        ir_service->update();
+        ns += elapsed_ns(start);
+    }
+    MotorService::get_instance(0)->stop();
+    return ns;
+}
+
+static uint64_t bench_motor_update(uint32_t iterations)
+{
+    // 运行至远处的目标, 每个控制周期编码器前进固定脉冲数, 测量位置、速度、PID 及输出的完整一步
+    MotorService *ms = MotorService::get_instance(0);
+    ms->goto_pos(1e8f);
+    uint64_t ns = 0;
+    for (uint32_t i = 0; i < iterations; i++)
+    {
+        ReplayHost::set_now_us(ReplayHost::now_us() + CONTROL_TICK_US);
+        ms->set_motor_pos(ms->get_motor_pos() + MOVE_PULSES_PER_TICK);
+
+        bench_clock::time_point start = bench_clock::now();
+        ms->update();
+        ns += elapsed_ns(start);
+    }
+    ms->stop();
+    return ns;
+}
+
+static const Bench BENCHES[] = {
+    {"is_close_enough", 100000, &bench_is_close},
+    {"pid_compute", 20000, &bench_pid_compute},
+    {"logger_printf", 20000, &bench_logger_printf},
+    {"ir_anykey", 2000, &bench_ir_anykey},
+    {"motor_update", 20000, &bench_motor_update},
+};
+
+/** 与设备启动顺序相同地初始化电机及应用逻辑, 设备文件系统映射到临时目录 */
+static bool setup_firmware()
+{
+    char fs_root[] = "/tmp/bench_fs.XXXXXX";
+    if (mkdtemp(fs_root) == nullptr)
+    {
+        perror("mkdtemp");
+        return false;
+    }
+    ReplayHost::set_fs_root(fs_root);
+    ReplayHost::set_serial_output(false);
+
+    Serial.begin(115200);
+    ConfigService *config = ConfigService::get_instance();
+    config->begin();
+    config->motor(0).full_close_pos = BENCH_CLOSE_POS;
+
+    LoggerService::get_instance()->begin();
+    WirelessService::get_instance()->begin();
+    for (int ch = 0; ch < MOTOR_CHANNELS; ch++)
+    {
+        MotorService::get_instance(ch)->begin();
+    }
+    IRService::get_instance()->begin();
+    Application::get_instance()->begin();
+    CaptureService::get_instance()->begin();
+    HistoryService::get_instance()->begin();
+    TraceService::get_instance()->begin();
+    return true;
+}
+
+int main(int argc, char **argv)
+{
+    int rounds = DEF_ROUNDS;
+    const char *only = nullptr;
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--rounds") == 0 && i + 1 < argc)
+        {
+            rounds = constrain(strtol(argv[++i], nullptr, 10), 1L, (long)MAX_ROUNDS);
+        }
+        else if (strcmp(argv[i], "--only") == 0 && i + 1 < argc)
+        {
+            only = argv[++i];
+        }
+        else
+        {
+            fprintf(stderr, "Usage: %s [--rounds <N, default %d>] [--only <name>]\n", argv[0], DEF_ROUNDS);
+            return 2;
+        }
+    }
+
+    if (!setup_firmware())
+    {
+        return 2;
+    }
+
+    printf("{\"rounds\":%d,\"results\":[", rounds);
+    bool first = true;
+    for (const Bench &bench : BENCHES)
+    {
+        if (only != nullptr && strcmp(only, bench.name) != 0)
+        {
+            continue;
+        }
+
+        // 各轮单次耗时插入排序, 取中位数以排除调度及缓存的影响
+        double ns[MAX_ROUNDS];
+        for (int r = 0; r < rounds; r++)
+        {
+            double value = (double)bench.fn(bench.iterations) / bench.iterations;
+            int j = r;
+            for (; j > 0 && ns[j - 1] > value; j--)
+            {
+                ns[j] = ns[j - 1];
+            }
+            ns[j] = value;
+        }
+
+        printf("%s{\"name\":\"%s\",\"iterations\":%lu,\"ns_per_op\":{\"median\":%.1f,\"min\":%.1f,\"max\":%.1f}}",
+               first ? "" : ",", bench.name, (unsigned long)bench.iterations, ns[rounds / 2], ns[0], ns[rounds - 1]);
+        first = false;
+    }
+    printf("]}\n");
+    return 0;
+}
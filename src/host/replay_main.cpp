@@ -0,0 +1,655 @@
+// 主机重放驱动: 读取设备记录 (/record 下载的 rec.bin), 把其中的外部输入按记录时刻送入在 Linux 上编译的
+// 原始 MotorService/Application, 由固件自身的 RecorderService 把重放中的输入及输出写到输出目录,
+// 最后比较两份记录的 PWM 输出及停止事件。虚拟时钟只在调度器空闲时推进, 重放远快于实际时间且结果确定,
+// 输出不一致时返回 1, 可直接用于 git bisect run。
+//
+// 用法: program <rec.bin> [-o <输出目录>] [-q]
+
+#include "service/config.h"
+#include "service/logger.h"
+#include "service/wireless.h"
+#include "service/motor.h"
+#include "service/ir.h"
+#include "service/ntp.h"
+#include "service/scheduler.h"
+#include "service/capture.h"
+#include "service/history.h"
+#include "service/trace.h"
+#include "service/recorder.h"
+#include "application.h"
+
+#include <ArduinoHA.h>
+#include <TinyIR.h>
+#include <replay_host.h>
+
+#include <chrono>
+#include <vector>
+
+#include <dirent.h>
+#include <sys/stat.h>
+
+static constexpr const char *DEF_OUT_DIR = "replay_out";
+static constexpr const char *OUT_DIR_MARKER = ".replay"; // 只清理带有该标记的输出目录
+static constexpr uint64_t CONTROL_TICK_US = 1000;       // 电机控制任务周期, 与 MotorService 一致
+static constexpr int GRID_SAMPLES = 64;                 // 推算控制任务相位所用的编码器记录数
+static constexpr uint64_t TAIL_US = 1000;               // 最后一条记录之后继续运行的时间
+
+/** 一条解码后的记录, t_us 为设备上的绝对时刻 (64 位, 不回绕) */
+struct Event
+{
+    uint8_t type;
+    uint64_t t_us;
+    uint8_t channel;
+    long value; // 编码器绝对读数、PWM 值或停止位置
+    uint8_t reason;
+    uint16_t address;
+    uint8_t command;
+    uint8_t flags; // 红外标志或 HTTP 方法
+    int64_t epoch_ms;
+    uint32_t count;
+    std::string topic; // MQTT 主题或 HTTP 请求
+    std::string payload;
+    std::vector<long> sync_pos;
+};
+
+/** 启动记录中的设备状态 */
+struct BootInfo
+{
+    uint32_t boot_ms;
+    uint8_t reset_reason;
+    ConfigService::MotorConf motor[MOTOR_CHANNELS];
+    ConfigService::TuningConf tuning[MOTOR_CHANNELS];
+    ConfigService::CalibrationConf calibration[MOTOR_CHANNELS];
+    std::string group;
+};
+
+struct Recording
+{
+    bool has_boot;
+    BootInfo boot;
+    std::vector<Event> events;
+    uint64_t origin_us; // 首个同步记录的时刻
+};
+
+/** 顺序读取记录内容, 越界时置 ok 为 false */
+class Reader
+{
+public:
+    Reader(const std::vector<uint8_t> &data, size_t pos) : m_data(data), m_pos(pos), m_ok(true) {}
+
+    bool eof() const { return m_pos >= m_data.size(); }
+    bool ok() const { return m_ok; }
+    void fail() { m_ok = false; }
+    size_t pos() const { return m_pos; }
+
+    bool bytes(void *dst, size_t n)
+    {
+        if (!m_ok || m_pos + n > m_data.size())
+        {
+            m_ok = false;
+            return false;
+        }
+        memcpy(dst, m_data.data() + m_pos, n);
+        m_pos += n;
+        return true;
+    }
+
+    uint8_t u8()
+    {
+        uint8_t value = 0;
+        this->bytes(&value, 1);
+        return value;
+    }
+
+    uint32_t varint()
+    {
+        uint32_t value = 0;
+        for (int shift = 0; shift < 35 && m_ok; shift += 7)
+        {
+            uint8_t b = this->u8();
+            value |= (uint32_t)(b & 0x7F) << shift;
+            if (!(b & 0x80))
+            {
+                return value;
+            }
+        }
+        m_ok = false;
+        return 0;
+    }
+
+    int32_t svarint()
+    {
+        uint32_t value = this->varint();
+        return (int32_t)((value >> 1) ^ (0 - (value & 1)));
+    }
+
+    std::string text()
+    {
+        uint32_t len = this->varint();
+        if (!m_ok || m_pos + len > m_data.size())
+        {
+            m_ok = false;
+            return std::string();
+        }
+        std::string value((const char *)m_data.data() + m_pos, len);
+        m_pos += len;
+        return value;
+    }
+
+private:
+    const std::vector<uint8_t> &m_data;
+    size_t m_pos;
+    bool m_ok;
+};
+
+static bool read_file(const std::string &path, std::vector<uint8_t> &data)
+{
+    FILE *fp = fopen(path.c_str(), "rb");
+    if (fp == nullptr)
+    {
+        return false;
+    }
+    uint8_t chunk[4096];
+    size_t n;
+    while ((n = fread(chunk, 1, sizeof(chunk), fp)) > 0)
+    {
+        data.insert(data.end(), chunk, chunk + n);
+    }
+    fclose(fp);
+    return true;
+}
+
+/** 解码记录文件并追加到 rec, 每个文件以启动记录开头, rec 中已有之前的记录时只保留首个启动记录 */
+static bool load_recording(const std::string &path, Recording &rec)
+{
+    std::vector<uint8_t> data;
+    if (!read_file(path, data))
+    {
+        fprintf(stderr, "%s: cannot open file\n", path.c_str());
+        return false;
+    }
+    RecorderService::FileHeader header;
+    if (data.size() < sizeof(header) || (memcpy(&header, data.data(), sizeof(header)), header.magic != RecorderService::RECORD_MAGIC))
+    {
+        fprintf(stderr, "%s: not a recording\n", path.c_str());
+        return false;
+    }
+    if (header.version != RecorderService::RECORD_VERSION)
+    {
+        fprintf(stderr, "%s: recording version %u, this firmware writes version %u\n", path.c_str(), header.version,
+                RecorderService::RECORD_VERSION);
+        return false;
+    }
+    if (header.channels != MOTOR_CHANNELS)
+    {
+        fprintf(stderr, "%s: recorded with %u motor channels, this build has %d (use the replay%s environment)\n",
+                path.c_str(), header.channels, MOTOR_CHANNELS, header.channels > 1 ? "_dual" : "");
+        return false;
+    }
+
+    Reader r(data, sizeof(header));
+    bool have_time = !rec.events.empty();
+    uint64_t t_us = have_time ? rec.events.back().t_us : 0;
+    uint32_t pending_dt = 0; // 启动记录的时刻由之后的同步记录确定
+    long pos[MOTOR_CHANNELS] = {};
+    while (!r.eof())
+    {
+        size_t start = r.pos();
+        Event ev = {};
+        ev.type = r.u8();
+        uint32_t dt = r.varint();
+        switch (ev.type)
+        {
+        case RecorderService::TYPE_BOOT:
+        {
+            BootInfo boot;
+            r.bytes(&boot.boot_ms, sizeof(boot.boot_ms));
+            boot.reset_reason = r.u8();
+            if (r.u8() != MOTOR_CHANNELS)
+            {
+                fprintf(stderr, "%s: boot record channel count mismatch\n", path.c_str());
+                return false;
+            }
+            // 配置结构在设备及主机上的布局相同 (小端, 4 字节对齐)
+            for (int ch = 0; ch < MOTOR_CHANNELS; ch++)
+            {
+                r.bytes(&boot.motor[ch], sizeof(boot.motor[ch]));
+                r.bytes(&boot.tuning[ch], sizeof(boot.tuning[ch]));
+                r.bytes(&boot.calibration[ch], sizeof(boot.calibration[ch]));
+            }
+            boot.group = r.text();
+            if (!rec.has_boot)
+            {
+                rec.boot = boot;
+                rec.has_boot = true;
+                pending_dt = dt;
+            }
+            break;
+        }
+        case RecorderService::TYPE_SYNC:
+        {
+            uint32_t sync_us;
+            r.bytes(&sync_us, sizeof(sync_us));
+            r.bytes(&ev.epoch_ms, sizeof(ev.epoch_ms));
+            for (int ch = 0; ch < MOTOR_CHANNELS; ch++)
+            {
+                pos[ch] = r.svarint();
+                ev.sync_pos.push_back(pos[ch]);
+            }
+            // 设备 micros() 为 32 位, 以启动时刻或上一条记录展开为 64 位
+            uint64_t ref_us = have_time ? t_us : (uint64_t)rec.boot.boot_ms * 1000;
+            if (!have_time && !rec.has_boot)
+            {
+                fprintf(stderr, "%s: recording does not start with a boot record\n", path.c_str());
+                return false;
+            }
+            t_us = ref_us + (int64_t)(int32_t)(sync_us - (uint32_t)ref_us);
+            if (!have_time)
+            {
+                rec.origin_us = t_us;
+                if (!rec.events.empty())
+                {
+                    rec.events.back().t_us = t_us - pending_dt;
+                }
+            }
+            have_time = true;
+            break;
+        }
+        case RecorderService::TYPE_ENCODER:
+            ev.channel = r.u8();
+            if (ev.channel >= MOTOR_CHANNELS)
+            {
+                r.fail();
+                break;
+            }
+            pos[ev.channel] += r.svarint();
+            ev.value = pos[ev.channel];
+            break;
+        case RecorderService::TYPE_IR:
+            r.bytes(&ev.address, sizeof(ev.address));
+            ev.command = r.u8();
+            ev.flags = r.u8();
+            break;
+        case RecorderService::TYPE_MQTT:
+            ev.topic = r.text();
+            ev.payload = r.text();
+            break;
+        case RecorderService::TYPE_HTTP:
+            ev.flags = r.u8();
+            ev.topic = r.text();
+            break;
+        case RecorderService::TYPE_PWM:
+            ev.channel = r.u8();
+            ev.value = r.svarint();
+            break;
+        case RecorderService::TYPE_STOP:
+            ev.channel = r.u8();
+            ev.value = r.svarint();
+            ev.reason = r.u8();
+            break;
+        case RecorderService::TYPE_DROPPED:
+            ev.count = r.varint();
+            break;
+        case RecorderService::TYPE_CLOCK:
+            r.bytes(&ev.epoch_ms, sizeof(ev.epoch_ms));
+            break;
+        default:
+            fprintf(stderr, "%s: unknown record type %u at offset %zu, stopping\n", path.c_str(), ev.type, start);
+            return !rec.events.empty();
+        }
+        if (!r.ok())
+        {
+            // 设备仍在写入或断电时最后一条记录可能不完整
+            fprintf(stderr, "%s: truncated record at offset %zu, ignored\n", path.c_str(), start);
+            break;
+        }
+        if (ev.type != RecorderService::TYPE_BOOT && !have_time)
+        {
+            fprintf(stderr, "%s: record before the first sync record\n", path.c_str());
+            return false;
+        }
+        if (ev.type != RecorderService::TYPE_BOOT && ev.type != RecorderService::TYPE_SYNC)
+        {
+            t_us += dt;
+        }
+        ev.t_us = t_us;
+        rec.events.push_back(ev);
+    }
+    return rec.has_boot && have_time;
+}
+
+/** 运行固件调度器直到虚拟时刻 t_us */
+static void run_until(uint64_t t_us)
+{
+    ReplayHost::set_limit_us(t_us);
+    while (ReplayHost::now_us() < t_us)
+    {
+        SchedulerService::get_instance()->run();
+    }
+}
+
+/** 由编码器记录的时刻推算设备控制任务的相位: 取各时刻除以周期的余数, 循环意义上最早的一个 */
+static uint64_t control_phase(const Recording &rec, uint64_t default_phase)
+{
+    std::vector<uint64_t> phases;
+    for (const Event &ev : rec.events)
+    {
+        if (ev.type == RecorderService::TYPE_ENCODER)
+        {
+            phases.push_back(ev.t_us % CONTROL_TICK_US);
+            if (phases.size() >= (size_t)GRID_SAMPLES)
+            {
+                break;
+            }
+        }
+    }
+    if (phases.empty())
+    {
+        return default_phase;
+    }
+
+    // 最大间隔之后的余数即为最早的记录相位
+    std::sort(phases.begin(), phases.end());
+    uint64_t phase = phases[0];
+    uint64_t max_gap = phases[0] + CONTROL_TICK_US - phases.back();
+    for (size_t i = 1; i < phases.size(); i++)
+    {
+        if (phases[i] - phases[i - 1] > max_gap)
+        {
+            max_gap = phases[i] - phases[i - 1];
+            phase = phases[i];
+        }
+    }
+    return phase;
+}
+
+/** 按 main.cpp 的顺序初始化固件服务, 不启动网络相关服务 */
+static void setup_firmware(const Recording &rec, uint64_t setup_us, uint64_t start_us)
+{
+    const BootInfo &boot = rec.boot;
+    ReplayHost::set_now_us(setup_us);
+    ReplayHost::set_limit_us(setup_us);
+    ReplayHost::set_reset_reason(boot.reset_reason);
+
+    Serial.begin(115200);
+    ConfigService *config = ConfigService::get_instance();
+    config->begin();
+    for (int ch = 0; ch < MOTOR_CHANNELS; ch++)
+    {
+        config->motor(ch) = boot.motor[ch];
+        config->tuning(ch) = boot.tuning[ch];
+        config->calibration(ch) = boot.calibration[ch];
+    }
+    snprintf(config->mqtt_group(), sizeof(ConfigService::ConfigData::mqtt_group), "%s", boot.group.c_str());
+
+    LoggerService::get_instance()->begin();
+    WirelessService::get_instance()->begin();
+    for (int ch = 0; ch < MOTOR_CHANNELS; ch++)
+    {
+        MotorService::get_instance(ch)->begin();
+    }
+    IRService::get_instance()->begin();
+    Application::get_instance()->begin();
+    CaptureService::get_instance()->begin();
+    HistoryService::get_instance()->begin();
+    TraceService::get_instance()->begin();
+
+    // 设备在初始化完成后才开始记录, 之后第一轮调度时控制任务才开始运行
+    ReplayHost::set_now_us(start_us);
+    RecorderService::get_instance()->begin();
+}
+
+/** 把一条记录中的输入送入固件 */
+static void feed_event(const Event &ev, bool first_sync)
+{
+    ESP8266WebServer *server = LoggerService::get_instance()->web_server();
+    switch (ev.type)
+    {
+    case RecorderService::TYPE_ENCODER:
+        // 设备在控制周期开始时读取编码器, 提前半个周期写入, 由重放中对应的控制周期读取
+        run_until(ev.t_us - CONTROL_TICK_US / 2);
+        MotorService::get_instance(ev.channel)->set_motor_pos(ev.value);
+        break;
+    case RecorderService::TYPE_IR:
+        run_until(ev.t_us);
+        TinyIRReceiverData.Address = ev.address;
+        TinyIRReceiverData.Command = ev.command;
+        TinyIRReceiverData.Flags = ev.flags;
+        TinyIRReceiverData.justWritten = true;
+        IRService::get_instance()->update();
+        break;
+    case RecorderService::TYPE_MQTT:
+        run_until(ev.t_us);
+        HAMqtt::instance()->processMessage(ev.topic.c_str(), (const uint8_t *)ev.payload.data(), ev.payload.size());
+        break;
+    case RecorderService::TYPE_HTTP:
+        run_until(ev.t_us);
+        server->replayRequest((HTTPMethod)ev.flags, ev.topic.c_str());
+        break;
+    case RecorderService::TYPE_CLOCK:
+        run_until(ev.t_us);
+        ReplayHost::set_epoch(ev.epoch_ms);
+        NTPService::get_instance()->update(true);
+        break;
+    case RecorderService::TYPE_SYNC:
+        // 从轮换或清空后的文件开始重放时, 以首个同步记录恢复各通道编码器读数;
+        // 同步记录可能带有已同步的时间
+        run_until(ev.t_us);
+        for (int ch = 0; first_sync && ch < MOTOR_CHANNELS; ch++)
+        {
+            // 重新设置齿隙以更新齿隙跟踪的起点, 读数变化不计入齿隙状态
+            MotorService *ms = MotorService::get_instance(ch);
+            ms->set_motor_pos(ev.sync_pos[ch]);
+            ms->set_backlash(ms->get_backlash(), ms->get_backlash_slack());
+        }
+        if (ev.epoch_ms != 0 && !NTPService::get_instance()->is_synced())
+        {
+            ReplayHost::set_epoch(ev.epoch_ms);
+            NTPService::get_instance()->update(true);
+        }
+        break;
+    case RecorderService::TYPE_DROPPED:
+        fprintf(stderr, "Warning: %u records were dropped on the device at %.3f ms, replay may diverge\n",
+                ev.count, ev.t_us / 1000.0);
+        break;
+    default:
+        // 输出记录: 只推进时间, 由重放产生的输出与之比较
+        run_until(ev.t_us);
+        break;
+    }
+}
+
+static bool is_output(const Event &ev)
+{
+    return ev.type == RecorderService::TYPE_PWM || ev.type == RecorderService::TYPE_STOP;
+}
+
+static void print_output(const char *label, const Recording &rec, const Event &ev)
+{
+    double t_ms = ((int64_t)ev.t_us - (int64_t)rec.origin_us) / 1000.0;
+    if (ev.type == RecorderService::TYPE_PWM)
+    {
+        printf("  %s: %12.3f ms  pwm  channel=%u pwm=%ld\n", label, t_ms, ev.channel, ev.value);
+    }
+    else
+    {
+        printf("  %s: %12.3f ms  stop channel=%u pos=%ld reason=%u\n", label, t_ms, ev.channel, ev.value, ev.reason);
+    }
+}
+
+/** 比较两份记录的电机输出序列, 时刻以各自的首个同步记录为原点, 返回是否一致 */
+static bool compare_outputs(const Recording &device, const Recording &replay)
+{
+    std::vector<const Event *> a, b;
+    for (const Event &ev : device.events)
+    {
+        if (is_output(ev))
+        {
+            a.push_back(&ev);
+        }
+    }
+    for (const Event &ev : replay.events)
+    {
+        if (is_output(ev))
+        {
+            b.push_back(&ev);
+        }
+    }
+
+    int64_t max_skew_us = 0;
+    int stops = 0;
+    for (size_t i = 0; i < a.size() && i < b.size(); i++)
+    {
+        const Event &ea = *a[i];
+        const Event &eb = *b[i];
+        if (ea.type != eb.type || ea.channel != eb.channel || ea.value != eb.value || ea.reason != eb.reason)
+        {
+            printf("First divergence at output #%zu:\n", i);
+            print_output("device", device, ea);
+            print_output("replay", replay, eb);
+            return false;
+        }
+        int64_t skew_us = ((int64_t)ea.t_us - (int64_t)device.origin_us) - ((int64_t)eb.t_us - (int64_t)replay.origin_us);
+        max_skew_us = max(max_skew_us, skew_us < 0 ? -skew_us : skew_us);
+        stops += ea.type == RecorderService::TYPE_STOP ? 1 : 0;
+    }
+    if (a.size() != b.size())
+    {
+        printf("Output count differs: device has %zu, replay has %zu\n", a.size(), b.size());
+        return false;
+    }
+    printf("Outputs match: %zu PWM changes, %d stops, max timing difference %.3f ms\n", a.size() - stops, stops,
+           max_skew_us / 1000.0);
+    return true;
+}
+
+/** 准备输出目录: 不存在时创建, 已存在时须带有标记文件, 清除其中上次重放的文件 */
+static bool prepare_out_dir(const std::string &dir)
+{
+    std::string marker = dir + "/" + OUT_DIR_MARKER;
+    struct stat st;
+    if (stat(dir.c_str(), &st) != 0)
+    {
+        if (mkdir(dir.c_str(), 0755) != 0)
+        {
+            fprintf(stderr, "%s: cannot create directory\n", dir.c_str());
+            return false;
+        }
+    }
+    else if (!S_ISDIR(st.st_mode) || stat(marker.c_str(), &st) != 0)
+    {
+        fprintf(stderr, "%s: exists and is not a replay output directory\n", dir.c_str());
+        return false;
+    }
+    else
+    {
+        DIR *d = opendir(dir.c_str());
+        struct dirent *entry;
+        while (d != nullptr && (entry = readdir(d)) != nullptr)
+        {
+            std::string path = dir + "/" + entry->d_name;
+            if (strcmp(entry->d_name, OUT_DIR_MARKER) != 0 && stat(path.c_str(), &st) == 0 && S_ISREG(st.st_mode))
+            {
+                remove(path.c_str());
+            }
+        }
+        if (d != nullptr)
+        {
+            closedir(d);
+        }
+    }
+
+    FILE *fp = fopen(marker.c_str(), "w");
+    if (fp == nullptr)
+    {
+        fprintf(stderr, "%s: cannot write to directory\n", dir.c_str());
+        return false;
+    }
+    fclose(fp);
+    ReplayHost::set_fs_root(dir);
+    return true;
+}
+
+int main(int argc, char **argv)
+{
+    const char *input = nullptr;
+    std::string out_dir = DEF_OUT_DIR;
+    bool quiet = false;
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "-o") == 0 && i + 1 < argc)
+        {
+            out_dir = argv[++i];
+        }
+        else if (strcmp(argv[i], "-q") == 0)
+        {
+            quiet = true;
+        }
+        else if (input == nullptr && argv[i][0] != '-')
+        {
+            input = argv[i];
+        }
+        else
+        {
+            input = nullptr;
+            break;
+        }
+    }
+    if (input == nullptr)
+    {
+        fprintf(stderr, "Usage: %s <rec.bin> [-o <output dir, default %s>] [-q]\n"
+                        "  -q  do not print the firmware log\n", argv[0], DEF_OUT_DIR);
+        return 2;
+    }
+
+    Recording device = {};
+    if (!load_recording(input, device) || !prepare_out_dir(out_dir))
+    {
+        return 2;
+    }
+
+    // 初始化时刻与设备控制任务同相位, 且不早于开始记录前一个周期, 控制任务的首次运行不会被判定为延误
+    uint64_t start_us = device.events[0].t_us;
+    uint64_t phase = control_phase(device, start_us % CONTROL_TICK_US);
+    uint64_t setup_us = start_us - (start_us + CONTROL_TICK_US - phase) % CONTROL_TICK_US;
+    ReplayHost::set_serial_output(!quiet);
+    setup_firmware(device, setup_us, start_us);
+
+    auto wall_start = std::chrono::steady_clock::now();
+    bool first_sync = true;
+    for (const Event &ev : device.events)
+    {
+        if (ev.type == RecorderService::TYPE_BOOT)
+        {
+            continue;
+        }
+        feed_event(ev, first_sync);
+        first_sync = first_sync && ev.type != RecorderService::TYPE_SYNC;
+    }
+    run_until(device.events.back().t_us + TAIL_US);
+    double wall_s = std::chrono::duration<double>(std::chrono::steady_clock::now() - wall_start).count();
+
+    // 与下载记录相同, 通过 HTTP 接口把缓冲区写入文件
+    LoggerService::get_instance()->web_server()->replayRequest(HTTP_GET, RecorderService::WEB_RECORD_PATH);
+    ReplayHost::set_serial_output(true);
+
+    double virtual_s = (device.events.back().t_us - start_us) / 1e6;
+    printf("Replayed %zu records, %.3f s of device time in %.3f s (%.0fx real time)\n", device.events.size(),
+           virtual_s, wall_s, wall_s > 0 ? virtual_s / wall_s : 0.0);
+
+    // 重放记录超过文件上限时已轮换, 依次读取旧文件及当前文件
+    Recording replay = {};
+    std::string old_path = out_dir + RecorderService::RECORD_OLD_FILE;
+    struct stat st;
+    if (stat(old_path.c_str(), &st) == 0 && !load_recording(old_path, replay))
+    {
+        return 2;
+    }
+    std::string rec_path = out_dir + RecorderService::RECORD_FILE;
+    if (!load_recording(rec_path, replay))
+    {
+        return 2;
+    }
+    printf("Replay recording written to %s\n", rec_path.c_str());
+    return compare_outputs(device, replay) ? 0 : 1;
+}
@@ -3,55 +3,127 @@
 #include "service/wireless.h"
 #include "service/ntp.h"
 #include "service/logger.h"
+#include "service/scheduler.h"
+#include "service/profiler.h"
+#include "service/config.h"
+#include "service/telemetry.h"
+#include "service/capture.h"
+#include "service/history.h"
+#include "service/heap.h"
+#include "service/metrics.h"
+#include "service/trace.h"
+#include "service/bench.h"
+#include "service/recorder.h"
+#include "utility/boot_timeline.h"
 #include "application.h"
 
 #include <Arduino.h>
 
-void setup()
-{
-  // 初始化串口
-  Serial.begin(115200);
-  LoggerService::println("Reset reason: " + ESP.getResetReason());
+static constexpr int NETWORK_BOOT_CHECK_INTERVAL_MS = 50; // 检查 WiFi 是否连接以启动网络服务的间隔(ms)
 
-  // 初始化 WiFi
-  WirelessService *wireless_service = WirelessService::get_instance();
-  wireless_service->begin();
+static int network_boot_task = -1;
+
+/** WiFi 首次连接后启动依赖网络的服务 */
+static void start_network_services()
+{
+  if (!WirelessService::get_instance()->is_connected())
+  {
+    return;
+  }
+  SchedulerService::get_instance()->cancel(network_boot_task);
+  BootTimeline::mark("wifi");
 
   // 初始化 NTP 服务
   NTPService *ntp_service = NTPService::get_instance();
   ntp_service->begin();
+  BootTimeline::mark("ntp");
+
+  BootTimeline::dump();
+}
 
-  // 初始化日志远程访问服务(必须在 WiFi 服务和 NTP 服务之后初始化)
+void setup()
+{
+  // 初始化串口
+#ifdef DUAL_CHANNEL
+  // RX 引脚用作第二路编码器输入, 串口只保留输出
+  Serial.begin(115200, SERIAL_8N1, SERIAL_TX_ONLY);
+#else
+  Serial.begin(115200);
+#endif
+  LoggerService::printf_P(PSTR("Reset reason: %s\n"), ESP.getResetReason().c_str());
+
+  // 挂载文件系统并一次性加载全部配置
+  ConfigService::get_instance()->begin();
+  BootTimeline::mark("config");
+
+  // 初始化日志远程访问服务, HTTP 服务在 WiFi 连接后自动可用
   LoggerService *logger_service = LoggerService::get_instance();
   logger_service->begin();
 
-  // 初始化电机编码器
-  MotorService *motor_service = MotorService::get_instance();
-  motor_service->begin();
+#ifdef ENABLE_LOOP_PROFILER
+  // 启动主循环性能分析服务(须在日志服务之后初始化)
+  ProfilerService::get_instance()->begin();
+#endif
+
+  // 加载网络配置并在后台开始连接 WiFi
+  // (按 RESET 按钮重启时会先阻塞检查配置清除按钮, 该按钮与电机驱动共用引脚)
+  WirelessService *wireless_service = WirelessService::get_instance();
+  wireless_service->begin();
+  BootTimeline::mark("wifi_init");
+
+  // 初始化各通道电机编码器, 所有通道共用一个控制任务
+  for (int ch = 0; ch < MOTOR_CHANNELS; ch++)
+  {
+    MotorService::get_instance(ch)->begin();
+  }
+  BootTimeline::mark("motor");
 
   // 初始化红外接收模块并启动红外遥控数据接收服务
   IRService *ir_service = IRService::get_instance();
   ir_service->begin();
+  BootTimeline::mark("ir");
 
-  // 初始化应用程序
+  // 初始化应用程序, 恢复电机位置, MQTT 连接在 WiFi 就绪后自动建立
   Application *app = Application::get_instance();
   app->begin();
+  BootTimeline::mark("app");
+
+  // 注册运动轨迹捕获下载接口
+  CaptureService::get_instance()->begin();
+
+  // 打开运动历史统计文件并注册查询接口
+  HistoryService::get_instance()->begin();
+
+  // 启动 WebSocket 实时遥测服务, 有客户端连接时才开始采样
+  TelemetryService::get_instance()->begin();
+
+  // 启动堆内存监测, 启动完成后各服务不应再分配堆内存
+  HeapService::get_instance()->begin();
+
+  // 注册 Prometheus 指标接口
+  MetricsService::get_instance()->begin();
+
+  // 注册命令延迟跟踪查询接口
+  TraceService::get_instance()->begin();
+
+#ifdef ENABLE_BENCH
+  // 注册热点路径基准测试接口
+  BenchService::get_instance()->begin();
+#endif
+
+#ifdef ENABLE_RECORDER
+  // 开始记录外部输入, 启动记录包含已恢复的标定数据
+  RecorderService::get_instance()->begin();
+#endif
+
+  // NTP 等依赖网络的服务在 WiFi 连接后启动
+  network_boot_task = SchedulerService::get_instance()->add_periodic(
+      "netboot", start_network_services,
+      NETWORK_BOOT_CHECK_INTERVAL_MS * 1000UL, SchedulerService::PRIO_BACKGROUND);
 }
 
 void loop()
 {
-  WirelessService *wireless_service = WirelessService::get_instance();
-  NTPService *ntp_service = NTPService::get_instance();
-  LoggerService *logger_service = LoggerService::get_instance();
-  IRService *ir_service = IRService::get_instance();
-  MotorService *motor_service = MotorService::get_instance();
-  Application *app = Application::get_instance();
-
-  // 更新服务状态
-  wireless_service->update();
-  ntp_service->update();
-  logger_service->update();
-  ir_service->update();
-  motor_service->update();
-  app->update();
+  // 各服务在 begin() 中注册了调度任务, 每轮只运行到期的任务
+  SchedulerService::get_instance()->run();
 }
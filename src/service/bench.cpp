@@ -0,0 +1,188 @@
+#include "service/bench.h"
+
+#ifdef ENABLE_BENCH
+
+#include "config/pins.h"
+#include "service/config.h"
+#include "service/heap.h"
+#include "service/logger.h"
+#include "service/motor.h"
+#include "utility/misc.h"
+
+#include <PID_v1.h>
+
+// 保存测试结果, 避免编译器优化掉被测计算
+static volatile uint32_t bench_sink = 0;
+
+const BenchService::Bench BenchService::BENCHES[] = {
+    {"is_close_enough", 1000, &BenchService::bench_is_close_},
+    {"pid_compute", 200, &BenchService::bench_pid_compute_},
+    {"logger_printf", 20, &BenchService::bench_logger_printf_},
+    {"config_load", 10, &BenchService::bench_config_load_},
+    {"config_save", 2, &BenchService::bench_config_save_},
+};
+
+BenchService::BenchService()
+{
+}
+
+BenchService::~BenchService()
+{
+}
+
+void BenchService::begin()
+{
+    LoggerService::get_instance()->web_server()->on(WEB_BENCH_PATH, &BenchService::handle_web_bench_);
+}
+
+uint32_t BenchService::bench_is_close_(uint32_t iterations)
+{
+    volatile float val = 1234.0f;
+    uint32_t hits = 0;
+    uint32_t start = ESP.getCycleCount();
+    for (uint32_t i = 0; i < iterations; i++)
+    {
+        hits += is_close_enough(val, (float)(i * 8));
+    }
+    uint32_t cycles = ESP.getCycleCount() - start;
+    bench_sink = hits;
+    return cycles;
+}
+
+uint32_t BenchService::bench_pid_compute_(uint32_t iterations)
+{
+    // PID 控制器只在距上次计算超过采样时间时才计算, 每次新建控制器保证 Compute() 执行完整的一步
+    double input = 0, output = 0, setpoint = 1000;
+    uint32_t cycles = 0;
+    for (uint32_t i = 0; i < iterations; i++)
+    {
+        PID pid(&input, &output, &setpoint, MotorService::PID_DEF_KP, MotorService::PID_DEF_KI,
+                MotorService::PID_DEF_KD, DIRECT);
+        pid.SetOutputLimits(-MotorService::PWM_RANGE, MotorService::PWM_RANGE);
+        pid.SetMode(AUTOMATIC);
+        input = (double)(i % 100);
+
+        uint32_t start = ESP.getCycleCount();
+        pid.Compute();
+        cycles += ESP.getCycleCount() - start;
+    }
+    bench_sink = (uint32_t)output;
+    return cycles;
+}
+
+uint32_t BenchService::bench_logger_printf_(uint32_t iterations)
+{
+    // 与控制周期中 Teleplot 输出相同的格式, 包括串口输出的耗时
+    uint32_t start = ESP.getCycleCount();
+    for (uint32_t i = 0; i < iterations; i++)
+    {
+        LoggerService::printf_P(PSTR(">bench: %lu %.3f\n"), (unsigned long)i, i * 0.5f);
+    }
+    return ESP.getCycleCount() - start;
+}
+
+uint32_t BenchService::bench_config_load_(uint32_t iterations)
+{
+    ConfigService *config = ConfigService::get_instance();
+    uint32_t ok = 0;
+    uint32_t start = ESP.getCycleCount();
+    for (uint32_t i = 0; i < iterations; i++)
+    {
+        ok += config->reload();
+    }
+    uint32_t cycles = ESP.getCycleCount() - start;
+    bench_sink = ok;
+    return cycles;
+}
+
+uint32_t BenchService::bench_config_save_(uint32_t iterations)
+{
+    // 保存未修改的配置, 只产生 Flash 写入
+    ConfigService *config = ConfigService::get_instance();
+    uint32_t ok = 0;
+    uint32_t start = ESP.getCycleCount();
+    for (uint32_t i = 0; i < iterations; i++)
+    {
+        ok += config->save();
+    }
+    uint32_t cycles = ESP.getCycleCount() - start;
+    bench_sink = ok;
+    return cycles;
+}
+
+void BenchService::handle_web_bench_()
+{
+    ESP8266WebServer *server = LoggerService::get_instance()->web_server();
+
+    // 测试阻塞控制任务, 只在所有电机静止时运行
+    for (int ch = 0; ch < MOTOR_CHANNELS; ch++)
+    {
+        if (MotorService::get_instance(ch)->is_moving())
+        {
+            server->send_P(409, PSTR("application/json"), PSTR("{\"error\":\"motor is moving\"}\n"));
+            return;
+        }
+    }
+
+    int rounds = DEF_ROUNDS;
+    if (server->hasArg("rounds"))
+    {
+        rounds = constrain(strtol(server->arg("rounds").c_str(), nullptr, 10), 1L, (long)MAX_ROUNDS);
+    }
+    const char *only = server->hasArg("only") ? server->arg("only").c_str() : nullptr;
+
+    uint32_t mhz = ESP.getCpuFreqMHz();
+    server->setContentLength(CONTENT_LENGTH_UNKNOWN);
+    server->send_P(200, PSTR("application/json"), PSTR(""));
+
+    char buf[224];
+    snprintf_P(buf, sizeof(buf), PSTR("{\"cpu_mhz\":%lu,\"rounds\":%d,\"heap_trace\":%s,\"results\":["),
+               (unsigned long)mhz, rounds,
+#ifdef ENABLE_HEAP_TRACE
+               "true"
+#else
+               "false"
+#endif
+    );
+    server->sendContent(buf);
+
+    bool first = true;
+    for (const Bench &bench : BENCHES)
+    {
+        if (only != nullptr && strcmp(only, bench.name) != 0)
+        {
+            continue;
+        }
+
+        // 各轮单次耗时插入排序, 取中位数以排除偶发中断的影响
+        float ns[MAX_ROUNDS];
+        uint32_t allocs = 0;
+        for (int r = 0; r < rounds; r++)
+        {
+            uint32_t alloc_start = HeapService::alloc_count();
+            uint32_t cycles = bench.fn(bench.iterations);
+            allocs += HeapService::alloc_count() - alloc_start;
+            ESP.wdtFeed();
+
+            float value = (float)cycles * 1000.0f / mhz / bench.iterations;
+            int j = r;
+            for (; j > 0 && ns[j - 1] > value; j--)
+            {
+                ns[j] = ns[j - 1];
+            }
+            ns[j] = value;
+        }
+
+        snprintf_P(buf, sizeof(buf),
+                   PSTR("%s{\"name\":\"%s\",\"iterations\":%lu,\"ns_per_op\":{\"median\":%.1f,\"min\":%.1f,\"max\":%.1f},"
+                        "\"allocs_per_op\":%.2f}"),
+                   first ? "" : ",", bench.name, (unsigned long)bench.iterations, ns[rounds / 2], ns[0], ns[rounds - 1],
+                   (float)allocs / rounds / bench.iterations);
+        server->sendContent(buf);
+        first = false;
+    }
+    server->sendContent_P(PSTR("]}\n"));
+    server->sendContent("");
+}
+
+#endif
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <Arduino.h>
+
+/** 热点路径基准测试服务
+ *
+ * 在设备上测量控制及日志热点路径的单次耗时和堆分配次数: 误差判定 is_close_enough()、PID 单步计算、
+ * 格式化日志输出、配置记录的加载和保存。
+ * 每项测试运行多轮, 每轮执行固定次数, 输出各轮单次耗时的中位数、最小值、最大值及平均每次的堆分配次数,
+ * 结果为 JSON, 供刷机后对比趋势。测试期间阻塞调度, 电机运行时拒绝执行。
+ *
+ * 编译时定义 ENABLE_BENCH 启用; 不依赖设备的热点路径 (含红外按键及电机控制周期) 在主机上测量, 见 pio run -e bench。
+ */
+class BenchService
+{
+public:
+    static constexpr int DEF_ROUNDS = 7;                  // 默认测试轮数
+    static constexpr int MAX_ROUNDS = 15;                 // 最大测试轮数
+    static constexpr const char *WEB_BENCH_PATH = "/bench"; // ?rounds=<N> 测试轮数, ?only=<名称> 只运行一项
+
+    /** 基准测试函数, 执行 iterations 次被测操作, 返回被测部分消耗的 CPU 周期数 */
+    using bench_fn_t = uint32_t (*)(uint32_t iterations);
+
+    /** 基准测试项 */
+    struct Bench
+    {
+        const char *name;
+        uint32_t iterations; // 每轮执行次数
+        bench_fn_t fn;
+    };
+
+    static BenchService *get_instance()
+    {
+        static BenchService instance;
+        return &instance;
+    }
+
+    ~BenchService();
+
+    /** 注册 HTTP 测试接口 (须在日志服务启动后调用) */
+    void begin();
+
+protected:
+    BenchService();
+
+    static void handle_web_bench_();
+
+    static uint32_t bench_is_close_(uint32_t iterations);
+    static uint32_t bench_pid_compute_(uint32_t iterations);
+    static uint32_t bench_logger_printf_(uint32_t iterations);
+    static uint32_t bench_config_load_(uint32_t iterations);
+    static uint32_t bench_config_save_(uint32_t iterations);
+
+    static const Bench BENCHES[];
+};
@@ -0,0 +1,296 @@
+#include "service/capture.h"
+#include "service/config.h"
+#include "service/logger.h"
+#include "service/motor.h"
+#include "service/scheduler.h"
+
+#include <LittleFS.h>
+
+CaptureService::CaptureService() : m_active(false),
+                                   m_save_pending(false),
+                                   m_start_ms(0),
+                                   m_next_id(0),
+                                   m_tick(0),
+                                   m_step(0),
+                                   m_reached_10(false),
+                                   m_t10_ms(0),
+                                   m_last_record_us(0),
+                                   m_pwm_integral(0),
+                                   m_metrics(),
+                                   m_samples()
+{
+}
+
+CaptureService::~CaptureService()
+{
+}
+
+void CaptureService::begin()
+{
+    // 从已保存的捕获文件中找出最大序号, 重启后继续编号
+    if (ConfigService::get_instance()->is_mounted())
+    {
+        for (int i = 0; i < MAX_FILES; i++)
+        {
+            char path[24];
+            snprintf(path, sizeof(path), CAPTURE_FILE_FMT, i);
+            File file = LittleFS.open(path, "r");
+            if (!file)
+            {
+                continue;
+            }
+            FileHeader header;
+            if (file.read((uint8_t *)&header, sizeof(header)) == sizeof(header) && header.magic == CAPTURE_MAGIC)
+            {
+                m_next_id = max(m_next_id, header.metrics.id + 1);
+            }
+            file.close();
+        }
+    }
+
+    LoggerService::get_instance()->web_server()->on(WEB_CAPTURE_PATH, &CaptureService::handle_web_capture_);
+}
+
+void CaptureService::arm(uint8_t channel, long start_pos, long setpoint)
+{
+    if (m_active && m_metrics.channel != channel)
+    {
+        LoggerService::printf_P(PSTR("Capture #%lu: channel %u capture preempted\n"), (unsigned long)m_metrics.id, m_metrics.channel);
+    }
+
+    // 上一次捕获尚未保存时先保存, 避免被新数据覆盖
+    if (m_save_pending)
+    {
+        CaptureService::save_();
+    }
+
+    memset(&m_metrics, 0, sizeof(m_metrics));
+    m_metrics.id = m_next_id++;
+    m_metrics.start_pos = start_pos;
+    m_metrics.setpoint = setpoint;
+    m_metrics.sample_stride = 1;
+    m_metrics.channel = channel;
+
+    m_step = setpoint - start_pos;
+    m_reached_10 = false;
+    m_t10_ms = 0;
+    m_tick = 0;
+    m_pwm_integral = 0;
+    m_start_ms = millis();
+    m_last_record_us = micros();
+    m_active = true;
+}
+
+void CaptureService::record(uint8_t channel, long setpoint, long pos, float speed, int pwm)
+{
+    if (!this->is_active(channel))
+    {
+        return;
+    }
+
+    unsigned long cur_us = micros();
+    uint32_t t_ms = millis() - m_start_ms;
+    m_pwm_integral += (uint64_t)abs(pwm) * (cur_us - m_last_record_us);
+    m_last_record_us = cur_us;
+
+    // 以运动方向为正计算行程进度, 在线更新上升时间、超调量和调节时间
+    long progress = (m_step >= 0) ? pos - m_metrics.start_pos : m_metrics.start_pos - pos;
+    long span = abs(m_step);
+    if (!m_reached_10 && progress * 10 >= span)
+    {
+        m_reached_10 = true;
+        m_t10_ms = t_ms;
+    }
+    if (m_metrics.rise_ms == 0 && m_reached_10 && progress * 10 >= span * 9)
+    {
+        m_metrics.rise_ms = max(t_ms - m_t10_ms, (uint32_t)1);
+    }
+    m_metrics.overshoot = max(m_metrics.overshoot, (int32_t)(progress - span));
+    if (!MotorService::get_instance(channel)->is_close((float)pos, (float)setpoint))
+    {
+        m_metrics.settle_ms = t_ms;
+    }
+
+    // 每 sample_stride 个控制周期记录一个样本, 缓冲区写满时丢弃一半样本并加倍记录间隔
+    if (++m_tick < m_metrics.sample_stride)
+    {
+        return;
+    }
+    m_tick = 0;
+
+    if (m_metrics.sample_count >= MAX_SAMPLES)
+    {
+        for (int i = 0; i < MAX_SAMPLES / 2; i++)
+        {
+            m_samples[i] = m_samples[i * 2];
+        }
+        m_metrics.sample_count = MAX_SAMPLES / 2;
+        m_metrics.sample_stride *= 2;
+    }
+
+    Sample &s = m_samples[m_metrics.sample_count++];
+    s.t_ms = t_ms;
+    s.setpoint = setpoint;
+    s.pos = pos;
+    s.speed = (int16_t)constrain(speed, -32768.0f, 32767.0f);
+    s.pwm = pwm;
+}
+
+void CaptureService::finish(uint8_t channel, long final_pos)
+{
+    if (!this->is_active(channel))
+    {
+        return;
+    }
+    m_active = false;
+
+    m_metrics.duration_ms = millis() - m_start_ms;
+    m_metrics.ss_error = final_pos - m_metrics.setpoint;
+    m_metrics.pwm_integral = (uint32_t)(m_pwm_integral / 1000);
+
+    LoggerService::printf_P(PSTR("Capture #%lu: ch=%u step=%ld rise=%lums overshoot=%ld settle=%lums ss_err=%ld duration=%lums |pwm|dt=%lu\n"),
+                            (unsigned long)m_metrics.id, m_metrics.channel, m_step, (unsigned long)m_metrics.rise_ms, (long)m_metrics.overshoot,
+                            (unsigned long)m_metrics.settle_ms, (long)m_metrics.ss_error, (unsigned long)m_metrics.duration_ms,
+                            (unsigned long)m_metrics.pwm_integral);
+
+    // 写文件较慢, 放到后台任务中执行, 不阻塞电机控制任务
+    m_save_pending = true;
+    SchedulerService::get_instance()->add_oneshot("capture", &CaptureService::save_, 0, SchedulerService::PRIO_BACKGROUND);
+}
+
+void CaptureService::abort(uint8_t channel)
+{
+    if (this->is_active(channel))
+    {
+        m_active = false;
+    }
+}
+
+void CaptureService::save_()
+{
+    CaptureService *cs = CaptureService::get_instance();
+    if (!cs->m_save_pending)
+    {
+        return;
+    }
+    cs->m_save_pending = false;
+
+    if (!ConfigService::get_instance()->is_mounted())
+    {
+        return;
+    }
+
+    char path[24];
+    snprintf(path, sizeof(path), CAPTURE_FILE_FMT, (int)(cs->m_metrics.id % MAX_FILES));
+    File file = LittleFS.open(path, "w");
+    if (!file)
+    {
+        LoggerService::printf_P(PSTR("Failed to open capture file for writing: %s\n"), path);
+        return;
+    }
+
+    FileHeader header;
+    header.magic = CAPTURE_MAGIC;
+    header.metrics = cs->m_metrics;
+    file.write((const uint8_t *)&header, sizeof(header));
+    file.write((const uint8_t *)cs->m_samples, cs->m_metrics.sample_count * sizeof(Sample));
+    file.close();
+}
+
+void CaptureService::handle_web_capture_()
+{
+    ESP8266WebServer *server = LoggerService::get_instance()->web_server();
+
+    if (server->hasArg("id"))
+    {
+        CaptureService::send_csv_(strtoul(server->arg("id").c_str(), nullptr, 10));
+        return;
+    }
+
+    // 列出已保存的捕获及其指标
+    server->setContentLength(CONTENT_LENGTH_UNKNOWN);
+    server->send(200, "text/plain", "");
+    server->sendContent_P(PSTR("id,channel,start_pos,setpoint,rise_ms,overshoot,settle_ms,ss_error,duration_ms,pwm_integral,samples,stride\n"));
+    for (int i = 0; i < MAX_FILES; i++)
+    {
+        char path[24];
+        snprintf(path, sizeof(path), CAPTURE_FILE_FMT, i);
+        File file = LittleFS.open(path, "r");
+        if (!file)
+        {
+            continue;
+        }
+
+        FileHeader header;
+        bool ok = file.read((uint8_t *)&header, sizeof(header)) == sizeof(header) && header.magic == CAPTURE_MAGIC;
+        file.close();
+        if (!ok)
+        {
+            continue;
+        }
+
+        const Metrics &m = header.metrics;
+        char buf[160];
+        snprintf_P(buf, sizeof(buf), PSTR("%lu,%u,%ld,%ld,%lu,%ld,%lu,%ld,%lu,%lu,%u,%u\n"),
+                   (unsigned long)m.id, m.channel, (long)m.start_pos, (long)m.setpoint, (unsigned long)m.rise_ms, (long)m.overshoot,
+                   (unsigned long)m.settle_ms, (long)m.ss_error, (unsigned long)m.duration_ms, (unsigned long)m.pwm_integral,
+                   m.sample_count, m.sample_stride);
+        server->sendContent(buf);
+    }
+    server->sendContent("");
+}
+
+void CaptureService::send_csv_(uint32_t id)
+{
+    ESP8266WebServer *server = LoggerService::get_instance()->web_server();
+
+    char path[24];
+    snprintf(path, sizeof(path), CAPTURE_FILE_FMT, (int)(id % MAX_FILES));
+    File file = LittleFS.open(path, "r");
+    FileHeader header;
+    if (!file || file.read((uint8_t *)&header, sizeof(header)) != sizeof(header) ||
+        header.magic != CAPTURE_MAGIC || header.metrics.id != id)
+    {
+        if (file)
+        {
+            file.close();
+        }
+        server->send_P(404, PSTR("text/plain"), PSTR("Capture not found.\n"));
+        return;
+    }
+
+    // 逐个样本读取并分块发送, 不在内存中生成完整 CSV
+    server->setContentLength(CONTENT_LENGTH_UNKNOWN);
+    server->send(200, "text/csv", "");
+
+    const Metrics &m = header.metrics;
+    char buf[128];
+    snprintf_P(buf, sizeof(buf), PSTR("# channel=%u rise_ms=%lu overshoot=%ld settle_ms=%lu ss_error=%ld pwm_integral=%lu\n"),
+               m.channel, (unsigned long)m.rise_ms, (long)m.overshoot, (unsigned long)m.settle_ms, (long)m.ss_error,
+               (unsigned long)m.pwm_integral);
+    server->sendContent(buf);
+    server->sendContent_P(PSTR("t_ms,setpoint,pos,speed,pwm\n"));
+
+    // 多行合并为一个数据块发送, 减少 TCP 报文数
+    char chunk[512];
+    size_t chunk_len = 0;
+    Sample s;
+    for (uint16_t i = 0; i < m.sample_count && file.read((uint8_t *)&s, sizeof(s)) == sizeof(s); i++)
+    {
+        int n = snprintf_P(buf, sizeof(buf), PSTR("%lu,%ld,%ld,%d,%d\n"),
+                           (unsigned long)s.t_ms, (long)s.setpoint, (long)s.pos, s.speed, s.pwm);
+        if (chunk_len + n > sizeof(chunk))
+        {
+            server->sendContent(chunk, chunk_len);
+            chunk_len = 0;
+        }
+        memcpy(chunk + chunk_len, buf, n);
+        chunk_len += n;
+    }
+    file.close();
+    if (chunk_len > 0)
+    {
+        server->sendContent(chunk, chunk_len);
+    }
+    server->sendContent("");
+}
@@ -0,0 +1,100 @@
+#pragma once
+
+#include <Arduino.h>
+
+/** 电机运动轨迹捕获服务
+ *
+ * goto_pos() 启动 PID 控制时开始捕获, 每个控制周期记录设定点、位置、速度和 PWM 输出,
+ * 直到电机进入稳态。样本缓冲区写满时两两合并并加倍记录间隔, 保证完整覆盖整个运动过程;
+ * 阶跃响应指标 (上升时间、超调量、调节时间、稳态误差、|PWM| 积分) 则按每个控制周期在线计算,
+ * 不受抽取影响。最近若干次捕获保存在文件系统中, 可通过 HTTP 接口下载 CSV 格式数据。
+ * 多个电机通道共用一个捕获缓冲区, 同一时刻只捕获最近一次启动 PID 运动的通道。
+ */
+class CaptureService
+{
+public:
+    static constexpr int MAX_SAMPLES = 400;                          // 单次捕获最多样本数
+    static constexpr int MAX_FILES = 4;                              // 文件系统中保留的捕获次数
+    static constexpr const char *CAPTURE_FILE_FMT = "/capture%d.bin"; // 捕获文件名格式
+    static constexpr const char *WEB_CAPTURE_PATH = "/capture";      // 捕获列表, ?id=<序号> 下载 CSV 数据
+    static constexpr uint32_t CAPTURE_MAGIC = 0x32504343;            // "CCP2"
+
+    struct Sample
+    {
+        uint32_t t_ms;    // 相对捕获开始的时间(ms)
+        int32_t setpoint; // PID 设定点
+        int32_t pos;      // 窗帘位置
+        int16_t speed;    // 滤波后速度(pulse/s)
+        int16_t pwm;      // PWM 输出值
+    };
+
+    /** 阶跃响应指标 */
+    struct Metrics
+    {
+        uint32_t id;             // 捕获序号
+        int32_t start_pos;       // 起始位置
+        int32_t setpoint;        // 目标位置
+        uint32_t rise_ms;        // 上升时间 (10% -> 90% 行程), 未达到 90% 时为 0
+        int32_t overshoot;       // 超调量(编码脉冲数)
+        uint32_t settle_ms;      // 调节时间 (最后一次进入目标误差范围的时间)
+        int32_t ss_error;        // 稳态误差(编码脉冲数)
+        uint32_t duration_ms;    // 总时长 (到判定稳态为止)
+        uint32_t pwm_integral;   // |PWM| 对时间的积分 (PWM*ms), 用作能耗参考
+        uint16_t sample_count;   // 样本数
+        uint16_t sample_stride;  // 样本记录间隔(控制周期数)
+        uint8_t channel;         // 电机通道号
+        uint8_t reserved[3];
+    };
+
+    static CaptureService *get_instance()
+    {
+        static CaptureService instance;
+        return &instance;
+    }
+
+    ~CaptureService();
+
+    /** 注册 HTTP 下载接口 (须在日志服务启动后调用) */
+    void begin();
+
+    /** 开始捕获一次运动, 其它通道正在进行的捕获被放弃 */
+    void arm(uint8_t channel, long start_pos, long setpoint);
+    /** 记录一个控制周期的数据 */
+    void record(uint8_t channel, long setpoint, long pos, float speed, int pwm);
+    /** 电机进入稳态时结束捕获, 计算指标并保存 */
+    void finish(uint8_t channel, long final_pos);
+    /** 放弃当前捕获 (手动控制打断 PID 运动时) */
+    void abort(uint8_t channel);
+
+    /** 是否正在捕获指定通道 */
+    bool is_active(uint8_t channel) const { return m_active && m_metrics.channel == channel; }
+    /** 获取最近一次捕获的指标 */
+    const Metrics &get_last_metrics() const { return m_metrics; }
+
+protected:
+    CaptureService();
+
+    struct FileHeader
+    {
+        uint32_t magic;
+        Metrics metrics;
+    };
+
+    static void save_();
+    static void handle_web_capture_();
+    static void send_csv_(uint32_t id);
+
+    bool m_active;
+    bool m_save_pending;
+    unsigned long m_start_ms;
+    uint32_t m_next_id;     // 下一次捕获的序号
+    uint16_t m_tick;        // 当前记录间隔内的控制周期计数
+    long m_step;            // 行程 (目标位置 - 起始位置)
+    bool m_reached_10;      // 已到达 10% 行程
+    uint32_t m_t10_ms;
+    unsigned long m_last_record_us;
+    uint64_t m_pwm_integral;  // |PWM| 对时间的积分 (PWM*us)
+
+    Metrics m_metrics;
+    Sample m_samples[MAX_SAMPLES];
+};
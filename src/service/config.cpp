@@ -0,0 +1,222 @@
+#include "service/config.h"
+#include "service/logger.h"
+#include "utility/crc.h"
+
+#include <LittleFS.h>
+#include <ArduinoJson.h>
+
+ConfigService::ConfigService() : m_mounted(false),
+                                 m_record()
+{
+    this->set_defaults_();
+}
+
+ConfigService::~ConfigService()
+{
+    this->end();
+}
+
+void ConfigService::begin()
+{
+    unsigned long start_us = micros();
+
+    LoggerService::println(F("Mounting filesystem ..."));
+    m_mounted = LittleFS.begin();
+    if (!m_mounted)
+    {
+        LoggerService::println(F("Failed to mount filesystem, using default config."));
+        return;
+    }
+
+    if (!this->load_())
+    {
+        // 没有有效的二进制配置时尝试从旧的 JSON 配置文件迁移
+        if (this->migrate_legacy_())
+        {
+            LoggerService::println(F("Legacy config migrated."));
+        }
+        else
+        {
+            LoggerService::println(F("No valid config found, using default values."));
+        }
+    }
+
+    LoggerService::printf_P(PSTR("Config loaded in %lu us, free heap: %u, max free block: %u\n"),
+                            micros() - start_us, ESP.getFreeHeap(), ESP.getMaxFreeBlockSize());
+}
+
+void ConfigService::end()
+{
+    if (m_mounted)
+    {
+        LittleFS.end();
+        m_mounted = false;
+    }
+}
+
+bool ConfigService::remount()
+{
+    if (!m_mounted)
+    {
+        m_mounted = LittleFS.begin();
+        LoggerService::println(m_mounted ? F("Filesystem remounted") : F("Failed to remount filesystem"));
+    }
+    return m_mounted;
+}
+
+void ConfigService::set_defaults_()
+{
+    memset(&m_record, 0, sizeof(m_record));
+    strlcpy(m_record.data.mqtt.server, DEF_MQTT_SERVER, sizeof(m_record.data.mqtt.server));
+    strlcpy(m_record.data.mqtt.port, DEF_MQTT_PORT, sizeof(m_record.data.mqtt.port));
+    strlcpy(m_record.data.mqtt_group, DEF_MQTT_GROUP, sizeof(m_record.data.mqtt_group));
+}
+
+bool ConfigService::load_()
+{
+    File conf_file = LittleFS.open(CONFIG_FILE, "r");
+    if (!conf_file)
+    {
+        return false;
+    }
+
+    // 一次读入整个记录, 旧版本记录较短时缺少的字段保持默认值
+    ConfigRecord record;
+    memcpy(&record, &m_record, sizeof(record));
+    size_t n = conf_file.read((uint8_t *)&record, sizeof(record));
+    conf_file.close();
+
+    const ConfigHeader &header = record.header;
+    if (n < sizeof(ConfigHeader) || header.magic != CONFIG_MAGIC || header.version > CONFIG_VERSION ||
+        header.length > sizeof(ConfigData) || n < sizeof(ConfigHeader) + header.length)
+    {
+        LoggerService::println(F("Invalid config file header, ignored."));
+        return false;
+    }
+
+    if (crc32(&record.data, header.length) != header.crc)
+    {
+        LoggerService::println(F("Config file CRC mismatch, ignored."));
+        return false;
+    }
+
+    memcpy(&m_record.data, &record.data, header.length);
+
+    if (header.version < CONFIG_VERSION)
+    {
+        LoggerService::printf_P(PSTR("Config upgraded from version %u to %u\n"), header.version, CONFIG_VERSION);
+        this->save();
+    }
+    return true;
+}
+
+bool ConfigService::save()
+{
+    if (!m_mounted)
+    {
+        LoggerService::println(F("Failed to save config: filesystem not mounted."));
+        return false;
+    }
+
+    m_record.header.magic = CONFIG_MAGIC;
+    m_record.header.version = CONFIG_VERSION;
+    m_record.header.length = sizeof(ConfigData);
+    m_record.header.crc = crc32(&m_record.data, sizeof(ConfigData));
+
+    // 先写入临时文件, 完整写入后再重命名覆盖, 避免写入中途断电损坏配置
+    File conf_file = LittleFS.open(CONFIG_TMP_FILE, "w");
+    if (!conf_file)
+    {
+        LoggerService::printf_P(PSTR("Failed to open config file for writing: %s\n"), CONFIG_TMP_FILE);
+        return false;
+    }
+    size_t n = conf_file.write((const uint8_t *)&m_record, sizeof(m_record));
+    conf_file.close();
+
+    if (n != sizeof(m_record) || !LittleFS.rename(CONFIG_TMP_FILE, CONFIG_FILE))
+    {
+        LoggerService::printf_P(PSTR("Failed to write config file: %s\n"), CONFIG_FILE);
+        LittleFS.remove(CONFIG_TMP_FILE);
+        return false;
+    }
+    return true;
+}
+
+bool ConfigService::migrate_legacy_()
+{
+    bool migrated = false;
+
+    if (LittleFS.exists(LEGACY_MQTT_CONF_FILE))
+    {
+        File conf_file = LittleFS.open(LEGACY_MQTT_CONF_FILE, "r");
+        if (conf_file)
+        {
+            JsonDocument doc;
+            auto err = deserializeJson(doc, conf_file);
+            conf_file.close();
+            if (!err)
+            {
+                MqttConf &mqtt = m_record.data.mqtt;
+                strlcpy(mqtt.server, doc["mqtt_server"] | DEF_MQTT_SERVER, sizeof(mqtt.server));
+                strlcpy(mqtt.port, doc["mqtt_port"] | DEF_MQTT_PORT, sizeof(mqtt.port));
+                strlcpy(mqtt.user, doc["mqtt_user"] | "", sizeof(mqtt.user));
+                strlcpy(mqtt.pass, doc["mqtt_pass"] | "", sizeof(mqtt.pass));
+                migrated = true;
+            }
+            else
+            {
+                LoggerService::printf_P(PSTR("Failed to parse legacy MQTT config: %s\n"), err.c_str());
+            }
+        }
+    }
+
+    if (LittleFS.exists(LEGACY_MOTOR_CONF_FILE))
+    {
+        File conf_file = LittleFS.open(LEGACY_MOTOR_CONF_FILE, "r");
+        if (conf_file)
+        {
+            JsonDocument doc;
+            auto err = deserializeJson(doc, conf_file);
+            conf_file.close();
+            if (!err)
+            {
+                MotorConf &motor = m_record.data.motor;
+                motor.full_close_pos = doc["full_close_pos"] | 0L;
+                motor.full_open_pos = doc["full_open_pos"] | 0L;
+                motor.current_pos = doc["current_pos"] | 0L;
+                motor.reversed = (doc["reversed"] | false) ? 1 : 0;
+                motor.backlash = doc["backlash"] | 0L;
+                motor.slack = doc["slack"] | 0L;
+                migrated = true;
+            }
+            else
+            {
+                LoggerService::printf_P(PSTR("Failed to parse legacy motor config: %s\n"), err.c_str());
+            }
+        }
+    }
+
+    if (LittleFS.exists(LEGACY_WIFI_CACHE_FILE))
+    {
+        File cache_file = LittleFS.open(LEGACY_WIFI_CACHE_FILE, "r");
+        if (cache_file)
+        {
+            WifiCache cache;
+            if (cache_file.read((uint8_t *)&cache, sizeof(cache)) == sizeof(cache))
+            {
+                m_record.data.wifi = cache;
+                migrated = true;
+            }
+            cache_file.close();
+        }
+    }
+
+    // 迁移结果保存成功后才删除旧文件
+    if (migrated && this->save())
+    {
+        LittleFS.remove(LEGACY_MQTT_CONF_FILE);
+        LittleFS.remove(LEGACY_MOTOR_CONF_FILE);
+        LittleFS.remove(LEGACY_WIFI_CACHE_FILE);
+    }
+    return migrated;
+}
@@ -0,0 +1,153 @@
+#pragma once
+
+#include <Arduino.h>
+
+/** 统一配置存储服务
+ *
+ * 启动时挂载一次文件系统, 所有配置保存在一个带版本号和 CRC 校验的二进制记录中,
+ * 启动时一次读入静态内存, 保存时先写临时文件再重命名以保证原子性。
+ * 新增字段只能追加在 ConfigData 末尾, 旧版本记录中缺少的字段保持默认值。
+ */
+class ConfigService
+{
+public:
+    static constexpr const char *CONFIG_FILE = "/config.bin";
+    static constexpr const char *CONFIG_TMP_FILE = "/config.tmp";
+    static constexpr const char *LEGACY_MQTT_CONF_FILE = "/mqtt_conf.json";
+    static constexpr const char *LEGACY_MOTOR_CONF_FILE = "/motor_conf.json";
+    static constexpr const char *LEGACY_WIFI_CACHE_FILE = "/wifi_cache.bin";
+    static constexpr uint32_t CONFIG_MAGIC = 0x434D4243; // "CBMC"
+    static constexpr uint16_t CONFIG_VERSION = 5;
+    static constexpr const char *DEF_MQTT_SERVER = "chaosgateway";
+    static constexpr const char *DEF_MQTT_PORT = "1883";
+    static constexpr const char *DEF_MQTT_GROUP = "default";
+
+    /** MQTT 服务器设置 */
+    struct MqttConf
+    {
+        char server[40];
+        char port[6];
+        char user[40];
+        char pass[40];
+    };
+
+    /** 电机标定数据 */
+    struct MotorConf
+    {
+        int32_t full_close_pos; // 窗帘完全关闭时的电机标定位置
+        int32_t full_open_pos;  // 窗帘完全打开时的电机标定位置
+        int32_t current_pos;    // 当前电机停止位置
+        int32_t backlash;       // 电机齿隙大小(编码脉冲数)
+        int32_t slack;          // 电机停止时在齿隙中的位置
+        uint8_t reversed;       // 电机是否反向
+        uint8_t reserved[3];
+    };
+
+    /** 电机控制参数, 含义及取值范围见 MotorService::Tuning */
+    struct TuningConf
+    {
+        float kp;
+        float ki;
+        float kd;
+        float pid_sample_ms;
+        float stable_sample_ms;
+        float stable_n_sample;
+        float speed_cutoff_hz;
+        float rel_err_tol;
+        float abs_err_tol;
+        uint8_t valid; // 0 表示未保存过, 使用编译时默认值
+        uint8_t reserved[3];
+    };
+
+    /** 开度中间标定点, 按开度升序, 含义见 PositionMap */
+    struct CalibrationConf
+    {
+        uint8_t count;      // 标定点数
+        uint8_t percent[7]; // 各点开度百分比
+        int32_t pos[7];     // 各点电机位置
+    };
+
+    /** 上次成功连接的接入点及 IP 租约缓存 */
+    struct WifiCache
+    {
+        uint32_t magic;
+        uint32_t crc; // 之后所有字段的 CRC32
+        uint8_t bssid[6];
+        uint8_t channel;
+        uint8_t reserved;
+        uint32_t ip;
+        uint32_t gateway;
+        uint32_t netmask;
+        uint32_t dns;
+    };
+
+    /** 配置数据, 新增字段追加在末尾并增加 CONFIG_VERSION */
+    struct ConfigData
+    {
+        MqttConf mqtt;
+        MotorConf motor;
+        WifiCache wifi;
+        char mqtt_group[24]; // v2: 同步移动分组名称
+        MotorConf motor2;    // v3: 第二通道电机标定数据
+        TuningConf tuning;   // v4: 电机控制参数
+        TuningConf tuning2;  // v4: 第二通道电机控制参数
+        CalibrationConf calibration;  // v5: 开度中间标定点
+        CalibrationConf calibration2; // v5: 第二通道开度中间标定点
+    };
+
+    static ConfigService *get_instance()
+    {
+        static ConfigService instance;
+        return &instance;
+    }
+
+    ~ConfigService();
+
+    /** 挂载文件系统并加载配置, 必要时从旧的 JSON 配置文件迁移 */
+    void begin();
+    /** 卸载文件系统 (OTA 更新文件系统前调用) */
+    void end();
+    /** 重新挂载文件系统 (OTA 更新失败后调用), 内存中的配置保持不变 */
+    bool remount();
+    /** 文件系统是否已挂载 */
+    bool is_mounted() const { return m_mounted; }
+
+    /** 原子地保存配置 */
+    bool save();
+    /** 重新从文件加载配置 (基准测试用) */
+    bool reload() { return m_mounted && this->load_(); }
+
+    MqttConf &mqtt() { return m_record.data.mqtt; }
+    /** 电机标定数据, channel 为电机通道号 */
+    MotorConf &motor(int channel = 0) { return channel == 0 ? m_record.data.motor : m_record.data.motor2; }
+    /** 电机控制参数, channel 为电机通道号 */
+    TuningConf &tuning(int channel = 0) { return channel == 0 ? m_record.data.tuning : m_record.data.tuning2; }
+    /** 开度中间标定点, channel 为电机通道号 */
+    CalibrationConf &calibration(int channel = 0) { return channel == 0 ? m_record.data.calibration : m_record.data.calibration2; }
+    WifiCache &wifi() { return m_record.data.wifi; }
+    char *mqtt_group() { return m_record.data.mqtt_group; }
+
+protected:
+    ConfigService();
+
+    struct ConfigHeader
+    {
+        uint32_t magic;
+        uint16_t version;
+        uint16_t length; // 数据部分长度
+        uint32_t crc;    // 数据部分的 CRC32
+    };
+
+    struct ConfigRecord
+    {
+        ConfigHeader header;
+        ConfigData data;
+    };
+
+    void set_defaults_();
+    bool load_();
+    bool migrate_legacy_();
+
+    bool m_mounted;
+    ConfigRecord m_record;
+};
@@ -0,0 +1,165 @@
+#include "service/heap.h"
+#include "service/logger.h"
+#include "service/scheduler.h"
+
+#ifdef ENABLE_HEAP_TRACE
+
+// 链接器以 --wrap 将所有对 malloc/realloc/calloc 的引用重定向到 __wrap_ 版本, 原函数以 __real_ 前缀访问
+// (operator new、String、LittleFS 及 lwIP 均经由这几个函数分配; SDK 内部直接调用 pvPortMalloc 的分配不计入)
+// 核心的堆分配函数位于 IRAM, 包装函数同样放在 IRAM 中, 保证在 Flash 缓存关闭时也可调用
+static volatile uint32_t heap_alloc_count = 0;
+
+extern "C"
+{
+    void *__real_malloc(size_t size);
+    void *__real_realloc(void *ptr, size_t size);
+    void *__real_calloc(size_t count, size_t size);
+
+    void *IRAM_ATTR __wrap_malloc(size_t size)
+    {
+        heap_alloc_count++;
+        return __real_malloc(size);
+    }
+
+    void *IRAM_ATTR __wrap_realloc(void *ptr, size_t size)
+    {
+        heap_alloc_count++;
+        return __real_realloc(ptr, size);
+    }
+
+    void *IRAM_ATTR __wrap_calloc(size_t count, size_t size)
+    {
+        heap_alloc_count++;
+        return __real_calloc(count, size);
+    }
+}
+
+HeapService::NoAllocScope::~NoAllocScope()
+{
+    uint32_t allocs = HeapService::alloc_count() - m_start;
+    if (allocs > 0)
+    {
+        HeapService::get_instance()->note_violation_(m_name, allocs);
+    }
+}
+
+uint32_t HeapService::alloc_count()
+{
+    return heap_alloc_count;
+}
+
+#else
+
+uint32_t HeapService::alloc_count()
+{
+    return 0;
+}
+
+#endif
+
+HeapService::HeapService() : m_min_free(UINT32_MAX),
+                             m_min_max_block(UINT32_MAX),
+                             m_max_frag(0),
+                             m_last_report_allocs(0),
+                             m_last_report_ms(0),
+                             m_violations(0),
+                             m_last_violation(nullptr)
+{
+}
+
+HeapService::~HeapService()
+{
+}
+
+void HeapService::begin()
+{
+    this->sample_();
+
+    SchedulerService::get_instance()->add_periodic(
+        "heap", &HeapService::sample_, SAMPLE_INTERVAL_MS * 1000UL, SchedulerService::PRIO_BACKGROUND);
+
+    LoggerService::get_instance()->web_server()->on(WEB_HEAP_PATH, &HeapService::handle_web_heap_);
+}
+
+void HeapService::sample_()
+{
+    HeapService *heap = HeapService::get_instance();
+
+    uint32_t free_heap;
+    uint32_t max_block;
+    uint8_t frag;
+    ESP.getHeapStats(&free_heap, &max_block, &frag);
+
+    heap->m_min_free = min(heap->m_min_free, free_heap);
+    heap->m_min_max_block = min(heap->m_min_max_block, max_block);
+    heap->m_max_frag = max(heap->m_max_frag, frag);
+
+    // 定时输出到日志, 两次输出之间的分配次数应在启动完成后保持稳定
+    unsigned long cur_ms = millis();
+    if (heap->m_last_report_ms == 0 || cur_ms - heap->m_last_report_ms >= (unsigned long)REPORT_INTERVAL_MS)
+    {
+        heap->m_last_report_ms = cur_ms;
+
+        char buf[192];
+        heap->format_(buf, sizeof(buf));
+        LoggerService::printf_P(PSTR("Heap: %s\n"), buf);
+        heap->m_last_report_allocs = HeapService::alloc_count();
+    }
+}
+
+void HeapService::note_violation_(const char *name, uint32_t allocs)
+{
+    m_violations++;
+    if (m_last_violation != name)
+    {
+        // 同一作用域连续违规只记录一次日志, 避免刷屏
+        m_last_violation = name;
+        LoggerService::printf_P(PSTR("Heap: %lu allocation(s) in no-alloc scope %s\n"), (unsigned long)allocs, name);
+    }
+}
+
+int HeapService::format_(char *buf, size_t size) const
+{
+    uint32_t free_heap;
+    uint32_t max_block;
+    uint8_t frag;
+    ESP.getHeapStats(&free_heap, &max_block, &frag);
+
+    uint32_t allocs = HeapService::alloc_count();
+    return snprintf_P(buf, size,
+                      PSTR("free=%lu min_free=%lu max_block=%lu min_max_block=%lu frag=%u%% max_frag=%u%% "
+                           "allocs=%lu (+%lu) violations=%lu last=%s"),
+                      (unsigned long)free_heap, (unsigned long)m_min_free,
+                      (unsigned long)max_block, (unsigned long)m_min_max_block,
+                      frag, m_max_frag,
+                      (unsigned long)allocs, (unsigned long)(allocs - m_last_report_allocs),
+                      (unsigned long)m_violations, m_last_violation ? m_last_violation : "-");
+}
+
+void HeapService::handle_web_heap_()
+{
+    HeapService *heap = HeapService::get_instance();
+    ESP8266WebServer *server = LoggerService::get_instance()->web_server();
+
+    if (server->hasArg("reset"))
+    {
+        // 重新开始记录最低值及违规次数
+        heap->m_min_free = UINT32_MAX;
+        heap->m_min_max_block = UINT32_MAX;
+        heap->m_max_frag = 0;
+        heap->m_violations = 0;
+        heap->m_last_violation = nullptr;
+        heap->sample_();
+        server->send_P(200, PSTR("text/plain"), PSTR("Heap stats reset.\n"));
+        return;
+    }
+
+    char buf[192];
+    int len = heap->format_(buf, sizeof(buf));
+    if (len > 0 && len < (int)sizeof(buf) - 1)
+    {
+        buf[len++] = '\n';
+        buf[len] = '\0';
+    }
+    server->send_P(200, PSTR("text/plain"), buf);
+}
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <Arduino.h>
+
+// 编译时定义 ENABLE_HEAP_TRACE 并以 -Wl,--wrap=malloc,--wrap=realloc,--wrap=calloc 链接时统计堆分配次数,
+// 未定义时以下宏为空操作
+#ifdef ENABLE_HEAP_TRACE
+#define HEAP_NO_ALLOC_SCOPE(name) HeapService::NoAllocScope heap_no_alloc_scope_((name))
+#else
+#define HEAP_NO_ALLOC_SCOPE(name) \
+    do                            \
+    {                             \
+    } while (0)
+#endif
+
+/** 堆内存监测服务
+ *
+ * 稳态运行时各服务不应再分配堆内存, 长时间运行后堆碎片才不会增长。
+ * 定时采样空闲堆大小、最大连续空闲块及碎片率并记录最低值, 定时输出到日志, 同时通过 HTTP 接口查询。
+ * 启用堆分配跟踪时, 控制路径 (红外按键分发、电机控制周期及其停止回调) 以 HEAP_NO_ALLOC_SCOPE 标记,
+ * 作用域内发生堆分配即计为一次违规并记录作用域名称。
+ */
+class HeapService
+{
+public:
+    static constexpr int SAMPLE_INTERVAL_MS = 1000;     // 采样间隔(ms)
+    static constexpr int REPORT_INTERVAL_MS = 60000;    // 日志输出间隔(ms)
+    static constexpr const char *WEB_HEAP_PATH = "/heap";
+
+#ifdef ENABLE_HEAP_TRACE
+    /** 检查作用域内没有堆分配 */
+    class NoAllocScope
+    {
+    public:
+        NoAllocScope(const char *name) : m_name(name), m_start(HeapService::alloc_count()) {}
+        ~NoAllocScope();
+
+    private:
+        const char *m_name;
+        uint32_t m_start;
+    };
+#endif
+
+    static HeapService *get_instance()
+    {
+        static HeapService instance;
+        return &instance;
+    }
+
+    ~HeapService();
+
+    /** 注册定时采样任务及 HTTP 查询接口 (须在日志服务启动后调用) */
+    void begin();
+
+    /** 获取累计堆分配次数 (malloc/realloc/calloc), 未启用堆分配跟踪时恒为 0 */
+    static uint32_t alloc_count();
+
+protected:
+    HeapService();
+
+    static void sample_();
+    static void handle_web_heap_();
+
+    void note_violation_(const char *name, uint32_t allocs);
+    int format_(char *buf, size_t size) const;
+
+    uint32_t m_min_free;              // 最低空闲堆大小
+    uint32_t m_min_max_block;         // 最小的最大连续空闲块
+    uint8_t m_max_frag;               // 最高碎片率(%)
+    uint32_t m_last_report_allocs;    // 上次输出日志时的累计分配次数
+    unsigned long m_last_report_ms;   // 上次输出日志的时间戳
+    uint32_t m_violations;            // 控制路径上发生堆分配的次数
+    const char *m_last_violation;     // 最近一次发生堆分配的作用域名称
+};
@@ -0,0 +1,252 @@
+#include "service/history.h"
+#include "service/config.h"
+#include "service/logger.h"
+#include "service/ntp.h"
+
+#include <LittleFS.h>
+
+static const char *const STOP_REASON_NAMES[] = {"reached", "stalled", "command", "manual", "calibration"};
+
+HistoryService::HistoryService() : m_ready(false),
+                                   m_moves_header(),
+                                   m_days_header(),
+                                   m_today()
+{
+}
+
+HistoryService::~HistoryService()
+{
+}
+
+void HistoryService::begin()
+{
+    if (ConfigService::get_instance()->is_mounted())
+    {
+        m_ready = this->open_ring_(MOVES_FILE, m_moves_header, sizeof(MoveRecord), MAX_MOVES) &&
+                  this->open_ring_(DAILY_FILE, m_days_header, sizeof(DailyRecord), MAX_DAYS);
+    }
+    if (!m_ready)
+    {
+        LoggerService::println(F("Move history disabled: failed to open history files."));
+        return;
+    }
+
+    // 读取最近一天的汇总, 同一天的后续运动继续累加
+    if (m_days_header.count > 0)
+    {
+        File file = LittleFS.open(DAILY_FILE, "r");
+        if (!this->read_ring_(file, m_days_header, 0, &m_today))
+        {
+            memset(&m_today, 0, sizeof(m_today));
+        }
+        file.close();
+    }
+
+    LoggerService::get_instance()->web_server()->on(WEB_HISTORY_PATH, &HistoryService::handle_web_history_);
+    LoggerService::printf_P(PSTR("Move history: %u moves, %u days recorded\n"), m_moves_header.count, m_days_header.count);
+}
+
+void HistoryService::append(const MotorService::MoveStats &stats)
+{
+    if (!m_ready)
+    {
+        return;
+    }
+
+    NTPService *ntp = NTPService::get_instance();
+    MoveRecord rec;
+    memset(&rec, 0, sizeof(rec));
+    rec.ts = ntp->is_synced() ? (uint32_t)time(nullptr) : 0;
+    rec.start_pos = stats.start_pos;
+    rec.target_pos = stats.target_pos;
+    rec.final_pos = stats.final_pos;
+    rec.duration_ms = stats.duration_ms;
+    rec.energy = (uint32_t)(stats.pwm_integral_us / 1000);
+    rec.overshoot = (int16_t)constrain(stats.overshoot, -32768L, 32767L);
+    rec.peak_speed = (uint16_t)min(stats.peak_speed, 65535.0f);
+    rec.reason = stats.reason;
+    rec.mode = stats.mode;
+    rec.channel = stats.channel;
+    this->write_ring_(MOVES_FILE, m_moves_header, &rec, false);
+
+    // 时间未同步时无法确定日期, 不计入每日汇总
+    if (rec.ts == 0)
+    {
+        return;
+    }
+
+    uint32_t day = (rec.ts + NTPService::NTP_GMT_OFFSET) / 86400;
+    bool same_day = m_days_header.count > 0 && m_today.day == day;
+    if (!same_day)
+    {
+        memset(&m_today, 0, sizeof(m_today));
+        m_today.day = day;
+    }
+    m_today.moves++;
+    m_today.stalls += rec.reason == MotorService::STOP_STALLED ? 1 : 0;
+    m_today.travel += abs(rec.final_pos - rec.start_pos);
+    m_today.duration_ms += rec.duration_ms;
+    m_today.energy += rec.energy;
+    m_today.peak_speed_sum += rec.peak_speed;
+    m_today.max_overshoot = max(m_today.max_overshoot, rec.overshoot);
+    this->write_ring_(DAILY_FILE, m_days_header, &m_today, same_day);
+}
+
+bool HistoryService::open_ring_(const char *path, RingHeader &header, uint16_t record_size, uint16_t capacity)
+{
+    File file = LittleFS.open(path, "r");
+    if (file)
+    {
+        bool ok = file.read((uint8_t *)&header, sizeof(header)) == sizeof(header) &&
+                  header.magic == HISTORY_MAGIC && header.record_size == record_size && header.capacity == capacity &&
+                  header.head < capacity && header.count <= capacity;
+        file.close();
+        if (ok)
+        {
+            return true;
+        }
+        LoggerService::printf_P(PSTR("History file format changed, recreating: %s\n"), path);
+    }
+
+    // 创建文件并预先写满记录空间, 此后只做原地覆盖写入
+    file = LittleFS.open(path, "w");
+    if (!file)
+    {
+        return false;
+    }
+    header.magic = HISTORY_MAGIC;
+    header.record_size = record_size;
+    header.capacity = capacity;
+    header.head = 0;
+    header.count = 0;
+    file.write((const uint8_t *)&header, sizeof(header));
+
+    uint8_t zeros[128] = {};
+    size_t remaining = (size_t)record_size * capacity;
+    while (remaining > 0)
+    {
+        size_t n = min(remaining, sizeof(zeros));
+        if (file.write(zeros, n) != n)
+        {
+            file.close();
+            return false;
+        }
+        remaining -= n;
+    }
+    file.close();
+    return true;
+}
+
+bool HistoryService::write_ring_(const char *path, RingHeader &header, const void *record, bool overwrite_last)
+{
+    File file = LittleFS.open(path, "r+");
+    if (!file)
+    {
+        LoggerService::printf_P(PSTR("Failed to open history file for writing: %s\n"), path);
+        return false;
+    }
+
+    uint16_t slot = overwrite_last ? (header.head + header.capacity - 1) % header.capacity : header.head;
+    file.seek(sizeof(RingHeader) + (uint32_t)slot * header.record_size);
+    file.write((const uint8_t *)record, header.record_size);
+
+    if (!overwrite_last)
+    {
+        header.head = (header.head + 1) % header.capacity;
+        header.count = min((uint16_t)(header.count + 1), header.capacity);
+        file.seek(0);
+        file.write((const uint8_t *)&header, sizeof(header));
+    }
+    file.close();
+    return true;
+}
+
+bool HistoryService::read_ring_(File &file, const RingHeader &header, int age, void *record)
+{
+    // age 为 0 表示最新一条记录
+    if (!file || age < 0 || age >= header.count)
+    {
+        return false;
+    }
+    uint16_t slot = (header.head + header.capacity - 1 - age) % header.capacity;
+    return file.seek(sizeof(RingHeader) + (uint32_t)slot * header.record_size) &&
+           file.read((uint8_t *)record, header.record_size) == header.record_size;
+}
+
+void HistoryService::handle_web_history_()
+{
+    HistoryService *hs = HistoryService::get_instance();
+    ESP8266WebServer *server = LoggerService::get_instance()->web_server();
+
+    if (server->hasArg("days"))
+    {
+        hs->send_days_(server->arg("days").toInt());
+    }
+    else
+    {
+        hs->send_moves_(server->hasArg("moves") ? server->arg("moves").toInt() : DEF_QUERY_COUNT);
+    }
+}
+
+void HistoryService::send_moves_(int count)
+{
+    ESP8266WebServer *server = LoggerService::get_instance()->web_server();
+    server->setContentLength(CONTENT_LENGTH_UNKNOWN);
+    server->send(200, "text/csv", "");
+    server->sendContent_P(PSTR("ts,channel,start_pos,target_pos,final_pos,duration_ms,energy,overshoot,peak_speed,reason\n"));
+
+    // 从最新记录开始输出
+    File file = LittleFS.open(MOVES_FILE, "r");
+    MoveRecord rec;
+    char buf[128];
+    for (int age = 0; age < count && this->read_ring_(file, m_moves_header, age, &rec); age++)
+    {
+        const char *reason = rec.reason < sizeof(STOP_REASON_NAMES) / sizeof(STOP_REASON_NAMES[0]) ? STOP_REASON_NAMES[rec.reason] : "unknown";
+        snprintf_P(buf, sizeof(buf), PSTR("%lu,%u,%ld,%ld,%ld,%lu,%lu,%d,%u,%s\n"),
+                   (unsigned long)rec.ts, rec.channel, (long)rec.start_pos, (long)rec.target_pos, (long)rec.final_pos,
+                   (unsigned long)rec.duration_ms, (unsigned long)rec.energy, rec.overshoot, rec.peak_speed, reason);
+        server->sendContent(buf);
+    }
+    if (file)
+    {
+        file.close();
+    }
+    server->sendContent("");
+}
+
+void HistoryService::send_days_(int count)
+{
+    ESP8266WebServer *server = LoggerService::get_instance()->web_server();
+    server->setContentLength(CONTENT_LENGTH_UNKNOWN);
+    server->send(200, "text/csv", "");
+    server->sendContent_P(PSTR("date,moves,stalls,travel,avg_duration_ms,energy_per_kpulse,avg_peak_speed,max_overshoot\n"));
+
+    // 能耗按每千脉冲行程归一化, 便于比较行程不同的日期
+    File file = LittleFS.open(DAILY_FILE, "r");
+    DailyRecord rec;
+    char buf[128];
+    for (int age = 0; age < count && this->read_ring_(file, m_days_header, age, &rec); age++)
+    {
+        if (rec.moves == 0)
+        {
+            continue;
+        }
+        time_t day_ts = (time_t)rec.day * 86400;
+        struct tm day_tm;
+        gmtime_r(&day_ts, &day_tm);
+        char date[12];
+        strftime(date, sizeof(date), "%Y-%m-%d", &day_tm);
+
+        snprintf_P(buf, sizeof(buf), PSTR("%s,%u,%u,%lu,%lu,%lu,%lu,%d\n"),
+                   date, rec.moves, rec.stalls, (unsigned long)rec.travel,
+                   (unsigned long)(rec.duration_ms / rec.moves),
+                   (unsigned long)(rec.travel > 0 ? (uint64_t)rec.energy * 1000 / rec.travel : 0),
+                   (unsigned long)(rec.peak_speed_sum / rec.moves), rec.max_overshoot);
+        server->sendContent(buf);
+    }
+    if (file)
+    {
+        file.close();
+    }
+    server->sendContent("");
+}
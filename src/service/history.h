@@ -0,0 +1,94 @@
+#pragma once
+
+#include "service/motor.h"
+
+#include <Arduino.h>
+#include <LittleFS.h>
+
+/** 电机运动历史统计服务
+ *
+ * 每次运动结束时将精简记录追加到文件系统中固定大小的循环文件, 同时累加当天的汇总数据,
+ * 用于观察长期运行趋势 (如减速箱磨损导致运动变慢、能耗升高、堵转增多)。
+ * 每日汇总不区分电机通道。两个循环文件均以文件头记录写入位置, 单条记录原地覆盖写入, 文件大小不随时间增长。
+ */
+class HistoryService
+{
+public:
+    static constexpr const char *MOVES_FILE = "/history.bin";      // 单次运动记录循环文件
+    static constexpr const char *DAILY_FILE = "/history_day.bin";  // 每日汇总循环文件
+    static constexpr int MAX_MOVES = 512;                           // 保留的运动记录数
+    static constexpr int MAX_DAYS = 366;                            // 保留的每日汇总天数
+    static constexpr uint32_t HISTORY_MAGIC = 0x54534843;           // "CHST"
+    static constexpr const char *WEB_HISTORY_PATH = "/history";     // ?moves=<N> 最近 N 次运动, ?days=<N> 最近 N 天汇总
+    static constexpr int DEF_QUERY_COUNT = 50;                      // 查询默认返回条数
+
+    /** 单次运动记录 */
+    struct MoveRecord
+    {
+        uint32_t ts;          // 停止时刻 UTC 时间戳(s), 时间未同步时为 0
+        int32_t start_pos;    // 起始位置
+        int32_t target_pos;   // 目标位置
+        int32_t final_pos;    // 停止位置
+        uint32_t duration_ms; // 运动时长
+        uint32_t energy;      // |PWM| 对时间的积分 (PWM*ms)
+        int16_t overshoot;    // 超调量
+        uint16_t peak_speed;  // 最大速度(pulse/s)
+        uint8_t reason;       // 停止原因, 见 MotorService::StopReason
+        uint8_t mode;         // 运动方式, 见 MotorService::MoveMode
+        uint8_t channel;      // 电机通道号
+        uint8_t reserved;
+    };
+
+    /** 每日汇总 */
+    struct DailyRecord
+    {
+        uint32_t day;            // 本地日期 (自 1970-01-01 起的天数)
+        uint16_t moves;          // 运动次数
+        uint16_t stalls;         // 堵转次数
+        uint32_t travel;         // 总行程(编码脉冲数)
+        uint32_t duration_ms;    // 总运动时长
+        uint32_t energy;         // 总能耗 (PWM*ms)
+        uint32_t peak_speed_sum; // 最大速度之和, 除以运动次数即为平均最大速度
+        int16_t max_overshoot;   // 最大超调量
+        uint16_t reserved;
+    };
+
+    static HistoryService *get_instance()
+    {
+        static HistoryService instance;
+        return &instance;
+    }
+
+    ~HistoryService();
+
+    /** 打开或创建循环文件并注册 HTTP 查询接口 (须在配置服务及日志服务启动后调用) */
+    void begin();
+
+    /** 追加一次运动记录并更新当日汇总 */
+    void append(const MotorService::MoveStats &stats);
+
+protected:
+    HistoryService();
+
+    struct RingHeader
+    {
+        uint32_t magic;
+        uint16_t record_size; // 记录大小, 格式变化时重建文件
+        uint16_t capacity;    // 最大记录数
+        uint16_t head;        // 下一条记录的写入位置
+        uint16_t count;       // 已写入记录数
+    };
+
+    static void handle_web_history_();
+
+    bool open_ring_(const char *path, RingHeader &header, uint16_t record_size, uint16_t capacity);
+    bool write_ring_(const char *path, RingHeader &header, const void *record, bool overwrite_last);
+    bool read_ring_(File &file, const RingHeader &header, int age, void *record);
+    void send_moves_(int count);
+    void send_days_(int count);
+
+    bool m_ready;
+    RingHeader m_moves_header;
+    RingHeader m_days_header;
+    DailyRecord m_today; // 最近一天的汇总
+};
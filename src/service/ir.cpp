@@ -1,5 +1,9 @@
 #include "service/ir.h"
 #include "service/logger.h"
+#include "service/scheduler.h"
+#include "service/heap.h"
+#include "service/trace.h"
+#include "service/recorder.h"
 
 #include <Arduino.h>
 // 不使用 LED_BUILTIN 反馈接收数据
@@ -7,42 +11,71 @@
 #define NO_LED_FEEDBACK_CODE
 #include <TinyIRReceiver.hpp>
 
-IRService *IRService::m_instance = nullptr;
-
 IRService::IRService()
-    : m_last_key(KEY_UNKNOWN), m_last_key_ms(0), m_debounce_ms(DEFAULT_DEBOUNCE_TIME_MS), m_last_poll_ms(0), m_anykey_handler(nullptr)
+    : m_last_key(KEY_UNKNOWN), m_last_key_ms(0), m_debounce_ms(DEFAULT_DEBOUNCE_TIME_MS),
+      m_key_handlers(), m_key_handler_count(0), m_anykey_handler(nullptr),
+      m_frames(0), m_dropped_frames(0)
 {
+#ifdef IR_RECEIVE_PWR
     pinMode(IR_RECEIVE_PWR, OUTPUT);
     digitalWrite(IR_RECEIVE_PWR, LOW);
+#endif
 }
 
 IRService::~IRService()
 {
+#ifdef IR_RECEIVE_PWR
     digitalWrite(IR_RECEIVE_PWR, LOW); // 关闭红外接收模块
-
-    delete m_instance;
+#endif
 }
 
 void IRService::begin()
 {
+#ifdef IR_RECEIVE_PWR
     digitalWrite(IR_RECEIVE_PWR, HIGH); // 使能红外接收模块
+#endif
 
     // 初始化红外接收模块
     if (!initPCIInterruptForTinyReceiver())
     {
-        LoggerService::printf("No interrupt available for pin %d\n", IR_RECEIVE_PIN);
+        LoggerService::printf_P(PSTR("No interrupt available for pin %d\n"), IR_RECEIVE_PIN);
     }
-    LoggerService::printf("Ready to receive NEC IR signals at pin %d\n", IR_RECEIVE_PIN);
+    LoggerService::printf_P(PSTR("Ready to receive NEC IR signals at pin %d\n"), IR_RECEIVE_PIN);
+
+    // 注册红外数据轮询任务
+    SchedulerService::get_instance()->add_periodic(
+        "ir",
+        []()
+        {
+            IRService::get_instance()->update();
+        },
+        POLL_INTERVAL_MS * 1000UL, SchedulerService::PRIO_INPUT);
 }
 
-void IRService::update()
+void IRService::on_key(IRKey key, const key_handler_t callback)
 {
-    unsigned long cur_ms = millis();
-    if (cur_ms - m_last_poll_ms > POLL_INTERVAL_MS)
+    // 已注册的按键直接替换处理函数
+    for (int i = 0; i < m_key_handler_count; i++)
+    {
+        if (m_key_handlers[i].key == key)
+        {
+            m_key_handlers[i].handler = callback;
+            return;
+        }
+    }
+    if (m_key_handler_count >= MAX_KEY_HANDLERS)
     {
-        m_last_poll_ms = cur_ms;
-        this->_poll();
+        LoggerService::printf_P(PSTR("IR: no free slot for key 0x%02X\n"), key);
+        return;
     }
+    m_key_handlers[m_key_handler_count].key = key;
+    m_key_handlers[m_key_handler_count].handler = callback;
+    m_key_handler_count++;
+}
+
+void IRService::update()
+{
+    this->_poll();
 }
 
 void IRService::_poll()
@@ -50,6 +83,8 @@ void IRService::_poll()
     if (TinyIRReceiverData.justWritten)
     {
         TinyIRReceiverData.justWritten = false;
+        m_frames++;
+        RECORD_IR(TinyIRReceiverData.Address, TinyIRReceiverData.Command, TinyIRReceiverData.Flags);
 
         if (TinyIRReceiverData.Flags != IRDATA_FLAGS_PARITY_FAILED)
         {
@@ -58,27 +93,52 @@ void IRService::_poll()
             if (millis() > m_last_key_ms + m_debounce_ms)
             {
                 m_last_key_ms = millis();
+                TraceService::get_instance()->receive(TraceService::SOURCE_IR, micros());
+                this->dispatch_(TinyIRReceiverData.Command, TinyIRReceiverData.Flags);
+            }
+            else
+            {
+                // 去抖时间内的帧
+                m_dropped_frames++;
+            }
+        }
+        else
+        {
+            // 校验失败的帧
+            m_dropped_frames++;
+        }
+    }
+}
 
-                IRKey key = (IRKey)TinyIRReceiverData.Command;
-                if (TinyIRReceiverData.Flags == IRDATA_FLAGS_IS_REPEAT)
-                {
-                    key = m_last_key;
-                }
-                else
-                {
-                    m_last_key = key;
-                }
+void IRService::dispatch_(uint8_t command, uint8_t flags)
+{
+    IRKey key = (IRKey)command;
+    if (flags == IRDATA_FLAGS_IS_REPEAT)
+    {
+        key = m_last_key;
+    }
+    else
+    {
+        m_last_key = key;
+    }
 
-                // 根据遥控器按键执行对应动作
-                if (key_handlers.find(key) != key_handlers.end())
-                {
-                    key_handlers[key]();
-                }
-                else if (m_anykey_handler)
-                {
-                    m_anykey_handler(key);
-                }
-            }
+    // 根据遥控器按键执行对应动作, 按键处理属于控制路径, 不应分配堆内存
+    HEAP_NO_ALLOC_SCOPE("ir");
+    key_handler_t handler = nullptr;
+    for (int i = 0; i < m_key_handler_count; i++)
+    {
+        if (m_key_handlers[i].key == key)
+        {
+            handler = m_key_handlers[i].handler;
+            break;
         }
     }
-}
\ No newline at end of file
+    if (handler != nullptr)
+    {
+        handler();
+    }
+    else if (m_anykey_handler != nullptr)
+    {
+        m_anykey_handler(key);
+    }
+}
@@ -2,8 +2,7 @@
 
 #include "config/pins.h"
 
-#include <map>
-#include <functional>
+#include <Arduino.h>
 
 // 通用 17 键红外遥控器按键编码
 typedef enum
@@ -36,17 +35,15 @@ class IRService
 public:
     static constexpr int DEFAULT_DEBOUNCE_TIME_MS = 100;
     static constexpr int POLL_INTERVAL_MS = 10;
+    static constexpr int MAX_KEY_HANDLERS = 17; // 按键事件处理函数数量上限, 等于遥控器按键数
 
-    using key_handler_t = std::function<void()>;
-    using anykey_handler_t = std::function<void(IRKey)>;
+    using key_handler_t = void (*)();
+    using anykey_handler_t = void (*)(IRKey);
 
     static IRService *get_instance()
     {
-        if (m_instance == nullptr)
-        {
-            m_instance = new IRService();
-        }
-        return m_instance;
+        static IRService instance;
+        return &instance;
     }
 
     ~IRService();
@@ -59,12 +56,12 @@ public:
 
     /** 注册按键事件对应的处理函数 */
     void on_anykey(const anykey_handler_t callback) { m_anykey_handler = callback; }
-    void on_key(IRKey key, const key_handler_t callback) { key_handlers[key] = callback; }
+    void on_key(IRKey key, const key_handler_t callback);
 
     /** 清除所有注册的按键事件处理函数 */
     void clear_key_handlers()
     {
-        key_handlers.clear();
+        m_key_handler_count = 0;
     }
     void clear_anykey_handler()
     {
@@ -74,17 +71,31 @@ public:
     /** 设置按键事件去抖时间 */
     void set_debounce_time(unsigned int time_ms) { m_debounce_ms = time_ms; }
 
+    /** 获取累计接收的红外帧数 */
+    uint32_t get_frame_count() const { return m_frames; }
+    /** 获取累计丢弃的红外帧数 (校验失败或在去抖时间内) */
+    uint32_t get_dropped_frame_count() const { return m_dropped_frames; }
+
 protected:
     IRService();
     void _poll();
+    /** 按键分发: 处理重复帧并调用按键对应的处理函数, 没有时调用任意按键处理函数 */
+    void dispatch_(uint8_t command, uint8_t flags);
+
+    IRKey m_last_key;            // 上次按键码
+    unsigned long m_last_key_ms; // 上次按键事件时间
+    unsigned int m_debounce_ms;  // 按键去抖时间
 
-    IRKey m_last_key;             // 上次按键码
-    unsigned long m_last_key_ms;  // 上次按键事件时间
-    unsigned int m_debounce_ms;   // 按键去抖时间
-    unsigned long m_last_poll_ms; // 上次轮询数据时间
+    struct KeyHandler
+    {
+        IRKey key;
+        key_handler_t handler;
+    };
 
-    std::map<IRKey, key_handler_t> key_handlers; // 按键事件处理函数
+    KeyHandler m_key_handlers[MAX_KEY_HANDLERS]; // 按键事件处理函数
+    int m_key_handler_count;
     anykey_handler_t m_anykey_handler;           // 任意按键事件处理函数
+    uint32_t m_frames;                           // 累计接收的红外帧数
+    uint32_t m_dropped_frames;                   // 累计丢弃的红外帧数
 
-    static IRService *m_instance;
 };
@@ -1,53 +1,127 @@
 #include "service/logger.h"
+#include "service/scheduler.h"
 
-LoggerService *LoggerService::m_instance = nullptr;
-
-LoggerService::LoggerService() : m_log_buf(""), m_log_server(nullptr)
+LoggerService::LoggerService() : m_log_buf(), m_log_head(0), m_log_len(0), m_log_server(WEB_LOG_PORT)
 {
 }
 
 LoggerService::~LoggerService()
 {
-    delete m_log_server;
 }
 
 void handle_web_log()
 {
     auto logger = LoggerService::get_instance();
-    logger->m_log_server->send(200, "text/plain", logger->m_log_buf);
+    ESP8266WebServer *server = &logger->m_log_server;
+
+    // 缓冲区已回绕时从最早一条完整日志开始发送
+    size_t start = (logger->m_log_head + LoggerService::LOG_BUF_SIZE - logger->m_log_len) % LoggerService::LOG_BUF_SIZE;
+    size_t len = logger->m_log_len;
+    if (len == LoggerService::LOG_BUF_SIZE)
+    {
+        while (len > 0 && logger->m_log_buf[start] != '\n')
+        {
+            start = (start + 1) % LoggerService::LOG_BUF_SIZE;
+            len--;
+        }
+    }
+
+    // 按环形缓冲区的两段分块发送, 不复制到临时缓冲区
+    size_t first = min(len, LoggerService::LOG_BUF_SIZE - start);
+    server->setContentLength(len);
+    server->send(200, "text/plain", "");
+    server->sendContent(logger->m_log_buf + start, first);
+    if (len > first)
+    {
+        server->sendContent(logger->m_log_buf, len - first);
+    }
 }
 
 void LoggerService::begin()
 {
-    m_log_server = new ESP8266WebServer(WEB_LOG_PORT);
-    m_log_server->on("/", handle_web_log);
-    m_log_server->begin();
-    LoggerService::printf("HTTP server started on port %d.\n", WEB_LOG_PORT);
+    m_log_server.on("/", handle_web_log);
+    m_log_server.begin();
+    LoggerService::printf_P(PSTR("HTTP server started on port %d.\n"), WEB_LOG_PORT);
+
+    // 注册 HTTP 请求处理任务
+    SchedulerService::get_instance()->add_periodic(
+        "logger",
+        []()
+        {
+            LoggerService::get_instance()->update();
+        },
+        WEB_POLL_INTERVAL_MS * 1000UL, SchedulerService::PRIO_NETWORK);
 }
 
 void LoggerService::update()
 {
-    m_log_server->handleClient();
+    m_log_server.handleClient();
+}
+
+void LoggerService::append_(const char *data, size_t len)
+{
+    // 超过缓冲区大小的内容只保留末尾部分
+    if (len > LOG_BUF_SIZE)
+    {
+        data += len - LOG_BUF_SIZE;
+        len = LOG_BUF_SIZE;
+    }
+
+    size_t first = min(len, LOG_BUF_SIZE - m_log_head);
+    memcpy(m_log_buf + m_log_head, data, first);
+    memcpy(m_log_buf, data + first, len - first);
+    m_log_head = (m_log_head + len) % LOG_BUF_SIZE;
+    m_log_len = min(m_log_len + len, (size_t)LOG_BUF_SIZE);
 }
 
-String LoggerService::get_cur_ts_str_()
+void LoggerService::log_prefix_()
 {
     time_t cur_ts = time(nullptr);
     struct tm *timeinfo = localtime(&cur_ts);
     char buf[32];
-    strftime(buf, sizeof(buf), "%Y-%m-%d %H:%M:%S", timeinfo);
-    return String(buf);
+    size_t len = strftime(buf + 1, sizeof(buf) - 3, "%Y-%m-%d %H:%M:%S", timeinfo);
+    buf[0] = '[';
+    buf[len + 1] = ']';
+    buf[len + 2] = ' ';
+    this->append_(buf, len + 3);
 }
 
 void LoggerService::log(const String &msg, bool eol)
 {
-    String eol_mark = eol ? "\n" : "";
-    m_log_buf += "[" + get_cur_ts_str_() + "] " + msg + eol_mark;
+    this->log_prefix_();
+    this->append_(msg.c_str(), msg.length());
+    Serial.print(msg);
+    if (eol)
+    {
+        this->append_('\n');
+        Serial.print('\n');
+    }
+}
 
-    if (m_log_buf.length() > LOG_BUF_SIZE)
+void LoggerService::log(const __FlashStringHelper *msg, bool eol)
+{
+    // 直接从 Flash 分块读取, 不构造临时 String
+    this->log_prefix_();
+    PGM_P p = (PGM_P)msg;
+    char chunk[32];
+    size_t n;
+    while ((n = strnlen_P(p, sizeof(chunk))) > 0)
+    {
+        memcpy_P(chunk, p, n);
+        this->append_(chunk, n);
+        p += n;
+    }
+    Serial.print(msg);
+    if (eol)
     {
-        m_log_buf = m_log_buf.substring(m_log_buf.length() - LOG_BUF_SIZE / 2);
+        this->append_('\n');
+        Serial.print('\n');
     }
+}
 
-    Serial.print(msg + eol_mark);
+void LoggerService::log_raw_(const char *msg)
+{
+    this->log_prefix_();
+    this->append_(msg, strlen(msg));
+    Serial.print(msg);
 }
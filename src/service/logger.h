@@ -4,19 +4,25 @@
 #include <StreamString.h>
 #include <ESP8266WebServer.h>
 
+/** 日志服务
+ *
+ * 日志同时输出到串口和固定大小的内存环形缓冲区, 缓冲区写满后覆盖最早的日志, 内容可通过 HTTP 查看。
+ * 写日志不分配堆内存。
+ * 常量日志文本应放在 Flash 中: 固定文本用 println(F("...")), 格式化输出用 printf_P(PSTR("..."), ...),
+ * Flash 字符串直接追加到缓冲区, 不经过临时 String。
+ */
 class LoggerService
 {
 public:
     static constexpr int LOG_BUF_SIZE = 4096;
+    static constexpr int PRINTF_BUF_SIZE = 256; // 单条格式化日志最大长度
     static constexpr int WEB_LOG_PORT = 8080;
+    static constexpr int WEB_POLL_INTERVAL_MS = 10; // HTTP 请求处理间隔(ms)
 
     static LoggerService *get_instance()
     {
-        if (m_instance == nullptr)
-        {
-            m_instance = new LoggerService();
-        }
-        return m_instance;
+        static LoggerService instance;
+        return &instance;
     }
 
     ~LoggerService();
@@ -26,6 +32,11 @@ public:
         LoggerService::get_instance()->log(msg);
     }
 
+    static void println(const __FlashStringHelper *msg)
+    {
+        LoggerService::get_instance()->log(msg);
+    }
+
     static void println(const Printable &x)
     {
         StreamString ss;
@@ -43,6 +54,11 @@ public:
         LoggerService::get_instance()->log(msg, false);
     }
 
+    static void print(const __FlashStringHelper *msg)
+    {
+        LoggerService::get_instance()->log(msg, false);
+    }
+
     static void print(const Printable &x)
     {
         StreamString ss;
@@ -54,26 +70,45 @@ public:
     {
         va_list args;
         va_start(args, format);
-        char buf[2048];
+        char buf[PRINTF_BUF_SIZE];
         vsnprintf(buf, sizeof(buf), format, args);
         va_end(args);
-        LoggerService::get_instance()->log(buf, false);
+        LoggerService::get_instance()->log_raw_(buf);
+    }
+
+    /** 格式化输出, 格式字符串位于 Flash (PSTR) */
+    static void printf_P(PGM_P format, ...)
+    {
+        va_list args;
+        va_start(args, format);
+        char buf[PRINTF_BUF_SIZE];
+        vsnprintf_P(buf, sizeof(buf), format, args);
+        va_end(args);
+        LoggerService::get_instance()->log_raw_(buf);
     }
 
     void begin();
     void update();
     void log(const String &msg, bool eol = true);
-    String get_log_buf() const { return m_log_buf; }
+    void log(const __FlashStringHelper *msg, bool eol = true);
+    /** 获取日志 HTTP 服务, 供其他服务注册请求处理函数 */
+    ESP8266WebServer *web_server() { return &m_log_server; }
 
 protected:
     friend void handle_web_log();
 
     LoggerService();
 
-    String get_cur_ts_str_();
-
-    static LoggerService *m_instance;
-
-    String m_log_buf;
-    ESP8266WebServer *m_log_server;
+    /** 追加时间戳前缀 */
+    void log_prefix_();
+    /** 追加不带换行的 RAM 字符串 */
+    void log_raw_(const char *msg);
+    /** 向环形缓冲区追加数据 */
+    void append_(const char *data, size_t len);
+    void append_(char c) { this->append_(&c, 1); }
+
+    char m_log_buf[LOG_BUF_SIZE]; // 日志环形缓冲区
+    size_t m_log_head;            // 下一个写入位置
+    size_t m_log_len;             // 已写入的字节数
+    ESP8266WebServer m_log_server;
 };
@@ -0,0 +1,211 @@
+#include "config/pins.h"
+#include "service/metrics.h"
+#include "service/logger.h"
+#include "service/scheduler.h"
+#include "service/motor.h"
+#include "service/ir.h"
+#include "service/heap.h"
+#include "application.h"
+
+#include <ESP8266WiFi.h>
+
+/** Prometheus 文本格式输出缓冲区, 满时作为一个 HTTP 分块发送 */
+class MetricsWriter
+{
+public:
+    MetricsWriter(ESP8266WebServer *server) : m_server(server), m_len(0) {}
+
+    /** 输出指标的 HELP 及 TYPE 说明行, 各参数均为 Flash 字符串 */
+    void header(PGM_P name, PGM_P type, PGM_P help)
+    {
+        this->append_P(PSTR("# HELP "));
+        this->append_name_(name);
+        this->append_P(PSTR(" "));
+        this->append_P(help);
+        this->append_P(PSTR("\n# TYPE "));
+        this->append_name_(name);
+        this->append_P(PSTR(" "));
+        this->append_P(type);
+        this->append_P(PSTR("\n"));
+    }
+
+    /** 输出一个指标样本, labels 为 {} 中的标签内容, 可为 nullptr */
+    void sample(PGM_P name, const char *labels, uint32_t value)
+    {
+        char buf[16];
+        snprintf_P(buf, sizeof(buf), PSTR(" %lu\n"), (unsigned long)value);
+        this->sample_(name, labels, buf);
+    }
+
+    void sample(PGM_P name, const char *labels, int32_t value)
+    {
+        char buf[16];
+        snprintf_P(buf, sizeof(buf), PSTR(" %ld\n"), (long)value);
+        this->sample_(name, labels, buf);
+    }
+
+    void append_P(PGM_P str)
+    {
+        this->append_(str, strlen_P(str), true);
+    }
+
+    void append(const char *str)
+    {
+        this->append_(str, strlen(str), false);
+    }
+
+    void flush()
+    {
+        if (m_len > 0)
+        {
+            m_server->sendContent(m_buf, m_len);
+            m_len = 0;
+        }
+    }
+
+private:
+    void append_name_(PGM_P name)
+    {
+        this->append_P(PSTR("chaosblinds_"));
+        this->append_P(name);
+    }
+
+    void sample_(PGM_P name, const char *labels, const char *value)
+    {
+        this->append_name_(name);
+        if (labels != nullptr)
+        {
+            this->append_P(PSTR("{"));
+            this->append(labels);
+            this->append_P(PSTR("}"));
+        }
+        this->append(value);
+    }
+
+    void append_(const char *str, size_t len, bool progmem)
+    {
+        while (len > 0)
+        {
+            if (m_len == sizeof(m_buf))
+            {
+                this->flush();
+            }
+            size_t n = min(len, sizeof(m_buf) - m_len);
+            if (progmem)
+            {
+                memcpy_P(m_buf + m_len, str, n);
+            }
+            else
+            {
+                memcpy(m_buf + m_len, str, n);
+            }
+            m_len += n;
+            str += n;
+            len -= n;
+        }
+    }
+
+    ESP8266WebServer *m_server;
+    char m_buf[MetricsService::CHUNK_SIZE];
+    size_t m_len;
+};
+
+/** 输出各电机通道的同一累计计数 */
+static void write_motor_counter(MetricsWriter &writer, PGM_P name, PGM_P help, uint32_t MotorService::Counters::*field)
+{
+    writer.header(name, PSTR("counter"), help);
+    for (int ch = 0; ch < MOTOR_CHANNELS; ch++)
+    {
+        char labels[16];
+        snprintf_P(labels, sizeof(labels), PSTR("channel=\"%d\""), ch);
+        writer.sample(name, labels, MotorService::get_instance(ch)->get_counters().*field);
+    }
+}
+
+MetricsService::MetricsService()
+{
+}
+
+MetricsService::~MetricsService()
+{
+}
+
+void MetricsService::begin()
+{
+    LoggerService::get_instance()->web_server()->on(WEB_METRICS_PATH, &MetricsService::handle_web_metrics_);
+}
+
+void MetricsService::handle_web_metrics_()
+{
+    ESP8266WebServer *server = LoggerService::get_instance()->web_server();
+    server->setContentLength(CONTENT_LENGTH_UNKNOWN);
+    server->send_P(200, PSTR("text/plain; version=0.0.4"), PSTR(""));
+
+    MetricsWriter writer(server);
+    char labels[48];
+
+    // 系统
+    writer.header(PSTR("uptime_seconds"), PSTR("gauge"), PSTR("Seconds since boot."));
+    writer.sample(PSTR("uptime_seconds"), nullptr, (uint32_t)(micros64() / 1000000));
+
+    writer.header(PSTR("reset_reason_info"), PSTR("gauge"), PSTR("Reason of the last reset."));
+    snprintf_P(labels, sizeof(labels), PSTR("reason=\"%s\""), ESP.getResetReason().c_str());
+    writer.sample(PSTR("reset_reason_info"), labels, (uint32_t)1);
+
+    // 电机
+    write_motor_counter(writer, PSTR("motor_moves_total"), PSTR("Completed motor moves."), &MotorService::Counters::moves);
+    write_motor_counter(writer, PSTR("motor_stalls_total"), PSTR("Moves stopped short of the target."), &MotorService::Counters::stalls);
+    write_motor_counter(writer, PSTR("motor_travel_pulses_total"), PSTR("Encoder pulses travelled."), &MotorService::Counters::travel_pulses);
+
+    writer.header(PSTR("encoder_errors_total"), PSTR("counter"), PSTR("Invalid encoder transitions (missed edges)."));
+    for (int ch = 0; ch < MOTOR_CHANNELS; ch++)
+    {
+        snprintf_P(labels, sizeof(labels), PSTR("channel=\"%d\""), ch);
+        writer.sample(PSTR("encoder_errors_total"), labels, MotorService::get_instance(ch)->get_encoder_stats().errors);
+    }
+
+    // 红外遥控
+    IRService *ir = IRService::get_instance();
+    writer.header(PSTR("ir_frames_total"), PSTR("counter"), PSTR("IR frames received."));
+    writer.sample(PSTR("ir_frames_total"), nullptr, ir->get_frame_count());
+    writer.header(PSTR("ir_frames_dropped_total"), PSTR("counter"), PSTR("IR frames dropped by parity check or debounce."));
+    writer.sample(PSTR("ir_frames_dropped_total"), nullptr, ir->get_dropped_frame_count());
+
+    // 网络
+    Application *app = Application::get_instance();
+    writer.header(PSTR("mqtt_connected"), PSTR("gauge"), PSTR("Whether the MQTT connection is up."));
+    writer.sample(PSTR("mqtt_connected"), nullptr, (uint32_t)app->is_mqtt_connected());
+    writer.header(PSTR("mqtt_reconnects_total"), PSTR("counter"), PSTR("Successful MQTT reconnects."));
+    writer.sample(PSTR("mqtt_reconnects_total"), nullptr, app->get_mqtt_reconnects());
+    if (WiFi.status() == WL_CONNECTED)
+    {
+        writer.header(PSTR("wifi_rssi_dbm"), PSTR("gauge"), PSTR("WiFi signal strength."));
+        writer.sample(PSTR("wifi_rssi_dbm"), nullptr, (int32_t)WiFi.RSSI());
+    }
+
+    // 主循环
+    SchedulerService *scheduler = SchedulerService::get_instance();
+    writer.header(PSTR("loop_passes_total"), PSTR("counter"), PSTR("Main loop passes."));
+    writer.sample(PSTR("loop_passes_total"), nullptr, scheduler->get_loop_count());
+    writer.header(PSTR("loop_passes_per_second"), PSTR("gauge"), PSTR("Main loop passes per second over the last statistics period."));
+    writer.sample(PSTR("loop_passes_per_second"), nullptr, scheduler->get_loop_rate());
+    writer.header(PSTR("loop_max_pass_us"), PSTR("gauge"), PSTR("Longest main loop pass excluding idle time over the last statistics period."));
+    writer.sample(PSTR("loop_max_pass_us"), nullptr, scheduler->get_max_pass_us());
+
+    // 堆内存
+    uint32_t free_heap;
+    uint32_t max_block;
+    uint8_t frag;
+    ESP.getHeapStats(&free_heap, &max_block, &frag);
+    writer.header(PSTR("heap_free_bytes"), PSTR("gauge"), PSTR("Free heap."));
+    writer.sample(PSTR("heap_free_bytes"), nullptr, free_heap);
+    writer.header(PSTR("heap_max_block_bytes"), PSTR("gauge"), PSTR("Largest free heap block."));
+    writer.sample(PSTR("heap_max_block_bytes"), nullptr, max_block);
+    writer.header(PSTR("heap_fragmentation_percent"), PSTR("gauge"), PSTR("Heap fragmentation."));
+    writer.sample(PSTR("heap_fragmentation_percent"), nullptr, (uint32_t)frag);
+    writer.header(PSTR("heap_allocations_total"), PSTR("counter"), PSTR("Heap allocations, 0 unless built with ENABLE_HEAP_TRACE."));
+    writer.sample(PSTR("heap_allocations_total"), nullptr, HeapService::alloc_count());
+
+    writer.flush();
+    server->sendContent("");
+}
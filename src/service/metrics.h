@@ -0,0 +1,32 @@
+#pragma once
+
+#include <Arduino.h>
+
+/** Prometheus 指标导出服务
+ *
+ * 在日志 HTTP 服务上提供 /metrics 接口, 以 Prometheus 文本格式输出各服务的计数器和状态量。
+ * 计数器由各服务在运行路径上以整数自增维护, 本服务只在请求时读取,
+ * 输出内容逐条写入栈上的固定大小缓冲区, 缓冲区满时作为一个 HTTP 分块发送, 不构造完整的响应字符串。
+ */
+class MetricsService
+{
+public:
+    static constexpr const char *WEB_METRICS_PATH = "/metrics";
+    static constexpr int CHUNK_SIZE = 512; // HTTP 分块缓冲区大小
+
+    static MetricsService *get_instance()
+    {
+        static MetricsService instance;
+        return &instance;
+    }
+
+    ~MetricsService();
+
+    /** 注册 HTTP 指标接口 (须在日志服务启动后调用) */
+    void begin();
+
+protected:
+    MetricsService();
+
+    static void handle_web_metrics_();
+};
@@ -2,176 +2,451 @@
 #include "utility/misc.h"
 #include "service/motor.h"
 #include "service/logger.h"
-
-MotorService *MotorService::m_instance = nullptr;
-
-MotorService::MotorService() : m_encoder(ENCODER_A_PIN, ENCODER_B_PIN),
-                               m_reverse_dir(false),
-                               m_last_pos_pulse(0),
-                               m_last_speed_pulse(0.0),
-                               m_last_enc_read_ms(0),
-                               m_pid(&m_pid_input, &m_pid_output, &m_pid_setpoint, PID_DEF_KP, PID_DEF_KI, PID_DEF_KD, DIRECT),
-                               m_pid_input(0.0),
-                               m_pid_output(0.0),
-                               m_pid_setpoint(0.0),
-                               m_pid_target_set_ms(0),
-                               m_pid_last_report_ms(0),
-                               m_motor_reached_stable(true),
-                               m_good_sample_count(0),
-                               m_stable_last_ms(0),
-                               m_stable_last_pos(0)
+#include "service/scheduler.h"
+#include "service/capture.h"
+#include "service/heap.h"
+#include "service/trace.h"
+#include "service/recorder.h"
+
+#include <new>
+
+const MotorService::MotorPins MotorService::PIN_PROFILES[MOTOR_CHANNELS] = {
+    {DRV_EEP_PIN, DRV_IN1_PIN, DRV_IN2_PIN, ENCODER_A_PIN, ENCODER_B_PIN},
+#if MOTOR_CHANNELS > 1
+    {DRV_EEP_PIN, DRV_IN3_PIN, DRV_IN4_PIN, ENCODER2_A_PIN, ENCODER2_B_PIN},
+#endif
+};
+
+const MotorService::TuningParam MotorService::TUNING_PARAMS[TUNING_PARAM_COUNT] = {
+    {"kp", 0.0f, 50.0f, 0.01f, &Tuning::kp},
+    {"ki", 0.0f, 50.0f, 0.01f, &Tuning::ki},
+    {"kd", 0.0f, 10.0f, 0.001f, &Tuning::kd},
+    {"pid_sample_ms", 1.0f, 100.0f, 1.0f, &Tuning::pid_sample_ms},
+    {"stable_sample_ms", 10.0f, 1000.0f, 1.0f, &Tuning::stable_sample_ms},
+    {"stable_n_sample", 1.0f, 200.0f, 1.0f, &Tuning::stable_n_sample},
+    {"speed_cutoff_hz", 0.1f, 50.0f, 0.1f, &Tuning::speed_cutoff_hz}, // 上限保证滤波时间常数 (约 3ms) 大于控制周期
+    {"rel_err_tol", 0.0f, 0.2f, 0.001f, &Tuning::rel_err_tol},
+    {"abs_err_tol", 0.0f, 1000.0f, 1.0f, &Tuning::abs_err_tol},
+};
+
+MotorService *MotorService::m_channels[MOTOR_CHANNELS] = {};
+int MotorService::m_tick_task = -1;
+unsigned long MotorService::m_tick_max_us = 0;
+
+MotorService::MotorService(uint8_t channel, const MotorPins &pins) : m_channel(channel),
+                                                                     m_plot_suffix(),
+                                                                     m_driver(pins.drv_sleep, pins.drv_in_a, pins.drv_in_b, PWM_RANGE),
+                                                                     m_encoder(pins.enc_a, pins.enc_b),
+                                                                     m_encoder_errors(0),
+                                                                     m_encoder_check_ms(0),
+                                                                     m_reverse_dir(false),
+                                                                     m_last_pos_pulse(0),
+                                                                     m_last_speed_pulse(0.0),
+                                                                     m_last_enc_read_us(0),
+                                                                     m_last_pwm(0),
+                                                                     m_tuning(MotorService::default_tuning()),
+                                                                     m_next_tuning(m_tuning),
+                                                                     m_tuning_pending(false),
+                                                                     m_pid(&m_pid_input, &m_pid_output, &m_pid_setpoint, PID_DEF_KP, PID_DEF_KI, PID_DEF_KD, DIRECT),
+                                                                     m_pid_input(0.0),
+                                                                     m_pid_output(0.0),
+                                                                     m_pid_setpoint(0.0),
+                                                                     m_pid_target_set_ms(0),
+                                                                     m_pid_last_report_ms(0),
+                                                                     m_motor_reached_stable(true),
+                                                                     m_good_sample_count(0),
+                                                                     m_stable_last_ms(0),
+                                                                     m_stable_last_pos(0),
+                                                                     m_backlash_pulse(0),
+                                                                     m_backlash_slack(0),
+                                                                     m_backlash_last_pos(0),
+                                                                     m_last_dir(0),
+                                                                     m_backlash_cal_dir(0),
+                                                                     m_backlash_cal_start(0),
+                                                                     m_backlash_cal_start_ms(0),
+                                                                     m_backlash_cal_peak_speed(0),
+                                                                     m_backlash_cal_load_pos(0),
+                                                                     m_backlash_cal_loaded(false),
+                                                                     m_cmd_start_us(0),
+                                                                     m_start_latency_us(0),
+                                                                     m_move(),
+                                                                     m_stop_requested(false),
+                                                                     m_move_last_us(0),
+                                                                     m_move_write_base(0),
+                                                                     m_counters(),
+                                                                     m_stop_callback(nullptr)
 {
-    pinMode(ENCODER_PWR, OUTPUT);
-    // 启动编码器电源
-    digitalWrite(ENCODER_PWR, HIGH);
-
-    pinMode(DRV_EEP_PIN, OUTPUT);
-    pinMode(DRV_IN1_PIN, OUTPUT);
-    pinMode(DRV_IN2_PIN, OUTPUT);
-
-    analogWriteRange(PWM_RANGE);
-    analogWriteFreq(PWM_FREQ);
+    MotorService::init_shared_();
+    if (channel > 0)
+    {
+        snprintf_P(m_plot_suffix, sizeof(m_plot_suffix), PSTR("%u"), channel + 1);
+    }
+    m_move.channel = channel;
 
-    analogWrite(DRV_IN1_PIN, 0);
-    analogWrite(DRV_IN2_PIN, 0);
-    digitalWrite(DRV_EEP_PIN, LOW);
+    // 初始化电机驱动模块, 输出置零并休眠
+    m_driver.begin();
+    m_driver.set_decay(DEF_DECAY_MODE);
 
-    float tau = 1 / (2 * PI * SPEED_CUTOFF_FREQ);                 // 低通滤波器时间常数 (s)
-    speed_ema_alpha = 1.0 - exp(-UPDATE_DT_IN_MS / 1000.0 / tau); // 指数加权滤波系数 α=1-e^(-T/τ)
+    m_speed_tau_us = 1e6f / (2 * PI * m_tuning.speed_cutoff_hz); // 低通滤波器时间常数 (us)
 }
 
 MotorService::~MotorService()
 {
-    // 关闭编码器电源
+    m_driver.stop();
+    m_channels[m_channel] = nullptr;
+
+    // 所有通道都已销毁时关闭编码器电源
+    for (MotorService *ms : m_channels)
+    {
+        if (ms != nullptr)
+        {
+            return;
+        }
+    }
     digitalWrite(ENCODER_PWR, LOW);
-    digitalWrite(DRV_EEP_PIN, LOW);
+}
+
+MotorService *MotorService::create_(int channel)
+{
+    // 在静态存储区中构造, 不占用堆
+    alignas(MotorService) static uint8_t storage[MOTOR_CHANNELS][sizeof(MotorService)];
+    return new (storage[channel]) MotorService(channel, PIN_PROFILES[channel]);
+}
+
+void MotorService::init_shared_()
+{
+    static bool initialized = false;
+    if (initialized)
+    {
+        return;
+    }
+    initialized = true;
+
+    pinMode(ENCODER_PWR, OUTPUT);
+    // 启动编码器电源
+    digitalWrite(ENCODER_PWR, HIGH);
+
+    analogWriteRange(PWM_RANGE);
+    analogWriteFreq(PWM_FREQ);
 }
 
 void MotorService::begin(long motor_init_pos, bool is_reverse)
 {
-    // 初始化编码器位置
+    // 挂接编码器中断并初始化编码器位置
+    m_encoder.begin();
     this->set_motor_pos(motor_init_pos);
     this->set_reverse(is_reverse);
 
     // 初始化位置 PID 控制器
     m_pid.SetMode(MANUAL);
-    m_pid.SetSampleTime(PID_SAMPLE_TIME);
+    m_pid.SetSampleTime(lroundf(m_tuning.pid_sample_ms));
     m_pid.SetOutputLimits(-PWM_RANGE, PWM_RANGE);
+
+    // 各通道共用一个电机控制任务, 以最高优先级运行
+    if (m_tick_task < 0)
+    {
+        m_tick_task = SchedulerService::get_instance()->add_periodic(
+            "motor", &MotorService::update_all_, CONTROL_TICK_US, SchedulerService::PRIO_CONTROL);
+
+        LoggerService::get_instance()->web_server()->on(WEB_ENCODER_PATH, &MotorService::handle_web_encoder_);
+    }
+}
+
+void MotorService::update_all_()
+{
+    // 控制周期 (含停止回调) 不应分配堆内存
+    HEAP_NO_ALLOC_SCOPE("motor");
+
+    unsigned long start_us = micros();
+    for (MotorService *ms : m_channels)
+    {
+        if (ms != nullptr)
+        {
+            ms->update();
+        }
+    }
+
+    // 记录最大耗时, 用于确认多通道时仍能在一个控制周期内完成
+    unsigned long cost_us = micros() - start_us;
+    if (cost_us > m_tick_max_us)
+    {
+        m_tick_max_us = cost_us;
+    }
 }
 
 void MotorService::update()
 {
+    // 控制参数只在控制周期之间整体替换, 同一周期内各步骤使用同一组参数
+    if (m_tuning_pending)
+    {
+        this->apply_tuning_();
+    }
+    RECORD_ENCODER(m_channel, m_encoder.read());
+
+    m_driver.update();
+    this->_poll_track_backlash();
     this->_poll_measure_speed();
+    this->_poll_detect_backlash_load();
     this->_poll_run_pid();
+    this->_poll_move_stats();
     this->_poll_check_stable();
+    this->_poll_check_encoder();
+
+    // 记录运动轨迹
+    CaptureService *capture = CaptureService::get_instance();
+    if (capture->is_active(m_channel))
+    {
+        capture->record(m_channel, (long)m_pid_setpoint, this->get_cover_pos(), m_last_speed_pulse, m_last_pwm);
+    }
+}
+
+MotorService::Tuning MotorService::default_tuning()
+{
+    Tuning tuning;
+    tuning.kp = PID_DEF_KP;
+    tuning.ki = PID_DEF_KI;
+    tuning.kd = PID_DEF_KD;
+    tuning.pid_sample_ms = PID_SAMPLE_TIME;
+    tuning.stable_sample_ms = STABLE_SAMPLE_TIME;
+    tuning.stable_n_sample = STABLE_N_SAMPLE;
+    tuning.speed_cutoff_hz = SPEED_CUTOFF_FREQ;
+    tuning.rel_err_tol = REL_ERR_TOL;
+    tuning.abs_err_tol = ABS_ERR_TOL;
+    return tuning;
+}
+
+bool MotorService::is_valid_tuning(const Tuning &tuning)
+{
+    for (const TuningParam &param : TUNING_PARAMS)
+    {
+        // NaN 不满足任何比较, 同样被拒绝
+        float value = tuning.*param.field;
+        if (!(value >= param.min && value <= param.max))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool MotorService::set_tuning(const Tuning &tuning)
+{
+    if (!MotorService::is_valid_tuning(tuning))
+    {
+        return false;
+    }
+    m_next_tuning = tuning;
+    m_tuning_pending = true;
+    return true;
+}
+
+void MotorService::apply_tuning_()
+{
+    m_tuning = m_next_tuning;
+    m_tuning_pending = false;
+
+    // 先设置采样时间, SetTunings() 按新的采样时间换算积分及微分系数
+    m_pid.SetSampleTime(lroundf(m_tuning.pid_sample_ms));
+    m_pid.SetTunings(m_tuning.kp, m_tuning.ki, m_tuning.kd);
+
+    m_speed_tau_us = 1e6f / (2 * PI * m_tuning.speed_cutoff_hz);
+
+    LoggerService::printf_P(PSTR("Motor %u tuning: kp=%.3f ki=%.3f kd=%.3f pid=%ldms stable=%ldx%ldms cutoff=%.1fHz tol=%.3f/%.0f\n"),
+                            m_channel, m_tuning.kp, m_tuning.ki, m_tuning.kd, lroundf(m_tuning.pid_sample_ms),
+                            lroundf(m_tuning.stable_n_sample), lroundf(m_tuning.stable_sample_ms), m_tuning.speed_cutoff_hz,
+                            m_tuning.rel_err_tol, m_tuning.abs_err_tol);
+}
+
+void MotorService::set_cover_pos(long cover_pos)
+{
+    this->set_motor_pos(cover_pos + m_backlash_slack - m_backlash_pulse / 2);
+    m_backlash_last_pos = this->get_pos_pulse();
+}
+
+void MotorService::set_backlash(long backlash_pulse, long slack)
+{
+    m_backlash_pulse = max(backlash_pulse, 0L);
+    m_backlash_slack = constrain(slack, 0L, m_backlash_pulse);
+    m_backlash_last_pos = this->get_pos_pulse();
+}
+
+void MotorService::start_backlash_cal()
+{
+    // 向上次运动的反方向运行，未知方向时默认反转
+    m_backlash_cal_dir = (m_last_dir > 0) ? -1 : 1;
+    m_backlash_cal_start = this->get_pos_pulse();
+    m_backlash_cal_start_ms = millis();
+    m_backlash_cal_peak_speed = 0;
+    m_backlash_cal_loaded = false;
+
+    CaptureService::get_instance()->abort(m_channel);
+    this->start_move_(MOVE_BACKLASH_CAL);
+    m_motor_reached_stable = false;
+    this->_disable_pid();
+    this->motor_run(m_backlash_cal_dir * BACKLASH_CAL_PWM);
+}
+
+long MotorService::finish_backlash_cal()
+{
+    if (!this->is_backlash_cal())
+    {
+        return -1;
+    }
+
+    this->motor_brake();
+    long travel;
+    if (m_backlash_cal_loaded)
+    {
+        travel = abs(m_backlash_cal_load_pos - m_backlash_cal_start);
+    }
+    else
+    {
+        // 齿隙过小时电机未加速到空载转速即带动负载, 无法检测转速下降, 扣除按键反应时间内的行程
+        long reaction = lroundf(fabsf(m_last_speed_pulse) * BACKLASH_CAL_REACTION_MS / 1000.0f);
+        travel = max(abs(this->get_pos_pulse() - m_backlash_cal_start) - reaction, 0L);
+    }
+    int dir = m_backlash_cal_dir;
+    m_backlash_cal_dir = 0;
+
+    if (travel > BACKLASH_CAL_MAX_PULSE)
+    {
+        return -1;
+    }
+
+    // 标定结束时电机已在运行方向上贴合负载
+    this->set_backlash(travel, dir > 0 ? travel : 0);
+    return travel;
+}
+
+void MotorService::abort_backlash_cal_()
+{
+    // 放弃标定, 保留原有齿隙, 停止后由停止回调上报
+    this->motor_brake();
+    m_backlash_cal_dir = 0;
 }
 
 void MotorService::goto_pos(float motor_pos)
 {
     // 目标位置同当前位置不同时更新 PID 控制器设定点，并开启 PID 自动控制
-    if (!is_close_enough(motor_pos, this->get_pos_pulse()))
+    if (!this->is_close(motor_pos, this->get_cover_pos()))
     {
+        m_backlash_cal_dir = 0;
         m_pid_target_set_ms = millis();
         m_pid_setpoint = motor_pos;
 
+        this->start_move_(MOVE_PID);
+        m_move.target_pos = (long)motor_pos;
         m_motor_reached_stable = false;
         this->_enable_pid();
+
+        // 开始捕获本次运动轨迹
+        CaptureService::get_instance()->arm(m_channel, this->get_cover_pos(), (long)motor_pos);
     }
 }
 
 void MotorService::forward(int pwm)
 {
+    m_backlash_cal_dir = 0;
+    this->start_move_(MOVE_MANUAL);
+    CaptureService::get_instance()->abort(m_channel);
     m_motor_reached_stable = false;
     this->_disable_pid();
-    this->motor_forward(pwm);
+    this->motor_forward(this->backlash_takeup(pwm));
 }
 
 void MotorService::backward(int pwm)
 {
+    m_backlash_cal_dir = 0;
+    this->start_move_(MOVE_MANUAL);
+    CaptureService::get_instance()->abort(m_channel);
     m_motor_reached_stable = false;
     this->_disable_pid();
-    this->motor_backward(pwm);
+    this->motor_backward(-this->backlash_takeup(-pwm));
+}
+
+void MotorService::start_move_(MoveMode mode)
+{
+    m_move.mode = mode;
+    m_stop_requested = false;
+
+    // 电机已在运行时视为同一次运动, 不重新计时
+    if (m_motor_reached_stable)
+    {
+        m_cmd_start_us = micros() | 1; // 保证非 0
+        TraceService::get_instance()->dispatch(m_channel);
+
+        long cur_pos = this->get_cover_pos();
+        m_move.start_ms = millis();
+        m_move.start_pos = cur_pos;
+        m_move.target_pos = cur_pos;
+        m_move.final_pos = cur_pos;
+        m_move.duration_ms = 0;
+        m_move.overshoot = 0;
+        m_move.peak_speed = 0;
+        m_move.pwm_integral_us = 0;
+        m_move_last_us = micros();
+        m_move_write_base = m_driver.get_write_count();
+    }
 }
 
 void MotorService::stop()
 {
+    m_backlash_cal_dir = 0;
+    m_cmd_start_us = 0;
+    TraceService::get_instance()->discard_receipt();
     if (!m_motor_reached_stable)
     {
+        m_stop_requested = true;
         m_motor_reached_stable = false;
         this->_disable_pid();
         this->motor_brake();
     }
 }
 
-void MotorService::motor_run(int pwm)
+int MotorService::backlash_takeup(int pwm) const
 {
-    if (pwm > 0)
-    {
-        this->motor_forward(pwm);
-    }
-    else if (pwm < 0)
+    // 输出方向与齿隙贴合方向不一致时，负载尚未跟随，以加速 PWM 值快速越过齿隙
+    if (pwm > PWM_DEADZONE && m_backlash_slack < m_backlash_pulse)
     {
-        this->motor_backward(-pwm);
+        return max(pwm, BACKLASH_TAKEUP_PWM);
     }
-    else
+    if (pwm < -PWM_DEADZONE && m_backlash_slack > 0)
     {
-        // 停止电机的同时让驱动模块休眠
-        this->motor_brake();
+        return min(pwm, -BACKLASH_TAKEUP_PWM);
     }
+    return pwm;
 }
 
-void MotorService::driver_wakeup()
-{
-    digitalWrite(DRV_EEP_PIN, HIGH);
-}
-
-void MotorService::driver_sleep()
+void MotorService::motor_run(int pwm)
 {
-    digitalWrite(DRV_EEP_PIN, LOW);
+    // 零输出时按衰减方式制动或滑行, 驱动模块保持唤醒, 避免 PID 控制过零时反复休眠
+    m_last_pwm = pwm;
+    RECORD_PWM(m_channel, pwm);
+    m_driver.set_output(m_reverse_dir ? -pwm : pwm);
+    if (pwm != 0)
+    {
+        TraceService::get_instance()->mark_pwm(m_channel);
+    }
 }
 
 void MotorService::motor_brake()
 {
-    digitalWrite(DRV_IN1_PIN, LOW);
-    digitalWrite(DRV_IN2_PIN, LOW);
-
-    this->driver_sleep();
+    // 停止电机的同时让驱动模块休眠
+    m_last_pwm = 0;
+    RECORD_PWM(m_channel, 0);
+    m_driver.stop();
 }
 
 void MotorService::motor_forward(int pwm)
 {
-    this->driver_wakeup();
-
-    if (this->m_reverse_dir)
-    {
-        // 反向正转 (即反转 CCW)
-        analogWrite(DRV_IN1_PIN, 0);
-        analogWrite(DRV_IN2_PIN, pwm);
-    }
-    else
-    {
-        // 正常正转 CW
-        analogWrite(DRV_IN1_PIN, pwm);
-        analogWrite(DRV_IN2_PIN, 0);
-    }
+    // 设置反转标志时为反转 CCW
+    this->motor_run(pwm);
 }
 
 void MotorService::motor_backward(int pwm)
 {
-    this->driver_wakeup();
-
-    if (this->m_reverse_dir)
-    {
-        // 反向反转 (即正转 CW)
-        analogWrite(DRV_IN1_PIN, pwm);
-        analogWrite(DRV_IN2_PIN, 0);
-    }
-    else
-    {
-        // 正常反转 CCW
-        analogWrite(DRV_IN1_PIN, 0);
-        analogWrite(DRV_IN2_PIN, pwm);
-    }
+    // 设置反转标志时为正转 CW
+    this->motor_run(-pwm);
 }
 
 void MotorService::_poll_run_pid()
@@ -179,14 +454,14 @@ void MotorService::_poll_run_pid()
     // 自动控制时根据 PID 运算结果驱动电动机
     if (m_pid.GetMode() == AUTOMATIC)
     {
-        // 读取编码器位置作为位置 PID 输入
-        m_pid_input = (double)this->get_pos_pulse();
+        // 读取扣除齿隙后的窗帘位置作为位置 PID 输入
+        m_pid_input = (double)this->get_cover_pos();
 
         // 执行位置 PID 计算
         m_pid.Compute();
 
-        // 获取 PID 输出结果作为 PWM 强度信号
-        int pwm_signal = (int)m_pid_output;
+        // 获取 PID 输出结果作为 PWM 强度信号，换向时加速消除齿隙
+        int pwm_signal = this->backlash_takeup((int)m_pid_output);
 
         // 通过 PWM 强度信号设定电机转速
         this->motor_run(pwm_signal);
@@ -198,7 +473,7 @@ void MotorService::_poll_run_pid()
             m_pid_last_report_ms = cur_ms;
 
             // 以 Teleplot 格式输出 PWM 数据以绘图
-            LoggerService::printf(">pwm: %d\n", pwm_signal);
+            LoggerService::printf_P(PSTR(">pwm%s: %d\n"), m_plot_suffix, pwm_signal);
         }
     }
 }
@@ -207,13 +482,13 @@ void MotorService::_poll_check_stable()
 {
     unsigned long cur_ms = millis();
 
-    if (!m_motor_reached_stable && cur_ms - m_stable_last_ms > STABLE_SAMPLE_TIME)
+    if (!m_motor_reached_stable && cur_ms - m_stable_last_ms > (unsigned long)lroundf(m_tuning.stable_sample_ms))
     {
         m_stable_last_ms = cur_ms;
 
-        // 读取编码器位置
-        long enc_val = this->get_pos_pulse();
-        if (is_close_enough((float)enc_val, (float)m_stable_last_pos))
+        // 读取窗帘位置, 齿隙内的电机晃动不影响稳态判定
+        long enc_val = this->get_cover_pos();
+        if (this->is_close((float)enc_val, (float)m_stable_last_pos))
         {
             m_good_sample_count++;
         }
@@ -223,12 +498,13 @@ void MotorService::_poll_check_stable()
             m_good_sample_count = 0;
         }
 
-        if (m_good_sample_count > STABLE_N_SAMPLE)
+        if (m_good_sample_count > lroundf(m_tuning.stable_n_sample))
         {
             // 连续多个采样点满足误差要求，可以认为电机到达目标
             unsigned long stable_time = millis() - m_pid_target_set_ms;
-            LoggerService::printf("cur_pos=%ld, pos_setpoint=%f, n_good_sample=%d\n", enc_val, m_pid_setpoint, m_good_sample_count);
-            LoggerService::printf("Stable time %ld ms\n", stable_time);
+            LoggerService::printf_P(PSTR("ch=%u, cur_pos=%ld, pos_setpoint=%f, n_good_sample=%d\n"), m_channel, enc_val, m_pid_setpoint, m_good_sample_count);
+            LoggerService::printf_P(PSTR("Stable time %ld ms, %lu driver GPIO writes\n"), stable_time,
+                                    (unsigned long)(m_driver.get_write_count() - m_move_write_base));
             m_motor_reached_stable = true;
 
             // 重置达标样本点数
@@ -238,18 +514,170 @@ void MotorService::_poll_check_stable()
             this->_disable_pid();
             this->motor_brake();
 
+            // 结束轨迹捕获并计算阶跃响应指标
+            CaptureService::get_instance()->finish(m_channel, enc_val);
+
+            // 完成运动统计并判定停止原因
+            m_move.final_pos = enc_val;
+            m_move.duration_ms = millis() - m_move.start_ms;
+            if (m_move.mode == MOVE_PID)
+            {
+                m_move.reason = m_stop_requested                                         ? STOP_COMMAND
+                                : this->is_close((float)enc_val, (float)m_move.target_pos) ? STOP_REACHED
+                                                                                          : STOP_STALLED;
+            }
+            else
+            {
+                m_move.target_pos = enc_val;
+                m_move.reason = m_move.mode == MOVE_MANUAL ? STOP_MANUAL : STOP_CALIBRATION;
+            }
+            m_counters.moves++;
+            if (m_move.reason == STOP_STALLED)
+            {
+                m_counters.stalls++;
+            }
+
+            TraceService::get_instance()->mark_stop(m_channel);
+            RECORD_STOP(m_channel, enc_val, m_move.reason);
+
             // 调用电机停止回调函数
             if (this->m_stop_callback)
             {
-                this->m_stop_callback(this->get_pos_pulse());
+                this->m_stop_callback(m_channel, this->get_cover_pos());
             }
         }
     }
 }
 
-void MotorService::_poll_measure_speed()
+void MotorService::_poll_move_stats()
+{
+    if (m_motor_reached_stable)
+    {
+        return;
+    }
+
+    unsigned long cur_us = micros();
+    m_move.pwm_integral_us += (uint64_t)abs(m_last_pwm) * (cur_us - m_move_last_us);
+    m_move_last_us = cur_us;
+    m_move.peak_speed = max(m_move.peak_speed, abs(m_last_speed_pulse));
+
+    if (m_move.mode == MOVE_PID)
+    {
+        // 以运动方向为正计算越过目标位置的距离
+        long beyond = this->get_cover_pos() - m_move.target_pos;
+        if (m_move.target_pos < m_move.start_pos)
+        {
+            beyond = -beyond;
+        }
+        m_move.overshoot = max(m_move.overshoot, beyond);
+    }
+}
+
+void MotorService::_poll_check_encoder()
 {
     unsigned long cur_ms = millis();
+    if (cur_ms - m_encoder_check_ms < ENCODER_CHECK_INTERVAL_MS)
+    {
+        return;
+    }
+    m_encoder_check_ms = cur_ms;
+
+    // 非法转换说明有边沿丢失, 位置可能已漂移
+    QuadratureEncoder::Stats stats = m_encoder.get_stats();
+    if (stats.errors != m_encoder_errors)
+    {
+        LoggerService::printf_P(PSTR("Encoder %u: %lu invalid transitions (+%lu), min edge gap %lu cycles\n"),
+                                m_channel, (unsigned long)stats.errors, (unsigned long)(stats.errors - m_encoder_errors),
+                                (unsigned long)stats.min_edge_gap_cycles);
+        m_encoder_errors = stats.errors;
+    }
+}
+
+void MotorService::handle_web_encoder_()
+{
+    ESP8266WebServer *server = LoggerService::get_instance()->web_server();
+    long channel = server->hasArg("ch") ? strtol(server->arg("ch").c_str(), nullptr, 10) : 0;
+    if (channel < 0 || channel >= MOTOR_CHANNELS)
+    {
+        server->send_P(400, PSTR("text/plain"), PSTR("Invalid channel.\n"));
+        return;
+    }
+    MotorService *ms = MotorService::get_instance(channel);
+
+    if (server->hasArg("reset"))
+    {
+        ms->m_encoder.reset_stats();
+        ms->m_encoder_errors = 0;
+        server->send_P(200, PSTR("text/plain"), PSTR("Encoder stats reset.\n"));
+        return;
+    }
+
+    QuadratureEncoder::Stats stats = ms->m_encoder.get_stats();
+    uint32_t mhz = ESP.getCpuFreqMHz();
+    char buf[384];
+    int len = snprintf_P(buf, sizeof(buf),
+                         PSTR("channel %ld\ntick_max_us %lu\nposition %lld\nedges %lu\nerrors %lu\nisr_max_cycles %lu\nisr_max_ns %lu\nmin_edge_gap_us %lu\n"),
+                         channel, m_tick_max_us, (long long)ms->m_encoder.read64(), (unsigned long)stats.edges, (unsigned long)stats.errors,
+                         (unsigned long)stats.isr_max_cycles, (unsigned long)(stats.isr_max_cycles * 1000 / mhz),
+                         (unsigned long)(stats.min_edge_gap_cycles == UINT32_MAX ? 0 : stats.min_edge_gap_cycles / mhz));
+
+    // 基准测试期间关闭中断, 电机运行时拒绝执行
+    if (server->hasArg("bench"))
+    {
+        if (ms->is_moving())
+        {
+            snprintf_P(buf + len, sizeof(buf) - len, PSTR("bench skipped: motor is moving\n"));
+        }
+        else
+        {
+            QuadratureEncoder::BenchResult result = ms->m_encoder.bench();
+            snprintf_P(buf + len, sizeof(buf) - len,
+                       PSTR("bench_cpu_mhz %lu\nbench_handler_cycles %lu\nbench_handler_ns %lu\nbench_max_edge_rate_hz %lu\n"),
+                       (unsigned long)mhz, (unsigned long)result.handler_cycles, (unsigned long)result.handler_ns,
+                       (unsigned long)result.max_edge_rate);
+        }
+    }
+    // 正文在 RAM 中, send_P() 以 memcpy_P() 读取, 对 RAM 地址同样适用
+    server->send_P(200, PSTR("text/plain"), buf);
+}
+
+void MotorService::_poll_track_backlash()
+{
+    long enc_val = this->get_pos_pulse();
+    long enc_diff = enc_val - m_backlash_last_pos;
+    if (enc_diff == 0)
+    {
+        return;
+    }
+    m_backlash_last_pos = enc_val;
+    m_last_dir = enc_diff > 0 ? 1 : -1;
+    m_counters.travel_pulses += abs(enc_diff);
+
+    // 命令发出后首次检测到编码器变化即为电机开始转动
+    if (m_cmd_start_us != 0)
+    {
+        m_start_latency_us = micros() - m_cmd_start_us;
+        m_cmd_start_us = 0;
+        LoggerService::printf_P(PSTR("Motor %u start latency %lu us\n"), m_channel, m_start_latency_us);
+    }
+    TraceService::get_instance()->mark_motion(m_channel);
+
+    // 电机在齿隙内移动时负载不动, 到达齿隙边界后带动负载
+    m_backlash_slack = constrain(m_backlash_slack + enc_diff, 0L, m_backlash_pulse);
+
+    // 标定时超出最大行程仍未结束则放弃标定, 已检测到负载时从负载位置起算
+    long cal_ref = m_backlash_cal_loaded ? m_backlash_cal_load_pos : m_backlash_cal_start;
+    if (this->is_backlash_cal() && abs(enc_val - cal_ref) > BACKLASH_CAL_MAX_PULSE)
+    {
+        LoggerService::println(F("Backlash calibration aborted: travel limit exceeded"));
+        this->abort_backlash_cal_();
+    }
+}
+
+void MotorService::_poll_measure_speed()
+{
+    unsigned long cur_us = micros();
+    unsigned long dt_us = cur_us - m_last_enc_read_us;
 
     // 读取编码器位置
     long enc_val = this->get_pos_pulse();
@@ -258,25 +686,50 @@ void MotorService::_poll_measure_speed()
     long enc_diff = enc_val - m_last_pos_pulse;
 
     // 当编码器位置变化超过阈值(适应高转速情况)或者采样间隔超过阈值(适应低转速情况)时更新电机速度
-    if (abs(enc_diff) > SPEED_PULSE_THRESHOLD || cur_ms - m_last_enc_read_ms > SPEED_INTERVAL_THRESHOLD)
+    if (abs(enc_diff) > SPEED_PULSE_THRESHOLD || dt_us > SPEED_INTERVAL_THRESHOLD * 1000UL)
     {
-        m_last_enc_read_ms = cur_ms;
-
-        // 计算电机速度 (pulse/s)
-        float speed = (double)enc_diff / (cur_ms - m_last_enc_read_ms + 1) * 1000;
+        // 计算电机速度 (pulse/s), 按上次采样至今的实际间隔计算
+        float speed = (double)enc_diff * 1e6 / max(dt_us, 1UL);
 
-        // 指数移动平均更新上次电机速度
-        m_last_speed_pulse = (1 - speed_ema_alpha) * m_last_speed_pulse + speed_ema_alpha * speed;
+        // 采样间隔随转速变化, 按实际间隔计算指数加权滤波系数 α=1-e^(-T/τ), 保持截止频率不变
+        float alpha = 1.0f - expf(-(float)dt_us / m_speed_tau_us);
+        m_last_speed_pulse = (1 - alpha) * m_last_speed_pulse + alpha * speed;
 
         // 电机位置变化时以 Teleplot 格式输出位置和速度信息
         if (enc_val != m_last_pos_pulse)
         {
-            LoggerService::printf(">pos: %ld\n", enc_val);
-            LoggerService::printf(">speed: %.3f\n", m_last_speed_pulse);
+            LoggerService::printf_P(PSTR(">pos%s: %ld\n"), m_plot_suffix, enc_val);
+            LoggerService::printf_P(PSTR(">speed%s: %.3f\n"), m_plot_suffix, m_last_speed_pulse);
         }
 
         // 更新上一次的编码器位置和时间
         m_last_pos_pulse = enc_val;
+        m_last_enc_read_us = cur_us;
+    }
+}
+
+void MotorService::_poll_detect_backlash_load()
+{
+    // 速度滤波器响应时间随截止频率变化, 等待滤波后转速跟上实际转速再开始检测
+    unsigned long settle_ms = max((unsigned long)BACKLASH_CAL_SETTLE_MS, (unsigned long)(3 * m_speed_tau_us / 1000));
+    if (!this->is_backlash_cal() || m_backlash_cal_loaded || millis() - m_backlash_cal_start_ms < settle_ms)
+    {
+        return;
+    }
+
+    // 齿隙内电机空载运行, 齿隙闭合后带动负载, 同一 PWM 下转速明显下降
+    float speed = fabsf(m_last_speed_pulse);
+    if (speed > m_backlash_cal_peak_speed)
+    {
+        m_backlash_cal_peak_speed = speed;
+    }
+    else if (speed < m_backlash_cal_peak_speed * BACKLASH_CAL_LOAD_RATIO)
+    {
+        m_backlash_cal_loaded = true;
+        m_backlash_cal_load_pos = this->get_pos_pulse();
+        LoggerService::printf_P(PSTR("Motor %u backlash calibration: load engaged after %ld pulses (%.0f -> %.0f pulse/s)\n"),
+                                m_channel, abs(m_backlash_cal_load_pos - m_backlash_cal_start),
+                                m_backlash_cal_peak_speed, speed);
     }
 }
 
@@ -1,10 +1,17 @@
 #pragma once
 
-#include <Encoder.h>
-#include <PID_v1.h>
+#include "config/pins.h"
+#include "utility/quadrature_encoder.h"
+#include "utility/drv8833.h"
+#include "utility/misc.h"
 
-#include <functional>
+#include <PID_v1.h>
 
+/** 电机控制和状态感知服务
+ *
+ * 每个实例控制 DRV8833 的一路 H 桥及对应的编码器, 引脚由 MotorPins 描述。
+ * 按通道号通过 get_instance() 获取实例, 所有通道共用一个控制任务, 在同一个控制周期中依次更新。
+ */
 class MotorService
 {
 public:
@@ -13,10 +20,10 @@ public:
     static constexpr int PWM_DEADZONE = 30;             // PWM 输出死区
     static constexpr int PWM_MIN_SPEED = 255;           // PWM 最低速阈值
     static constexpr int PPR = 12;                      // 编码器每转一圈的脉冲数
-    static constexpr int UPDATE_DT_IN_MS = 10;          // 电机速度更新时间间隔 (ms)
+    static constexpr int CONTROL_TICK_US = 1000;        // 电机控制任务调度间隔 (us)
     static constexpr int SPEED_CUTOFF_FREQ = 5;         // 电机速度低通滤波截止频率 5 Hz
     static constexpr int SPEED_PULSE_THRESHOLD = 10;    // 编码器改变量超过 10 个脉冲就更新速度
-    static constexpr int SPEED_INTERVAL_THRESHOLD = 50; // 编码器采样间隔超过 10ms 就更新速度
+    static constexpr int SPEED_INTERVAL_THRESHOLD = 50; // 编码器采样间隔超过 50ms 就更新速度
     static constexpr int STABLE_N_SAMPLE = 20;          // 判定进入稳态要求所需满足误差的连续样本数
     static constexpr int STABLE_SAMPLE_TIME = 50;       // 判定样本采样时间(ms)
     static constexpr int PID_SAMPLE_TIME = 5;           // PID 控制采样时间(ms), 临界振荡周期 ~0.3s
@@ -24,21 +31,118 @@ public:
     static constexpr double PID_DEF_KP = 2.0;           // PID 控制参数 P
     static constexpr double PID_DEF_KI = 0.2;           // PID 控制参数 I
     static constexpr double PID_DEF_KD = 0.12;          // PID 控制参数 D
+    static constexpr int BACKLASH_TAKEUP_PWM = 220;     // 换向时消除齿隙的加速 PWM 值
+    static constexpr int BACKLASH_CAL_PWM = 128;        // 齿隙标定时的电机 PWM 值
+    static constexpr long BACKLASH_CAL_MAX_PULSE = 600; // 齿隙标定允许的最大行程(编码脉冲数), 超出则放弃标定
+    static constexpr int BACKLASH_CAL_SETTLE_MS = 150;  // 齿隙标定开始后电机加速到空载转速的时间(ms), 之后开始检测负载, 不短于 3 倍速度滤波时间常数
+    static constexpr float BACKLASH_CAL_LOAD_RATIO = 0.7f; // 转速降至空载峰值转速的该比例以下时判定齿隙闭合、开始带动负载
+    static constexpr int BACKLASH_CAL_REACTION_MS = 200; // 未检测到负载时按 OK 键的反应时间补偿(ms), 按按键时带负载的滤波转速扣除行程
+    static constexpr Drv8833::DecayMode DEF_DECAY_MODE = Drv8833::DECAY_SLOW; // 默认 PWM 衰减方式, 慢衰减低速线性度较好
+    static constexpr int ENCODER_CHECK_INTERVAL_MS = 1000; // 检查编码器非法转换计数的间隔(ms)
+    static constexpr const char *WEB_ENCODER_PATH = "/encoder"; // 编码器统计, ?ch=<通道号> 选择通道, ?bench 运行中断处理耗时基准测试, ?reset 清除统计
+    static constexpr int TUNING_PARAM_COUNT = 9;        // 运行时可调的控制参数个数
+
+    /** 单个电机通道的引脚 */
+    struct MotorPins
+    {
+        uint8_t drv_sleep; // 驱动模块休眠引脚 (同一芯片的两路共用)
+        uint8_t drv_in_a;  // H 桥输入 A (正转时为高)
+        uint8_t drv_in_b;  // H 桥输入 B (反转时为高)
+        uint8_t enc_a;     // 编码器 A 相
+        uint8_t enc_b;     // 编码器 B 相
+    };
+
+    static const MotorPins PIN_PROFILES[MOTOR_CHANNELS]; // 各通道引脚
 
-    using motor_stop_callback_t = std::function<void(long)>;
+    // 运动方式
+    enum MoveMode : uint8_t
+    {
+        MOVE_PID,         // PID 控制运行至目标位置
+        MOVE_MANUAL,      // 手动定速运行
+        MOVE_BACKLASH_CAL // 齿隙标定
+    };
+
+    // 电机停止原因
+    enum StopReason : uint8_t
+    {
+        STOP_REACHED = 0,    // 到达目标位置
+        STOP_STALLED = 1,    // 未到达目标位置但已停止转动 (堵转或负载过大)
+        STOP_COMMAND = 2,    // PID 运行过程中收到停止命令
+        STOP_MANUAL = 3,     // 手动运行结束
+        STOP_CALIBRATION = 4 // 齿隙标定结束
+    };
+
+    /** 单次运动统计 */
+    struct MoveStats
+    {
+        unsigned long start_ms;    // 运动开始时间戳
+        long start_pos;            // 起始位置
+        long target_pos;           // 目标位置 (非 PID 运动时为停止位置)
+        long final_pos;            // 停止位置
+        unsigned long duration_ms; // 运动开始至判定稳态的时间
+        long overshoot;            // 越过目标位置的最大距离 (仅 PID 运动)
+        float peak_speed;          // 最大速度(pulse/s)
+        uint64_t pwm_integral_us;  // |PWM| 对时间的积分 (PWM*us)
+        MoveMode mode;
+        StopReason reason;
+        uint8_t channel;           // 电机通道号
+    };
 
-    static MotorService *get_instance()
+    /** 累计运行计数 */
+    struct Counters
     {
-        if (m_instance == nullptr)
+        uint32_t moves;         // 完成的运动次数
+        uint32_t stalls;        // 堵转次数
+        uint32_t travel_pulses; // 累计行程(编码脉冲数)
+    };
+
+    /** 运行时可调的控制参数, 整数参数取整后生效 */
+    struct Tuning
+    {
+        float kp;               // PID 控制参数 P
+        float ki;               // PID 控制参数 I
+        float kd;               // PID 控制参数 D
+        float pid_sample_ms;    // PID 控制采样时间(ms)
+        float stable_sample_ms; // 稳态判定采样时间(ms)
+        float stable_n_sample;  // 判定进入稳态所需满足误差的连续样本数
+        float speed_cutoff_hz;  // 电机速度低通滤波截止频率(Hz)
+        float rel_err_tol;      // 判定到达目标位置的相对误差
+        float abs_err_tol;      // 判定到达目标位置的绝对误差(编码脉冲数)
+    };
+
+    /** 控制参数描述: 名称、取值范围及 HA 数值实体的调节步长 */
+    struct TuningParam
+    {
+        const char *key;
+        float min;
+        float max;
+        float step;
+        float Tuning::*field;
+    };
+
+    static const TuningParam TUNING_PARAMS[TUNING_PARAM_COUNT];
+
+    using motor_stop_callback_t = void (*)(uint8_t channel, long cur_pos);
+
+    /** 获取指定通道的电机服务, 首次调用时按 PIN_PROFILES 在静态存储区中创建 */
+    static MotorService *get_instance(int channel = 0)
+    {
+        if (m_channels[channel] == nullptr)
         {
-            m_instance = new MotorService();
+            m_channels[channel] = MotorService::create_(channel);
         }
-        return m_instance;
+        return m_channels[channel];
     }
 
+    MotorService(uint8_t channel, const MotorPins &pins);
     ~MotorService();
 
-    /** 启动电机控制和状态感知服务 */
+    /** 获取通道号 */
+    uint8_t get_channel() const { return m_channel; }
+    /** 获取共用控制任务单次执行的最大耗时(us) */
+    static unsigned long get_tick_max_us() { return m_tick_max_us; }
+
+    /** 启动电机控制和状态感知服务, 首个启动的通道注册共用控制任务 */
     void begin(long motor_init_pos = 0, bool is_reverse = false);
 
     /** 更新电机位置和速度信息 */
@@ -46,6 +150,10 @@ public:
 
     /** 设置电机编码器初始位置值 */
     void set_motor_pos(long motor_pos) { m_encoder.write(motor_pos); }
+    /** 获取电机编码器读数 (未按转向换算) */
+    long get_motor_pos() { return m_encoder.read(); }
+    /** 设置窗帘位置值（根据齿隙状态换算为电机编码器位置） */
+    void set_cover_pos(long cover_pos);
     /** 电机运行至目标位置值 */
     void goto_pos(float motor_pos);
     /** 电机正转（默认 CW） */
@@ -62,12 +170,32 @@ public:
         *ki = m_pid.GetKi();
         *kd = m_pid.GetKd();
     }
-    /** 设置 PID 控制参数 */
-    void set_pid_tunings(double kp, double ki, double kd)
+    /** 设置 PID 控制参数, 其余参数保持不变 */
+    bool set_pid_tunings(double kp, double ki, double kd)
     {
-        m_pid.SetTunings(kp, ki, kd);
+        Tuning tuning = this->get_tuning();
+        tuning.kp = kp;
+        tuning.ki = ki;
+        tuning.kd = kd;
+        return this->set_tuning(tuning);
     }
 
+    /** 编译时默认控制参数 */
+    static Tuning default_tuning();
+    /** 检查控制参数是否都在允许范围内 */
+    static bool is_valid_tuning(const Tuning &tuning);
+    /** 设置控制参数: 校验通过后暂存, 在下一个控制周期开始时整体生效, 校验失败返回 false */
+    bool set_tuning(const Tuning &tuning);
+    /** 获取控制参数, 包括已暂存尚未生效的参数 */
+    const Tuning &get_tuning() const { return m_tuning_pending ? m_next_tuning : m_tuning; }
+    /** 按当前生效的误差容限判定两个位置是否足够接近 */
+    bool is_close(float val, float dst) const { return is_close_enough(val, dst, m_tuning.rel_err_tol, m_tuning.abs_err_tol); }
+
+    /** 设置 PWM 衰减方式 */
+    void set_decay_mode(Drv8833::DecayMode mode) { m_driver.set_decay(mode); }
+    /** 获取 PWM 衰减方式 */
+    Drv8833::DecayMode get_decay_mode() const { return m_driver.get_decay(); }
+
     /** 设置电机转向反向标志 */
     void set_reverse(bool is_reverse) { m_reverse_dir = is_reverse; }
     /** 获取电机转向反向标志 */
@@ -79,6 +207,43 @@ public:
         return m_reverse_dir ? -val : val;
     }
     float get_speed_pulse() const { return m_last_speed_pulse; }
+    /** 电机是否正在运行 */
+    bool is_moving() const { return !m_motor_reached_stable; }
+    /** 获取 PID 控制目标位置 */
+    long get_target_pos() const { return (long)m_pid_setpoint; }
+    /** 获取编码器统计数据 */
+    QuadratureEncoder::Stats get_encoder_stats() const { return m_encoder.get_stats(); }
+
+    /** 获取当前 PWM 输出值 (正值正转, 负值反转, 0 停止) */
+    int get_pwm() const { return m_last_pwm; }
+    /** PID 自动控制是否启用 */
+    bool is_pid_active() { return m_pid.GetMode() == AUTOMATIC; }
+    /** 获取最近一次命令到电机实际开始转动的延迟(us) */
+    unsigned long get_start_latency_us() const { return m_start_latency_us; }
+    /** 获取当前或最近一次运动的统计数据, 在停止回调中读取即为刚结束的运动 */
+    const MoveStats &get_move_stats() const { return m_move; }
+    /** 获取累计运行计数 */
+    const Counters &get_counters() const { return m_counters; }
+
+    /** 获取扣除齿隙后的窗帘位置值
+     * 齿隙居中时窗帘位置与电机位置相同，正向贴合时落后 1/2 齿隙，反向贴合时超前 1/2 齿隙
+     * */
+    long get_cover_pos() { return this->get_pos_pulse() - m_backlash_slack + m_backlash_pulse / 2; }
+
+    /** 设置齿隙大小及当前齿隙状态 (0 表示反向贴合, 等于齿隙大小表示正向贴合) */
+    void set_backlash(long backlash_pulse, long slack);
+    /** 获取齿隙大小(编码脉冲数) */
+    long get_backlash() const { return m_backlash_pulse; }
+    /** 获取当前齿隙状态 */
+    long get_backlash_slack() const { return m_backlash_slack; }
+
+    /** 开始齿隙标定: 电机以低速向上次运动的反方向运行，窗帘开始移动后调用 finish_backlash_cal() */
+    void start_backlash_cal();
+    /** 结束齿隙标定并返回测得的齿隙大小，标定失败时返回 -1。
+     * 齿隙取检测到转速下降(开始带动负载)时的行程, 未检测到时取总行程减去反应时间内的行程 */
+    long finish_backlash_cal();
+    /** 是否正在进行齿隙标定 */
+    bool is_backlash_cal() const { return m_backlash_cal_dir != 0; }
 
     float get_angle_deg() { return this->get_pos_pulse() * 360.0 / PPR; }
     float get_speed_deg() const { return m_last_speed_pulse * 360.0 / PPR; }
@@ -86,26 +251,46 @@ public:
     void set_stop_callback(motor_stop_callback_t callback) { m_stop_callback = callback; }
 
 protected:
-    MotorService();
-
-    /** 唤醒电机驱动模块 */
-    void driver_wakeup();
-    /** 休眠电机驱动模块*/
-    void driver_sleep();
+    static MotorService *create_(int channel);
+    /** 配置各通道共用的编码器电源及 PWM 参数 */
+    static void init_shared_();
+    /** 共用控制任务, 依次更新所有通道 */
+    static void update_all_();
 
-    /** 电机停止 */
+    /** 电机停止并让驱动模块休眠 */
     void motor_brake();
     /** 电机正向旋转 (CW, PWM 值 >= 0)*/
     void motor_forward(int pwm);
     /** 电机反向旋转 (CCW, PWM 值 >= 0)*/
     void motor_backward(int pwm);
     /** 电机旋转
-     * 正常情况下正 PWM 值表示正转 CW, 负 PWM 值表示反转 CCW, 0 表示停止, 设置反转标志时转向相反
+     * 正常情况下正 PWM 值表示正转 CW, 负 PWM 值表示反转 CCW, 0 表示制动但驱动模块保持唤醒, 设置反转标志时转向相反
      * */
     void motor_run(int pwm);
 
+    /** 使暂存的控制参数生效, 同时更新 PID 控制器及速度滤波系数 */
+    void apply_tuning_();
+
+    /** 换向时以加速 PWM 值快速消除齿隙 */
+    int backlash_takeup(int pwm) const;
+
+    /** 记录运动命令: 电机静止时开始新一次运动统计, 并测量命令到电机开始转动的延迟 */
+    void start_move_(MoveMode mode);
+    /** 运动过程中更新运动统计 */
+    void _poll_move_stats();
+    /** 检查编码器非法转换计数, 增加时输出日志 */
+    void _poll_check_encoder();
+
+    static void handle_web_encoder_();
+
+    /** 根据编码器位置变化更新齿隙状态 */
+    void _poll_track_backlash();
+    /** 放弃齿隙标定: 停止电机, 保留原有齿隙 */
+    void abort_backlash_cal_();
     /** 计算电机当前角速度 */
     void _poll_measure_speed();
+    /** 齿隙标定时根据转速下降检测齿隙闭合位置 */
+    void _poll_detect_backlash_load();
     /** 检查 PID 控制时电机是否已进入稳态 */
     void _poll_check_stable();
     /** 运行 PID 电机控制 */
@@ -115,15 +300,31 @@ protected:
     /** 停用 PID 算法 */
     void _disable_pid();
 
-    static MotorService *m_instance;
+    static MotorService *m_channels[MOTOR_CHANNELS];
+    static int m_tick_task;              // 共用控制任务编号
+    static unsigned long m_tick_max_us;  // 共用控制任务单次执行的最大耗时
+
+    uint8_t m_channel;
+    char m_plot_suffix[4]; // Teleplot 变量名后缀, 通道 0 为空
+
+    // 电机驱动模块
+    Drv8833 m_driver;
 
     // 电机位置编码器
-    Encoder m_encoder;
+    QuadratureEncoder m_encoder;
+    uint32_t m_encoder_errors;            // 已报告的编码器非法转换次数
+    unsigned long m_encoder_check_ms;     // 上次检查编码器统计的时间戳
     bool m_reverse_dir;
     long m_last_pos_pulse;
     float m_last_speed_pulse;
-    unsigned long m_last_enc_read_ms;
-    float speed_ema_alpha;
+    unsigned long m_last_enc_read_us; // 上次更新电机速度的时间戳
+    float m_speed_tau_us;             // 速度低通滤波时间常数 (us)
+    int m_last_pwm; // 当前 PWM 输出值
+
+    // 控制参数
+    Tuning m_tuning;        // 当前生效的控制参数
+    Tuning m_next_tuning;   // 暂存待生效的控制参数
+    bool m_tuning_pending;  // 是否有暂存的控制参数
 
     // PID 控制器
     PID m_pid;
@@ -136,5 +337,26 @@ protected:
     unsigned long m_stable_last_ms; // 最近一次稳定采样的时间戳
     long m_stable_last_pos;         // 最近一次稳定采样的位置值
 
+    // 齿隙模型
+    long m_backlash_pulse;        // 齿隙大小(编码脉冲数)
+    long m_backlash_slack;        // 电机在齿隙中的位置, 取值 [0, m_backlash_pulse]
+    long m_backlash_last_pos;     // 上次更新齿隙状态时的电机位置
+    int m_last_dir;               // 电机最近一次运动方向 (1 正转, -1 反转, 0 未知)
+    int m_backlash_cal_dir;       // 齿隙标定运行方向, 0 表示未在标定
+    long m_backlash_cal_start;    // 齿隙标定开始时的电机位置
+    unsigned long m_backlash_cal_start_ms; // 齿隙标定开始的时间戳
+    float m_backlash_cal_peak_speed;       // 齿隙标定中空载运行的峰值转速 (pulse/s)
+    long m_backlash_cal_load_pos;          // 检测到开始带动负载时的电机位置
+    bool m_backlash_cal_loaded;            // 是否已检测到开始带动负载
+
+    unsigned long m_cmd_start_us;      // 最近一次运动命令的时间戳, 0 表示电机已开始转动
+    unsigned long m_start_latency_us;  // 最近一次命令到电机开始转动的延迟
+
+    MoveStats m_move;               // 当前或最近一次运动统计
+    bool m_stop_requested;          // 运动过程中是否收到停止命令
+    unsigned long m_move_last_us;   // 上次更新运动统计的时间戳
+    uint32_t m_move_write_base;     // 运动开始时驱动模块的 GPIO 写入次数
+    Counters m_counters;            // 累计运行计数
+
     motor_stop_callback_t m_stop_callback;
 };
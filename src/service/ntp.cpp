@@ -1,50 +1,321 @@
 #include <stdint.h>
 #include "service/ntp.h"
 #include "service/logger.h"
+#include "service/scheduler.h"
+#include "service/recorder.h"
 
-NTPService *NTPService::m_instance = nullptr;
+#include <sys/time.h>
 
-NTPService::NTPService() : m_udp()
+static constexpr uint32_t NTP_UNIX_EPOCH_DIFF = 2208988800UL; // 1900-01-01 到 1970-01-01 的秒数
+
+/** 读取网络字节序的 32 位整数 */
+static uint32_t read_be32(const uint8_t *p)
+{
+    return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+}
+
+/** 将 NTP 时间戳(秒 + 2^-32 秒)转换为 Unix 时间 (us) */
+static int64_t ntp_to_unix_us(const uint8_t *p)
+{
+    uint32_t sec = read_be32(p);
+    uint32_t frac = read_be32(p + 4);
+    return ((int64_t)sec - NTP_UNIX_EPOCH_DIFF) * 1000000LL + (((uint64_t)frac * 1000000ULL) >> 32);
+}
+
+NTPService::NTPService() : m_pcb(nullptr),
+                           m_started(false),
+                           m_state(NTP_IDLE),
+                           m_server_addr(),
+                           m_state_ms(0),
+                           m_last_sync_ms(0),
+                           m_next_sync_ms(0),
+                           m_req_local_us(0),
+                           m_req_cookie(),
+                           m_reply(),
+                           m_reply_local_us(0),
+                           m_reply_ready(false),
+                           m_sync_interval_s(NTP_MIN_INTERVAL),
+                           m_drift_ppm(0.0f),
+                           m_sync_count(0),
+                           m_reject_count(0)
 {
-    m_time_client = new NTPClient(m_udp, NTP_SERVER, NTP_GMT_OFFSET);
-    m_last_sync_ts = 0;
 }
 
 NTPService::~NTPService()
 {
-    delete m_time_client;
+    if (m_pcb != nullptr)
+    {
+        udp_remove(m_pcb);
+        m_pcb = nullptr;
+    }
 }
 
 void NTPService::begin()
 {
-    m_time_client->begin();
-    LoggerService::println("NTP service started.");
-    LoggerService::printf("NTP server: %s, GMT offset: %ld, Sync interval: %ld\n", NTP_SERVER, NTP_GMT_OFFSET, NTP_UPDATE_INTERVAL);
+    // 系统时间保存 UTC, 由时区设置换算本地时间
+    char tz[16];
+    snprintf_P(tz, sizeof(tz), PSTR("UTC%ld"), -NTP_GMT_OFFSET / 3600);
+    setenv("TZ", tz, 1);
+    tzset();
+
+    // 直接使用 lwIP UDP 接口, 应答到达时在接收回调中记录时间戳, 不受调度任务轮询间隔影响
+    m_pcb = udp_new();
+    if (m_pcb == nullptr || udp_bind(m_pcb, IP_ADDR_ANY, NTP_LOCAL_PORT) != ERR_OK)
+    {
+        LoggerService::println(F("Failed to open NTP socket"));
+        if (m_pcb != nullptr)
+        {
+            udp_remove(m_pcb);
+            m_pcb = nullptr;
+        }
+        return;
+    }
+    udp_recv(m_pcb, &NTPService::recv_cb_, this);
+    m_started = true;
+
+    LoggerService::println(F("NTP service started."));
+    LoggerService::printf_P(PSTR("NTP server: %s, GMT offset: %ld, Sync interval: %ld-%ld\n"), NTP_SERVER, NTP_GMT_OFFSET, NTP_MIN_INTERVAL, NTP_MAX_INTERVAL);
+
+    // 立即开始首次同步, 应答在后续调度任务中接收
+    this->start_sync_();
 
-    sync_time_();
+    // 注册时间同步任务
+    SchedulerService::get_instance()->add_periodic(
+        "ntp",
+        []()
+        {
+            NTPService::get_instance()->update();
+        },
+        CHECK_INTERVAL_MS * 1000UL, SchedulerService::PRIO_BACKGROUND);
 }
 
 void NTPService::update(bool force)
 {
-    time_t cur_ts = time(nullptr);
-    if (force || cur_ts > m_last_sync_ts + NTP_UPDATE_INTERVAL)
+    if (!m_started)
+    {
+        return;
+    }
+
+    switch (m_state)
+    {
+    case NTP_IDLE:
+        if (force || (long)(millis() - m_next_sync_ms) >= 0)
+        {
+            LoggerService::println(F("Sync time with NTP server..."));
+            this->start_sync_();
+        }
+        break;
+    case NTP_RESOLVING:
+        if (millis() - m_state_ms > NTP_REPLY_TIMEOUT_MS)
+        {
+            LoggerService::printf_P(PSTR("NTP server %s lookup timed out\n"), NTP_SERVER);
+            this->finish_sync_(false);
+        }
+        break;
+    case NTP_WAIT_REPLY:
+        this->poll_reply_();
+        break;
+    }
+}
+
+int64_t NTPService::epoch_ms() const
+{
+    return now_us_() / 1000;
+}
+
+int64_t NTPService::now_us_()
+{
+    struct timeval tv;
+    gettimeofday(&tv, nullptr);
+    return (int64_t)tv.tv_sec * 1000000LL + tv.tv_usec;
+}
+
+void NTPService::start_sync_()
+{
+    m_state = NTP_RESOLVING;
+    m_state_ms = millis();
+
+    // 已缓存的域名会立即返回, 否则在回调中发送请求
+    err_t err = dns_gethostbyname(NTP_SERVER, &m_server_addr, &NTPService::dns_found_cb_, this);
+    if (err == ERR_OK)
+    {
+        this->send_request_();
+    }
+    else if (err != ERR_INPROGRESS)
+    {
+        this->finish_sync_(false);
+    }
+}
+
+void NTPService::dns_found_cb_(const char *name, const ip_addr_t *ipaddr, void *arg)
+{
+    NTPService *ntp = static_cast<NTPService *>(arg);
+    if (ntp->m_state != NTP_RESOLVING)
+    {
+        return;
+    }
+
+    if (ipaddr == nullptr)
+    {
+        LoggerService::printf_P(PSTR("NTP server %s lookup failed\n"), NTP_SERVER);
+        ntp->finish_sync_(false);
+        return;
+    }
+
+    ntp->m_server_addr = *ipaddr;
+    ntp->send_request_();
+}
+
+void NTPService::recv_cb_(void *arg, struct udp_pcb *pcb, struct pbuf *p, const ip_addr_t *addr, u16_t port)
+{
+    // 应答到达时立即读取本地时间作为 T4, 处理留给调度任务
+    int64_t t4 = now_us_();
+    NTPService *ntp = static_cast<NTPService *>(arg);
+
+    // 只保留来自服务器的、对本次请求的第一个完整应答, 其余 (包括之前遗留的应答) 直接丢弃
+    if (ntp->m_state == NTP_WAIT_REPLY && !ntp->m_reply_ready && port == NTP_PORT &&
+        ip_addr_get_ip4_u32(addr) == ip_addr_get_ip4_u32(&ntp->m_server_addr) && p->tot_len >= NTP_PACKET_SIZE &&
+        pbuf_copy_partial(p, ntp->m_reply, NTP_PACKET_SIZE, 0) == NTP_PACKET_SIZE &&
+        memcmp(ntp->m_reply + 24, ntp->m_req_cookie, sizeof(ntp->m_req_cookie)) == 0)
+    {
+        ntp->m_reply_local_us = t4;
+        ntp->m_reply_ready = true;
+    }
+    pbuf_free(p);
+}
+
+void NTPService::send_request_()
+{
+    struct pbuf *p = pbuf_alloc(PBUF_TRANSPORT, NTP_PACKET_SIZE, PBUF_RAM);
+    if (p == nullptr)
+    {
+        LoggerService::println(F("Failed to send NTP request"));
+        this->finish_sync_(false);
+        return;
+    }
+
+    uint8_t *packet = static_cast<uint8_t *>(p->payload);
+    memset(packet, 0, NTP_PACKET_SIZE);
+    packet[0] = 0x23; // LI = 0, VN = 4, Mode = 3 (客户端)
+
+    // 用随机数填充发送时间戳作为请求标识, 服务器会在应答的起始时间戳中原样返回
+    m_req_cookie[0] = ESP.random();
+    m_req_cookie[1] = ESP.random();
+    memcpy(packet + 40, m_req_cookie, sizeof(m_req_cookie));
+
+    // 先进入等待状态, 之前遗留的应答因标识不符在接收回调中丢弃
+    m_reply_ready = false;
+    m_state = NTP_WAIT_REPLY;
+    m_state_ms = millis();
+
+    m_req_local_us = now_us_();
+    err_t err = udp_sendto(m_pcb, p, &m_server_addr, NTP_PORT);
+    pbuf_free(p);
+    if (err != ERR_OK)
     {
-        LoggerService::printf("Now: %lld, Last sync: %lld, Diff: %lld\n", (int64_t)cur_ts, (int64_t)m_last_sync_ts, (int64_t)cur_ts - (int64_t)m_last_sync_ts);
-        LoggerService::println("Sync time with NTP server...");
-        sync_time_();
+        LoggerService::println(F("Failed to send NTP request"));
+        this->finish_sync_(false);
     }
 }
 
-void NTPService::sync_time_()
+void NTPService::poll_reply_()
 {
-    // 同步时间
-    m_time_client->update();
-    time_t ts = m_time_client->getEpochTime();
+    if (!m_reply_ready)
+    {
+        if (millis() - m_state_ms > NTP_REPLY_TIMEOUT_MS)
+        {
+            LoggerService::println(F("NTP request timed out"));
+            this->finish_sync_(false);
+        }
+        return;
+    }
+
+    // 接收回调已校验来源及请求标识, T4 为应答到达时刻
+    const uint8_t *packet = m_reply;
+    int64_t t4 = m_reply_local_us;
+
+    uint8_t li = packet[0] >> 6;
+    uint8_t mode = packet[0] & 0x07;
+    uint8_t stratum = packet[1];
+    int64_t t2 = ntp_to_unix_us(packet + 32); // 服务器接收时间
+    int64_t t3 = ntp_to_unix_us(packet + 40); // 服务器发送时间
+
+    // 丢弃未同步 (LI = 3)、非服务器应答、KoD (stratum = 0) 及时间不合理的样本
+    if (li == 3 || mode != 4 || stratum == 0 || stratum > 15 || t3 < (int64_t)NTP_MIN_VALID_EPOCH * 1000000LL || t3 < t2)
+    {
+        LoggerService::printf_P(PSTR("NTP reply rejected: li=%u mode=%u stratum=%u\n"), li, mode, stratum);
+        m_reject_count++;
+        this->finish_sync_(false);
+        return;
+    }
+
+    int64_t t1 = m_req_local_us;
+    int64_t delay_us = (t4 - t1) - (t3 - t2);
+    if (delay_us < 0 || delay_us > NTP_MAX_DELAY_MS * 1000LL)
+    {
+        LoggerService::printf_P(PSTR("NTP reply rejected: round trip delay %ld ms\n"), (long)(delay_us / 1000));
+        m_reject_count++;
+        this->finish_sync_(false);
+        return;
+    }
+
+    // 本地时钟偏差 θ = ((T2 - T1) + (T3 - T4)) / 2
+    int64_t offset_us = ((t2 - t1) + (t3 - t4)) / 2;
+
+    // 根据上次同步后累积的偏差估算时钟漂移率
+    unsigned long cur_ms = millis();
+    if (m_sync_count > 0)
+    {
+        unsigned long elapsed_ms = cur_ms - m_last_sync_ms;
+        if (elapsed_ms > NTP_MIN_INTERVAL * 1000UL / 2)
+        {
+            // 本地时钟偏快时 offset 为负, 漂移率为正
+            float drift_ppm = -(float)offset_us * 1000.0f / elapsed_ms;
+            m_drift_ppm = (m_sync_count == 1) ? drift_ppm : (1 - DRIFT_EMA_ALPHA) * m_drift_ppm + DRIFT_EMA_ALPHA * drift_ppm;
+        }
+    }
 
     // 设置系统时间
-    struct timeval tv = {ts, 0};
+    int64_t corrected_us = now_us_() + offset_us;
+    struct timeval tv = {(time_t)(corrected_us / 1000000LL), (suseconds_t)(corrected_us % 1000000LL)};
     settimeofday(&tv, nullptr);
 
-    m_last_sync_ts = time(nullptr);
-    LoggerService::println("Time synchronized.");
+    LoggerService::printf_P(PSTR("Time synchronized: offset %ld ms, delay %ld ms, drift %.1f ppm\n"),
+                            (long)(offset_us / 1000), (long)(delay_us / 1000), m_drift_ppm);
+
+    m_last_sync_ms = cur_ms;
+    m_sync_count++;
+    RECORD_CLOCK(this->epoch_ms());
+    this->finish_sync_(true);
+}
+
+void NTPService::finish_sync_(bool ok)
+{
+    m_state = NTP_IDLE;
+    m_state_ms = millis();
+
+    if (ok)
+    {
+        this->adapt_interval_();
+        m_next_sync_ms = millis() + m_sync_interval_s * 1000UL;
+    }
+    else
+    {
+        m_next_sync_ms = millis() + NTP_RETRY_INTERVAL * 1000UL;
+    }
+}
+
+void NTPService::adapt_interval_()
+{
+    // 首次同步后尽快进行第二次同步以测量漂移率
+    if (m_sync_count < 2)
+    {
+        m_sync_interval_s = NTP_MIN_INTERVAL;
+        return;
+    }
+
+    // 选择使累积误差不超过目标值的同步间隔: 间隔(s) = 误差(us) / 漂移率(ppm)
+    float drift = fabsf(m_drift_ppm);
+    long interval_s = (drift > 0.01f) ? (long)(NTP_TARGET_ERROR_MS * 1000.0f / drift) : NTP_MAX_INTERVAL;
+    m_sync_interval_s = constrain(interval_s, NTP_MIN_INTERVAL, NTP_MAX_INTERVAL);
 }
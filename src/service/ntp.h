@@ -1,24 +1,53 @@
 #pragma once
 
 #include <Arduino.h>
-#include <NTPClient.h>
-#include <WifiUdp.h>
+#include <lwip/dns.h>
+#include <lwip/udp.h>
 #include <time.h>
 
+// 编译时定义 NTP_SERVER_HOST 及 NTP_SERVER_PORT 可改用其他 NTP 服务器, 如 tools/ntp_loopback.py 模拟的测试服务器
+#ifndef NTP_SERVER_HOST
+#define NTP_SERVER_HOST "cn.pool.ntp.org"
+#endif
+#ifndef NTP_SERVER_PORT
+#define NTP_SERVER_PORT 123
+#endif
+
+/** NTP 时间同步服务
+ *
+ * 以非阻塞方式完成域名解析和 NTP 请求/应答交换, 应答由 lwIP 接收回调在到达时记录时间戳 (T4),
+ * 之后在调度任务中处理, 校验失败或不合理的样本会被丢弃。根据相邻两次同步测得的时钟漂移率调整同步间隔。
+ */
 class NTPService
 {
 public:
-    static constexpr const long NTP_UPDATE_INTERVAL = 3600; // 每小时同步一次
-    static constexpr const char *NTP_SERVER = "cn.pool.ntp.org";
-    static constexpr const long NTP_GMT_OFFSET = 8 * 3600; // 时区: UTC+8
+    static constexpr const long NTP_MIN_INTERVAL = 900;     // 最短同步间隔(s)
+    static constexpr const long NTP_MAX_INTERVAL = 21600;   // 最长同步间隔(s)
+    static constexpr const long NTP_RETRY_INTERVAL = 60;    // 同步失败后的重试间隔(s)
+    static constexpr const char *NTP_SERVER = NTP_SERVER_HOST;
+    static constexpr const uint16_t NTP_PORT = NTP_SERVER_PORT;
+    static constexpr const uint16_t NTP_LOCAL_PORT = 2390;
+    static constexpr int NTP_PACKET_SIZE = 48;
+    static constexpr const long NTP_GMT_OFFSET = 8 * 3600;  // 时区: UTC+8
+    static constexpr int CHECK_INTERVAL_MS = 100;           // 检查同步状态及接收应答的间隔(ms)
+    static constexpr int NTP_REPLY_TIMEOUT_MS = 2000;       // 等待应答的超时时间(ms)
+    static constexpr int NTP_MAX_DELAY_MS = 500;            // 允许的最大网络往返延迟(ms)
+    static constexpr int NTP_TARGET_ERROR_MS = 50;          // 两次同步之间允许累积的最大时钟误差(ms)
+    static constexpr time_t NTP_MIN_VALID_EPOCH = 1704067200; // 2024-01-01, 早于此时刻的样本视为不合理
+    static constexpr float DRIFT_EMA_ALPHA = 0.3f;          // 时钟漂移率指数平滑系数
+
+    // 同步状态
+    enum SyncState
+    {
+        NTP_IDLE,       // 等待下次同步
+        NTP_RESOLVING,  // 解析服务器域名
+        NTP_WAIT_REPLY  // 已发送请求, 等待应答
+    };
 
     static NTPService *get_instance()
     {
-        if (m_instance == nullptr)
-        {
-            m_instance = new NTPService();
-        }
-        return m_instance;
+        static NTPService instance;
+        return &instance;
     }
 
     ~NTPService();
@@ -26,14 +55,43 @@ public:
     void begin();
     void update(bool force = false);
 
+    /** 系统时间是否已同步 */
+    bool is_synced() const { return m_sync_count > 0; }
+    /** 获取当前 UTC 时间 (ms) */
+    int64_t epoch_ms() const;
+    /** 获取测得的本地时钟漂移率 (ppm, 正值表示本地时钟偏快) */
+    float get_drift_ppm() const { return m_drift_ppm; }
+    /** 获取当前同步间隔(s) */
+    long get_sync_interval() const { return m_sync_interval_s; }
+
 protected:
     NTPService();
 
-    static NTPService *m_instance;
+    void start_sync_();
+    void send_request_();
+    void poll_reply_();
+    void finish_sync_(bool ok);
+    void adapt_interval_();
+
+    static void dns_found_cb_(const char *name, const ip_addr_t *ipaddr, void *arg);
+    static void recv_cb_(void *arg, struct udp_pcb *pcb, struct pbuf *p, const ip_addr_t *addr, u16_t port);
 
-    void sync_time_();
+    static int64_t now_us_();
 
-    WiFiUDP m_udp;
-    NTPClient *m_time_client;
-    time_t m_last_sync_ts; // 最后一次同 NTP 服务同步的时刻
+    struct udp_pcb *m_pcb;
+    bool m_started;
+    SyncState m_state;
+    ip_addr_t m_server_addr;
+    unsigned long m_state_ms;      // 进入当前状态的时间戳
+    unsigned long m_last_sync_ms;  // 最后一次成功同步的时刻 (millis)
+    unsigned long m_next_sync_ms;  // 下次同步的时刻 (millis)
+    int64_t m_req_local_us;        // 发送请求时的本地时间 (T1)
+    uint32_t m_req_cookie[2];      // 请求中的发送时间戳, 应答中须原样返回
+    uint8_t m_reply[NTP_PACKET_SIZE]; // 接收回调保存的应答
+    int64_t m_reply_local_us;      // 应答到达时的本地时间 (T4)
+    volatile bool m_reply_ready;   // 是否已收到本次请求的应答
+    long m_sync_interval_s;        // 当前同步间隔
+    float m_drift_ppm;             // 本地时钟漂移率
+    uint32_t m_sync_count;         // 成功同步次数
+    uint32_t m_reject_count;       // 被丢弃的样本数
 };
@@ -0,0 +1,165 @@
+#ifdef ENABLE_LOOP_PROFILER
+
+#include "service/profiler.h"
+#include "service/logger.h"
+
+ProfilerService::ProfilerService() : m_slots(),
+                                     m_cycles_per_us(ESP.getCpuFreqMHz()),
+                                     m_last_wdt_feed_us(0),
+                                     m_max_wdt_gap_us(0)
+{
+    m_slots[PASS_SLOT].name = "(pass)";
+}
+
+ProfilerService::~ProfilerService()
+{
+}
+
+void ProfilerService::begin()
+{
+    LoggerService::get_instance()->web_server()->on(WEB_PROFILE_PATH, &ProfilerService::handle_web_profile_);
+    LoggerService::printf_P(PSTR("Loop profiler enabled at http://<ip>:%d%s\n"), LoggerService::WEB_LOG_PORT, WEB_PROFILE_PATH);
+}
+
+void ProfilerService::record(int slot, const char *name, uint32_t cycles)
+{
+    SlotStats *slot_stats = this->find_slot_(slot, name);
+    if (slot_stats == nullptr)
+    {
+        return;
+    }
+
+    SlotStats &stats = *slot_stats;
+    uint32_t us = cycles / m_cycles_per_us;
+
+    stats.count++;
+    stats.total_us += us;
+    if (us > stats.max_us)
+    {
+        stats.max_us = us;
+    }
+
+    // 按耗时的二进制位数分桶: 0us 落入第 0 桶, [2^(i-1), 2^i) us 落入第 i 桶
+    int bucket = us == 0 ? 0 : 32 - __builtin_clz(us);
+    stats.hist[min(bucket, HIST_BUCKETS - 1)]++;
+}
+
+ProfilerService::SlotStats *ProfilerService::find_slot_(int hint, const char *name)
+{
+    // 周期任务始终占用同一调度槽, 通常在同编号的统计槽中直接命中
+    if (hint >= 0 && hint < MAX_SLOTS && m_slots[hint].name != nullptr &&
+        (m_slots[hint].name == name || strcmp(m_slots[hint].name, name) == 0))
+    {
+        return &m_slots[hint];
+    }
+
+    SlotStats *free_stats = nullptr;
+    for (SlotStats &stats : m_slots)
+    {
+        if (stats.name == nullptr)
+        {
+            if (free_stats == nullptr)
+            {
+                free_stats = &stats;
+            }
+        }
+        else if (stats.name == name || strcmp(stats.name, name) == 0)
+        {
+            return &stats;
+        }
+    }
+
+    // 新任务优先占用同编号的空闲统计槽
+    if (hint >= 0 && hint < MAX_SLOTS && m_slots[hint].name == nullptr)
+    {
+        free_stats = &m_slots[hint];
+    }
+    if (free_stats != nullptr)
+    {
+        free_stats->name = name;
+    }
+    return free_stats;
+}
+
+void ProfilerService::note_wdt_feed()
+{
+    unsigned long cur_us = micros();
+    if (m_last_wdt_feed_us != 0)
+    {
+        uint32_t gap_us = cur_us - m_last_wdt_feed_us;
+        if (gap_us > m_max_wdt_gap_us)
+        {
+            m_max_wdt_gap_us = gap_us;
+        }
+    }
+    m_last_wdt_feed_us = cur_us;
+}
+
+void ProfilerService::reset()
+{
+    for (int i = 0; i < MAX_SLOTS; i++)
+    {
+        const char *name = m_slots[i].name;
+        memset(&m_slots[i], 0, sizeof(SlotStats));
+        m_slots[i].name = name;
+    }
+    m_max_wdt_gap_us = 0;
+}
+
+uint32_t ProfilerService::get_max_task_us() const
+{
+    uint32_t max_us = 0;
+    for (int i = 0; i < SchedulerService::MAX_TASKS; i++)
+    {
+        max_us = max(max_us, m_slots[i].max_us);
+    }
+    return max_us;
+}
+
+void ProfilerService::handle_web_profile_()
+{
+    ProfilerService *profiler = ProfilerService::get_instance();
+    ESP8266WebServer *server = LoggerService::get_instance()->web_server();
+
+    if (server->hasArg("reset"))
+    {
+        profiler->reset();
+        server->send_P(200, PSTR("text/plain"), PSTR("Profiler reset.\n"));
+        return;
+    }
+
+    server->setContentLength(CONTENT_LENGTH_UNKNOWN);
+    server->send(200, "text/plain", "");
+
+    char buf[160];
+    snprintf_P(buf, sizeof(buf), PSTR("max_wdt_gap_us %lu\n\n"), (unsigned long)profiler->m_max_wdt_gap_us);
+    server->sendContent(buf);
+
+    for (int i = 0; i < MAX_SLOTS; i++)
+    {
+        const SlotStats &stats = profiler->m_slots[i];
+        if (stats.count == 0)
+        {
+            continue;
+        }
+
+        snprintf_P(buf, sizeof(buf), PSTR("%s: count=%lu avg_us=%lu max_us=%lu\n  hist:"),
+                   stats.name ? stats.name : "?", (unsigned long)stats.count,
+                   (unsigned long)(stats.total_us / stats.count), (unsigned long)stats.max_us);
+        server->sendContent(buf);
+
+        // 只输出非空的分桶, 格式为 <上界us>:<次数>
+        for (int b = 0; b < HIST_BUCKETS; b++)
+        {
+            if (stats.hist[b] > 0)
+            {
+                snprintf_P(buf, sizeof(buf), PSTR(" <%lu:%lu"), 1UL << b, (unsigned long)stats.hist[b]);
+                server->sendContent(buf);
+            }
+        }
+        server->sendContent_P(PSTR("\n"));
+    }
+    server->sendContent("");
+}
+
+#endif
@@ -0,0 +1,91 @@
+#pragma once
+
+#include "service/scheduler.h"
+
+#include <Arduino.h>
+
+// 编译时定义 ENABLE_LOOP_PROFILER 启用主循环性能分析, 未定义时以下宏均为空操作
+#ifdef ENABLE_LOOP_PROFILER
+#define PROFILE_BEGIN(var) uint32_t var = ESP.getCycleCount()
+#define PROFILE_END(slot, name, var) ProfilerService::get_instance()->record((slot), (name), ESP.getCycleCount() - (var))
+#define PROFILE_WDT_FEED() ProfilerService::get_instance()->note_wdt_feed()
+#else
+#define PROFILE_BEGIN(var) \
+    do                     \
+    {                      \
+    } while (0)
+#define PROFILE_END(slot, name, var) \
+    do                               \
+    {                                \
+    } while (0)
+#define PROFILE_WDT_FEED() \
+    do                     \
+    {                      \
+    } while (0)
+#endif
+
+#ifdef ENABLE_LOOP_PROFILER
+
+/** 主循环性能分析服务
+ *
+ * 用 CPU 周期计数器统计每个调度任务单次运行耗时, 按 2 的幂次分桶记录耗时分布及最大值,
+ * 统计按任务名称区分, 单次任务先后复用同一调度槽时各自统计;
+ * 同时记录两次喂狗之间的最长间隔, 通过 HTTP 接口输出统计数据。
+ */
+class ProfilerService
+{
+public:
+    static constexpr int MAX_SLOTS = SchedulerService::MAX_TASKS + 1; // 每个任务名称一个统计槽, 另加一个整轮统计槽
+    static constexpr int PASS_SLOT = SchedulerService::MAX_TASKS;     // 整轮循环(不含空闲时间)统计槽
+    static constexpr int HIST_BUCKETS = 21;                           // 耗时分桶数, 第 i 桶为 [2^(i-1), 2^i) us
+    static constexpr const char *WEB_PROFILE_PATH = "/profile";
+
+    struct SlotStats
+    {
+        const char *name;
+        uint32_t count;
+        uint32_t max_us;
+        uint64_t total_us;
+        uint32_t hist[HIST_BUCKETS];
+    };
+
+    static ProfilerService *get_instance()
+    {
+        static ProfilerService instance;
+        return &instance;
+    }
+
+    ~ProfilerService();
+
+    /** 注册 HTTP 统计数据接口 (须在日志服务启动后调用) */
+    void begin();
+
+    /** 记录一次运行耗时 (CPU 周期数), slot 为调度槽编号, 优先查找同一编号的统计槽 */
+    void record(int slot, const char *name, uint32_t cycles);
+    /** 记录一次喂狗 */
+    void note_wdt_feed();
+    /** 清除所有统计数据 */
+    void reset();
+
+    /** 获取统计槽数据 */
+    const SlotStats &get_slot(int slot) const { return m_slots[slot]; }
+    /** 获取所有任务中的最大单次运行耗时(us) */
+    uint32_t get_max_task_us() const;
+    /** 获取两次喂狗间的最长间隔(us) */
+    uint32_t get_max_wdt_gap_us() const { return m_max_wdt_gap_us; }
+
+protected:
+    ProfilerService();
+
+    static void handle_web_profile_();
+
+    /** 查找任务名称对应的统计槽, 没有时占用空闲统计槽, 已满时返回 nullptr */
+    SlotStats *find_slot_(int hint, const char *name);
+
+    SlotStats m_slots[MAX_SLOTS];
+    uint32_t m_cycles_per_us;
+    unsigned long m_last_wdt_feed_us;
+    uint32_t m_max_wdt_gap_us;
+};
+
+#endif
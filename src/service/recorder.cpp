@@ -0,0 +1,375 @@
+#include "service/recorder.h"
+
+#ifdef ENABLE_RECORDER
+
+#include "service/config.h"
+#include "service/logger.h"
+#include "service/motor.h"
+#include "service/ntp.h"
+#include "service/scheduler.h"
+
+#include <LittleFS.h>
+
+// 启动记录负载: millis, 复位原因, 通道数, 各通道配置结构, 分组名称长度 (varint, 1 字节) 及分组名称
+static constexpr size_t BOOT_PAYLOAD_SIZE = 6 +
+                                            MOTOR_CHANNELS * (sizeof(ConfigService::MotorConf) + sizeof(ConfigService::TuningConf) +
+                                                              sizeof(ConfigService::CalibrationConf)) +
+                                            1 + sizeof(ConfigService::ConfigData::mqtt_group);
+
+/** 写入无符号 varint (每字节 7 位, 低位在前), 返回字节数 */
+static size_t put_varint(uint8_t *p, uint32_t value)
+{
+    size_t n = 0;
+    while (value >= 0x80)
+    {
+        p[n++] = (uint8_t)(value | 0x80);
+        value >>= 7;
+    }
+    p[n++] = (uint8_t)value;
+    return n;
+}
+
+/** 写入 zigzag 编码的有符号 varint */
+static size_t put_svarint(uint8_t *p, int32_t value)
+{
+    return put_varint(p, ((uint32_t)value << 1) ^ (uint32_t)(value >> 31));
+}
+
+RecorderService::RecorderService() : m_started(false),
+                                     m_buffer(),
+                                     m_head(0),
+                                     m_tail(0),
+                                     m_used(0),
+                                     m_last_us(0),
+                                     m_last_pos(),
+                                     m_last_pwm(),
+                                     m_dropped(0),
+                                     m_dropped_total(0),
+                                     m_rotate_requested(false),
+                                     m_rotate_pos(-1),
+                                     m_file_size(0),
+                                     m_write_failed(false)
+{
+}
+
+RecorderService::~RecorderService()
+{
+}
+
+void RecorderService::begin()
+{
+    // 上次运行的记录保留为旧文件, 复现重启相关问题时需要
+    this->rotate_();
+    m_started = true;
+    m_last_us = micros();
+
+    // 同步记录给出各通道当前的编码器读数, 重放时以此恢复位置
+    for (int ch = 0; ch < MOTOR_CHANNELS; ch++)
+    {
+        m_last_pos[ch] = MotorService::get_instance(ch)->get_motor_pos();
+    }
+    this->write_sync_();
+
+    SchedulerService::get_instance()->add_periodic("recorder", &RecorderService::flush_task_, FLUSH_INTERVAL_US,
+                                                   SchedulerService::PRIO_BACKGROUND);
+    LoggerService::get_instance()->web_server()->on(WEB_RECORD_PATH, &RecorderService::handle_web_record_);
+}
+
+void RecorderService::encoder(uint8_t channel, long pos)
+{
+    if (pos == m_last_pos[channel])
+    {
+        return;
+    }
+    uint8_t buf[6];
+    buf[0] = channel;
+    size_t n = 1 + put_svarint(buf + 1, pos - m_last_pos[channel]);
+    m_last_pos[channel] = pos;
+    this->push_(TYPE_ENCODER, buf, n);
+}
+
+void RecorderService::pwm(uint8_t channel, int pwm)
+{
+    if (pwm == m_last_pwm[channel])
+    {
+        return;
+    }
+    m_last_pwm[channel] = pwm;
+    uint8_t buf[6];
+    buf[0] = channel;
+    size_t n = 1 + put_svarint(buf + 1, pwm);
+    this->push_(TYPE_PWM, buf, n);
+}
+
+void RecorderService::stop(uint8_t channel, long pos, uint8_t reason)
+{
+    uint8_t buf[7];
+    buf[0] = channel;
+    size_t n = 1 + put_svarint(buf + 1, pos);
+    buf[n++] = reason;
+    this->push_(TYPE_STOP, buf, n);
+}
+
+void RecorderService::ir(uint16_t address, uint8_t command, uint8_t flags)
+{
+    uint8_t buf[4] = {(uint8_t)address, (uint8_t)(address >> 8), command, flags};
+    this->push_(TYPE_IR, buf, sizeof(buf));
+}
+
+void RecorderService::mqtt(const char *topic, const uint8_t *payload, uint16_t length)
+{
+    // 过长的主题及负载截断记录
+    uint8_t buf[4 + 2 * MAX_TEXT_LEN];
+    size_t topic_len = min(strlen(topic), (size_t)MAX_TEXT_LEN);
+    size_t payload_len = min((size_t)length, (size_t)MAX_TEXT_LEN);
+    size_t n = put_varint(buf, topic_len);
+    memcpy(buf + n, topic, topic_len);
+    n += topic_len;
+    n += put_varint(buf + n, payload_len);
+    memcpy(buf + n, payload, payload_len);
+    n += payload_len;
+    this->push_(TYPE_MQTT, buf, n);
+}
+
+void RecorderService::http()
+{
+    // 以 "<路径>?<参数名>=<参数值>&..." 的形式记录请求
+    ESP8266WebServer *server = LoggerService::get_instance()->web_server();
+    char text[MAX_TEXT_LEN + 1];
+    int len = snprintf(text, sizeof(text), "%s", server->uri().c_str());
+    for (int i = 0; i < server->args() && len < MAX_TEXT_LEN; i++)
+    {
+        len += snprintf(text + len, sizeof(text) - len, "%c%s=%s", i == 0 ? '?' : '&',
+                        server->argName(i).c_str(), server->arg(i).c_str());
+    }
+    len = min(len, MAX_TEXT_LEN);
+
+    uint8_t buf[3 + MAX_TEXT_LEN];
+    buf[0] = (uint8_t)server->method();
+    size_t n = 1 + put_varint(buf + 1, len);
+    memcpy(buf + n, text, len);
+    this->push_(TYPE_HTTP, buf, n + len);
+}
+
+void RecorderService::clock(int64_t epoch_ms)
+{
+    uint8_t buf[sizeof(epoch_ms)];
+    memcpy(buf, &epoch_ms, sizeof(epoch_ms));
+    this->push_(TYPE_CLOCK, buf, sizeof(buf));
+}
+
+void RecorderService::push_(Type type, const uint8_t *payload, size_t len)
+{
+    if (!m_started)
+    {
+        return;
+    }
+
+    // 文件超过上限后, 在下一条记录前写入同步记录, 后台任务写到该位置时轮换文件
+    if (m_rotate_requested && m_rotate_pos < 0)
+    {
+        size_t pos = m_head;
+        if (!this->write_sync_())
+        {
+            m_dropped++;
+            m_dropped_total++;
+            return;
+        }
+        m_rotate_pos = (int)pos;
+    }
+
+    if (m_dropped > 0)
+    {
+        uint8_t buf[5];
+        if (!this->write_(TYPE_DROPPED, buf, put_varint(buf, m_dropped)))
+        {
+            m_dropped++;
+            m_dropped_total++;
+            return;
+        }
+        m_dropped = 0;
+    }
+
+    if (!this->write_(type, payload, len))
+    {
+        m_dropped++;
+        m_dropped_total++;
+    }
+}
+
+bool RecorderService::write_(Type type, const uint8_t *payload, size_t len)
+{
+    unsigned long cur_us = micros();
+    uint8_t head[6];
+    head[0] = type;
+    size_t n = 1 + put_varint(head + 1, cur_us - m_last_us);
+    if (BUFFER_SIZE - m_used < n + len)
+    {
+        return false;
+    }
+
+    for (size_t i = 0; i < n + len; i++)
+    {
+        m_buffer[m_head] = i < n ? head[i] : payload[i - n];
+        m_head = (m_head + 1) % BUFFER_SIZE;
+    }
+    m_used += n + len;
+    m_last_us = cur_us;
+    return true;
+}
+
+bool RecorderService::write_sync_()
+{
+    // 给出绝对时刻、UTC 时间及各通道编码器读数, 之后的差值以此为起点
+    uint8_t buf[4 + 8 + MOTOR_CHANNELS * 5];
+    uint32_t cur_us = micros();
+    memcpy(buf, &cur_us, sizeof(cur_us));
+    NTPService *ntp = NTPService::get_instance();
+    int64_t epoch_ms = ntp->is_synced() ? ntp->epoch_ms() : 0;
+    memcpy(buf + 4, &epoch_ms, sizeof(epoch_ms));
+    size_t n = 12;
+    for (int ch = 0; ch < MOTOR_CHANNELS; ch++)
+    {
+        n += put_svarint(buf + n, m_last_pos[ch]);
+    }
+    return this->write_(TYPE_SYNC, buf, n);
+}
+
+size_t RecorderService::build_boot_(uint8_t *buf)
+{
+    // 保存标定数据、控制参数及同步移动分组, 重放时以此恢复初始状态
+    ConfigService *config = ConfigService::get_instance();
+    uint32_t boot_ms = millis();
+    memcpy(buf, &boot_ms, sizeof(boot_ms));
+    buf[4] = (uint8_t)ESP.getResetInfoPtr()->reason;
+    buf[5] = MOTOR_CHANNELS;
+    size_t n = 6;
+    for (int ch = 0; ch < MOTOR_CHANNELS; ch++)
+    {
+        memcpy(buf + n, &config->motor(ch), sizeof(ConfigService::MotorConf));
+        n += sizeof(ConfigService::MotorConf);
+        memcpy(buf + n, &config->tuning(ch), sizeof(ConfigService::TuningConf));
+        n += sizeof(ConfigService::TuningConf);
+        memcpy(buf + n, &config->calibration(ch), sizeof(ConfigService::CalibrationConf));
+        n += sizeof(ConfigService::CalibrationConf);
+    }
+    size_t group_len = strnlen(config->mqtt_group(), sizeof(ConfigService::ConfigData::mqtt_group) - 1);
+    n += put_varint(buf + n, group_len);
+    memcpy(buf + n, config->mqtt_group(), group_len);
+    return n + group_len;
+}
+
+void RecorderService::flush_task_()
+{
+    RecorderService::get_instance()->flush_();
+}
+
+void RecorderService::flush_()
+{
+    if (m_rotate_pos >= 0)
+    {
+        this->drain_(((size_t)m_rotate_pos + BUFFER_SIZE - m_tail) % BUFFER_SIZE);
+        this->rotate_();
+        m_rotate_pos = -1;
+        m_rotate_requested = false;
+    }
+    this->drain_(m_used);
+
+    if (m_file_size >= MAX_FILE_SIZE)
+    {
+        m_rotate_requested = true;
+    }
+}
+
+void RecorderService::drain_(size_t n)
+{
+    if (n == 0)
+    {
+        return;
+    }
+
+    File file = LittleFS.open(RECORD_FILE, "a");
+    if (file && m_file_size == 0)
+    {
+        FileHeader header = {RECORD_MAGIC, RECORD_VERSION, MOTOR_CHANNELS, 0};
+        m_file_size += file.write((const uint8_t *)&header, sizeof(header));
+
+        // 每个文件以启动记录开头, 时间间隔记为 0, 其时刻由之后的同步记录确定
+        uint8_t boot[2 + BOOT_PAYLOAD_SIZE];
+        boot[0] = TYPE_BOOT;
+        boot[1] = 0;
+        m_file_size += file.write(boot, 2 + this->build_boot_(boot + 2));
+    }
+
+    // 缓冲区回绕时分两段写入, 写入失败的数据同样丢弃, 不阻塞记录
+    while (n > 0)
+    {
+        size_t chunk = min(n, (size_t)BUFFER_SIZE - m_tail);
+        size_t written = file ? file.write(m_buffer + m_tail, chunk) : 0;
+        if (written != chunk && !m_write_failed)
+        {
+            m_write_failed = true;
+            LoggerService::printf_P(PSTR("Recorder: failed to write %s\n"), RECORD_FILE);
+        }
+        m_file_size += written;
+        m_tail = (m_tail + chunk) % BUFFER_SIZE;
+        m_used -= chunk;
+        n -= chunk;
+    }
+    if (file)
+    {
+        file.close();
+    }
+}
+
+void RecorderService::rotate_()
+{
+    if (LittleFS.exists(RECORD_FILE))
+    {
+        LittleFS.remove(RECORD_OLD_FILE);
+        LittleFS.rename(RECORD_FILE, RECORD_OLD_FILE);
+    }
+    m_file_size = 0;
+}
+
+void RecorderService::handle_web_record_()
+{
+    RecorderService *rec = RecorderService::get_instance();
+    ESP8266WebServer *server = LoggerService::get_instance()->web_server();
+
+    if (server->hasArg("clear"))
+    {
+        // 丢弃缓冲区内容, 新文件以启动记录及同步记录开头
+        LittleFS.remove(RECORD_FILE);
+        LittleFS.remove(RECORD_OLD_FILE);
+        rec->m_tail = rec->m_head;
+        rec->m_used = 0;
+        rec->m_file_size = 0;
+        rec->m_rotate_requested = false;
+        rec->m_rotate_pos = -1;
+        rec->write_sync_();
+        server->send_P(200, PSTR("text/plain"), PSTR("Recording cleared.\n"));
+        return;
+    }
+
+    // 下载当前文件前先写入缓冲区中的记录
+    rec->flush_();
+    File file = LittleFS.open(server->hasArg("old") ? RECORD_OLD_FILE : RECORD_FILE, "r");
+    if (!file)
+    {
+        server->send_P(404, PSTR("text/plain"), PSTR("Recording not found.\n"));
+        return;
+    }
+
+    server->setContentLength(file.size());
+    server->send_P(200, PSTR("application/octet-stream"), PSTR(""));
+    uint8_t chunk[512];
+    int n;
+    while ((n = file.read(chunk, sizeof(chunk))) > 0)
+    {
+        server->sendContent((const char *)chunk, n);
+    }
+    file.close();
+}
+
+#endif
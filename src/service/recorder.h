@@ -0,0 +1,165 @@
+#pragma once
+
+#include "config/pins.h"
+
+#include <Arduino.h>
+
+// 编译时定义 ENABLE_RECORDER 启用输入记录, 未定义时以下宏均为空操作
+#ifdef ENABLE_RECORDER
+#define RECORD_ENCODER(channel, pos) RecorderService::get_instance()->encoder((channel), (pos))
+#define RECORD_PWM(channel, value) RecorderService::get_instance()->pwm((channel), (value))
+#define RECORD_STOP(channel, pos, reason) RecorderService::get_instance()->stop((channel), (pos), (reason))
+#define RECORD_IR(address, command, flags) RecorderService::get_instance()->ir((address), (command), (flags))
+#define RECORD_MQTT(topic, payload, length) RecorderService::get_instance()->mqtt((topic), (payload), (length))
+#define RECORD_HTTP() RecorderService::get_instance()->http()
+#define RECORD_CLOCK(epoch_ms) RecorderService::get_instance()->clock((epoch_ms))
+#else
+#define RECORD_ENCODER(channel, pos) \
+    do                               \
+    {                                \
+    } while (0)
+#define RECORD_PWM(channel, value) \
+    do                             \
+    {                              \
+    } while (0)
+#define RECORD_STOP(channel, pos, reason) \
+    do                                    \
+    {                                     \
+    } while (0)
+#define RECORD_IR(address, command, flags) \
+    do                                     \
+    {                                      \
+    } while (0)
+#define RECORD_MQTT(topic, payload, length) \
+    do                                      \
+    {                                       \
+    } while (0)
+#define RECORD_HTTP() \
+    do                \
+    {                 \
+    } while (0)
+#define RECORD_CLOCK(epoch_ms) \
+    do                         \
+    {                          \
+    } while (0)
+#endif
+
+#ifdef ENABLE_RECORDER
+
+/** 输入记录服务
+ *
+ * 按时间顺序记录所有外部输入 (每个控制周期变化的编码器读数、红外帧、MQTT 消息、HTTP 控制请求、NTP 时间)
+ * 及电机输出 (PWM 变化、停止事件), 用于在主机上复现现场问题并比较重放结果。
+ * 每条记录为 <类型><距上条记录的时间间隔 us (varint)><负载>, 有符号数以 zigzag varint 编码,
+ * 编码器读数记录相对上次记录值的差, 由文件开头的同步记录给出各通道的起始位置。
+ * 每个文件 (包括轮换及清空后的新文件) 以启动记录开头, 可以单独重放。
+ * 控制路径只把记录追加到内存缓冲区, 后台任务定时写入文件系统, 缓冲区满时丢弃并记录丢弃数。
+ * 文件超过上限时在下一条记录处轮换为旧文件, 启动时上次运行的记录同样轮换为旧文件。
+ * 记录格式的解码及比较见 tools/rec_decode.py, 主机重放驱动见 src/host/replay_main.cpp (pio run -e replay)。
+ */
+class RecorderService
+{
+public:
+    static constexpr int BUFFER_SIZE = 2048;                     // 内存缓冲区大小
+    static constexpr unsigned long FLUSH_INTERVAL_US = 100000;   // 写入文件系统的间隔(us)
+    static constexpr size_t MAX_FILE_SIZE = 128 * 1024;          // 单个记录文件大小上限
+    static constexpr const char *RECORD_FILE = "/rec.bin";
+    static constexpr const char *RECORD_OLD_FILE = "/rec.old";
+    static constexpr const char *WEB_RECORD_PATH = "/record";    // 下载当前记录, ?old 下载上一个文件, ?clear 清空记录
+    static constexpr uint32_t RECORD_MAGIC = 0x54524243;         // "CBRT"
+    static constexpr uint8_t RECORD_VERSION = 2;
+    static constexpr int MAX_TEXT_LEN = 96;                      // MQTT 主题、负载及 HTTP 请求的最大记录长度
+
+    // 记录类型
+    enum Type : uint8_t
+    {
+        TYPE_BOOT = 1,    // 启动 (文件开头): millis, 复位原因, 通道数, 各通道电机标定数据、控制参数及开度标定点 (ConfigService 原始结构), 同步移动分组名称
+        TYPE_SYNC = 2,    // 同步: micros, UTC 时间 ms (未同步时为 0), 各通道编码器位置
+        TYPE_ENCODER = 3, // 编码器读数变化: 通道, 差值
+        TYPE_IR = 4,      // 红外帧 (含校验失败及去抖丢弃的帧): 地址, 命令, 标志
+        TYPE_MQTT = 5,    // MQTT 消息: 主题, 负载
+        TYPE_HTTP = 6,    // HTTP 控制请求: 方法, 路径及参数
+        TYPE_PWM = 7,     // PWM 输出变化: 通道, PWM 值
+        TYPE_STOP = 8,    // 电机停止: 通道, 位置, 停止原因
+        TYPE_DROPPED = 9, // 缓冲区满丢弃的记录数
+        TYPE_CLOCK = 10   // NTP 同步完成: UTC 时间 ms
+    };
+
+    /** 文件头 */
+    struct FileHeader
+    {
+        uint32_t magic;
+        uint8_t version;
+        uint8_t channels; // 电机通道数
+        uint16_t reserved;
+    };
+
+    static RecorderService *get_instance()
+    {
+        static RecorderService instance;
+        return &instance;
+    }
+
+    ~RecorderService();
+
+    /** 轮换上次运行的记录, 写入同步记录并注册后台写入任务及 HTTP 下载接口
+     * (须在配置服务、日志服务、电机服务及应用程序启动后调用) */
+    void begin();
+
+    /** 编码器读数 (未按转向换算), 每个控制周期调用, 只记录变化 */
+    void encoder(uint8_t channel, long pos);
+    /** PWM 输出, 只记录变化 */
+    void pwm(uint8_t channel, int pwm);
+    /** 电机停止 */
+    void stop(uint8_t channel, long pos, uint8_t reason);
+    /** 红外帧 */
+    void ir(uint16_t address, uint8_t command, uint8_t flags);
+    /** MQTT 消息 */
+    void mqtt(const char *topic, const uint8_t *payload, uint16_t length);
+    /** 当前 HTTP 控制请求 */
+    void http();
+    /** NTP 同步后的 UTC 时间(ms) */
+    void clock(int64_t epoch_ms);
+
+    /** 获取丢弃的记录总数 */
+    uint32_t get_dropped_total() const { return m_dropped_total; }
+
+protected:
+    RecorderService();
+
+    static void flush_task_();
+    static void handle_web_record_();
+
+    /** 追加一条记录, 必要时先写入轮换同步记录及丢弃计数 */
+    void push_(Type type, const uint8_t *payload, size_t len);
+    /** 写入一条记录, 缓冲区空间不足时返回 false */
+    bool write_(Type type, const uint8_t *payload, size_t len);
+    /** 写入同步记录 */
+    bool write_sync_();
+    /** 生成启动记录的负载 (当前配置快照), 返回字节数 */
+    size_t build_boot_(uint8_t *buf);
+    /** 把缓冲区开头的 n 个字节追加到记录文件, 新文件先写入文件头及启动记录 */
+    void drain_(size_t n);
+    /** 把缓冲区内容写入文件系统, 到达轮换位置时轮换文件 */
+    void flush_();
+    /** 当前文件轮换为旧文件 */
+    void rotate_();
+
+    bool m_started;
+    uint8_t m_buffer[BUFFER_SIZE]; // 循环缓冲区
+    size_t m_head;                 // 写入位置
+    size_t m_tail;                 // 读取位置
+    size_t m_used;                 // 已用字节数
+    unsigned long m_last_us;       // 上条记录的时刻
+    long m_last_pos[MOTOR_CHANNELS]; // 各通道最近记录的编码器读数
+    int m_last_pwm[MOTOR_CHANNELS];  // 各通道最近记录的 PWM 值
+
+    uint32_t m_dropped;          // 尚未记录的丢弃数
+    uint32_t m_dropped_total;    // 丢弃总数
+    bool m_rotate_requested;     // 文件已超过上限, 等待下一条记录处轮换
+    int m_rotate_pos;            // 轮换同步记录在缓冲区中的位置, -1 表示无
+    size_t m_file_size;          // 当前记录文件大小
+    bool m_write_failed;         // 是否已报告写入失败
+};
+
+#endif
@@ -0,0 +1,181 @@
+#include "service/scheduler.h"
+#include "service/logger.h"
+#include "service/profiler.h"
+
+SchedulerService::SchedulerService() : m_tasks(),
+                                       m_loop_count(0),
+                                       m_stats_loops(0),
+                                       m_stats_idle_us(0),
+                                       m_stats_max_pass_us(0),
+                                       m_stats_start_ms(0),
+                                       m_loop_rate(0),
+                                       m_idle_permille(0),
+                                       m_max_pass_us(0)
+{
+}
+
+SchedulerService::~SchedulerService()
+{
+}
+
+int SchedulerService::add_periodic(const char *name, task_func_t func, unsigned long interval_us, TaskPriority prio)
+{
+    return this->add_task_(name, func, max(interval_us, 1UL), 0, prio);
+}
+
+int SchedulerService::add_oneshot(const char *name, task_func_t func, unsigned long delay_us, TaskPriority prio)
+{
+    return this->add_task_(name, func, 0, delay_us, prio);
+}
+
+int SchedulerService::add_task_(const char *name, task_func_t func, unsigned long interval_us, unsigned long delay_us, TaskPriority prio)
+{
+    for (int i = 0; i < MAX_TASKS; i++)
+    {
+        Task &task = m_tasks[i];
+        if (!task.active)
+        {
+            task.name = name;
+            task.func = func;
+            task.interval_us = interval_us;
+            task.deadline_us = micros() + delay_us;
+            task.prio = prio;
+            task.active = true;
+            return i;
+        }
+    }
+
+    LoggerService::printf_P(PSTR("Scheduler: no free slot for task %s\n"), name);
+    return -1;
+}
+
+void SchedulerService::cancel(int task_id)
+{
+    if (task_id >= 0 && task_id < MAX_TASKS)
+    {
+        m_tasks[task_id].active = false;
+    }
+}
+
+void SchedulerService::set_interval(int task_id, unsigned long interval_us)
+{
+    if (task_id >= 0 && task_id < MAX_TASKS && m_tasks[task_id].interval_us > 0)
+    {
+        m_tasks[task_id].interval_us = max(interval_us, 1UL);
+    }
+}
+
+void SchedulerService::run()
+{
+    m_loop_count++;
+    m_stats_loops++;
+
+    unsigned long pass_start_us = micros();
+    PROFILE_BEGIN(pass_start);
+
+    // 按优先级从高到低执行到期任务, 保证电机控制最先运行
+    for (uint8_t prio = 0; prio < PRIO_LEVELS; prio++)
+    {
+        for (int i = 0; i < MAX_TASKS; i++)
+        {
+            Task &task = m_tasks[i];
+            if (!task.active || task.prio != prio)
+            {
+                continue;
+            }
+
+            unsigned long cur_us = micros();
+            if ((long)(cur_us - task.deadline_us) < 0)
+            {
+                continue;
+            }
+
+            if (task.interval_us == 0)
+            {
+                // 单次任务执行前先释放, 允许任务在回调中重新注册
+                task.active = false;
+            }
+            else if (cur_us - task.deadline_us >= task.interval_us)
+            {
+                // 落后超过一个周期时不追赶错过的运行
+                task.deadline_us = cur_us + task.interval_us;
+            }
+            else
+            {
+                task.deadline_us += task.interval_us;
+            }
+
+            PROFILE_BEGIN(task_start);
+            task.func();
+            PROFILE_END(i, task.name, task_start);
+        }
+    }
+
+    PROFILE_END(ProfilerService::PASS_SLOT, "(pass)", pass_start);
+
+    uint32_t pass_us = micros() - pass_start_us;
+    if (pass_us > m_stats_max_pass_us)
+    {
+        m_stats_max_pass_us = pass_us;
+    }
+
+    // 找出最近的截止时间并在此之前空闲
+    unsigned long cur_us = micros();
+    unsigned long next_deadline_us = cur_us + MIN_SLEEP_US * 10;
+    for (int i = 0; i < MAX_TASKS; i++)
+    {
+        const Task &task = m_tasks[i];
+        if (task.active && (long)(task.deadline_us - next_deadline_us) < 0)
+        {
+            next_deadline_us = task.deadline_us;
+        }
+    }
+    this->idle_until_(next_deadline_us);
+
+    this->report_stats_();
+}
+
+void SchedulerService::idle_until_(unsigned long deadline_us)
+{
+    unsigned long start_us = micros();
+    long wait_us = (long)(deadline_us - start_us);
+    if (wait_us <= 0)
+    {
+        return;
+    }
+
+    if ((unsigned long)wait_us >= MIN_SLEEP_US)
+    {
+        // delay() 让出 CPU 给 WiFi 协议栈并允许调制解调器休眠
+        delay(wait_us / 1000);
+    }
+    else
+    {
+        yield();
+    }
+
+    m_stats_idle_us += micros() - start_us;
+}
+
+void SchedulerService::report_stats_()
+{
+    unsigned long cur_ms = millis();
+    unsigned long elapsed_ms = cur_ms - m_stats_start_ms;
+    if (elapsed_ms < STATS_REPORT_INTERVAL_MS)
+    {
+        return;
+    }
+
+    m_loop_rate = (uint32_t)((uint64_t)m_stats_loops * 1000 / elapsed_ms);
+    m_idle_permille = (uint16_t)min((uint64_t)m_stats_idle_us / elapsed_ms, (uint64_t)1000);
+    m_max_pass_us = m_stats_max_pass_us;
+
+    LoggerService::printf_P(PSTR("Scheduler: %lu loop passes/s, CPU idle %u.%u%%, max pass %lu us\n"),
+                            (unsigned long)m_loop_rate, m_idle_permille / 10, m_idle_permille % 10,
+                            (unsigned long)m_max_pass_us);
+
+    m_stats_start_ms = cur_ms;
+    m_stats_loops = 0;
+    m_stats_idle_us = 0;
+    m_stats_max_pass_us = 0;
+}
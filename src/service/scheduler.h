@@ -0,0 +1,85 @@
+#pragma once
+
+#include <Arduino.h>
+
+/** 协作式截止时间调度服务
+ *
+ * 各服务在 begin() 中注册周期任务或单次任务，主循环每轮只运行到期的任务，
+ * 同一轮中按优先级从高到低（数值从小到大）执行，空闲时间让出 CPU 或休眠。
+ */
+class SchedulerService
+{
+public:
+    static constexpr int MAX_TASKS = 16;                    // 最大任务数
+    static constexpr int STATS_REPORT_INTERVAL_MS = 60000;  // 调度统计报告间隔时间(ms)
+    static constexpr unsigned long MIN_SLEEP_US = 1000;     // 空闲时间超过该值时休眠, 否则仅让出 CPU
+
+    // 任务优先级, 数值越小优先级越高
+    enum TaskPriority
+    {
+        PRIO_CONTROL = 0,    // 电机控制
+        PRIO_INPUT = 1,      // 红外遥控等本地输入
+        PRIO_NETWORK = 2,    // 网络通信
+        PRIO_BACKGROUND = 3, // 时间同步等后台任务
+        PRIO_LEVELS = 4
+    };
+
+    using task_func_t = void (*)();
+
+    static SchedulerService *get_instance()
+    {
+        static SchedulerService instance;
+        return &instance;
+    }
+
+    ~SchedulerService();
+
+    /** 注册周期任务, 返回任务编号, 失败时返回 -1 */
+    int add_periodic(const char *name, task_func_t func, unsigned long interval_us, TaskPriority prio);
+    /** 注册单次任务, 在 delay_us 后执行一次, 返回任务编号, 失败时返回 -1 */
+    int add_oneshot(const char *name, task_func_t func, unsigned long delay_us, TaskPriority prio);
+    /** 取消任务 */
+    void cancel(int task_id);
+    /** 修改周期任务的运行间隔 */
+    void set_interval(int task_id, unsigned long interval_us);
+
+    /** 运行一轮调度: 执行所有到期任务, 然后在下一个截止时间前让出 CPU */
+    void run();
+
+    /** 获取上一统计周期的每秒循环轮数 */
+    uint32_t get_loop_rate() const { return m_loop_rate; }
+    /** 获取上一统计周期的 CPU 空闲百分比 (x10) */
+    uint16_t get_idle_permille() const { return m_idle_permille; }
+    /** 获取累计循环轮数 */
+    uint32_t get_loop_count() const { return m_loop_count; }
+    /** 获取上一统计周期内单轮循环执行任务的最大耗时(us), 不含空闲时间 */
+    uint32_t get_max_pass_us() const { return m_max_pass_us; }
+
+protected:
+    SchedulerService();
+
+    struct Task
+    {
+        const char *name;
+        task_func_t func;
+        unsigned long interval_us; // 0 表示单次任务
+        unsigned long deadline_us; // 下次运行的截止时间
+        uint8_t prio;
+        bool active;
+    };
+
+    int add_task_(const char *name, task_func_t func, unsigned long interval_us, unsigned long delay_us, TaskPriority prio);
+    void idle_until_(unsigned long deadline_us);
+    void report_stats_();
+
+    Task m_tasks[MAX_TASKS];
+
+    uint32_t m_loop_count;         // 累计循环轮数
+    uint32_t m_stats_loops;        // 统计周期内循环轮数
+    unsigned long m_stats_idle_us; // 统计周期内空闲时间
+    uint32_t m_stats_max_pass_us;  // 统计周期内单轮循环最大耗时
+    unsigned long m_stats_start_ms;
+    uint32_t m_loop_rate;
+    uint16_t m_idle_permille;
+    uint32_t m_max_pass_us;
+};
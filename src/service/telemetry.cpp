@@ -0,0 +1,462 @@
+#include "service/telemetry.h"
+#include "service/motor.h"
+#include "service/logger.h"
+#include "service/scheduler.h"
+
+#include <Hash.h>
+#include <strings.h>
+
+static constexpr const char *WS_GUID = "258EAFA5-E914-47DA-95CA-C5AB0DC85B11";
+
+// WebSocket 帧操作码
+static constexpr uint8_t WS_OP_TEXT = 0x1;
+static constexpr uint8_t WS_OP_BINARY = 0x2;
+static constexpr uint8_t WS_OP_CLOSE = 0x8;
+static constexpr uint8_t WS_OP_PING = 0x9;
+static constexpr uint8_t WS_OP_PONG = 0xA;
+
+/** Base64 编码, 返回输出长度 (不含结尾 0) */
+static size_t base64_encode(const uint8_t *src, size_t len, char *dst)
+{
+    static const char table[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    size_t n = 0;
+    for (size_t i = 0; i < len; i += 3)
+    {
+        uint32_t v = (uint32_t)src[i] << 16;
+        if (i + 1 < len)
+        {
+            v |= (uint32_t)src[i + 1] << 8;
+        }
+        if (i + 2 < len)
+        {
+            v |= src[i + 2];
+        }
+        dst[n++] = table[(v >> 18) & 0x3F];
+        dst[n++] = table[(v >> 12) & 0x3F];
+        dst[n++] = (i + 1 < len) ? table[(v >> 6) & 0x3F] : '=';
+        dst[n++] = (i + 2 < len) ? table[v & 0x3F] : '=';
+    }
+    dst[n] = '\0';
+    return n;
+}
+
+TelemetryService::TelemetryService() : m_server(WS_PORT),
+                                       m_clients(),
+                                       m_rate_hz(DEF_SAMPLE_RATE_HZ),
+                                       m_sample_task(-1),
+                                       m_channel(0),
+                                       m_last_flush_ms(0),
+                                       m_sample_seq(0),
+                                       m_batch_seq(0),
+                                       m_sample_count(0),
+                                       m_samples(),
+                                       m_tx_buf()
+{
+    for (WsClient &client : m_clients)
+    {
+        client.state = CLIENT_FREE;
+    }
+}
+
+TelemetryService::~TelemetryService()
+{
+}
+
+void TelemetryService::begin()
+{
+    m_server.begin();
+    m_server.setNoDelay(true);
+    LoggerService::printf_P(PSTR("Telemetry WebSocket server started on port %d.\n"), WS_PORT);
+
+    // 注册连接处理及发送任务, 采样任务在有客户端连接时才注册
+    SchedulerService::get_instance()->add_periodic(
+        "telemetry",
+        []()
+        {
+            TelemetryService::get_instance()->update();
+        },
+        LoggerService::WEB_POLL_INTERVAL_MS * 1000UL, SchedulerService::PRIO_NETWORK);
+}
+
+void TelemetryService::set_sample_rate(int rate_hz)
+{
+    m_rate_hz = constrain(rate_hz, 1, MAX_SAMPLE_RATE_HZ);
+    if (m_sample_task >= 0)
+    {
+        SchedulerService::get_instance()->set_interval(m_sample_task, 1000000UL / m_rate_hz);
+    }
+    LoggerService::printf_P(PSTR("Telemetry sample rate set to %d Hz\n"), m_rate_hz);
+}
+
+void TelemetryService::update()
+{
+    this->accept_clients_();
+
+    for (WsClient &client : m_clients)
+    {
+        if (client.state == CLIENT_FREE)
+        {
+            continue;
+        }
+        if (!client.conn.connected())
+        {
+            this->close_client_(client);
+            continue;
+        }
+        if (client.state == CLIENT_HANDSHAKE)
+        {
+            this->poll_handshake_(client);
+        }
+        else
+        {
+            this->poll_frames_(client);
+        }
+    }
+
+    unsigned long cur_ms = millis();
+    if (cur_ms - m_last_flush_ms >= FLUSH_INTERVAL_MS)
+    {
+        m_last_flush_ms = cur_ms;
+        this->flush_();
+    }
+}
+
+void TelemetryService::sample_()
+{
+    TelemetryService *ts = TelemetryService::get_instance();
+    uint32_t seq = ts->m_sample_seq++;
+
+    // 缓冲区满时丢弃样本, 客户端可从序号间隔发现
+    if (ts->m_sample_count >= MAX_BATCH)
+    {
+        return;
+    }
+    if (ts->m_sample_count == 0)
+    {
+        ts->m_batch_seq = seq;
+    }
+
+    MotorService *ms = MotorService::get_instance(ts->m_channel);
+    Sample &s = ts->m_samples[ts->m_sample_count++];
+    s.t_ms = millis();
+    s.pos = ms->get_cover_pos();
+    s.setpoint = ms->get_target_pos();
+    s.speed = (int16_t)constrain(ms->get_speed_pulse(), -32768.0f, 32767.0f);
+    s.pwm = ms->get_pwm();
+    s.flags = (ms->is_moving() ? SAMPLE_MOVING : 0) |
+              (ms->is_pid_active() ? SAMPLE_PID_ACTIVE : 0) |
+              (ms->is_backlash_cal() ? SAMPLE_BACKLASH_CAL : 0);
+    s.channel = ts->m_channel;
+}
+
+void TelemetryService::accept_clients_()
+{
+    if (!m_server.hasClient())
+    {
+        return;
+    }
+
+    WiFiClient conn = m_server.accept();
+    for (WsClient &client : m_clients)
+    {
+        if (client.state == CLIENT_FREE)
+        {
+            client.conn = conn;
+            client.conn.setNoDelay(true);
+            client.state = CLIENT_HANDSHAKE;
+            client.since_ms = millis();
+            client.decim = 1;
+            client.dropped = 0;
+            client.rx_len = 0;
+            return;
+        }
+    }
+
+    // 没有空闲连接槽时直接拒绝
+    conn.stop();
+}
+
+void TelemetryService::poll_handshake_(WsClient &client)
+{
+    // 非阻塞读取 HTTP 升级请求, 直到收到完整请求头
+    int avail = client.conn.available();
+    if (avail > 0)
+    {
+        size_t room = RX_BUF_SIZE - 1 - client.rx_len;
+        size_t n = client.conn.read((uint8_t *)client.rx_buf + client.rx_len, min((size_t)avail, room));
+        client.rx_len += n;
+        client.rx_buf[client.rx_len] = '\0';
+    }
+
+    if (strstr(client.rx_buf, "\r\n\r\n") == nullptr)
+    {
+        if (client.rx_len >= RX_BUF_SIZE - 1 || millis() - client.since_ms > HANDSHAKE_TIMEOUT_MS)
+        {
+            LoggerService::println(F("Telemetry: handshake failed"));
+            this->close_client_(client);
+        }
+        return;
+    }
+
+    // 查找 Sec-WebSocket-Key 请求头
+    const char *key = nullptr;
+    size_t key_len = 0;
+    for (char *line = client.rx_buf; line != nullptr && *line != '\0';)
+    {
+        char *eol = strstr(line, "\r\n");
+        if (strncasecmp(line, "Sec-WebSocket-Key:", 18) == 0 && eol != nullptr)
+        {
+            key = line + 18;
+            while (*key == ' ')
+            {
+                key++;
+            }
+            key_len = eol - key;
+            break;
+        }
+        line = eol != nullptr ? eol + 2 : nullptr;
+    }
+    if (key == nullptr || key_len == 0 || key_len > 32)
+    {
+        client.conn.write((const uint8_t *)"HTTP/1.1 400 Bad Request\r\n\r\n", 28);
+        this->close_client_(client);
+        return;
+    }
+
+    // Sec-WebSocket-Accept = Base64(SHA1(key + GUID))
+    char accept_src[32 + 36 + 1];
+    memcpy(accept_src, key, key_len);
+    strcpy(accept_src + key_len, WS_GUID);
+    uint8_t digest[20];
+    sha1((const uint8_t *)accept_src, strlen(accept_src), digest);
+    char accept[32];
+    base64_encode(digest, sizeof(digest), accept);
+
+    char resp[160];
+    int len = snprintf_P(resp, sizeof(resp),
+                         PSTR("HTTP/1.1 101 Switching Protocols\r\n"
+                              "Upgrade: websocket\r\n"
+                              "Connection: Upgrade\r\n"
+                              "Sec-WebSocket-Accept: %s\r\n\r\n"),
+                         accept);
+    client.conn.write((const uint8_t *)resp, len);
+
+    client.state = CLIENT_OPEN;
+    client.since_ms = millis();
+    client.rx_len = 0;
+    LoggerService::printf_P(PSTR("Telemetry: client %s connected\n"), client.conn.remoteIP().toString().c_str());
+
+    this->update_sampling_();
+}
+
+void TelemetryService::poll_frames_(WsClient &client)
+{
+    int avail = client.conn.available();
+    if (avail > 0)
+    {
+        size_t room = RX_BUF_SIZE - 1 - client.rx_len;
+        client.rx_len += client.conn.read((uint8_t *)client.rx_buf + client.rx_len, min((size_t)avail, room));
+    }
+
+    // 解析已完整接收的客户端帧 (客户端帧必须带掩码)
+    while (client.rx_len >= 2)
+    {
+        uint8_t *buf = (uint8_t *)client.rx_buf;
+        uint8_t opcode = buf[0] & 0x0F;
+        bool masked = buf[1] & 0x80;
+        size_t len = buf[1] & 0x7F;
+        if (!masked || len >= 126)
+        {
+            // 仅支持短命令帧
+            LoggerService::println(F("Telemetry: unsupported client frame"));
+            this->close_client_(client);
+            return;
+        }
+
+        size_t frame_len = 2 + 4 + len;
+        if (client.rx_len < frame_len)
+        {
+            return;
+        }
+
+        uint8_t *mask = buf + 2;
+        uint8_t *payload = buf + 6;
+        for (size_t i = 0; i < len; i++)
+        {
+            payload[i] ^= mask[i & 3];
+        }
+
+        if (opcode == WS_OP_TEXT)
+        {
+            char cmd[RX_BUF_SIZE];
+            memcpy(cmd, payload, len);
+            cmd[len] = '\0';
+            this->handle_command_(client, cmd);
+        }
+        else if (opcode == WS_OP_PING)
+        {
+            this->send_frame_(client, WS_OP_PONG, payload, len);
+        }
+        else if (opcode == WS_OP_CLOSE)
+        {
+            this->send_frame_(client, WS_OP_CLOSE, nullptr, 0);
+            this->close_client_(client);
+            return;
+        }
+
+        memmove(buf, buf + frame_len, client.rx_len - frame_len);
+        client.rx_len -= frame_len;
+    }
+}
+
+void TelemetryService::handle_command_(WsClient &client, char *cmd)
+{
+    char *arg = strchr(cmd, ' ');
+    long value = arg != nullptr ? strtol(arg + 1, nullptr, 10) : 0;
+
+    if (strncmp(cmd, "rate ", 5) == 0)
+    {
+        this->set_sample_rate(value);
+    }
+    else if (strncmp(cmd, "decim ", 6) == 0)
+    {
+        client.decim = constrain(value, 1L, (long)MAX_DECIMATION);
+        LoggerService::printf_P(PSTR("Telemetry: client decimation set to %u\n"), client.decim);
+    }
+    else if (strncmp(cmd, "channel ", 8) == 0)
+    {
+        m_channel = constrain(value, 0L, (long)MOTOR_CHANNELS - 1);
+        LoggerService::printf_P(PSTR("Telemetry: sampling motor channel %u\n"), m_channel);
+    }
+    else
+    {
+        LoggerService::printf_P(PSTR("Telemetry: unknown command '%s'\n"), cmd);
+    }
+}
+
+void TelemetryService::flush_()
+{
+    if (m_sample_count == 0)
+    {
+        return;
+    }
+
+    uint32_t first_seq = m_batch_seq;
+    uint8_t *payload = m_tx_buf + 4;
+
+    for (WsClient &client : m_clients)
+    {
+        if (client.state != CLIENT_OPEN)
+        {
+            continue;
+        }
+
+        // 按本连接的抽取倍率挑选样本, 所选样本序号均为 decim 的整数倍
+        FrameHeader *header = (FrameHeader *)payload;
+        Sample *out = (Sample *)(payload + sizeof(FrameHeader));
+        uint8_t count = 0;
+        uint32_t seq = 0;
+        for (uint8_t i = 0; i < m_sample_count; i++)
+        {
+            if ((first_seq + i) % client.decim != 0)
+            {
+                continue;
+            }
+            if (count == 0)
+            {
+                seq = first_seq + i;
+            }
+            memcpy(&out[count++], &m_samples[i], sizeof(Sample));
+        }
+        if (count == 0)
+        {
+            continue;
+        }
+
+        header->version = FRAME_VERSION;
+        header->count = count;
+        header->decim = client.decim;
+        header->rate_hz = m_rate_hz;
+        header->reserved = 0;
+        header->seq = seq;
+        header->dropped = client.dropped;
+
+        if (!this->send_frame_(client, WS_OP_BINARY, payload, sizeof(FrameHeader) + count * sizeof(Sample)))
+        {
+            client.dropped++;
+        }
+    }
+
+    m_sample_count = 0;
+}
+
+bool TelemetryService::send_frame_(WsClient &client, uint8_t opcode, const uint8_t *payload, size_t len)
+{
+    // 负载复制到发送缓冲区 m_tx_buf + 4 处, 与前面的帧头一起一次写入
+    uint8_t header[4];
+    size_t header_len;
+    header[0] = 0x80 | opcode;
+    if (len < 126)
+    {
+        header[1] = len;
+        header_len = 2;
+    }
+    else
+    {
+        header[1] = 126;
+        header[2] = len >> 8;
+        header[3] = len & 0xFF;
+        header_len = 4;
+    }
+
+    // 发送缓冲区不足时丢弃整帧, 不等待慢速客户端
+    if ((size_t)client.conn.availableForWrite() < header_len + len)
+    {
+        return false;
+    }
+
+    uint8_t *frame = m_tx_buf + 4 - header_len;
+    if (len > 0 && payload != m_tx_buf + 4)
+    {
+        memmove(m_tx_buf + 4, payload, len);
+    }
+    memcpy(frame, header, header_len);
+    return client.conn.write(frame, header_len + len) == header_len + len;
+}
+
+void TelemetryService::close_client_(WsClient &client)
+{
+    bool was_open = client.state == CLIENT_OPEN;
+    client.conn.stop();
+    client.state = CLIENT_FREE;
+    client.rx_len = 0;
+
+    if (was_open)
+    {
+        LoggerService::printf_P(PSTR("Telemetry: client disconnected, %lu frames dropped\n"), (unsigned long)client.dropped);
+        this->update_sampling_();
+    }
+}
+
+void TelemetryService::update_sampling_()
+{
+    bool any_open = false;
+    for (const WsClient &client : m_clients)
+    {
+        any_open = any_open || client.state == CLIENT_OPEN;
+    }
+
+    // 仅在有客户端时以高优先级采样, 与电机控制任务同步运行
+    SchedulerService *scheduler = SchedulerService::get_instance();
+    if (any_open && m_sample_task < 0)
+    {
+        m_sample_count = 0;
+        m_sample_task = scheduler->add_periodic("telemetry_sample", &TelemetryService::sample_,
+                                                1000000UL / m_rate_hz, SchedulerService::PRIO_CONTROL);
+    }
+    else if (!any_open && m_sample_task >= 0)
+    {
+        scheduler->cancel(m_sample_task);
+        m_sample_task = -1;
+    }
+}
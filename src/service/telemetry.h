@@ -0,0 +1,122 @@
+#pragma once
+
+#include <Arduino.h>
+#include <ESP8266WiFi.h>
+
+/** WebSocket 实时遥测服务
+ *
+ * 在独立端口上提供最小化的 WebSocket 服务, 按设定采样率采集电机位置、滤波速度、PID 设定点、
+ * PWM 输出及运行状态, 样本成批打包为二进制帧发送, 每个客户端可单独设置抽取倍率。
+ * 发送缓冲区不足时直接丢弃整帧并计数, 不会阻塞主循环。
+ *
+ * 客户端可发送文本帧命令: "rate <Hz>" 设置采样率, "decim <N>" 设置本连接每 N 个样本发送 1 个,
+ * "channel <N>" 选择采样的电机通道 (所有连接共用)。
+ * 二进制帧格式 (小端序): FrameHeader 后接 count 个 Sample。
+ */
+class TelemetryService
+{
+public:
+    static constexpr int WS_PORT = 8081;                  // WebSocket 服务端口
+    static constexpr int MAX_CLIENTS = 2;                 // 最大客户端连接数
+    static constexpr int DEF_SAMPLE_RATE_HZ = 100;        // 默认采样率(Hz)
+    static constexpr int MAX_SAMPLE_RATE_HZ = 1000;       // 最大采样率(Hz), 等于电机控制频率
+    static constexpr int MAX_DECIMATION = 1000;           // 最大抽取倍率
+    static constexpr int FLUSH_INTERVAL_MS = 50;          // 样本打包发送间隔(ms)
+    static constexpr int MAX_BATCH = 64;                  // 单帧最多样本数
+    static constexpr int HANDSHAKE_TIMEOUT_MS = 2000;     // 握手超时时间(ms)
+    static constexpr int RX_BUF_SIZE = 512;               // 握手请求及客户端帧接收缓冲区大小
+    static constexpr uint8_t FRAME_VERSION = 1;           // 二进制帧格式版本
+
+    // 样本状态位
+    enum SampleFlags
+    {
+        SAMPLE_MOVING = 0x01,     // 电机运行中
+        SAMPLE_PID_ACTIVE = 0x02, // PID 自动控制中
+        SAMPLE_BACKLASH_CAL = 0x04 // 齿隙标定中
+    };
+
+    struct __attribute__((packed)) FrameHeader
+    {
+        uint8_t version;  // 帧格式版本
+        uint8_t count;    // 样本数
+        uint16_t decim;   // 本连接抽取倍率
+        uint16_t rate_hz; // 采样率
+        uint16_t reserved;
+        uint32_t seq;     // 首个样本的序号
+        uint32_t dropped; // 本连接累计丢弃的帧数
+    };
+
+    struct __attribute__((packed)) Sample
+    {
+        uint32_t t_ms;    // 采样时间戳(ms)
+        int32_t pos;      // 窗帘位置(编码脉冲数)
+        int32_t setpoint; // PID 设定点
+        int16_t speed;    // 滤波后速度(pulse/s)
+        int16_t pwm;      // PWM 输出值
+        uint8_t flags;    // 状态位, 见 SampleFlags
+        uint8_t channel;  // 电机通道号
+    };
+
+    static TelemetryService *get_instance()
+    {
+        static TelemetryService instance;
+        return &instance;
+    }
+
+    ~TelemetryService();
+
+    /** 启动 WebSocket 服务 */
+    void begin();
+    /** 处理客户端连接、握手、命令及批量发送 */
+    void update();
+
+    /** 设置采样率(Hz) */
+    void set_sample_rate(int rate_hz);
+    /** 获取采样率(Hz) */
+    int get_sample_rate() const { return m_rate_hz; }
+
+protected:
+    TelemetryService();
+
+    enum ClientState
+    {
+        CLIENT_FREE,
+        CLIENT_HANDSHAKE,
+        CLIENT_OPEN
+    };
+
+    struct WsClient
+    {
+        WiFiClient conn;
+        ClientState state;
+        unsigned long since_ms; // 进入当前状态的时间戳
+        uint16_t decim;         // 抽取倍率
+        uint32_t dropped;       // 因发送缓冲区不足丢弃的帧数
+        uint16_t rx_len;
+        char rx_buf[RX_BUF_SIZE];
+    };
+
+    static void sample_();
+
+    void accept_clients_();
+    void poll_handshake_(WsClient &client);
+    void poll_frames_(WsClient &client);
+    void handle_command_(WsClient &client, char *cmd);
+    void flush_();
+    bool send_frame_(WsClient &client, uint8_t opcode, const uint8_t *payload, size_t len);
+    void close_client_(WsClient &client);
+    void update_sampling_();
+
+    WiFiServer m_server;
+    WsClient m_clients[MAX_CLIENTS];
+
+    int m_rate_hz;              // 采样率
+    int m_sample_task;          // 采样任务编号, 无客户端时为 -1
+    uint8_t m_channel;          // 采样的电机通道号
+    unsigned long m_last_flush_ms;
+    uint32_t m_sample_seq;      // 下一个样本的序号
+    uint32_t m_batch_seq;       // 缓冲区中首个样本的序号
+    uint8_t m_sample_count;     // 缓冲区中的样本数
+    Sample m_samples[MAX_BATCH];
+    uint8_t m_tx_buf[4 + sizeof(FrameHeader) + MAX_BATCH * sizeof(Sample)];
+};
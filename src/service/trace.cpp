@@ -0,0 +1,212 @@
+#include "service/trace.h"
+#include "service/logger.h"
+
+static const char *const SOURCE_NAMES[TraceService::SOURCE_COUNT] = {"ir", "mqtt", "http", "other"};
+static const char *const STAGE_NAMES[] = {"dispatch_us", "pwm_us", "motion_us", "stop_ms"};
+
+TraceService::TraceService() : m_traces(),
+                               m_head(0),
+                               m_count(0),
+                               m_active(),
+                               m_pending(false),
+                               m_pending_source(SOURCE_OTHER),
+                               m_pending_us(0)
+{
+    for (Active &active : m_active)
+    {
+        active.slot = -1;
+    }
+}
+
+TraceService::~TraceService()
+{
+}
+
+void TraceService::begin()
+{
+    LoggerService::get_instance()->web_server()->on(WEB_TRACE_PATH, &TraceService::handle_web_trace_);
+}
+
+void TraceService::receive(Source source, unsigned long rx_us)
+{
+    m_pending = true;
+    m_pending_source = source;
+    m_pending_us = rx_us;
+}
+
+void TraceService::dispatch(uint8_t channel)
+{
+    unsigned long cur_us = micros();
+
+    // 被覆盖的记录若仍在进行中则放弃
+    for (Active &active : m_active)
+    {
+        if (active.slot == m_head)
+        {
+            active.slot = -1;
+        }
+    }
+
+    Trace &trace = m_traces[m_head];
+    memset(&trace, 0, sizeof(trace));
+    trace.channel = channel;
+    trace.stages = 1 << STAGE_DISPATCH;
+    if (m_pending && cur_us - m_pending_us < RECEIPT_TIMEOUT_US)
+    {
+        trace.source = m_pending_source;
+        trace.rx_us = m_pending_us;
+        trace.dispatch_us = cur_us - m_pending_us;
+    }
+    else
+    {
+        trace.source = SOURCE_OTHER;
+        trace.rx_us = cur_us;
+    }
+    m_pending = false;
+
+    m_active[channel].slot = m_head;
+    m_active[channel].stage_us = cur_us;
+    m_head = (m_head + 1) % HISTORY;
+    m_count = min(m_count + 1, HISTORY);
+}
+
+TraceService::Trace *TraceService::active_trace_(uint8_t channel, Stage prev_stage)
+{
+    // 只在上一阶段已到达且下一阶段尚未到达时返回进行中的记录
+    const Active &active = m_active[channel];
+    if (active.slot < 0)
+    {
+        return nullptr;
+    }
+    Trace &trace = m_traces[active.slot];
+    if (!(trace.stages & (1 << prev_stage)) || (trace.stages & (1 << (prev_stage + 1))))
+    {
+        return nullptr;
+    }
+    return &trace;
+}
+
+void TraceService::mark_pwm(uint8_t channel)
+{
+    Trace *trace = this->active_trace_(channel, STAGE_DISPATCH);
+    if (trace != nullptr)
+    {
+        unsigned long cur_us = micros();
+        trace->pwm_us = cur_us - m_active[channel].stage_us;
+        trace->stages |= 1 << STAGE_PWM;
+        m_active[channel].stage_us = cur_us;
+    }
+}
+
+void TraceService::mark_motion(uint8_t channel)
+{
+    Trace *trace = this->active_trace_(channel, STAGE_PWM);
+    if (trace != nullptr)
+    {
+        unsigned long cur_us = micros();
+        trace->motion_us = cur_us - m_active[channel].stage_us;
+        trace->stages |= 1 << STAGE_MOTION;
+        m_active[channel].stage_us = cur_us;
+    }
+}
+
+void TraceService::mark_stop(uint8_t channel)
+{
+    Active &active = m_active[channel];
+    if (active.slot < 0)
+    {
+        return;
+    }
+    Trace &trace = m_traces[active.slot];
+    trace.stop_ms = (micros() - active.stage_us) / 1000;
+    trace.stages |= 1 << STAGE_STOP;
+    active.slot = -1;
+}
+
+void TraceService::handle_web_trace_()
+{
+    TraceService *tracer = TraceService::get_instance();
+    ESP8266WebServer *server = LoggerService::get_instance()->web_server();
+
+    server->setContentLength(CONTENT_LENGTH_UNKNOWN);
+    server->send_P(200, PSTR("text/plain"), PSTR(""));
+    if (server->hasArg("csv"))
+    {
+        tracer->send_csv_();
+    }
+    else
+    {
+        tracer->send_summary_();
+    }
+    server->sendContent("");
+}
+
+void TraceService::send_summary_()
+{
+    ESP8266WebServer *server = LoggerService::get_instance()->web_server();
+    server->sendContent_P(PSTR("source stage count p50 p90 p99 max\n"));
+
+    char buf[96];
+    uint32_t values[HISTORY];
+    for (int source = 0; source < SOURCE_COUNT; source++)
+    {
+        for (int stage = STAGE_DISPATCH; stage <= STAGE_STOP; stage++)
+        {
+            // 收集该来源已到达该阶段的记录, 插入排序后按最近秩法取分位数
+            int n = 0;
+            for (int i = 0; i < m_count; i++)
+            {
+                const Trace &trace = m_traces[i];
+                if (trace.source != source || !(trace.stages & (1 << stage)))
+                {
+                    continue;
+                }
+                uint32_t value = stage == STAGE_DISPATCH ? trace.dispatch_us
+                                 : stage == STAGE_PWM    ? trace.pwm_us
+                                 : stage == STAGE_MOTION ? trace.motion_us
+                                                         : trace.stop_ms;
+                int j = n++;
+                for (; j > 0 && values[j - 1] > value; j--)
+                {
+                    values[j] = values[j - 1];
+                }
+                values[j] = value;
+            }
+            if (n == 0)
+            {
+                continue;
+            }
+
+            snprintf_P(buf, sizeof(buf), PSTR("%s %s %d %lu %lu %lu %lu\n"),
+                       SOURCE_NAMES[source], STAGE_NAMES[stage], n,
+                       (unsigned long)values[(50 * n + 99) / 100 - 1],
+                       (unsigned long)values[(90 * n + 99) / 100 - 1],
+                       (unsigned long)values[(99 * n + 99) / 100 - 1],
+                       (unsigned long)values[n - 1]);
+            server->sendContent(buf);
+        }
+    }
+}
+
+void TraceService::send_csv_()
+{
+    ESP8266WebServer *server = LoggerService::get_instance()->web_server();
+
+    // 输出设备当前时刻, 供主机换算接收时刻
+    char buf[96];
+    snprintf_P(buf, sizeof(buf), PSTR("# now_us=%lu\n"), micros());
+    server->sendContent(buf);
+    server->sendContent_P(PSTR("rx_us,source,channel,dispatch_us,pwm_us,motion_us,stop_ms,stages\n"));
+
+    // 从最早的记录开始输出
+    int start = m_count < HISTORY ? 0 : m_head;
+    for (int i = 0; i < m_count; i++)
+    {
+        const Trace &trace = m_traces[(start + i) % HISTORY];
+        snprintf_P(buf, sizeof(buf), PSTR("%lu,%s,%u,%lu,%lu,%lu,%lu,%u\n"),
+                   (unsigned long)trace.rx_us, SOURCE_NAMES[trace.source], trace.channel,
+                   (unsigned long)trace.dispatch_us, (unsigned long)trace.pwm_us,
+                   (unsigned long)trace.motion_us, (unsigned long)trace.stop_ms, trace.stages);
+        server->sendContent(buf);
+    }
+}
@@ -0,0 +1,103 @@
+#pragma once
+
+#include "config/pins.h"
+
+#include <Arduino.h>
+
+/** 命令延迟跟踪服务
+ *
+ * 对每个让电机从静止开始运动的命令记录各阶段的时间间隔:
+ * 接收 (红外帧解码、本轮 MQTT 循环开始或 HTTP 请求处理开始) → 分发 (处理函数向电机发出命令)
+ * → 首次非零 PWM 输出 → 编码器首次变化 → 电机停止。
+ * 接收时刻先暂存, 由随后的电机命令认领, 超时未认领 (如停止命令) 则丢弃。
+ * 最近若干条记录保存在循环缓冲区中, HTTP 接口按命令来源输出各阶段延迟的分位数及原始记录。
+ */
+class TraceService
+{
+public:
+    static constexpr int HISTORY = 32;                             // 保留的跟踪记录数
+    static constexpr unsigned long RECEIPT_TIMEOUT_US = 500000;    // 接收时刻等待电机命令认领的最长时间(us)
+    static constexpr const char *WEB_TRACE_PATH = "/trace";        // ?csv 输出原始记录
+
+    // 命令来源
+    enum Source : uint8_t
+    {
+        SOURCE_IR = 0,
+        SOURCE_MQTT = 1,
+        SOURCE_HTTP = 2,
+        SOURCE_OTHER = 3, // 同步移动、标定等没有接收时刻的命令
+        SOURCE_COUNT = 4
+    };
+
+    // 跟踪阶段, 用作 Trace::stages 的位序号
+    enum Stage : uint8_t
+    {
+        STAGE_DISPATCH = 0, // 处理函数发出电机命令
+        STAGE_PWM = 1,      // 首次非零 PWM 输出
+        STAGE_MOTION = 2,   // 编码器首次变化
+        STAGE_STOP = 3      // 电机停止
+    };
+
+    /** 单条命令跟踪记录, 各间隔均相对于上一阶段 */
+    struct Trace
+    {
+        uint32_t rx_us;       // 接收时刻 (micros())
+        uint32_t dispatch_us; // 接收 → 分发
+        uint32_t pwm_us;      // 分发 → 首次 PWM 输出
+        uint32_t motion_us;   // 首次 PWM 输出 → 编码器首次变化
+        uint32_t stop_ms;     // 上一阶段 → 电机停止
+        uint8_t source;       // 命令来源, 见 Source
+        uint8_t channel;      // 电机通道号
+        uint8_t stages;       // 已到达阶段的位掩码
+    };
+
+    static TraceService *get_instance()
+    {
+        static TraceService instance;
+        return &instance;
+    }
+
+    ~TraceService();
+
+    /** 注册 HTTP 查询接口 (须在日志服务启动后调用) */
+    void begin();
+
+    /** 暂存命令接收时刻, 等待随后的电机命令认领 */
+    void receive(Source source, unsigned long rx_us);
+    /** 丢弃暂存的接收时刻 (命令不会让电机开始运动) */
+    void discard_receipt() { m_pending = false; }
+
+    /** 电机从静止开始运动: 认领暂存的接收时刻并开始一条新记录 */
+    void dispatch(uint8_t channel);
+    /** 电机输出非零 PWM, 每个控制周期均可调用, 只记录首次 */
+    void mark_pwm(uint8_t channel);
+    /** 编码器首次变化 */
+    void mark_motion(uint8_t channel);
+    /** 电机停止, 结束当前记录 */
+    void mark_stop(uint8_t channel);
+
+protected:
+    TraceService();
+
+    /** 各通道进行中的记录 */
+    struct Active
+    {
+        int8_t slot;       // 记录在循环缓冲区中的位置, -1 表示无
+        uint32_t stage_us; // 上一阶段的时刻
+    };
+
+    static void handle_web_trace_();
+
+    Trace *active_trace_(uint8_t channel, Stage prev_stage);
+    void send_summary_();
+    void send_csv_();
+
+    Trace m_traces[HISTORY];
+    int m_head;  // 下一条记录的写入位置
+    int m_count; // 已写入记录数
+    Active m_active[MOTOR_CHANNELS];
+
+    bool m_pending;           // 是否有待认领的接收时刻
+    Source m_pending_source;
+    unsigned long m_pending_us;
+};
@@ -1,47 +1,125 @@
 #include "service/wireless.h"
 #include "service/logger.h"
+#include "service/scheduler.h"
+#include "service/motor.h"
+#include "utility/crc.h"
 
-#include <LittleFS.h>
 #include <Arduino.h>
 #include <ArduinoOTA.h>
 
 #include <WiFiManager.h>
 #include <EasyButton.h>
-#include <ArduinoJson.h>
-
-WirelessService *WirelessService::m_instance = nullptr;
-
-WirelessService::WirelessService() : m_mqtt_server(),
-                                     m_mqtt_port(),
-                                     m_mqtt_user(),
-                                     m_mqtt_pass(),
-                                     m_should_save_config(false)
+#include <lwip/dhcp.h>
+
+WirelessService::WirelessService() : m_should_save_config(false),
+                                     m_wifi_cache(),
+                                     m_lease_pending(false),
+                                     m_state(WIFI_CONNECTING),
+                                     m_state_ms(0),
+                                     m_connect_start_ms(0),
+                                     m_ota_started(false),
+                                     m_ota_hash(),
+                                     m_ota_verifier(),
+                                     m_ota_start_ms(0),
+                                     m_ota_progress_step(0),
+                                     m_ota_size(0),
+                                     m_wm(nullptr),
+                                     m_param_server(nullptr),
+                                     m_param_port(nullptr),
+                                     m_param_user(nullptr),
+                                     m_param_pass(nullptr),
+                                     m_param_group(nullptr)
 {
-    strcpy(m_mqtt_server, DEF_MQTT_SERVER);
-    strcpy(m_mqtt_port, DEF_MQTT_PORT);
 }
 
 WirelessService::~WirelessService()
 {
+    delete m_wm;
+    delete m_param_server;
+    delete m_param_port;
+    delete m_param_user;
+    delete m_param_pass;
+    delete m_param_group;
 }
 
 void WirelessService::begin()
 {
-    this->load_conf_();
+    m_connect_start_ms = millis();
 
     // 如果是按 RESET 按钮重启, 则检查清除按钮状态
+    // (清除按钮与电机驱动共用 D3 引脚, 只能在电机服务初始化之前阻塞检查)
     if (ESP.getResetInfoPtr()->reason == REASON_EXT_SYS_RST)
     {
         this->wait_check_clear_btn_();
     }
 
-    this->setup_wifi_();
-    this->setup_ota_();
+    // WiFi 初始化为 STAT 模式, 连接过程在 update() 中异步完成
+    WiFi.mode(WIFI_STA);
+    this->start_connect_();
+
+    // 注册 WiFi 连接及 OTA 请求处理任务
+    SchedulerService::get_instance()->add_periodic(
+        "wireless",
+        []()
+        {
+            WirelessService::get_instance()->update();
+        },
+        UPDATE_INTERVAL_MS * 1000UL, SchedulerService::PRIO_NETWORK);
 }
 
 void WirelessService::update()
 {
-    ArduinoOTA.handle();
+    unsigned long cur_ms = millis();
+
+    switch (m_state)
+    {
+    case WIFI_FAST_CONNECTING:
+        if (WiFi.status() == WL_CONNECTED)
+        {
+            this->on_connected_();
+        }
+        else if (cur_ms - m_state_ms > FAST_CONNECT_TIMEOUT_MS)
+        {
+            // 快速连接失败, 恢复 DHCP 后回退到完整扫描
+            LoggerService::println(F("Fast WiFi connect failed, falling back to full scan"));
+            WiFi.disconnect();
+            WiFi.config(IPAddress(), IPAddress(), IPAddress());
+            memset(&m_wifi_cache, 0, sizeof(m_wifi_cache));
+            this->start_full_connect_();
+        }
+        break;
+    case WIFI_CONNECTING:
+        if (WiFi.status() == WL_CONNECTED)
+        {
+            this->on_connected_();
+        }
+        else if (cur_ms - m_state_ms > FULL_CONNECT_TIMEOUT_MS)
+        {
+            LoggerService::println(F("Failed to connect to WiFi, starting config portal"));
+            this->start_portal_();
+        }
+        break;
+    case WIFI_PORTAL:
+        m_wm->process();
+        if (WiFi.status() == WL_CONNECTED)
+        {
+            this->on_portal_saved_();
+            this->on_connected_();
+        }
+        else if (!m_wm->getConfigPortalActive())
+        {
+            // 配置门户超时后重新尝试用已保存的设置连接
+            this->start_full_connect_();
+        }
+        break;
+    case WIFI_CONNECTED:
+        if (m_lease_pending && netif_default != nullptr && dhcp_supplied_address(netif_default))
+        {
+            this->on_lease_bound_();
+        }
+        ArduinoOTA.handle();
+        break;
+    }
 }
 
 void WirelessService::clear_settings_and_restart()
@@ -51,110 +129,262 @@ void WirelessService::clear_settings_and_restart()
     ESP.restart();
 }
 
-void WirelessService::setup_wifi_()
+void WirelessService::start_connect_()
 {
-    // WiFi 初始化为 STAT 模式
-    WiFi.mode(WIFI_STA);
+    // 优先使用缓存的接入点和 IP 租约直接连接, 跳过信道扫描和 DHCP, 缓存的地址只用于本次连接
+    if (this->load_wifi_cache_(m_wifi_cache) && WiFi.SSID().length() > 0)
+    {
+        WiFi.config(IPAddress(m_wifi_cache.ip), IPAddress(m_wifi_cache.gateway), IPAddress(m_wifi_cache.netmask), IPAddress(m_wifi_cache.dns));
+        WiFi.begin(WiFi.SSID().c_str(), WiFi.psk().c_str(), m_wifi_cache.channel, m_wifi_cache.bssid);
+        m_state = WIFI_FAST_CONNECTING;
+        m_state_ms = millis();
+        return;
+    }
+
+    this->start_full_connect_();
+}
 
-    // 可配置的 MQTT 参数
-    WiFiManagerParameter custom_mqtt_server("server", "MQTT server", this->m_mqtt_server, sizeof(this->m_mqtt_server));
-    WiFiManagerParameter custom_mqtt_port("port", "MQTT port", this->m_mqtt_port, sizeof(this->m_mqtt_port));
-    WiFiManagerParameter custom_mqtt_user("user", "MQTT user", this->m_mqtt_user, sizeof(this->m_mqtt_user));
-    WiFiManagerParameter custom_mqtt_pass("pass", "MQTT pass", this->m_mqtt_pass, sizeof(this->m_mqtt_pass));
+void WirelessService::start_full_connect_()
+{
+    if (WiFi.SSID().length() == 0)
+    {
+        // 没有保存的 WiFi 设置, 直接打开配置门户
+        this->start_portal_();
+        return;
+    }
 
-    // 初始化 WiFiManager
-    WiFiManager wm;
+    WiFi.begin();
+    m_state = WIFI_CONNECTING;
+    m_state_ms = millis();
+}
+
+void WirelessService::start_portal_()
+{
+    if (m_wm == nullptr)
+    {
+        // 可配置的 MQTT 参数
+        ConfigService::MqttConf &mqtt = ConfigService::get_instance()->mqtt();
+        m_param_server = new WiFiManagerParameter("server", "MQTT server", mqtt.server, sizeof(mqtt.server));
+        m_param_port = new WiFiManagerParameter("port", "MQTT port", mqtt.port, sizeof(mqtt.port));
+        m_param_user = new WiFiManagerParameter("user", "MQTT user", mqtt.user, sizeof(mqtt.user));
+        m_param_pass = new WiFiManagerParameter("pass", "MQTT pass", mqtt.pass, sizeof(mqtt.pass));
+        char *group = ConfigService::get_instance()->mqtt_group();
+        m_param_group = new WiFiManagerParameter("group", "Blinds group", group, sizeof(ConfigService::ConfigData::mqtt_group));
+
+        // 初始化 WiFiManager, 以非阻塞方式运行配置门户
+        m_wm = new WiFiManager();
+        m_wm->setConfigPortalBlocking(false);
+        m_wm->setConfigPortalTimeout(CONFIG_PORTAL_TIMEOUT_S);
+        m_wm->setSaveConfigCallback(
+            [=]()
+            {
+                LoggerService::println(F("Should save MQTT config"));
+                this->m_should_save_config = true;
+            });
+        m_wm->addParameter(m_param_server);
+        m_wm->addParameter(m_param_port);
+        m_wm->addParameter(m_param_user);
+        m_wm->addParameter(m_param_pass);
+        m_wm->addParameter(m_param_group);
+    }
 
     this->m_should_save_config = false;
-    wm.setSaveConfigCallback(
-        [=]()
-        {
-            LoggerService::println("Should save MQTT config");
-            this->m_should_save_config = true;
-        });
-    wm.addParameter(&custom_mqtt_server);
-    wm.addParameter(&custom_mqtt_port);
-    wm.addParameter(&custom_mqtt_user);
-    wm.addParameter(&custom_mqtt_pass);
+    m_wm->startConfigPortal();
+    m_state = WIFI_PORTAL;
+    m_state_ms = millis();
+}
 
-    bool res = wm.autoConnect();
-    if (!res)
+void WirelessService::on_portal_saved_()
+{
+    if (!this->m_should_save_config)
     {
-        LoggerService::println("Failed to connect to WiFi, rebooting...");
-        delay(DEF_FAIL_REBOOT_DELAY);
-        ESP.restart();
+        return;
     }
-    LoggerService::println("Connected to WiFi, local IP & MAC:");
+
+    ConfigService *config = ConfigService::get_instance();
+    ConfigService::MqttConf &mqtt = config->mqtt();
+    strlcpy(mqtt.server, m_param_server->getValue(), sizeof(mqtt.server));
+    strlcpy(mqtt.port, m_param_port->getValue(), sizeof(mqtt.port));
+    strlcpy(mqtt.user, m_param_user->getValue(), sizeof(mqtt.user));
+    strlcpy(mqtt.pass, m_param_pass->getValue(), sizeof(mqtt.pass));
+    strlcpy(config->mqtt_group(), m_param_group->getValue(), sizeof(ConfigService::ConfigData::mqtt_group));
+
+    LoggerService::println(F("MQTT info:"));
+    LoggerService::printf_P(PSTR("Server: %s\n"), mqtt.server);
+    LoggerService::printf_P(PSTR("Port: %s\n"), mqtt.port);
+    LoggerService::printf_P(PSTR("User: %s\n"), mqtt.user);
+    LoggerService::printf_P(PSTR("Pass: %s\n"), mqtt.pass);
+    LoggerService::printf_P(PSTR("Group: %s\n"), config->mqtt_group());
+
+    LoggerService::println(F("Saving MQTT config ..."));
+    config->save();
+}
+
+void WirelessService::on_connected_()
+{
+    const char *mode = (m_state == WIFI_FAST_CONNECTING) ? "Fast connected" : "Connected";
+    LoggerService::printf_P(PSTR("%s to WiFi in %lu ms, local IP & MAC:\n"), mode, millis() - m_connect_start_ms);
     LoggerService::println(WiFi.localIP());
     LoggerService::println(WiFi.macAddress());
 
-    strcpy(this->m_mqtt_server, custom_mqtt_server.getValue());
-    strcpy(this->m_mqtt_port, custom_mqtt_port.getValue());
-    strcpy(this->m_mqtt_user, custom_mqtt_user.getValue());
-    strcpy(this->m_mqtt_pass, custom_mqtt_pass.getValue());
+    if (m_state == WIFI_FAST_CONNECTING)
+    {
+        // 缓存的租约可能已过期或被路由器分配给其他设备, 连接后立即恢复 DHCP:
+        // DHCP 在后台获取租约, 期间接口保留缓存的地址, 之后断线重连及续租均由 DHCP 完成
+        WiFi.config(IPAddress(), IPAddress(), IPAddress());
+        m_lease_pending = true;
+    }
+    else
+    {
+        // 缓存本次连接的接入点和 IP 租约供下次启动快速连接
+        this->save_wifi_cache_();
+    }
 
-    LoggerService::println("MQTT info:");
-    LoggerService::println("Server: " + String(this->m_mqtt_server));
-    LoggerService::println("Port: " + String(this->m_mqtt_port));
-    LoggerService::println("User: " + String(this->m_mqtt_user));
-    LoggerService::println("Pass: " + String(this->m_mqtt_pass));
+    m_state = WIFI_CONNECTED;
+    m_state_ms = millis();
 
-    if (this->m_should_save_config)
+    // OTA 服务依赖网络, 首次连接后再启动
+    if (!m_ota_started)
     {
-        LoggerService::println("Saving MQTT config ...");
-        this->save_conf_();
+        this->setup_ota_();
+        m_ota_started = true;
     }
 }
 
+void WirelessService::on_lease_bound_()
+{
+    m_lease_pending = false;
+    if (WiFi.localIP() != IPAddress(m_wifi_cache.ip))
+    {
+        // 地址变化后已建立的连接失效, 由各服务自行重连
+        LoggerService::println(F("DHCP lease differs from cached address, local IP:"));
+        LoggerService::println(WiFi.localIP());
+    }
+    else
+    {
+        LoggerService::println(F("DHCP lease confirmed cached address"));
+    }
+
+    // 以 DHCP 获得的租约更新缓存
+    this->save_wifi_cache_();
+}
+
+bool WirelessService::load_wifi_cache_(ConfigService::WifiCache &cache)
+{
+    const size_t body_offset = offsetof(ConfigService::WifiCache, bssid);
+    auto is_valid = [body_offset](const ConfigService::WifiCache &c)
+    {
+        return c.magic == WIFI_CACHE_MAGIC &&
+               c.crc == crc32((const uint8_t *)&c + body_offset, sizeof(c) - body_offset);
+    };
+
+    // RTC 内存在复位后仍然保留, 断电后则使用配置存储中的副本
+    if (ESP.rtcUserMemoryRead(WIFI_CACHE_RTC_OFFSET, (uint32_t *)&cache, sizeof(cache)) && is_valid(cache))
+    {
+        return true;
+    }
+
+    cache = ConfigService::get_instance()->wifi();
+    return is_valid(cache);
+}
+
+void WirelessService::save_wifi_cache_()
+{
+    const size_t body_offset = offsetof(ConfigService::WifiCache, bssid);
+
+    ConfigService::WifiCache cache = {};
+    cache.magic = WIFI_CACHE_MAGIC;
+    memcpy(cache.bssid, WiFi.BSSID(), sizeof(cache.bssid));
+    cache.channel = WiFi.channel();
+    cache.ip = WiFi.localIP();
+    cache.gateway = WiFi.gatewayIP();
+    cache.netmask = WiFi.subnetMask();
+    cache.dns = WiFi.dnsIP();
+    cache.crc = crc32((const uint8_t *)&cache + body_offset, sizeof(cache) - body_offset);
+
+    ESP.rtcUserMemoryWrite(WIFI_CACHE_RTC_OFFSET, (uint32_t *)&cache, sizeof(cache));
+
+    // 缓存内容未变化时不写配置存储, 减少闪存磨损
+    ConfigService *config = ConfigService::get_instance();
+    if (memcmp(&cache, &config->wifi(), sizeof(cache)) == 0)
+    {
+        return;
+    }
+    m_wifi_cache = cache;
+    config->wifi() = cache;
+    config->save();
+}
+
 void WirelessService::setup_ota_()
 {
     // 初始化 OTA
     ArduinoOTA.setPassword(DEF_OTA_PASSWORD);
 
+    // 镜像须以 tools/ota_pack.py 压缩并附加 SHA-256 摘要, 写入完成后校验摘要, 通过后才提交更新并重启
+    // gzip 压缩的镜像原样写入更新分区, 重启时由 eboot 流式解压复制到目标位置
+    Update.installSignature(&m_ota_hash, &m_ota_verifier);
+
     ArduinoOTA.onStart(
         []()
         {
-            String type;
-            if (ArduinoOTA.getCommand() == U_FLASH)
-            {
-                type = "sketch";
-            }
-            else
+            WirelessService *ws = WirelessService::get_instance();
+            ws->m_ota_start_ms = millis();
+            ws->m_ota_progress_step = 0;
+            ws->m_ota_size = 0;
+
+            // 传输期间 ArduinoOTA.handle() 阻塞主循环, 电机控制任务无法运行, 先停止所有电机
+            for (int ch = 0; ch < MOTOR_CHANNELS; ch++)
             {
-                // U_FS
-                type = "filesystem";
+                MotorService::get_instance(ch)->stop();
             }
 
             // 卸载关闭文件系统以避免 OTA 更新时造成数据损失
-            LittleFS.end();
+            ConfigService::get_instance()->end();
 
-            LoggerService::println("Start updating " + type);
+            LoggerService::printf_P(PSTR("Start updating %s\n"), ArduinoOTA.getCommand() == U_FLASH ? "sketch" : "filesystem");
         });
 
     ArduinoOTA.onEnd(
         []()
         {
-            LoggerService::println("\nEnd");
+            WirelessService *ws = WirelessService::get_instance();
+            LoggerService::printf_P(PSTR("OTA: %u bytes received in %lu ms, digest verified, rebooting\n"),
+                                    ws->m_ota_size, millis() - ws->m_ota_start_ms);
         });
     ArduinoOTA.onProgress(
         [](unsigned int progress, unsigned int total)
         {
-            LoggerService::printf("Progress: %u%%\r", (progress / (total / 100)));
+            // 每 10% 输出一次进度及平均传输速率
+            WirelessService *ws = WirelessService::get_instance();
+            ws->m_ota_size = total;
+            unsigned int step = total > 0 ? (unsigned int)((uint64_t)progress * 10 / total) : 0;
+            if (step > ws->m_ota_progress_step)
+            {
+                ws->m_ota_progress_step = step;
+                unsigned long elapsed_ms = millis() - ws->m_ota_start_ms;
+                LoggerService::printf_P(PSTR("OTA: %u%% (%u/%u bytes, %lu ms, %lu KB/s)\n"), step * 10, progress, total,
+                                        elapsed_ms, elapsed_ms > 0 ? progress / elapsed_ms : 0UL);
+            }
         });
     ArduinoOTA.onError(
         [](ota_error_t error)
         {
-            LoggerService::printf("Error[%u]: ", error);
+            LoggerService::printf_P(PSTR("Error[%u]: "), error);
             if (error == OTA_AUTH_ERROR)
-                LoggerService::println("Auth Failed");
+                LoggerService::println(F("Auth Failed"));
             else if (error == OTA_BEGIN_ERROR)
-                LoggerService::println("Begin Failed");
+                LoggerService::println(F("Begin Failed"));
             else if (error == OTA_CONNECT_ERROR)
-                LoggerService::println("Connect Failed");
+                LoggerService::println(F("Connect Failed"));
             else if (error == OTA_RECEIVE_ERROR)
-                LoggerService::println("Receive Failed");
+                LoggerService::println(F("Receive Failed"));
+            else if (error == OTA_END_ERROR && Update.getError() == UPDATE_ERROR_SIGN)
+                LoggerService::println(F("End Failed: image digest missing or mismatched"));
             else if (error == OTA_END_ERROR)
-                LoggerService::println("End Failed");
+                LoggerService::printf_P(PSTR("End Failed: %s\n"), Update.getErrorString().c_str());
+
+            // 更新未提交, 设备继续运行, 重新挂载 onStart 中卸载的文件系统
+            ConfigService::get_instance()->remount();
         });
     ArduinoOTA.begin();
 }
@@ -167,11 +397,11 @@ void WirelessService::wait_check_clear_btn_()
     clear_btn.onPressed(
         [=]()
         {
-            LoggerService::println("Clear button activated, clear WiFi setting and rebooting...");
+            LoggerService::println(F("Clear button activated, clear WiFi setting and rebooting..."));
             this->clear_settings_and_restart();
         });
 
-    LoggerService::printf("Press FLASH button to clear WiFi settings...\n");
+    LoggerService::printf_P(PSTR("Press FLASH button to clear WiFi settings...\n"));
 
     // 等待清除按钮按下并显示进度
     unsigned long clear_check_start = millis();
@@ -179,78 +409,7 @@ void WirelessService::wait_check_clear_btn_()
     {
         clear_btn.read();
         delay(5);
-        LoggerService::print(".");
+        LoggerService::print(F("."));
     }
     LoggerService::println();
 }
-
-void WirelessService::load_conf_()
-{
-    LoggerService::println("Mounting filesystem ...");
-    if (LittleFS.begin())
-    {
-        LoggerService::println("Filesystem mounted.");
-
-        if (LittleFS.exists(MQTT_CONF_FILE))
-        {
-            // MQTT 配置文件已存在, 读入其数据
-            LoggerService::println("Reading MQTT conf file " + String(MQTT_CONF_FILE) + " ...");
-            File conf_file = LittleFS.open(MQTT_CONF_FILE, "r");
-            if (conf_file)
-            {
-                LoggerService::println("Opened config file");
-
-                // 解析 JSON 数据
-                JsonDocument doc;
-                auto err = deserializeJson(doc, conf_file);
-                if (!err)
-                {
-                    LoggerService::println("Parsed JSON data");
-                    strcpy(this->m_mqtt_server, doc["mqtt_server"]);
-                    strcpy(this->m_mqtt_port, doc["mqtt_port"]);
-                    strcpy(this->m_mqtt_user, doc["mqtt_user"]);
-                    strcpy(this->m_mqtt_pass, doc["mqtt_pass"]);
-                }
-                else
-                {
-                    LoggerService::printf("Failed to load JSON config data: %s\n", err.c_str());
-                }
-
-                conf_file.close();
-            }
-        }
-    }
-    else
-    {
-        LoggerService::println("Failed to mount filesystem.");
-    }
-}
-
-void WirelessService::save_conf_()
-{
-    JsonDocument doc;
-    doc["mqtt_server"] = this->m_mqtt_server;
-    doc["mqtt_port"] = this->m_mqtt_port;
-    doc["mqtt_user"] = this->m_mqtt_user;
-    doc["mqtt_pass"] = this->m_mqtt_pass;
-
-    if (LittleFS.begin())
-    {
-        File conf_file = LittleFS.open(MQTT_CONF_FILE, "w");
-        if (!conf_file)
-        {
-            LoggerService::println("Failed to open config file for writing: " + String(MQTT_CONF_FILE));
-            return;
-        }
-
-        serializeJson(doc, conf_file);
-        serializeJson(doc, Serial);
-        LoggerService::println();
-
-        conf_file.close();
-    }
-    else
-    {
-        LoggerService::println("Failed to mount filesystem.");
-    }
-}
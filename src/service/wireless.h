@@ -1,6 +1,14 @@
 #pragma once
 
+#include "service/config.h"
+#include "utility/ota_digest.h"
+
 #include <Arduino.h>
+#include <ESP8266WiFi.h>
+#include <BearSSLHelpers.h>
+
+class WiFiManager;
+class WiFiManagerParameter;
 
 class WirelessService
 {
@@ -8,26 +16,38 @@ public:
     static constexpr int CLEAR_BTN_PIN = D3;       // 配置清除按钮引脚 (NodeMCU 上的 FLASH 按钮)
     static constexpr int CLEAR_CHECK_DELAY = 3000; // 重启后允许清除按钮生效的时间 (ms)
 
-    static constexpr int DEF_FAIL_REBOOT_DELAY = 5000;
+    static constexpr int UPDATE_INTERVAL_MS = 20;          // WiFi 连接及 OTA 请求处理间隔(ms)
+    static constexpr int FULL_CONNECT_TIMEOUT_MS = 20000;  // 扫描连接超时时间(ms), 超时后打开配置门户
+    static constexpr int CONFIG_PORTAL_TIMEOUT_S = 180;    // 配置门户超时时间(s), 超时后重新尝试连接
     static constexpr const char *DEF_OTA_PASSWORD = "chaos123456";
-    static constexpr const char *DEF_MQTT_SERVER = "chaosgateway";
-    static constexpr const char *DEF_MQTT_PORT = "1883";
-    static constexpr const char *MQTT_CONF_FILE = "/mqtt_conf.json";
+    static constexpr uint32_t WIFI_CACHE_MAGIC = 0x57464331; // "WFC1"
+    static constexpr int WIFI_CACHE_RTC_OFFSET = 0;          // RTC 用户内存中的缓存位置(4 字节块)
+    static constexpr int FAST_CONNECT_TIMEOUT_MS = 4000;     // 快速连接超时时间(ms), 超时后回退到完整扫描
+
+    // WiFi 连接状态
+    enum WifiState
+    {
+        WIFI_FAST_CONNECTING, // 使用缓存的接入点直接连接
+        WIFI_CONNECTING,      // 使用保存的设置扫描连接
+        WIFI_PORTAL,          // 运行配置门户
+        WIFI_CONNECTED        // 已连接
+    };
+
 
     static WirelessService *get_instance()
     {
-        if (m_instance == nullptr)
-        {
-            m_instance = new WirelessService();
-        }
-        return m_instance;
+        static WirelessService instance;
+        return &instance;
     }
 
     ~WirelessService();
 
-    /** 初始化无线网络 */
+    /** 初始化无线网络, 连接在后台异步完成 */
     void begin();
 
+    /** 是否已连接 WiFi */
+    bool is_connected() const { return m_state == WIFI_CONNECTED && WiFi.status() == WL_CONNECTED; }
+
     /** 更新无线网络服务状态 */
     void update();
 
@@ -35,28 +55,47 @@ public:
     void clear_settings_and_restart();
 
     /** 获取 MQTT 服务器地址 */
-    const char *mqtt_server() const { return m_mqtt_server; }
+    const char *mqtt_server() const { return ConfigService::get_instance()->mqtt().server; }
     /** 获取 MQTT 服务器端口 */
-    uint16_t mqtt_port() const { return atoi(m_mqtt_port); }
+    uint16_t mqtt_port() const { return atoi(ConfigService::get_instance()->mqtt().port); }
     /** 获取 MQTT 用户名 */
-    const char *mqtt_user() const { return m_mqtt_user; }
+    const char *mqtt_user() const { return ConfigService::get_instance()->mqtt().user; }
     /** 获取 MQTT 密码 */
-    const char *mqtt_pass() const { return m_mqtt_pass; }
+    const char *mqtt_pass() const { return ConfigService::get_instance()->mqtt().pass; }
+    /** 获取同步移动分组名称 */
+    const char *mqtt_group() const { return ConfigService::get_instance()->mqtt_group(); }
 
 protected:
     WirelessService();
 
-    void load_conf_();
-    void save_conf_();
     void wait_check_clear_btn_();
-    void setup_wifi_();
+    void start_connect_();
+    void start_full_connect_();
+    void start_portal_();
+    void on_portal_saved_();
+    void on_connected_();
+    void on_lease_bound_();
+    bool load_wifi_cache_(ConfigService::WifiCache &cache);
+    void save_wifi_cache_();
     void setup_ota_();
 
-    static WirelessService *m_instance;
-
-    char m_mqtt_server[40];
-    char m_mqtt_port[6];
-    char m_mqtt_user[40];
-    char m_mqtt_pass[40];
     bool m_should_save_config;
+    ConfigService::WifiCache m_wifi_cache; // 启动时加载的接入点缓存
+    bool m_lease_pending;                  // 快速连接后已恢复 DHCP, 等待获得租约
+
+    WifiState m_state;                    // WiFi 连接状态
+    unsigned long m_state_ms;             // 进入当前连接状态的时间戳
+    unsigned long m_connect_start_ms;     // 开始连接的时间戳
+    bool m_ota_started;                   // OTA 服务是否已启动
+    BearSSL::HashSHA256 m_ota_hash;       // OTA 镜像摘要计算
+    OtaDigestVerifier m_ota_verifier;     // OTA 镜像摘要校验
+    unsigned long m_ota_start_ms;         // OTA 开始时间戳
+    unsigned int m_ota_progress_step;     // 已输出的 OTA 进度 (10% 为一步)
+    unsigned int m_ota_size;              // OTA 镜像大小 (压缩后, 含摘要)
+    WiFiManager *m_wm;                    // 配置门户, 仅在需要时创建
+    WiFiManagerParameter *m_param_server; // 可配置的 MQTT 参数
+    WiFiManagerParameter *m_param_port;
+    WiFiManagerParameter *m_param_user;
+    WiFiManagerParameter *m_param_pass;
+    WiFiManagerParameter *m_param_group;
 };
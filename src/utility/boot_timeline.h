@@ -0,0 +1,41 @@
+#pragma once
+
+#include "service/logger.h"
+
+#include <Arduino.h>
+
+/** 启动阶段时间线, 记录各服务就绪的时刻并输出到日志 */
+class BootTimeline
+{
+public:
+    static constexpr int MAX_PHASES = 12;
+
+    /** 记录启动阶段完成时刻 */
+    static void mark(const char *phase)
+    {
+        unsigned long cur_ms = millis();
+        if (m_count < MAX_PHASES)
+        {
+            m_phases[m_count] = phase;
+            m_times_ms[m_count] = cur_ms;
+            m_count++;
+        }
+        LoggerService::printf_P(PSTR("Boot: %s ready at %lu ms\n"), phase, cur_ms);
+    }
+
+    /** 输出完整的启动时间线 */
+    static void dump()
+    {
+        LoggerService::println(F("Boot timeline:"));
+        for (int i = 0; i < m_count; i++)
+        {
+            unsigned long delta_ms = m_times_ms[i] - (i > 0 ? m_times_ms[i - 1] : 0);
+            LoggerService::printf_P(PSTR("  %-10s %6lu ms (+%lu ms)\n"), m_phases[i], m_times_ms[i], delta_ms);
+        }
+    }
+
+private:
+    static inline const char *m_phases[MAX_PHASES] = {};
+    static inline unsigned long m_times_ms[MAX_PHASES] = {};
+    static inline int m_count = 0;
+};
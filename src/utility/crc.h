@@ -0,0 +1,24 @@
+#pragma once
+
+#include <Arduino.h>
+
+/** 计算 CRC-32 (IEEE 802.3) 校验值, 可传入上次结果分段计算 */
+inline uint32_t crc32_update(uint32_t crc, const void *data, size_t len)
+{
+    const uint8_t *p = (const uint8_t *)data;
+    crc = ~crc;
+    while (len--)
+    {
+        crc ^= *p++;
+        for (int k = 0; k < 8; k++)
+        {
+            crc = (crc >> 1) ^ (0xEDB88320 & (0 - (crc & 1)));
+        }
+    }
+    return ~crc;
+}
+
+inline uint32_t crc32(const void *data, size_t len)
+{
+    return crc32_update(0, data, len);
+}
@@ -0,0 +1,182 @@
+#include "utility/drv8833.h"
+
+uint8_t Drv8833::m_awake_refs[17] = {};
+
+Drv8833::Drv8833(uint8_t sleep_pin, uint8_t in1_pin, uint8_t in2_pin, int pwm_range) : m_sleep_pin(sleep_pin),
+                                                                                       m_in1_pin(in1_pin),
+                                                                                       m_in2_pin(in2_pin),
+                                                                                       m_pwm_range(pwm_range),
+                                                                                       m_decay(DECAY_SLOW),
+                                                                                       m_awake(false),
+                                                                                       m_in1_duty(-1),
+                                                                                       m_in2_duty(-1),
+                                                                                       m_applied_pwm(0),
+                                                                                       m_requested_pwm(0),
+                                                                                       m_last_dir(0),
+                                                                                       m_last_drive_us(0),
+                                                                                       m_dead_pending(false),
+                                                                                       m_dead_start_us(0),
+                                                                                       m_write_count(0)
+{
+}
+
+Drv8833::~Drv8833()
+{
+}
+
+void Drv8833::begin()
+{
+    pinMode(m_sleep_pin, OUTPUT);
+    pinMode(m_in1_pin, OUTPUT);
+    pinMode(m_in2_pin, OUTPUT);
+
+    // 上电状态未知, 强制写入一次
+    m_in1_duty = -1;
+    m_in2_duty = -1;
+    this->stop();
+
+    // 共用休眠引脚的另一路可能已在运行
+    if (m_awake_refs[m_sleep_pin] == 0)
+    {
+        digitalWrite(m_sleep_pin, LOW);
+        m_write_count++;
+    }
+}
+
+void Drv8833::set_output(int pwm)
+{
+    pwm = constrain(pwm, -m_pwm_range, m_pwm_range);
+    m_requested_pwm = pwm;
+
+    this->wake_();
+
+    // 反向驱动前若距上次正向驱动不足死区时间, 先零输出等待死区结束
+    int dir = (pwm > 0) - (pwm < 0);
+    unsigned long cur_us = micros();
+    if (dir != 0 && m_last_dir != 0 && dir != m_last_dir && !m_dead_pending &&
+        cur_us - m_last_drive_us < REVERSAL_DEAD_TIME_US)
+    {
+        m_dead_pending = true;
+        m_dead_start_us = cur_us;
+    }
+
+    if (m_dead_pending)
+    {
+        if (cur_us - m_dead_start_us < REVERSAL_DEAD_TIME_US)
+        {
+            this->apply_(0);
+            return;
+        }
+        m_dead_pending = false;
+    }
+
+    this->apply_(pwm);
+}
+
+void Drv8833::stop()
+{
+    m_requested_pwm = 0;
+    m_dead_pending = false;
+
+    // 休眠前两路输入均置低电平 (滑行)
+    this->write_pin_(m_in1_pin, 0, m_in1_duty);
+    this->write_pin_(m_in2_pin, 0, m_in2_duty);
+    m_applied_pwm = 0;
+
+    this->sleep_();
+}
+
+void Drv8833::update()
+{
+    if (m_dead_pending && micros() - m_dead_start_us >= REVERSAL_DEAD_TIME_US)
+    {
+        m_dead_pending = false;
+        if (m_awake)
+        {
+            this->apply_(m_requested_pwm);
+        }
+    }
+}
+
+void Drv8833::set_decay(DecayMode mode)
+{
+    if (mode == m_decay)
+    {
+        return;
+    }
+    m_decay = mode;
+
+    // 按新的衰减方式重新输出
+    if (m_awake && !m_dead_pending)
+    {
+        this->apply_(m_applied_pwm);
+    }
+}
+
+void Drv8833::apply_(int pwm)
+{
+    int in1, in2;
+    int mag = abs(pwm);
+
+    if (m_decay == DECAY_SLOW)
+    {
+        // 慢衰减: 驱动侧保持高电平, 另一侧反相 PWM; 零输出时两路均为高电平 (制动)
+        in1 = pwm < 0 ? m_pwm_range - mag : m_pwm_range;
+        in2 = pwm > 0 ? m_pwm_range - mag : m_pwm_range;
+    }
+    else
+    {
+        // 快衰减: 驱动侧输出 PWM, 另一侧保持低电平; 零输出时两路均为低电平 (滑行)
+        in1 = pwm > 0 ? mag : 0;
+        in2 = pwm < 0 ? mag : 0;
+    }
+
+    this->write_pin_(m_in1_pin, in1, m_in1_duty);
+    this->write_pin_(m_in2_pin, in2, m_in2_duty);
+    m_applied_pwm = pwm;
+
+    if (pwm != 0)
+    {
+        m_last_dir = pwm > 0 ? 1 : -1;
+        m_last_drive_us = micros();
+    }
+}
+
+void Drv8833::wake_()
+{
+    if (m_awake)
+    {
+        return;
+    }
+    m_awake = true;
+    if (m_awake_refs[m_sleep_pin]++ == 0)
+    {
+        digitalWrite(m_sleep_pin, HIGH);
+        m_write_count++;
+    }
+}
+
+void Drv8833::sleep_()
+{
+    if (!m_awake)
+    {
+        return;
+    }
+    m_awake = false;
+    if (--m_awake_refs[m_sleep_pin] == 0)
+    {
+        digitalWrite(m_sleep_pin, LOW);
+        m_write_count++;
+    }
+}
+
+void Drv8833::write_pin_(uint8_t pin, int duty, int &cached)
+{
+    if (duty == cached)
+    {
+        return;
+    }
+    analogWrite(pin, duty);
+    cached = duty;
+    m_write_count++;
+}
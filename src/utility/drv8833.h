@@ -0,0 +1,73 @@
+#pragma once
+
+#include <Arduino.h>
+
+/** DRV8833 单通道 H 桥输出级
+ *
+ * 缓存两路输入引脚的当前占空比及休眠状态, 只在输出变化时写 GPIO。
+ * 支持两种 PWM 衰减方式:
+ * - 慢衰减: 一路输入保持高电平, 另一路输出反相 PWM, 关断期间两路均为高电平即制动, 低速线性度较好;
+ * - 快衰减: 一路输入输出 PWM, 另一路保持低电平, 关断期间两路均为低电平即滑行。
+ * 输出换向时先以零输出保持一段死区时间再反向驱动, 死区在 update() 中以非阻塞方式结束。
+ * 同一芯片的两路 H 桥共用休眠引脚, 按引脚对唤醒的实例计数, 所有实例都停止后才让芯片休眠。
+ */
+class Drv8833
+{
+public:
+    static constexpr unsigned long REVERSAL_DEAD_TIME_US = 2000; // 换向死区时间(us)
+
+    // PWM 衰减方式
+    enum DecayMode : uint8_t
+    {
+        DECAY_SLOW = 0, // 慢衰减 (关断期间制动)
+        DECAY_FAST = 1  // 快衰减 (关断期间滑行)
+    };
+
+    Drv8833(uint8_t sleep_pin, uint8_t in1_pin, uint8_t in2_pin, int pwm_range);
+    ~Drv8833();
+
+    /** 配置引脚, 输出置零并让驱动模块休眠 */
+    void begin();
+
+    /** 设置输出 (正值正转, 负值反转, 0 按衰减方式制动或滑行), 驱动模块保持唤醒 */
+    void set_output(int pwm);
+    /** 输出置零并让驱动模块休眠 */
+    void stop();
+    /** 换向死区结束后应用等待中的输出, 须在控制周期中调用 */
+    void update();
+
+    /** 设置 PWM 衰减方式 */
+    void set_decay(DecayMode mode);
+    /** 获取 PWM 衰减方式 */
+    DecayMode get_decay() const { return m_decay; }
+
+    /** 本路输出是否要求驱动模块唤醒 */
+    bool is_awake() const { return m_awake; }
+    /** 获取累计 GPIO 写入次数 */
+    uint32_t get_write_count() const { return m_write_count; }
+
+protected:
+    void apply_(int pwm);
+    void write_pin_(uint8_t pin, int duty, int &cached);
+    void wake_();
+    void sleep_();
+
+    static uint8_t m_awake_refs[17]; // 各 GPIO 作为休眠引脚时被唤醒的实例数
+
+    uint8_t m_sleep_pin;
+    uint8_t m_in1_pin;
+    uint8_t m_in2_pin;
+    int m_pwm_range;
+    DecayMode m_decay;
+
+    bool m_awake;                   // 本实例是否持有唤醒计数
+    int m_in1_duty;                 // IN1 当前占空比, -1 表示未知
+    int m_in2_duty;                 // IN2 当前占空比, -1 表示未知
+    int m_applied_pwm;              // 当前实际输出
+    int m_requested_pwm;            // 最近一次请求的输出
+    int m_last_dir;                 // 最近一次非零输出的方向
+    unsigned long m_last_drive_us;  // 最近一次非零输出的时间戳
+    bool m_dead_pending;            // 是否处于换向死区
+    unsigned long m_dead_start_us;  // 换向死区开始时间戳
+    uint32_t m_write_count;
+};
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <ArduinoHA.h>
+
+/** HA 自动发现配置发送策略
+ *
+ * 首次连接 MQTT 服务器时各实体发送完整的自动发现配置(以保留消息发布),
+ * 之后的断线重连只恢复命令主题订阅, 直到 HA 重启(先发出下线消息, 再发出上线消息)时再重新发送。
+ */
+class HADiscovery
+{
+public:
+    static bool should_skip() { return m_skip; }
+    static void set_skip(bool skip) { m_skip = skip; }
+
+private:
+    static inline bool m_skip = false;
+};
+
+/** 支持跳过重复发送自动发现配置的 HA 实体, HAS_COMMAND 表示实体需要订阅命令主题 */
+template <typename T, bool HAS_COMMAND>
+class HACachedDiscovery : public T
+{
+public:
+    using T::T;
+
+protected:
+    void onMqttConnected() override
+    {
+        if (!HADiscovery::should_skip())
+        {
+            T::onMqttConnected();
+            return;
+        }
+
+        // 服务器保留了自动发现配置, 只需恢复可用状态及命令订阅
+        if (this->uniqueId() == nullptr)
+        {
+            return;
+        }
+        this->publishAvailability();
+        if (HAS_COMMAND)
+        {
+            HABaseDeviceType::subscribeTopic(this->uniqueId(), AHATOFSTR(HACommandTopic));
+        }
+    }
+};
+
+using HACachedButton = HACachedDiscovery<HAButton, true>;
+using HACachedSensor = HACachedDiscovery<HASensor, false>;
+using HACachedNumber = HACachedDiscovery<HANumber, true>;
@@ -0,0 +1,24 @@
+#pragma once
+
+#include <Arduino.h>
+#include <Updater.h>
+
+/** OTA 镜像 SHA-256 摘要校验
+ *
+ * 镜像 (通常为 gzip 压缩后的固件或文件系统镜像) 末尾附加 32 字节 SHA-256 摘要及 4 字节小端长度字段,
+ * 由 tools/ota_pack.py 生成。Updater 在写入完成后、向 eboot 提交复制命令前计算摘要之前全部内容的哈希,
+ * 调用 verify() 与附加的摘要比较, 不一致时更新失败, 设备不会重启进入损坏的镜像。
+ */
+class OtaDigestVerifier : public UpdaterVerifyClass
+{
+public:
+    static constexpr uint32_t DIGEST_LEN = 32;
+
+    uint32_t length() override { return DIGEST_LEN; }
+
+    bool verify(UpdaterHashClass *hash, const void *signature, uint32_t signature_len) override
+    {
+        return signature_len == DIGEST_LEN && hash->len() == (int)DIGEST_LEN &&
+               memcmp(hash->hash(), signature, DIGEST_LEN) == 0;
+    }
+};
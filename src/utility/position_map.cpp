@@ -0,0 +1,121 @@
+#include "utility/position_map.h"
+
+/** 有符号整数除法, 结果四舍五入 */
+static int64_t div_round(int64_t num, int64_t den)
+{
+    if (den < 0)
+    {
+        num = -num;
+        den = -den;
+    }
+    return num >= 0 ? (num + den / 2) / den : -((-num + den / 2) / den);
+}
+
+PositionMap::PositionMap() : m_points(),
+                             m_count(0)
+{
+}
+
+int PositionMap::knots_(long close_pos, long open_pos, Point *out, int skip_percent) const
+{
+    // 以打开方向为正, 中间点须严格位于前一节点与完全打开位置之间
+    long dir = open_pos > close_pos ? 1 : -1;
+    int n = 0;
+    out[n++] = {(int32_t)close_pos, 0};
+    for (int i = 0; i < m_count; i++)
+    {
+        const Point &p = m_points[i];
+        if (p.percent != skip_percent && (p.pos - out[n - 1].pos) * dir > 0 && (open_pos - p.pos) * dir > 0)
+        {
+            out[n++] = p;
+        }
+    }
+    out[n++] = {(int32_t)open_pos, 100};
+    return n;
+}
+
+bool PositionMap::set_point(int percent, long pos, long close_pos, long open_pos)
+{
+    if (percent < 1 || percent > 99 || open_pos == close_pos)
+    {
+        return false;
+    }
+
+    // 新标定点须严格位于开度相邻的两个节点之间
+    Point nodes[MAX_KNOTS];
+    this->knots_(close_pos, open_pos, nodes, percent);
+    int upper = 1;
+    while (nodes[upper].percent < percent)
+    {
+        upper++;
+    }
+    long dir = open_pos > close_pos ? 1 : -1;
+    if ((pos - nodes[upper - 1].pos) * dir <= 0 || (nodes[upper].pos - pos) * dir <= 0)
+    {
+        return false;
+    }
+
+    // 替换同一开度的标定点, 否则按开度顺序插入
+    int i = 0;
+    while (i < m_count && m_points[i].percent < percent)
+    {
+        i++;
+    }
+    if (i < m_count && m_points[i].percent == percent)
+    {
+        m_points[i].pos = pos;
+        return true;
+    }
+    if (m_count >= MAX_POINTS)
+    {
+        return false;
+    }
+    memmove(&m_points[i + 1], &m_points[i], (m_count - i) * sizeof(Point));
+    m_points[i] = {(int32_t)pos, (uint8_t)percent};
+    m_count++;
+    return true;
+}
+
+long PositionMap::percent_to_pos(int percent, long close_pos, long open_pos) const
+{
+    percent = constrain(percent, 0, 100);
+    Point nodes[MAX_KNOTS];
+    int n = this->knots_(close_pos, open_pos, nodes, -1);
+
+    int i = 1;
+    while (i < n - 1 && nodes[i].percent < percent)
+    {
+        i++;
+    }
+    const Point &a = nodes[i - 1];
+    const Point &b = nodes[i];
+    return a.pos + (long)div_round((int64_t)(percent - a.percent) * (b.pos - a.pos), b.percent - a.percent);
+}
+
+int PositionMap::pos_to_percent(long pos, long close_pos, long open_pos) const
+{
+    if (open_pos == close_pos)
+    {
+        return 0;
+    }
+    long dir = open_pos > close_pos ? 1 : -1;
+    if ((pos - close_pos) * dir <= 0)
+    {
+        return 0;
+    }
+    if ((pos - open_pos) * dir >= 0)
+    {
+        return 100;
+    }
+
+    Point nodes[MAX_KNOTS];
+    int n = this->knots_(close_pos, open_pos, nodes, -1);
+    int i = 1;
+    while (i < n - 1 && (pos - nodes[i].pos) * dir > 0)
+    {
+        i++;
+    }
+    const Point &a = nodes[i - 1];
+    const Point &b = nodes[i];
+    return a.percent + (int)div_round((int64_t)(pos - a.pos) * (b.percent - a.percent), b.pos - a.pos);
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <Arduino.h>
+
+/** 开度百分比与电机位置的多点标定表
+ *
+ * 卷帘卷起后卷径变大, 每个编码脉冲对应的帘布行程随位置变化, 开度与电机位置不是线性关系。
+ * 除完全关闭 (0%) 和完全打开 (100%) 两端外, 可在若干中间开度处标定实际电机位置,
+ * 相邻标定点之间按整数运算线性插值。各点位置须随开度严格单调, 插值及反查结果因而也单调;
+ * 两端重新标定后不再单调的中间点在查表时忽略。
+ */
+class PositionMap
+{
+public:
+    static constexpr int MAX_POINTS = 7;              // 中间标定点数上限
+    static constexpr int MAX_KNOTS = MAX_POINTS + 2;  // 含两端的插值节点数上限
+
+    /** 标定点 */
+    struct Point
+    {
+        int32_t pos;     // 电机位置
+        uint8_t percent; // 开度百分比
+    };
+
+    PositionMap();
+
+    /** 清除所有中间标定点 */
+    void clear_points() { m_count = 0; }
+    /** 获取中间标定点数 */
+    int point_count() const { return m_count; }
+    /** 获取中间标定点, 按开度升序 */
+    const Point &point(int index) const { return m_points[index]; }
+
+    /** 标定开度 percent (1-99) 处的电机位置, 替换同一开度的已有标定点;
+     * 两端未标定、标定点已满或位置不在相邻节点之间时返回 false */
+    bool set_point(int percent, long pos, long close_pos, long open_pos);
+
+    /** 生成含两端的插值节点, 按开度升序, 返回节点数 */
+    int knots(long close_pos, long open_pos, Point *out) const { return this->knots_(close_pos, open_pos, out, -1); }
+
+    /** 将开度百分比换算为电机位置 */
+    long percent_to_pos(int percent, long close_pos, long open_pos) const;
+    /** 将电机位置换算为开度百分比 (四舍五入) */
+    int pos_to_percent(long pos, long close_pos, long open_pos) const;
+
+protected:
+    /** 生成插值节点, 跳过开度为 skip_percent 的标定点及不单调的标定点 */
+    int knots_(long close_pos, long open_pos, Point *out, int skip_percent) const;
+
+    Point m_points[MAX_POINTS];
+    int m_count;
+};
@@ -0,0 +1,140 @@
+#include "utility/quadrature_encoder.h"
+
+// 状态转换表, 下标为 (上次状态 << 2 | 当前状态), 状态为 (B << 1 | A), INVALID 表示两相同时变化
+// 放在 DRAM 中: 中断中不能访问 Flash, 而 IRAM 只支持 32 位对齐访问
+static constexpr int8_t INVALID = 2;
+static const int8_t TRANSITION_TABLE[16] = {
+    0, -1, +1, INVALID,
+    +1, 0, INVALID, -1,
+    -1, INVALID, 0, +1,
+    INVALID, +1, -1, 0};
+
+QuadratureEncoder::QuadratureEncoder(uint8_t pin_a, uint8_t pin_b) : m_pin_a(pin_a),
+                                                                     m_pin_b(pin_b),
+                                                                     m_attached(false),
+                                                                     m_state(0),
+                                                                     m_last_dir(0),
+                                                                     m_position(0),
+                                                                     m_edges(0),
+                                                                     m_errors(0),
+                                                                     m_isr_max_cycles(0),
+                                                                     m_last_edge_cycles(0),
+                                                                     m_min_edge_gap_cycles(UINT32_MAX)
+{
+}
+
+QuadratureEncoder::~QuadratureEncoder()
+{
+    if (m_attached)
+    {
+        detachInterrupt(digitalPinToInterrupt(m_pin_a));
+        detachInterrupt(digitalPinToInterrupt(m_pin_b));
+    }
+}
+
+void QuadratureEncoder::begin()
+{
+    pinMode(m_pin_a, INPUT_PULLUP);
+    pinMode(m_pin_b, INPUT_PULLUP);
+    delayMicroseconds(2000);
+
+    uint32_t gpi = GPI;
+    m_state = ((gpi >> m_pin_a) & 1) | (((gpi >> m_pin_b) & 1) << 1);
+
+    attachInterruptArg(digitalPinToInterrupt(m_pin_a), &QuadratureEncoder::isr_, this, CHANGE);
+    attachInterruptArg(digitalPinToInterrupt(m_pin_b), &QuadratureEncoder::isr_, this, CHANGE);
+    m_attached = true;
+}
+
+void IRAM_ATTR QuadratureEncoder::isr_(void *arg)
+{
+    uint32_t start = ESP.getCycleCount();
+    QuadratureEncoder *enc = (QuadratureEncoder *)arg;
+
+    // 一次读取输入寄存器, 保证两相电平为同一时刻的采样
+    uint32_t gpi = GPI;
+    uint8_t cur = ((gpi >> enc->m_pin_a) & 1) | (((gpi >> enc->m_pin_b) & 1) << 1);
+    int8_t delta = TRANSITION_TABLE[(enc->m_state << 2) | cur];
+    enc->m_state = cur;
+
+    if (delta == INVALID)
+    {
+        // 丢失了一个边沿, 按上次运动方向补偿 2 个脉冲
+        enc->m_errors++;
+        enc->m_position += 2 * enc->m_last_dir;
+    }
+    else if (delta != 0)
+    {
+        enc->m_position += delta;
+        enc->m_last_dir = delta;
+    }
+    enc->m_edges++;
+
+    uint32_t gap = start - enc->m_last_edge_cycles;
+    enc->m_last_edge_cycles = start;
+    if (gap < enc->m_min_edge_gap_cycles)
+    {
+        enc->m_min_edge_gap_cycles = gap;
+    }
+
+    uint32_t cost = ESP.getCycleCount() - start;
+    if (cost > enc->m_isr_max_cycles)
+    {
+        enc->m_isr_max_cycles = cost;
+    }
+}
+
+int64_t QuadratureEncoder::read64() const
+{
+    // 64 位读取不是原子操作, 读取期间关闭中断
+    uint32_t saved_ps = xt_rsil(15);
+    int64_t pos = m_position;
+    xt_wsr_ps(saved_ps);
+    return pos;
+}
+
+void QuadratureEncoder::write(int64_t pos)
+{
+    uint32_t saved_ps = xt_rsil(15);
+    m_position = pos;
+    xt_wsr_ps(saved_ps);
+}
+
+QuadratureEncoder::Stats QuadratureEncoder::get_stats() const
+{
+    uint32_t saved_ps = xt_rsil(15);
+    Stats stats = {m_edges, m_errors, m_isr_max_cycles, m_min_edge_gap_cycles};
+    xt_wsr_ps(saved_ps);
+    return stats;
+}
+
+void QuadratureEncoder::reset_stats()
+{
+    uint32_t saved_ps = xt_rsil(15);
+    m_edges = 0;
+    m_errors = 0;
+    m_isr_max_cycles = 0;
+    m_min_edge_gap_cycles = UINT32_MAX;
+    xt_wsr_ps(saved_ps);
+}
+
+QuadratureEncoder::BenchResult QuadratureEncoder::bench() const
+{
+    // 用临时解码器对象在相同引脚上运行中断处理函数, 不影响实际位置和统计
+    QuadratureEncoder scratch(m_pin_a, m_pin_b);
+
+    uint32_t saved_ps = xt_rsil(15);
+    uint32_t start = ESP.getCycleCount();
+    for (int i = 0; i < BENCH_ITERATIONS; i++)
+    {
+        QuadratureEncoder::isr_(&scratch);
+    }
+    uint32_t cycles = ESP.getCycleCount() - start;
+    xt_wsr_ps(saved_ps);
+
+    BenchResult result;
+    result.handler_cycles = cycles / BENCH_ITERATIONS;
+    result.handler_ns = result.handler_cycles * 1000 / ESP.getCpuFreqMHz();
+    result.max_edge_rate = ESP.getCpuFreqMHz() * 1000000UL / (result.handler_cycles + ISR_DISPATCH_CYCLES);
+    return result;
+}
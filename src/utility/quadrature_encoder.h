@@ -0,0 +1,69 @@
+#pragma once
+
+#include <Arduino.h>
+
+/** 正交编码器解码器
+ *
+ * A/B 两相引脚变化时进入中断, 一次读取 GPIO 输入寄存器得到两相电平, 以状态转换查找表得到位置增量,
+ * 中断处理函数位于 IRAM。两相同时变化属于非法转换 (说明有边沿丢失), 按上次运动方向计 ±2 并计数,
+ * 使位置漂移可被发现。位置以 64 位整数累计, 同时统计中断最大耗时及最短边沿间隔。
+ * 方向约定与 paulstoffregen/Encoder 库一致。仅支持 GPIO0-15。
+ */
+class QuadratureEncoder
+{
+public:
+    static constexpr uint32_t ISR_DISPATCH_CYCLES = 300; // 核心 GPIO 中断入口分发开销估计值(CPU 周期)
+    static constexpr int BENCH_ITERATIONS = 2000;        // 基准测试调用中断处理函数的次数
+
+    struct Stats
+    {
+        uint32_t edges;              // 中断次数
+        uint32_t errors;             // 非法转换次数
+        uint32_t isr_max_cycles;     // 中断处理函数最大耗时(CPU 周期)
+        uint32_t min_edge_gap_cycles; // 最短边沿间隔(CPU 周期)
+    };
+
+    struct BenchResult
+    {
+        uint32_t handler_cycles; // 中断处理函数平均耗时(CPU 周期)
+        uint32_t handler_ns;     // 中断处理函数平均耗时(ns)
+        uint32_t max_edge_rate;  // 估计可持续处理的最高边沿频率(Hz), 含中断分发开销
+    };
+
+    QuadratureEncoder(uint8_t pin_a, uint8_t pin_b);
+    ~QuadratureEncoder();
+
+    /** 配置引脚并挂接中断 */
+    void begin();
+
+    /** 读取位置 (低 32 位) */
+    long read() const { return (long)this->read64(); }
+    /** 读取 64 位位置 */
+    int64_t read64() const;
+    /** 设置位置 */
+    void write(int64_t pos);
+
+    /** 获取统计数据 */
+    Stats get_stats() const;
+    /** 清除统计数据 (不影响位置) */
+    void reset_stats();
+
+    /** 在当前引脚上直接调用中断处理函数测量耗时 (期间关闭中断, 须在电机静止时调用) */
+    BenchResult bench() const;
+
+protected:
+    static void IRAM_ATTR isr_(void *arg);
+
+    uint8_t m_pin_a;
+    uint8_t m_pin_b;
+    bool m_attached;
+    volatile uint8_t m_state;     // 上次两相电平 (B << 1 | A)
+    volatile int8_t m_last_dir;   // 上次运动方向
+    volatile int64_t m_position;
+
+    volatile uint32_t m_edges;
+    volatile uint32_t m_errors;
+    volatile uint32_t m_isr_max_cycles;
+    volatile uint32_t m_last_edge_cycles;
+    volatile uint32_t m_min_edge_gap_cycles;
+};
@@ -0,0 +1,128 @@
+#include "utility/tcp_probe.h"
+
+#include <lwip/dns.h>
+
+TcpProbe::TcpProbe() : m_state(PROBE_IDLE),
+                       m_pcb(nullptr),
+                       m_addr(),
+                       m_port(0),
+                       m_start_ms(0)
+{
+}
+
+TcpProbe::~TcpProbe()
+{
+    this->abort();
+}
+
+bool TcpProbe::start(const char *host, uint16_t port)
+{
+    this->abort();
+
+    m_port = port;
+    m_start_ms = millis();
+    m_state = PROBE_RESOLVING;
+
+    // 已缓存的域名或 IP 地址字符串会立即返回 ERR_OK, 否则在回调中继续
+    err_t err = dns_gethostbyname(host, &m_addr, &TcpProbe::dns_found_cb_, this);
+    if (err == ERR_OK)
+    {
+        this->connect_();
+    }
+    else if (err != ERR_INPROGRESS)
+    {
+        this->finish_(PROBE_FAILED);
+    }
+
+    return m_state != PROBE_FAILED;
+}
+
+TcpProbe::State TcpProbe::poll(unsigned long timeout_ms)
+{
+    if ((m_state == PROBE_RESOLVING || m_state == PROBE_CONNECTING) && millis() - m_start_ms > timeout_ms)
+    {
+        this->finish_(PROBE_FAILED);
+    }
+    return m_state;
+}
+
+void TcpProbe::abort()
+{
+    this->finish_(PROBE_IDLE);
+}
+
+void TcpProbe::connect_()
+{
+    m_pcb = tcp_new();
+    if (m_pcb == nullptr)
+    {
+        this->finish_(PROBE_FAILED);
+        return;
+    }
+
+    m_state = PROBE_CONNECTING;
+    tcp_arg(m_pcb, this);
+    tcp_err(m_pcb, &TcpProbe::error_cb_);
+    if (tcp_connect(m_pcb, &m_addr, m_port, &TcpProbe::connected_cb_) != ERR_OK)
+    {
+        this->finish_(PROBE_FAILED);
+    }
+}
+
+void TcpProbe::finish_(State state)
+{
+    if (m_pcb != nullptr)
+    {
+        tcp_arg(m_pcb, nullptr);
+        tcp_err(m_pcb, nullptr);
+        tcp_abort(m_pcb);
+        m_pcb = nullptr;
+    }
+    m_state = state;
+}
+
+void TcpProbe::dns_found_cb_(const char *name, const ip_addr_t *ipaddr, void *arg)
+{
+    TcpProbe *probe = static_cast<TcpProbe *>(arg);
+
+    // 探测已超时或被中止时忽略迟到的解析结果
+    if (probe->m_state != PROBE_RESOLVING)
+    {
+        return;
+    }
+
+    if (ipaddr == nullptr)
+    {
+        probe->finish_(PROBE_FAILED);
+        return;
+    }
+
+    probe->m_addr = *ipaddr;
+    probe->connect_();
+}
+
+err_t TcpProbe::connected_cb_(void *arg, struct tcp_pcb *pcb, err_t err)
+{
+    TcpProbe *probe = static_cast<TcpProbe *>(arg);
+    if (probe == nullptr)
+    {
+        return ERR_OK;
+    }
+
+    // 握手完成后立即复位连接, 在回调中中止连接必须返回 ERR_ABRT
+    probe->finish_(err == ERR_OK ? PROBE_SUCCEEDED : PROBE_FAILED);
+    return ERR_ABRT;
+}
+
+void TcpProbe::error_cb_(void *arg, err_t err)
+{
+    TcpProbe *probe = static_cast<TcpProbe *>(arg);
+    if (probe == nullptr)
+    {
+        return;
+    }
+
+    // 出错时 lwIP 已释放连接控制块
+    probe->m_pcb = nullptr;
+    probe->m_state = PROBE_FAILED;
+}
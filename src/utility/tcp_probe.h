@@ -0,0 +1,48 @@
+#pragma once
+
+#include <Arduino.h>
+#include <lwip/tcp.h>
+
+/** 非阻塞 TCP 连通性探测
+ *
+ * 直接使用 lwIP 异步接口完成域名解析和 TCP 握手, start() 立即返回,
+ * 之后在主循环中调用 poll() 查询结果。握手成功后立即复位连接。
+ */
+class TcpProbe
+{
+public:
+    enum State
+    {
+        PROBE_IDLE,
+        PROBE_RESOLVING,
+        PROBE_CONNECTING,
+        PROBE_SUCCEEDED,
+        PROBE_FAILED
+    };
+
+    TcpProbe();
+    ~TcpProbe();
+
+    /** 开始探测目标主机端口, 返回 false 表示无法发起探测 */
+    bool start(const char *host, uint16_t port);
+    /** 查询探测状态, 超过 timeout_ms 仍未完成时判定为失败 */
+    State poll(unsigned long timeout_ms);
+    /** 中止探测 */
+    void abort();
+
+    State get_state() const { return m_state; }
+
+protected:
+    void connect_();
+    void finish_(State state);
+
+    static void dns_found_cb_(const char *name, const ip_addr_t *ipaddr, void *arg);
+    static err_t connected_cb_(void *arg, struct tcp_pcb *pcb, err_t err);
+    static void error_cb_(void *arg, err_t err);
+
+    volatile State m_state;
+    struct tcp_pcb *m_pcb;
+    ip_addr_t m_addr;
+    uint16_t m_port;
+    unsigned long m_start_ms;
+};
@@ -0,0 +1,77 @@
+"""构建后统计固件 DRAM 占用 (PlatformIO extra script)
+
+ESP8266 的 DRAM 共 80KB, .data (已初始化变量)、.rodata (未放入 Flash 的常量, 包括普通字符串字面量)
+和 .bss (零初始化变量) 都占用 DRAM, 剩余部分才是堆。每次构建后输出各段大小、与上一次构建的差值,
+以及 .rodata/.data 中最大的符号, 用于确认字符串是否已移到 Flash (PROGMEM)。
+上一次构建的结果保存在 .pio/build/<env>/dram_report.json。
+"""
+
+import json
+import os
+import subprocess
+
+Import("env")  # noqa: F821
+
+DRAM_SIZE = 80 * 1024
+DRAM_SECTIONS = (".data", ".rodata", ".bss")
+TOP_SYMBOLS = 10
+
+
+def read_sections(size_tool, elf):
+    out = subprocess.check_output([size_tool, "-A", elf]).decode()
+    sections = {}
+    for line in out.splitlines():
+        parts = line.split()
+        if len(parts) >= 2 and parts[0] in DRAM_SECTIONS and parts[1].isdigit():
+            sections[parts[0]] = int(parts[1])
+    return sections
+
+
+def read_top_symbols(nm_tool, elf):
+    # 只统计 .data/.rodata 中的符号 (nm 类型 d/D/r/R)
+    out = subprocess.check_output([nm_tool, "--size-sort", "-S", "-C", elf]).decode(errors="replace")
+    symbols = []
+    for line in out.splitlines():
+        parts = line.split(None, 3)
+        if len(parts) == 4 and parts[2] in ("d", "D", "r", "R"):
+            symbols.append((int(parts[1], 16), parts[3]))
+    symbols.sort(reverse=True)
+    return symbols[:TOP_SYMBOLS]
+
+
+def dram_report(source, target, env):
+    elf = str(target[0])
+    size_tool = env.subst("$SIZETOOL")
+    nm_tool = size_tool[: -len("size")] + "nm" if size_tool.endswith("size") else "nm"
+    report_file = os.path.join(env.subst("$BUILD_DIR"), "dram_report.json")
+
+    sections = read_sections(size_tool, elf)
+    used = sum(sections.get(name, 0) for name in DRAM_SECTIONS)
+    sections["total"] = used
+
+    previous = None
+    if os.path.exists(report_file):
+        with open(report_file) as f:
+            previous = json.load(f)
+
+    print("DRAM usage (%s):" % env.subst("$PIOENV"))
+    for name in DRAM_SECTIONS + ("total",):
+        value = sections.get(name, 0)
+        line = "  %-8s %7d bytes" % (name, value)
+        if previous is not None:
+            line += "  (before %7d, %+d)" % (previous.get(name, 0), value - previous.get(name, 0))
+        print(line)
+    print("  free for heap: %d bytes of %d" % (DRAM_SIZE - used, DRAM_SIZE))
+
+    try:
+        print("Largest .data/.rodata symbols:")
+        for size, name in read_top_symbols(nm_tool, elf):
+            print("  %6d  %s" % (size, name))
+    except (OSError, subprocess.CalledProcessError):
+        pass
+
+    with open(report_file, "w") as f:
+        json.dump(sections, f)
+
+
+env.AddPostAction("$BUILD_DIR/${PROGNAME}.elf", dram_report)  # noqa: F821
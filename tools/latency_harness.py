@@ -0,0 +1,171 @@
+"""测量 MQTT 命令从 Broker 到电机首次 PWM 输出的端到端延迟
+
+交替发送 HA 按钮的打开/关闭命令, 每次在电机开始运动后发送停止命令, 窗帘只在当前位置附近小幅往返。
+发布命令前记录主机时刻, 之后轮询设备的 /trace?csv 接口等待新的跟踪记录,
+按每次请求的往返时间中点把设备 micros() 换算为主机时刻, 得到 Broker 到首次 PWM 输出的延迟,
+并与设备端记录的接收 → 分发 → 首次 PWM 间隔对照, 差值即为 Broker 转发、网络传输及等待 MQTT 循环的时间。
+
+用法:
+    pip install paho-mqtt
+    python tools/latency_harness.py --device 192.168.100.246 --device-id <MAC 十六进制> --spawn-broker -n 20
+
+设备的 MQTT 服务器须配置为运行本脚本的主机。--device-id 为 HA 设备唯一标识,
+即 MQTT 主题 aha/<device-id>/blinds_open/cmd_t 中的部分。
+"""
+
+import argparse
+import shutil
+import subprocess
+import sys
+import time
+import urllib.request
+
+import paho.mqtt.client as mqtt
+
+POLL_INTERVAL_S = 0.02
+PWM_TIMEOUT_S = 5.0
+STOP_TIMEOUT_S = 30.0
+STAGE_PWM = 1 << 1
+STAGE_STOP = 1 << 3
+
+
+def fetch_traces(device):
+    """读取设备跟踪记录, 返回 (设备 now_us, 请求往返中点的主机时刻, 往返时间, 记录列表)"""
+    t1 = time.monotonic()
+    with urllib.request.urlopen("http://%s:8080/trace?csv" % device, timeout=2) as resp:
+        body = resp.read().decode()
+    t2 = time.monotonic()
+
+    now_us = None
+    rows = []
+    for line in body.splitlines():
+        if line.startswith("# now_us="):
+            now_us = int(line.split("=", 1)[1])
+        elif line and line[0].isdigit():
+            f = line.split(",")
+            rows.append({
+                "rx_us": int(f[0]),
+                "source": f[1],
+                "channel": int(f[2]),
+                "dispatch_us": int(f[3]),
+                "pwm_us": int(f[4]),
+                "motion_us": int(f[5]),
+                "stop_ms": int(f[6]),
+                "stages": int(f[7]),
+            })
+    return now_us, (t1 + t2) / 2, t2 - t1, rows
+
+
+def device_to_host(dev_us, now_us, host_mid):
+    # micros() 约 71 分钟回绕一次, 按 32 位取差值
+    return host_mid - ((now_us - dev_us) & 0xFFFFFFFF) / 1e6
+
+
+def wait_for_trace(device, rx_after, stage, timeout):
+    """等待 rx_after 之后接收的 MQTT 命令记录到达指定阶段"""
+    deadline = time.monotonic() + timeout
+    while time.monotonic() < deadline:
+        now_us, host_mid, rtt, rows = fetch_traces(device)
+        for row in reversed(rows):
+            if row["source"] != "mqtt":
+                continue
+            if device_to_host(row["rx_us"], now_us, host_mid) < rx_after - rtt:
+                break
+            if row["stages"] & stage:
+                return row, now_us, host_mid, rtt
+        time.sleep(POLL_INTERVAL_S)
+    return None
+
+
+def percentile(values, p):
+    values = sorted(values)
+    return values[max(0, (p * len(values) + 99) // 100 - 1)]
+
+
+def summarize(name, values, unit):
+    if values:
+        print("%-22s n=%-3d p50=%-8.1f p90=%-8.1f p99=%-8.1f max=%-8.1f %s" % (
+            name, len(values), percentile(values, 50), percentile(values, 90),
+            percentile(values, 99), max(values), unit))
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("--device", required=True, help="设备 IP 地址")
+    parser.add_argument("--device-id", required=True, help="HA 设备唯一标识")
+    parser.add_argument("--broker", default="127.0.0.1")
+    parser.add_argument("--port", type=int, default=1883)
+    parser.add_argument("--user")
+    parser.add_argument("--password")
+    parser.add_argument("--prefix", default="aha", help="ArduinoHA 数据主题前缀")
+    parser.add_argument("--spawn-broker", action="store_true", help="在本机启动 mosquitto")
+    parser.add_argument("--settle", type=float, default=1.0, help="每次运动停止后的等待时间(s)")
+    parser.add_argument("-n", "--count", type=int, default=10, help="测量次数")
+    args = parser.parse_args()
+
+    broker = None
+    if args.spawn_broker:
+        mosquitto = shutil.which("mosquitto")
+        if mosquitto is None:
+            sys.exit("mosquitto not found")
+        # mosquitto 2.x 默认只监听本机, 以配置文件允许设备匿名连接
+        conf = "/tmp/latency_harness_mosquitto.conf"
+        with open(conf, "w") as f:
+            f.write("listener %d 0.0.0.0\nallow_anonymous true\n" % args.port)
+        broker = subprocess.Popen([mosquitto, "-c", conf])
+        print("Waiting for the device to connect to the spawned broker...")
+        time.sleep(15)
+
+    try:
+        client = mqtt.Client(mqtt.CallbackAPIVersion.VERSION2)
+    except AttributeError:
+        client = mqtt.Client()
+    if args.user:
+        client.username_pw_set(args.user, args.password)
+    client.connect(args.broker, args.port)
+    client.loop_start()
+
+    def topic(button):
+        return "%s/%s/%s/cmd_t" % (args.prefix, args.device_id, button)
+
+    e2e_ms, dispatch_ms, pwm_ms, motion_ms = [], [], [], []
+    try:
+        for i in range(args.count):
+            button = "blinds_open" if i % 2 == 0 else "blinds_close"
+
+            t_pub = time.monotonic()
+            client.publish(topic(button), "PRESS").wait_for_publish()
+            result = wait_for_trace(args.device, t_pub, STAGE_PWM, PWM_TIMEOUT_S)
+            client.publish(topic("blinds_stop"), "PRESS").wait_for_publish()
+            if result is None:
+                print("#%d %s: no PWM output within %.0f s" % (i, button, PWM_TIMEOUT_S))
+                continue
+
+            row, now_us, host_mid, rtt = result
+            pwm_dev_us = row["rx_us"] + row["dispatch_us"] + row["pwm_us"]
+            e2e = (device_to_host(pwm_dev_us, now_us, host_mid) - t_pub) * 1000
+            e2e_ms.append(e2e)
+            dispatch_ms.append(row["dispatch_us"] / 1000)
+            pwm_ms.append(row["pwm_us"] / 1000)
+            print("#%d %s: broker->PWM %.1f ms (+-%.1f), receipt->dispatch %.1f ms, dispatch->PWM %.1f ms" % (
+                i, button, e2e, rtt * 500, row["dispatch_us"] / 1000, row["pwm_us"] / 1000))
+
+            stopped = wait_for_trace(args.device, t_pub, STAGE_STOP, STOP_TIMEOUT_S)
+            if stopped is not None and stopped[0]["motion_us"]:
+                motion_ms.append(stopped[0]["motion_us"] / 1000)
+            time.sleep(args.settle)
+    finally:
+        client.loop_stop()
+        client.disconnect()
+        if broker is not None:
+            broker.terminate()
+
+    print()
+    summarize("broker->PWM", e2e_ms, "ms")
+    summarize("receipt->dispatch", dispatch_ms, "ms")
+    summarize("dispatch->PWM", pwm_ms, "ms")
+    summarize("PWM->motion", motion_ms, "ms")
+
+
+if __name__ == "__main__":
+    main()
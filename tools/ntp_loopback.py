@@ -0,0 +1,183 @@
+"""模拟 NTP 服务器, 验证设备 NTPService 对各种应答的处理
+
+依次对设备的每个 NTP 请求按测试场景构造应答, 之后读取设备日志 (http://<设备>:8080/) 检查预期结果:
+    cookie  起始时间戳与请求不符, 设备应忽略应答并超时
+    kod     Kiss-o'-Death (stratum 0, RATE), 设备应丢弃
+    unsync  LI = 3 (服务器未同步), 设备应丢弃
+    stale   发送时间早于 2024 年, 设备应丢弃
+    delay   应答延迟 700 ms 且服务器处理时间为 0, 往返延迟超限, 设备应丢弃
+    ok      正常应答, 设备应完成同步
+    drift   连续两次正常应答, 第一次之后服务器时钟以 --drift-ppm 偏快,
+            第二次同步测得的偏差按间隔换算应约为该速率 (设备上报的漂移率经过平滑, 只作参考输出)
+同步失败后设备 60s 重试, 成功后至少 900s 才再次同步 (drift 场景需等待第二次同步)。
+按遥控器 0、4 键可立即触发同步。
+
+固件须以 NTP 服务器指向运行本脚本的主机编译, 例如在 platformio.ini 的 build_flags 中增加:
+    -D NTP_SERVER_HOST=\\"192.168.100.10\\"
+    -D NTP_SERVER_PORT=12300
+用法:
+    python tools/ntp_loopback.py --device 192.168.100.246 --port 12300
+"""
+
+import argparse
+import re
+import socket
+import struct
+import sys
+import time
+import urllib.request
+
+NTP_UNIX_EPOCH_DIFF = 2208988800
+STALE_EPOCH = 1577836800  # 2020-01-01
+DELAY_S = 0.7
+LOG_TIMEOUT_S = 6.0
+SCENARIOS = ["cookie", "kod", "unsync", "stale", "delay", "ok", "drift"]
+EXPECTED = {
+    "cookie": r"NTP request timed out",
+    "kod": r"NTP reply rejected: li=0 mode=4 stratum=0",
+    "unsync": r"NTP reply rejected: li=3",
+    "stale": r"NTP reply rejected: li=0 mode=4 stratum=2",
+    "delay": r"NTP reply rejected: round trip delay",
+    "ok": r"Time synchronized: offset",
+    "drift": r"Time synchronized: offset (-?\d+) ms, delay \d+ ms, drift (-?[\d.]+) ppm",
+}
+
+
+class ServerClock:
+    """测试服务器时钟, 相对主机时钟偏移 offset 秒并以 ppm 偏快"""
+
+    def __init__(self, offset, ppm):
+        self.offset = offset
+        self.ppm = ppm
+        self.start = time.monotonic()
+
+    def now(self):
+        return time.time() + self.offset + (time.monotonic() - self.start) * self.ppm * 1e-6
+
+
+def ntp_timestamp(t):
+    sec = int(t)
+    return struct.pack("!II", sec + NTP_UNIX_EPOCH_DIFF, int((t - sec) * 2 ** 32) & 0xFFFFFFFF)
+
+
+def build_reply(request, t2, t3, li=0, stratum=2, refid=b"LOCL", origin=None):
+    header = struct.pack("!BBbb", (li << 6) | (4 << 3) | 4, stratum, 6, -20)
+    root = struct.pack("!II", 0, 0) + refid
+    origin = request[40:48] if origin is None else origin
+    return header + root + ntp_timestamp(t3) + origin + ntp_timestamp(t2) + ntp_timestamp(t3)
+
+
+def fetch_log(device):
+    with urllib.request.urlopen("http://%s:8080/" % device, timeout=3) as resp:
+        return resp.read().decode(errors="replace")
+
+
+def new_log_lines(before, after):
+    # 日志为环形缓冲区, 以之前最后一行为锚点截取新增部分, 找不到锚点时检查全部内容
+    lines = before.rstrip("\n").split("\n")
+    anchor = lines[-1] if lines and lines[-1] else None
+    if anchor is not None:
+        pos = after.rfind(anchor)
+        if pos >= 0:
+            return after[pos + len(anchor):]
+    return after
+
+
+def wait_log(device, before, pattern):
+    deadline = time.monotonic() + LOG_TIMEOUT_S
+    while time.monotonic() < deadline:
+        match = re.search(pattern, new_log_lines(before, fetch_log(device)))
+        if match:
+            return match
+        time.sleep(0.2)
+    return None
+
+
+def serve_one(sock, device, clock, scenario, timeout):
+    """等待一个请求并按场景应答, 返回设备日志中的匹配结果"""
+    sock.settimeout(timeout)
+    try:
+        request, addr = sock.recvfrom(512)
+    except socket.timeout:
+        sys.exit("no NTP request within %.0f s" % timeout)
+    t2 = clock.now()
+    if len(request) < 48:
+        sys.exit("short NTP request from %s" % addr[0])
+
+    before = fetch_log(device)
+    if scenario == "cookie":
+        origin = bytes(b ^ 0xFF for b in request[40:48])
+        reply = build_reply(request, t2, clock.now(), origin=origin)
+    elif scenario == "kod":
+        reply = build_reply(request, t2, clock.now(), stratum=0, refid=b"RATE")
+    elif scenario == "unsync":
+        reply = build_reply(request, t2, clock.now(), li=3)
+    elif scenario == "stale":
+        reply = build_reply(request, STALE_EPOCH, STALE_EPOCH + 0.001)
+    elif scenario == "delay":
+        # 服务器时间戳表明处理时间为 0, 延迟全部计入网络往返
+        time.sleep(DELAY_S)
+        t = clock.now()
+        reply = build_reply(request, t, t)
+    else:
+        reply = build_reply(request, t2, clock.now())
+    sock.sendto(reply, addr)
+    return wait_log(device, before, EXPECTED[scenario])
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("--device", required=True, help="设备 IP 地址")
+    parser.add_argument("--bind", default="0.0.0.0")
+    parser.add_argument("--port", type=int, default=123, help="监听端口, 须与 NTP_SERVER_PORT 一致")
+    parser.add_argument("--scenarios", default=",".join(SCENARIOS), help="逗号分隔的测试场景")
+    parser.add_argument("--offset", type=float, default=0.0, help="服务器时钟相对主机的偏移(s)")
+    parser.add_argument("--drift-ppm", type=float, default=200.0, help="drift 场景中服务器时钟偏快的速率(ppm)")
+    parser.add_argument("--tolerance-ppm", type=float, default=10.0, help="drift 场景允许的测量误差(ppm)")
+    args = parser.parse_args()
+
+    scenarios = [s for s in args.scenarios.split(",") if s]
+    unknown = [s for s in scenarios if s not in EXPECTED]
+    if unknown:
+        sys.exit("unknown scenarios: %s" % ", ".join(unknown))
+
+    sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+    sock.bind((args.bind, args.port))
+    clock = ServerClock(args.offset, 0.0)
+    print("Listening on %s:%d, press 0 then 4 on the remote to trigger a sync" % (args.bind, args.port))
+
+    failed = 0
+    for scenario in scenarios:
+        print("[%s] waiting for request..." % scenario)
+        if scenario == "drift":
+            # 第一次同步对齐时钟后服务器时钟开始偏快, 第二次同步测得漂移率
+            clock = ServerClock(args.offset, 0.0)
+            if serve_one(sock, args.device, clock, "ok", 120) is None:
+                print("[drift] FAIL: first sync not logged")
+                failed += 1
+                continue
+            clock = ServerClock(args.offset, args.drift_ppm)
+            first_sync = time.monotonic()
+            print("[drift] clock now %+.0f ppm, waiting for the next sync (up to 20 min)..." % args.drift_ppm)
+            match = serve_one(sock, args.device, clock, scenario, 1200)
+            if match is None:
+                ok, detail = False, "second sync not logged"
+            else:
+                # 服务器偏快时设备测得的偏差为正
+                elapsed = time.monotonic() - first_sync
+                measured = float(match.group(1)) * 1000 / elapsed
+                ok = abs(measured - args.drift_ppm) <= args.tolerance_ppm
+                detail = "offset after %.0f s is %.1f ppm, expected %.1f (device drift estimate %s ppm)" % (
+                    elapsed, measured, args.drift_ppm, match.group(2))
+        else:
+            match = serve_one(sock, args.device, clock, scenario, 120)
+            ok, detail = match is not None, (match.group(0) if match else "expected '%s'" % EXPECTED[scenario])
+        print("[%s] %s: %s" % (scenario, "PASS" if ok else "FAIL", detail))
+        failed += 0 if ok else 1
+
+    print("%d/%d scenarios passed" % (len(scenarios) - failed, len(scenarios)))
+    sys.exit(1 if failed else 0)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,53 @@
+"""打包 OTA 镜像: gzip 压缩并附加 SHA-256 摘要 (PlatformIO extra script, 也可单独运行)
+
+输出格式为 <gzip 压缩的镜像><32 字节 SHA-256 摘要><4 字节小端摘要长度>, 摘要针对压缩后的内容计算。
+设备端 Updater 写入完成后校验摘要 (见 src/utility/ota_digest.h), 重启时由 eboot 流式解压。
+文件系统镜像需要以 ATOMIC_FS_UPDATE 编译的固件才能压缩更新。
+
+作为 PlatformIO 脚本时, upload_protocol 为 espota 的 upload 和 uploadfs 目标会先打包为 <镜像>.ota 再上传;
+单独运行时: python tools/ota_pack.py firmware.bin [firmware.bin.ota]
+"""
+
+import gzip
+import hashlib
+import os
+import struct
+import sys
+
+
+def pack(src, dst):
+    with open(src, "rb") as f:
+        raw = f.read()
+    # 固定 mtime 使相同输入得到相同输出
+    data = gzip.compress(raw, compresslevel=9, mtime=0)
+    digest = hashlib.sha256(data).digest()
+    with open(dst, "wb") as f:
+        f.write(data)
+        f.write(digest)
+        f.write(struct.pack("<I", len(digest)))
+    print("OTA image %s: %d -> %d bytes (%.0f%%), sha256 %s" % (
+        os.path.basename(dst), len(raw), len(data), 100.0 * len(data) / max(len(raw), 1), digest.hex()))
+
+
+def pack_before_upload(source, target, env):
+    src = str(source[0])
+    pack(src, src + ".ota")
+
+
+def main():
+    if len(sys.argv) not in (2, 3):
+        sys.exit("usage: ota_pack.py <image.bin> [output]")
+    src = sys.argv[1]
+    pack(src, sys.argv[2] if len(sys.argv) == 3 else src + ".ota")
+
+
+try:
+    Import("env")  # noqa: F821
+except NameError:
+    if __name__ == "__main__":
+        main()
+else:
+    if env.subst("$UPLOAD_PROTOCOL") == "espota":  # noqa: F821
+        env.AddPreAction("upload", pack_before_upload)  # noqa: F821
+        env.AddPreAction("uploadfs", pack_before_upload)  # noqa: F821
+        env.Replace(UPLOADCMD=env["UPLOADCMD"].replace("$SOURCE", "${SOURCE}.ota"))  # noqa: F821
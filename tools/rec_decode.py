@@ -0,0 +1,212 @@
+"""解码设备输入记录 (/record 下载的 rec.bin), 输出事件时间线或与另一份记录比较电机输出
+
+记录由编译时定义 ENABLE_RECORDER 的固件生成 (见 src/service/recorder.h):
+    <文件头 8 字节: magic "CBRT", 版本, 通道数, 保留>
+    之后每条记录为 <类型 1 字节><距上条记录的时间间隔 us, varint><负载>
+有符号数以 zigzag varint 编码。编码器记录为相对上次记录值的差, 由同步记录给出起点。
+
+主机重放驱动 (src/host/replay_main.cpp, pio run -e replay) 把记录中的输入送入在 Linux 上编译的控制逻辑,
+产生的输入及输出以同样格式写出, 可用 --compare 与设备记录比较 PWM 输出及停止事件。
+两份设备记录或不同固件版本的重放结果之间同样可以比较。
+
+用法:
+    curl -o rec.bin http://<设备地址>:8080/record
+    python tools/rec_decode.py rec.bin              # 文本时间线
+    python tools/rec_decode.py rec.bin --jsonl      # 每行一个 JSON 事件
+    python tools/rec_decode.py rec.bin --compare replay.bin
+"""
+
+import argparse
+import json
+import struct
+import sys
+
+RECORD_MAGIC = 0x54524243
+RECORD_VERSION = 2
+
+TYPE_BOOT = 1
+TYPE_SYNC = 2
+TYPE_ENCODER = 3
+TYPE_IR = 4
+TYPE_MQTT = 5
+TYPE_HTTP = 6
+TYPE_PWM = 7
+TYPE_STOP = 8
+TYPE_DROPPED = 9
+TYPE_CLOCK = 10
+
+MOTOR_CONF = struct.Struct("<5iB3x")  # ConfigService::MotorConf
+TUNING_CONF = struct.Struct("<9fB3x")  # ConfigService::TuningConf
+CALIBRATION_CONF = struct.Struct("<8B7i")  # ConfigService::CalibrationConf
+TUNING_KEYS = ("kp", "ki", "kd", "pid_sample_ms", "stable_sample_ms", "stable_n_sample",
+               "speed_cutoff_hz", "rel_err_tol", "abs_err_tol")
+STOP_REASONS = ("reached", "stalled", "command", "manual", "calibration")
+HTTP_METHODS = ("ANY", "GET", "HEAD", "POST", "PUT", "PATCH", "DELETE", "OPTIONS")
+
+
+class Reader:
+    def __init__(self, data, pos=0):
+        self.data = data
+        self.pos = pos
+
+    def eof(self):
+        return self.pos >= len(self.data)
+
+    def u8(self):
+        value = self.data[self.pos]
+        self.pos += 1
+        return value
+
+    def bytes(self, n):
+        if self.pos + n > len(self.data):
+            raise EOFError
+        value = self.data[self.pos:self.pos + n]
+        self.pos += n
+        return value
+
+    def unpack(self, st):
+        return st.unpack(self.bytes(st.size))
+
+    def varint(self):
+        value = shift = 0
+        while True:
+            b = self.u8()
+            value |= (b & 0x7F) << shift
+            shift += 7
+            if not b & 0x80:
+                return value
+
+    def svarint(self):
+        value = self.varint()
+        return (value >> 1) ^ -(value & 1)
+
+
+def decode(path):
+    """逐条解码记录, 返回事件列表, 时间 t_us 为自文件中首个同步记录起的微秒数"""
+    with open(path, "rb") as f:
+        data = f.read()
+    magic, version, channels = struct.unpack_from("<IBB", data)
+    if magic != RECORD_MAGIC or version != RECORD_VERSION:
+        sys.exit("%s: not a version %d recording" % (path, RECORD_VERSION))
+
+    r = Reader(data, 8)
+    events = []
+    t_us = None
+    pos = [0] * channels
+    while not r.eof():
+        try:
+            kind = r.u8()
+            dt = r.varint()
+            if t_us is not None:
+                t_us += dt
+            ev = {}
+            if kind == TYPE_BOOT:
+                boot_ms, reason, n = struct.unpack("<IBB", r.bytes(6))
+                ev = {"type": "boot", "millis": boot_ms, "reset_reason": reason, "channels": []}
+                for _ in range(n):
+                    motor = r.unpack(MOTOR_CONF)
+                    tuning = r.unpack(TUNING_CONF)
+                    calib = r.unpack(CALIBRATION_CONF)
+                    count = min(calib[0], 7)
+                    ev["channels"].append({
+                        "close_pos": motor[0], "open_pos": motor[1], "current_pos": motor[2],
+                        "backlash": motor[3], "slack": motor[4], "reversed": bool(motor[5]),
+                        "tuning": dict(zip(TUNING_KEYS, tuning[:9])) if tuning[9] else None,
+                        "calibration": [{"percent": calib[1 + i], "pos": calib[8 + i]} for i in range(count)],
+                    })
+                ev["group"] = r.bytes(r.varint()).decode(errors="replace")
+            elif kind == TYPE_SYNC:
+                sync_us, epoch_ms = struct.unpack("<Iq", r.bytes(12))
+                pos = [r.svarint() for _ in range(channels)]
+                # 首个同步记录作为时间原点
+                t_us = 0 if t_us is None else t_us
+                ev = {"type": "sync", "micros": sync_us, "epoch_ms": epoch_ms, "pos": list(pos)}
+            elif kind == TYPE_ENCODER:
+                ch = r.u8()
+                pos[ch] += r.svarint()
+                ev = {"type": "encoder", "channel": ch, "pos": pos[ch]}
+            elif kind == TYPE_IR:
+                address, command, flags = struct.unpack("<HBB", r.bytes(4))
+                ev = {"type": "ir", "address": address, "command": command, "flags": flags}
+            elif kind == TYPE_MQTT:
+                topic = r.bytes(r.varint()).decode(errors="replace")
+                payload = r.bytes(r.varint()).decode(errors="replace")
+                ev = {"type": "mqtt", "topic": topic, "payload": payload}
+            elif kind == TYPE_HTTP:
+                method = r.u8()
+                request = r.bytes(r.varint()).decode(errors="replace")
+                name = HTTP_METHODS[method] if method < len(HTTP_METHODS) else str(method)
+                ev = {"type": "http", "method": name, "request": request}
+            elif kind == TYPE_PWM:
+                ch = r.u8()
+                ev = {"type": "pwm", "channel": ch, "pwm": r.svarint()}
+            elif kind == TYPE_STOP:
+                ch = r.u8()
+                stop_pos = r.svarint()
+                reason = r.u8()
+                ev = {"type": "stop", "channel": ch, "pos": stop_pos,
+                      "reason": STOP_REASONS[reason] if reason < len(STOP_REASONS) else reason}
+            elif kind == TYPE_DROPPED:
+                ev = {"type": "dropped", "count": r.varint()}
+            elif kind == TYPE_CLOCK:
+                (epoch_ms,) = struct.unpack("<q", r.bytes(8))
+                ev = {"type": "clock", "epoch_ms": epoch_ms}
+            else:
+                print("%s: unknown record type %d at offset %d, stopping" % (path, kind, r.pos), file=sys.stderr)
+                break
+        except (EOFError, IndexError):
+            # 设备仍在写入或断电时最后一条记录可能不完整
+            print("%s: truncated record at end of file" % path, file=sys.stderr)
+            break
+        ev["t_us"] = t_us or 0
+        events.append(ev)
+    return events
+
+
+def format_event(ev):
+    t = "%12.3f ms" % (ev["t_us"] / 1000.0)
+    fields = " ".join("%s=%s" % (k, v) for k, v in ev.items() if k not in ("type", "t_us"))
+    return "%s  %-8s %s" % (t, ev["type"], fields)
+
+
+def outputs(events):
+    return [ev for ev in events if ev["type"] in ("pwm", "stop")]
+
+
+def compare(a_path, a, b_path, b):
+    """比较两份记录的电机输出序列, 返回是否一致"""
+    out_a, out_b = outputs(a), outputs(b)
+    strip = lambda ev: {k: v for k, v in ev.items() if k != "t_us"}
+    max_skew = 0
+    for i, (ea, eb) in enumerate(zip(out_a, out_b)):
+        if strip(ea) != strip(eb):
+            print("First divergence at output #%d:" % i)
+            print("  %s: %s" % (a_path, format_event(ea)))
+            print("  %s: %s" % (b_path, format_event(eb)))
+            return False
+        max_skew = max(max_skew, abs(ea["t_us"] - eb["t_us"]))
+    if len(out_a) != len(out_b):
+        print("Output count differs: %s has %d, %s has %d" % (a_path, len(out_a), b_path, len(out_b)))
+        return False
+    stops = sum(1 for ev in out_a if ev["type"] == "stop")
+    print("Outputs match: %d PWM changes, %d stops, max timing difference %.3f ms" % (
+        len(out_a) - stops, stops, max_skew / 1000.0))
+    return True
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("recording")
+    parser.add_argument("--jsonl", action="store_true", help="每行输出一个 JSON 事件")
+    parser.add_argument("--compare", metavar="OTHER", help="与另一份记录比较 PWM 输出及停止事件")
+    args = parser.parse_args()
+
+    events = decode(args.recording)
+    if args.compare:
+        sys.exit(0 if compare(args.recording, events, args.compare, decode(args.compare)) else 1)
+    for ev in events:
+        print(json.dumps(ev, ensure_ascii=False) if args.jsonl else format_event(ev))
+
+
+if __name__ == "__main__":
+    main()